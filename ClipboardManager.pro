@@ -8,7 +8,7 @@ DEFINES += APP_NAME=\\\"Xclipy\\\"
 DEFINES += APP_ORGANIZATION=\\\"Xclipy\\\"
 DEFINES += APP_DOMAIN=\\\"xclipy.com\\\"
 
-QT += core gui widgets
+QT += core gui widgets network
 
 CONFIG += c++17
 
@@ -36,6 +36,12 @@ unix:!macx {
     # Linux needs X11
     CONFIG += link_pkgconfig
     PKGCONFIG += x11
+
+    # Optional: XTest for synthesizing paste keystrokes from paste hotkeys
+    packagesExist(xtst) {
+        PKGCONFIG += xtst
+        DEFINES += XCLIPY_HAVE_XTEST
+    }
 }
 
 # Source files
@@ -44,14 +50,64 @@ SOURCES += \
     src/ClipboardManager.cpp \
     src/HistoryWindow.cpp \
     src/PreferencesWindow.cpp \
-    src/GlobalHotkey.cpp
+    src/GlobalHotkey.cpp \
+    src/ChangeCoalescer.cpp \
+    src/Benchmarks.cpp \
+    src/HistoryStore.cpp \
+    src/CapturePipeline.cpp \
+    src/HistorySnapshot.cpp \
+    src/ClipboardProbe.cpp \
+    src/EntryArena.cpp \
+    src/HistoryModel.cpp \
+    src/NearDuplicateIndex.cpp \
+    src/HistorySearch.cpp \
+    src/Frecency.cpp \
+    src/HistoryArchive.cpp \
+    src/PinStore.cpp \
+    src/SharedHistoryRing.cpp \
+    src/SingleInstance.cpp \
+    src/HistoryExport.cpp \
+    src/ContentClassifier.cpp \
+    src/PreviewPane.cpp \
+    src/ClipboardDriver.cpp \
+    src/WorkloadTrace.cpp \
+    src/MemoryAccounting.cpp \
+    src/TimerWheel.cpp \
+    src/ExpiryIndex.cpp \
+    src/SourceIndex.cpp
 
 # Header files
 HEADERS += \
     include/ClipboardManager.h \
     include/HistoryWindow.h \
     include/PreferencesWindow.h \
-    include/GlobalHotkey.h
+    include/GlobalHotkey.h \
+    include/ChangeCoalescer.h \
+    include/Benchmarks.h \
+    include/HistoryStore.h \
+    include/CapturePipeline.h \
+    include/SpscQueue.h \
+    include/SnapshotPublisher.h \
+    include/HistorySnapshot.h \
+    include/ClipboardProbe.h \
+    include/EntryArena.h \
+    include/HistoryModel.h \
+    include/NearDuplicateIndex.h \
+    include/HistorySearch.h \
+    include/Frecency.h \
+    include/HistoryArchive.h \
+    include/PinStore.h \
+    include/SharedHistoryRing.h \
+    include/SingleInstance.h \
+    include/HistoryExport.h \
+    include/ContentClassifier.h \
+    include/PreviewPane.h \
+    include/ClipboardDriver.h \
+    include/WorkloadTrace.h \
+    include/MemoryAccounting.h \
+    include/TimerWheel.h \
+    include/ExpiryIndex.h \
+    include/SourceIndex.h
 
 # Build directory
 DESTDIR = build
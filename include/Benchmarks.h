@@ -0,0 +1,12 @@
+#pragma once
+#include <QStringList>
+
+// Headless benchmarks for the capture engine, run with:
+//   Xclipy --benchmark <name> [--option=value ...]
+// Results are printed to stdout as "key: value" lines.
+namespace Benchmarks {
+
+bool isBenchmarkInvocation(int argc, char *argv[]);
+int run(const QStringList &arguments);
+
+}
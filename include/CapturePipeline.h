@@ -0,0 +1,287 @@
+#pragma once
+#include <QObject>
+#include <QSemaphore>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QLockFile>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include "SpscQueue.h"
+#include "HistoryStore.h"
+#include "HistorySnapshot.h"
+#include "NearDuplicateIndex.h"
+#include "Frecency.h"
+#include "ExpiryIndex.h"
+#include "SourceIndex.h"
+#include "HistoryArchive.h"
+#include "PinStore.h"
+#include "HistoryExport.h"
+#include "SharedHistoryRing.h"
+#include "WorkloadTrace.h"
+
+class QIODevice;
+class QLocalServer;
+class QLocalSocket;
+class QThread;
+class QTimer;
+
+// Moves everything after the clipboard read off the GUI thread.
+// The GUI thread pushes raw snapshots and history commands into a lock-free
+// SPSC queue. A worker thread publishes the pins, recovers the store, then
+// hashes, classifies,
+// indexes, compresses and persists items in order (entries trimmed off the
+// end can move to a cold HistoryArchive), and publishes the
+// resulting history as an immutable snapshot once per drained batch.
+// Between batches it sleeps until the next entry is due to expire, and
+// removes every entry due by then in one batch.
+// Any thread may take the current snapshot without blocking the worker.
+//
+// Instances of Xclipy on different displays share one store with a single
+// writer: whoever holds the store's lock file. The writer mirrors each
+// committed journal batch into a SharedHistoryRing. Follower instances
+// recover the store read-only, then replay the ring. They forward their
+// captures and commands to the writer over a local socket, and take over
+// the lock when the writer exits.
+class CapturePipeline : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Stage {
+        QueueWait,
+        Hash,
+        Classify,
+        Index,
+        Similarity,
+        Compress,
+        Persist,
+        Publish,
+        Count
+    };
+
+    struct StageStats {
+        QString name;
+        quint64 count = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+    };
+
+    explicit CapturePipeline(const QString &storeDirectory = QString(), QObject *parent = nullptr);
+    ~CapturePipeline();
+
+    // Starts the worker; it recovers stored history before processing any item
+    void start(int maxHistorySize, int maxSelectionHistorySize);
+    void stop();
+    bool isRecovered() const;
+    // False while another instance owns the store and this one follows it
+    bool isWriter() const { return !following.load(std::memory_order_relaxed); }
+
+    // Any thread; wait-free
+    HistorySnapshotRef snapshot() const;
+    // Cold tier; its search and counters are safe from any thread
+    const HistoryArchive *archive() const { return &coldArchive; }
+
+    // Producer side: GUI thread only
+    // concealed: the owner marked the text as a password; source: the
+    // application it was copied from, if known (see SourceIndex); formats:
+    // what the owner advertised, for the workload trace
+    bool submitText(const QString &text, bool concealed = false, const QString &source = QString(),
+                    quint8 formats = WorkloadTrace::FormatText);
+    bool submitFiles(const QStringList &files, const QString &source = QString(),
+                     quint8 formats = WorkloadTrace::FormatFiles);
+    bool submitSelection(const QString &text, quint8 formats = WorkloadTrace::FormatText);
+    // Also drops the pin of a pinned entry
+    void removeEntry(const QString &text);
+    // Pinned entries move out of history into a tier exempt from trimming;
+    // unpinning returns an entry to the front of history
+    void pinEntry(const QString &text);
+    void unpinEntry(const QString &text);
+    // Counts a paste or copy from history as a use of that entry
+    void touchEntry(const QString &text, quint8 formats = WorkloadTrace::FormatText);
+    void clear();
+    void setLimits(int maxHistorySize, int maxSelectionHistorySize);
+    // Normalized dedup drops clips equal up to whitespace and line endings;
+    // a threshold >= 0 groups clips whose fingerprints differ by at most that many bits
+    void setDedupOptions(bool normalize, int nearDuplicateThreshold);
+    // Entries trimmed past the history limit go to the cold archive instead of being dropped
+    void setArchiveEvicted(bool enabled);
+    // History entries older than maxAgeSeconds, and concealed ones older than
+    // concealedSeconds, are removed; 0 keeps them (see ExpiryIndex)
+    void setExpiry(qint64 maxAgeSeconds, qint64 concealedSeconds);
+    // Merges an export file into the history (see HistoryExport); entries
+    // already kept are skipped. Runs in slices between capture batches.
+    void importHistory(const QString &path);
+    // Records this instance's capture events to path (see WorkloadTrace),
+    // on the worker, which has each clip's bytes and kinds; empty stops
+    void setWorkloadTrace(const QString &path);
+
+    QVector<StageStats> stageStats() const;
+    void resetStageStats();
+    quint64 droppedCount() const;
+    quint64 duplicateCount() const;
+    static QString stageName(Stage stage);
+
+signals:
+    void recovered(const HistoryStore::RecoveryStats &stats, bool migrated);
+    void importFinished(const HistoryExport::Stats &stats);
+    // Delivered on the GUI thread after a new snapshot is published
+    void historyPublished(quint64 version);
+
+private:
+    struct Item {
+        enum class Type : quint8 {
+            Text,
+            Files,
+            Selection,
+            Remove,
+            Pin,
+            Unpin,
+            Use,
+            Clear,
+            Import,
+            Limits,
+            Dedup,
+            ArchiveOption,
+            Expiry,
+            Trace,
+            Stop
+        };
+        Type type = Type::Text;
+        QString text;
+        QString source;
+        int maxHistory = 0;
+        int maxSelections = 0;
+        bool normalize = false;
+        int threshold = -1;
+        bool archive = false;
+        bool concealed = false;
+        qint64 maxAge = 0;
+        qint64 concealedLifetime = 0;
+        quint32 requester = 0;  // followerLinks id of the instance that forwarded it; 0 = this one
+        quint8 traceFormats = WorkloadTrace::FormatText;
+        bool traceOnly = false; // follower: a forwarded item, queued here only to be traced
+        bool traced = false;    // forwarded: the instance that sent it traced it
+        qint64 enqueuedNs = 0;
+    };
+
+    struct StageCounter {
+        std::atomic<quint64> count{0};
+        std::atomic<qint64> totalNs{0};
+        std::atomic<qint64> maxNs{0};
+    };
+
+    bool push(Item &&item, bool mayDrop);
+    void launch();
+    void run();
+    void publishRecovered(const HistoryStore::RecoveryStats &stats, bool migrated);
+    // Cross-instance sharing; the socket side runs on the GUI thread
+    QString linkName() const;
+    void listenForFollowers();
+    void connectToWriter();
+    bool forward(const Item &item);
+    void receiveForwarded(QIODevice *device, quint32 requester = 0);
+    // Follower: results of the items it forwarded, sent back by the writer
+    void receiveReplies();
+    void tryPromote();
+    void commitStore();
+    // Follower worker
+    void runFollower();
+    bool follow();
+    void resync(HistoryStore::RecoveryStats *stats);
+    void adoptFollowed();
+    struct ImportJob;
+    void startImport(const QString &path, quint32 requester);
+    bool importSlice();
+    bool archiveImported(ImportJob &job, const HistoryExport::Record &record, quint32 hash);
+    bool finishImport();
+    void reportImport(const HistoryExport::Stats &stats, quint32 requester);
+    void loadPins();
+    void savePins();
+    // Drops history copies of pinned entries; true if there were any
+    bool removePinned(QStringList *list) const;
+    void recoverStore();
+    bool process(Item &item);
+    void capture(Item &item, HistoryStore::List list);
+    // kinds: the clip's as stored, or nullptr to classify it here
+    void traceItem(const Item &item, QByteArrayView utf8, const ContentClassifier::Kinds *kinds);
+    void trim(HistoryStore::List list);
+    bool pin(const QString &text);
+    bool unpin(const QString &text);
+    void recordPrepend(const QString &text, const QByteArray &utf8);
+    QString frecencyPath() const;
+    QString expiryPath() const;
+    QString sourcesPath() const;
+    // Removes the history entries whose time is up; true if there were any
+    bool expireDue();
+    // Starts the entry's expiry clock and copies it into the entry
+    void trackExpiry(HistoryEntry *entry, bool concealed, qint64 time = ExpiryIndex::now());
+    void stampExpiry(HistoryEntry *entry) const;
+    bool indexEntry(QByteArrayView utf8, quint32 hash, bool rebuilding, quint32 *group);
+    void unindex(QByteArrayView utf8, quint32 hash);
+    // classified: kinds already known by content hash, to skip reclassifying
+    void rebuildIndexes(const QHash<quint32, ContentClassifier::Kinds> *classified = nullptr);
+    void publish();
+    // Reports the worker's index, archive and buffer footprint to MemoryAccounting
+    void accountMemory();
+    void record(Stage stage, qint64 ns);
+
+    // Worker-owned state
+    HistoryStore store;
+    HistoryArchive coldArchive;
+    PinStore pinStore;
+    EntryArena arena;
+    EntryList history;
+    EntryList selections;
+    EntryList pins;
+    bool pinsChanged = false;
+    bool snapshotDue = false;       // set when a change is too wide for the journal
+    std::unique_ptr<ImportJob> importJob;
+    QByteArray committedRecords;    // for the ring, since the last batch
+    SharedHistoryRing sharedRing;
+    HistoryStore::State followed;   // follower: the writer's history, replayed
+    quint64 ringEpoch = 0;
+    quint64 ringCursor = 0;
+    QHash<quint32, int> hashIndex;
+    QHash<quint64, int> normalizedIndex;
+    NearDuplicateIndex nearDuplicates;
+    FrecencyIndex frecency;
+    ExpiryIndex expiry;
+    bool expirySaveDue = false;     // a concealed entry's clock must survive a crash
+    SourceIndex sources;
+    bool normalizeDuplicates = false;
+    int nearDuplicateThreshold = -1;
+    bool archiveEvicted = false;
+    quint64 version = 0;
+    HistorySnapshotPublisher snapshots;
+    int maxHistory = 50;
+    int maxSelections = 20;
+
+    SpscQueue<Item> queue;
+    QSemaphore available;
+    QThread *worker;
+    QElapsedTimer clock;
+    std::atomic<bool> recoveredFlag{false};
+    std::atomic<bool> following{false};
+    QLockFile writerLock;
+    QLocalServer *followerServer = nullptr;
+    QHash<quint32, QLocalSocket *> followerLinks;   // writer: connected followers
+    quint32 nextFollowerId = 0;
+    QLocalSocket *writerLink = nullptr;
+    QByteArray pendingForward;
+    WorkloadTrace::Recorder trace;      // worker thread only
+    std::atomic<bool> tracing{false};
+    QTimer *promoteTimer = nullptr;
+    std::atomic<quint64> dropped{0};
+    std::atomic<quint64> duplicates{0};
+    StageCounter counters[int(Stage::Count)];
+
+    static const int kCompressThreshold = 4096;
+    static const int kFollowIntervalMs = 100;
+    static const int kPromoteIntervalMs = 2000;
+    static const int kMaxPendingForward = 1024 * 1024;
+    static const int kImportSlice = 8192;
+    static const int kMaxExpiryWaitMs = 60 * 60 * 1000;
+    static const quint8 kConcealedFlag = 0x80;
+    static const quint8 kSourceFlag = 0x40;     // the frame's text is followed by a source app
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <QtGlobal>
+
+// Collapses a burst of change notifications into a single commit.
+// With the Trailing policy a change is committed once no further change has
+// been seen for the quiet period, or once maxDelay has passed since the burst
+// started so that a value that never stops changing is still recorded.
+// Leading commits the first change of a burst and suppresses the rest;
+// Immediate commits every change. Time is passed in explicitly so bursts can
+// be replayed deterministically.
+class ChangeCoalescer {
+public:
+    enum class Policy {
+        Immediate,
+        Leading,
+        Trailing
+    };
+
+    explicit ChangeCoalescer(int quietPeriodMs = 400, int maxDelayMs = 5000);
+
+    void setPolicy(Policy policy);
+    Policy policy() const;
+
+    void setQuietPeriod(int ms);
+    int quietPeriod() const;
+    void setMaxDelay(int ms);
+    int maxDelay() const;
+
+    // Record a change observed at nowMs and restart the quiet window.
+    // Returns true if the change should be committed right away.
+    bool noteChange(qint64 nowMs);
+
+    // Ends the pending burst once it has settled; true if the settled value
+    // should be committed now (Trailing only)
+    bool takeSettled(qint64 nowMs);
+
+    // Milliseconds until the pending burst can settle, or -1 if nothing is pending
+    qint64 msUntilSettled(qint64 nowMs) const;
+
+    bool hasPending() const;
+    void reset();
+
+    quint64 changeCount() const;
+    quint64 commitCount() const;
+    quint64 suppressedCount() const;
+
+private:
+    Policy currentPolicy = Policy::Trailing;
+    int quietPeriodMs;
+    int maxDelayMs;
+    bool pending = false;
+    qint64 burstStartMs = 0;
+    qint64 lastChangeMs = 0;
+    quint64 changes = 0;
+    quint64 commits = 0;
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QStringList>
+
+// Synthetic clipboard owner for end-to-end capture measurements, run with:
+//   Xclipy --drive-clipboard --log=<path> [--rate=50] [--size=256] [--count=500]
+//                            [--burst=1] [--settle=2000]
+// It takes the CLIPBOARD `burst` times per tick, `rate` ticks per second,
+// each time with a distinct `size`-byte text, and keeps owning it for
+// `settle` ms after the last change so the final one can still be read.
+// Every change is logged as "<ns> <hash> <bytes> <seq>".
+//
+// A capturing Xclipy started with XCLIPY_CAPTURE_LOG=<path> logs each text
+// it takes from the clipboard as "<ns> <hash> <bytes>" (see logLine), on the
+// same monotonic clock, so scripts/e2e-capture.sh can match the two logs.
+namespace ClipboardDriver {
+
+bool isDriverInvocation(int argc, char *argv[]);
+int run(const QStringList &arguments);
+
+// Monotonic nanoseconds, comparable across processes on one machine
+qint64 monotonicNs();
+// "<ns> <hash> <bytes>", without a line break
+QByteArray logLine(QByteArrayView utf8);
+
+}
@@ -5,19 +5,79 @@
 #include <QSettings>
 #include <QKeySequence>
 #include <QMimeData>
+#include <QVector>
+#include <QElapsedTimer>
+#include "ChangeCoalescer.h"
+#include "HistoryStore.h"
+#include "CapturePipeline.h"
+#include "ClipboardProbe.h"
+#include "WorkloadTrace.h"
 
 class GlobalHotkey;
+class QFile;
+class QThread;
+class QTimer;
 
 class ClipboardManager : public QObject {
     Q_OBJECT
 
 public:
+    // Actions a global hotkey can be bound to
+    enum class HotkeyAction {
+        ToggleHistory,
+        PasteEntry
+    };
+
+    struct HotkeyBinding {
+        QKeySequence keySequence;
+        HotkeyAction action = HotkeyAction::ToggleHistory;
+        int entryIndex = 0; // PasteEntry: 0 is the most recent entry
+    };
+
+    // Groups setter calls into one update. Until the outermost transaction
+    // ends, setters only change the values; then settings are written and
+    // synced once, the capture worker gets each changed option once,
+    // hotkeys are re-registered only if they differ from before the
+    // transaction, and settingsChanged is emitted once. Every setter runs
+    // in a transaction of its own when called outside one.
+    class SettingsTransaction {
+    public:
+        explicit SettingsTransaction(ClipboardManager *manager);
+        ~SettingsTransaction();
+
+        SettingsTransaction(const SettingsTransaction &) = delete;
+        SettingsTransaction &operator=(const SettingsTransaction &) = delete;
+
+    private:
+        ClipboardManager *manager;
+    };
+
     explicit ClipboardManager(QObject *parent = nullptr);
-    const QStringList& getHistory() const;
+    ~ClipboardManager();
+    
+    // Loads stored history on a background thread; emits historyReady when merged
+    void loadHistoryAsync();
+    bool isHistoryLoaded() const;
+    
+    // Per-stage capture latency
+    QVector<CapturePipeline::StageStats> getPipelineStats() const;
+    // Stage latencies and per-subsystem memory, current and peak
+    void logPipelineStats() const;
+    // Consistent view of history, selections and pins; safe to hand to other threads
+    HistorySnapshotRef historySnapshot() const;
+    const HistoryArchive *historyArchive() const;
     void clearHistory();
     void setClipboardText(const QString &text);
     void setClipboardFiles(const QStringList &filePaths);
     void removeFromHistory(const QString &text);
+    // Pinned entries are listed first and never trimmed
+    void pinEntry(const QString &text);
+    void unpinEntry(const QString &text);
+    // Backup and restore (see HistoryExport). Both run off the GUI thread and
+    // report through exportFinished / importFinished; export returns false
+    // while an earlier export is still running.
+    bool exportHistory(const QString &path);
+    void importHistory(const QString &path);
     
     // Settings management
     void setMaxHistorySize(int size);
@@ -33,34 +93,174 @@ public:
     bool isGlobalHotkeyEnabled() const;
     void setGlobalHotkeyEnabled(bool enabled);
     
+    // Direct paste hotkeys (Ctrl+Alt+1..9 by default)
+    void setPasteHotkeysEnabled(bool enabled);
+    bool isPasteHotkeysEnabled() const;
+    void setPasteHotkeyBindings(const QList<HotkeyBinding> &bindings);
+    QList<HotkeyBinding> getPasteHotkeyBindings() const;
+    void setSynthesizePaste(bool enabled);
+    bool getSynthesizePaste() const;
+    void pasteHistoryEntry(int index);
+    
+    // X11 PRIMARY selection tracking, kept in its own bounded ring
+    void setTrackPrimarySelection(bool enabled);
+    bool getTrackPrimarySelection() const;
+    void setSelectionQuietPeriod(int ms);
+    int getSelectionQuietPeriod() const;
+    void setMaxSelectionHistorySize(int size);
+    int getMaxSelectionHistorySize() const;
+    bool isSelectionSupported() const;
+    
+    // Debouncing of rapid successive clipboard owner changes
+    void setCaptureDebouncePolicy(ChangeCoalescer::Policy policy);
+    ChangeCoalescer::Policy getCaptureDebouncePolicy() const;
+    void setCaptureDebounceWindow(int ms);
+    int getCaptureDebounceWindow() const;
+    quint64 getSuppressedCaptureCount() const;
+    
+    // Duplicate handling: normalized dedup and collapsing of similar clips
+    void setNormalizeDuplicates(bool enabled);
+    bool getNormalizeDuplicates() const;
+    void setCollapseNearDuplicates(bool enabled);
+    bool getCollapseNearDuplicates() const;
+    void setNearDuplicateThreshold(int bits);
+    int getNearDuplicateThreshold() const;
+
+    // History window order: most recent first, or by frecency
+    void setRankByFrecency(bool enabled);
+    bool getRankByFrecency() const;
+
+    // Keep entries trimmed past the history limit in the searchable cold archive
+    void setArchiveEvictedEntries(bool enabled);
+    bool getArchiveEvictedEntries() const;
+
+    // Expiry: history entries older than the maximum age (days), and entries
+    // a password manager marked, after their lifetime (seconds); 0 keeps them
+    void setHistoryMaxAge(int days);
+    int getHistoryMaxAge() const;
+    void setConcealedEntryLifetime(int seconds);
+    int getConcealedEntryLifetime() const;
+
+    // Applications never recorded from, by WM_CLASS or process name
+    // (case-insensitive); their clipboard contents are never even read
+    void setExcludedSourceApps(const QStringList &apps);
+    QStringList getExcludedSourceApps() const;
+
+    // Opt-in anonymized trace of capture events, for replaying real
+    // workloads (see WorkloadTrace); a new file is started each time
+    void setRecordWorkloadTrace(bool enabled);
+    bool getRecordWorkloadTrace() const;
+    QString workloadTracePath() const;
+    
     void loadSettings();
     void saveSettings();
 
 signals:
-    void historyChanged(const QStringList &history);
+    void historyChanged();
+    void historyReady();
     void showHistoryRequested();
     void toggleHistoryRequested();
+    void selectionHistoryChanged();
+    // Once per settings transaction that changed anything
+    void settingsChanged();
+    void exportFinished(const HistoryExport::Stats &stats);
+    void importFinished(const HistoryExport::Stats &stats);
 
 private slots:
     void checkClipboard();
+    void pollClipboard();
+    void onClipboardChanged();
+    void onCaptureSettled();
     void onGlobalHotkeyPressed(int id);
+    void onSelectionChanged();
+    void commitSelection();
+    void onPipelineRecovered(const HistoryStore::RecoveryStats &stats, bool migrated);
+    void onHistoryPublished(quint64 version);
 
 private:
+    // What a settings transaction has to apply when it ends
+    enum SettingsChange : quint32 {
+        PersistSettings = 0x01,
+        PipelineLimits = 0x02,
+        PipelineDedup = 0x04,
+        PipelineArchive = 0x08,
+        GlobalHotkeyChange = 0x10,
+        PasteHotkeyChange = 0x20,
+        PipelineExpiry = 0x40
+    };
+
+    void beginSettingsUpdate();
+    void endSettingsUpdate();
+    void settingsUpdated(quint32 changes);
+    void applySettingsChanges(quint32 changes);
     void registerGlobalHotkey();
+    void registerPasteHotkeys();
+    void unregisterPasteHotkeys();
+    static QList<HotkeyBinding> defaultPasteHotkeyBindings();
     void checkClipboardForFiles();
+    void markClipboardSeen();
+    static QStringList localFiles(const QMimeData *mimeData);
+    void applyDedupOptions();
+    void applyExpiry();
+    static quint8 traceFormats(const ClipboardProbe::Signature &signature);
+    bool isExcludedSource(const ClipboardProbe::Source &source) const;
     QClipboard *clipboard;
     QString lastText;
     QStringList lastFiles;
-    QStringList history;
+    ClipboardProbe clipboardProbe;
+    ClipboardProbe::Signature lastSignature;
+    HistorySnapshotRef publishedSnapshot;
     QSettings settings;
+    CapturePipeline *pipeline;
+    bool historyLoaded = false;
+    QThread *exportThread = nullptr;
+    QFile *captureLog = nullptr;   // XCLIPY_CAPTURE_LOG, for the end-to-end harness
     bool selfCopy = false;
     
+    // PRIMARY selection capture
+    QString lastSelection;
+    ClipboardProbe::Signature lastSelectionSignature;
+    ChangeCoalescer selectionCoalescer;
+    QTimer *selectionTimer;
+    QElapsedTimer captureClock;
+    
+    // Clipboard burst debouncing
+    ChangeCoalescer clipboardCoalescer;
+    QTimer *captureTimer;
+    
     // Configurable settings
     int maxHistorySize = 50;
     bool autoStart = false;
     bool showTrayIcon = true;
     QKeySequence globalHotkey = QKeySequence("Ctrl+Shift+V");
     bool globalHotkeyEnabled = true;
+    bool pasteHotkeysEnabled = false;
+    bool synthesizePaste = false;
+    QList<HotkeyBinding> pasteHotkeyBindings;
+    bool trackPrimarySelection = false;
+    int selectionQuietPeriod = 400;
+    int maxSelectionHistorySize = 20;
+    ChangeCoalescer::Policy captureDebouncePolicy = ChangeCoalescer::Policy::Trailing;
+    int captureDebounceWindow = 150;
+    bool normalizeDuplicates = false;
+    bool collapseNearDuplicates = false;
+    int nearDuplicateThreshold = 3;
+    bool rankByFrecency = false;
+    bool archiveEvictedEntries = false;
+    int historyMaxAgeDays = 0;
+    int concealedEntryLifetime = 60;
+    QStringList excludedSourceApps;
+    bool recordWorkloadTrace = false;
+    QString tracePath;      // recorded by the pipeline's worker; empty when off
+
+    // Open settings transactions, and what they changed so far
+    int settingsUpdateDepth = 0;
+    quint32 pendingSettingsChanges = 0;
+    QKeySequence hotkeyBeforeUpdate;
+    bool hotkeyEnabledBeforeUpdate = true;
+    
+    // Indexed by hotkey id for O(1) dispatch; id 0 is the history toggle
+    QVector<HotkeyBinding> hotkeyBindings;
     
     // Global hotkey instance
     GlobalHotkey *globalHotkeyManager;
@@ -0,0 +1,56 @@
+#pragma once
+#include <QClipboard>
+#include <QStringList>
+#include <memory>
+
+// Cheap clipboard change detection that never transfers the payload.
+// A signature is built from the selection owner, its change stamp (X11
+// TIMESTAMP target, Windows sequence number, macOS pasteboard change count)
+// and the advertised formats, so a poll can tell "nothing changed" or "no
+// format we store" without copying megabytes out of the owning application.
+// The formats also tell whether a password manager marked the contents as
+// a password, so it can be kept only briefly.
+//
+// The owner also names the application the contents came from (X11
+// WM_CLASS and _NET_WM_PID, the owning process on Windows), so it can be
+// excluded before anything is read. Owners are looked up once each: the
+// result is cached by owner window until the server reports it destroyed.
+class ClipboardProbe {
+public:
+    struct Source {
+        QString app;        // WM_CLASS class, else the process name; empty if unknown
+        QString instance;   // WM_CLASS instance
+        qint64 pid = 0;
+
+        bool isKnown() const { return !app.isEmpty(); }
+        // Case-insensitive, against either WM_CLASS name
+        bool matches(const QStringList &apps) const;
+    };
+
+    struct Signature {
+        bool valid = false;     // false: the platform can't tell, read the contents
+        quint64 owner = 0;
+        quint64 stamp = 0;
+        bool hasText = true;
+        bool hasFiles = true;
+        bool concealed = false; // the owner marked it as a password (x-kde-passwordManagerHint)
+        Source source;          // may be known even when valid is false
+
+        bool operator==(const Signature &other) const {
+            return valid && other.valid && owner == other.owner && stamp == other.stamp;
+        }
+        bool operator!=(const Signature &other) const { return !(*this == other); }
+    };
+
+    ClipboardProbe();
+    ~ClipboardProbe();
+
+    ClipboardProbe(const ClipboardProbe &) = delete;
+    ClipboardProbe &operator=(const ClipboardProbe &) = delete;
+
+    Signature probe(QClipboard::Mode mode);
+
+private:
+    struct Platform;
+    std::unique_ptr<Platform> platform;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <QByteArrayView>
+#include <QString>
+
+// Tells what a clip holds, so the history window can filter and render by
+// kind. An entry may be several kinds at once (a command line that holds a
+// URL), so kinds are bits of a small set kept in the entry's metadata.
+//
+// Classification runs on the capture worker. It starts with one pass over
+// the first kScanBytes that records which marker bytes occur, how many
+// lines and blanks there are and whether all of it is ASCII; on x86 that
+// pass compares 16 bytes at a time with SSE2. Most kinds are then rejected
+// from that profile alone (no '@' is no email, a blank is no URL or token),
+// and only the survivors get a precise check.
+class ContentClassifier {
+public:
+    enum Kind : quint16 {
+        Url = 0x0001,
+        Email = 0x0002,
+        Json = 0x0004,
+        Color = 0x0008,
+        Code = 0x0010,
+        Command = 0x0020,
+        FilePath = 0x0040,
+        Secret = 0x0080,
+        Classified = 0x8000     // set on every result, so plain text isn't classified again
+    };
+    using Kinds = quint16;
+
+    static const int kKindCount = 8;
+    static const int kScanBytes = 64 * 1024;
+
+    static Kinds classify(QByteArrayView utf8);
+    static Kind kindAt(int index) { return Kind(1 << index); }
+    static QString kindName(Kind kind);
+
+    // Which marker bytes occur, by Marker bit
+    struct Profile {
+        quint32 markers = 0;
+        int lines = 0;          // newline count + 1
+        int blanks = 0;         // spaces and tabs
+        bool ascii = true;
+    };
+
+    enum Marker : quint32 {
+        Colon = 0x0001,
+        At = 0x0002,
+        Brace = 0x0004,         // { or }
+        Bracket = 0x0008,       // [ or ]
+        Hash = 0x0010,
+        Slash = 0x0020,
+        Semicolon = 0x0040,
+        Equals = 0x0080,
+        Paren = 0x0100,         // ( or )
+        Pipe = 0x0200,
+        Dollar = 0x0400,
+        Backslash = 0x0800,
+        Quote = 0x1000,         // " or '
+        Dot = 0x2000,
+        Ampersand = 0x4000,
+        Greater = 0x8000
+    };
+
+    static Profile profile(QByteArrayView utf8);
+    // Same result without SIMD, for comparison
+    static Profile profileScalar(QByteArrayView utf8);
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <QByteArrayView>
+#include <QString>
+
+// Immutable history entry body, stored as UTF-8 inside an EntryArena slab.
+// The handle is the size of a QString; copies share the slab, and a slab is
+// freed once the last entry pointing into it is gone. Decoding to QString is
+// left to the caller: a bounded preview for visible rows, the full text only
+// on paste or copy.
+class Utf8Entry {
+public:
+    Utf8Entry() = default;
+    Utf8Entry(const Utf8Entry &other);
+    Utf8Entry(Utf8Entry &&other) noexcept;
+    Utf8Entry &operator=(Utf8Entry other) noexcept;
+    ~Utf8Entry();
+
+    bool isNull() const { return slab == nullptr; }
+    int size() const { return length; }
+    quint32 hash() const { return hashValue; }
+    QByteArrayView bytes() const { return QByteArrayView(data, length); }
+    bool equals(QByteArrayView utf8, quint32 utf8Hash) const;
+
+    QString toString() const;
+    // Leading text up to maxLines non-empty lines or maxBytes, whichever comes first
+    QString preview(int maxLines, int maxBytes, bool *truncated = nullptr) const;
+
+    static quint32 hashOf(QByteArrayView utf8);
+
+private:
+    friend class EntryArena;
+    struct Slab;
+
+    Slab *slab = nullptr;
+    const char *data = nullptr;
+    int length = 0;
+    quint32 hashValue = 0;
+};
+
+// Bump allocator for entry bodies. Small entries are packed into shared
+// slabs; large ones get a slab of their own so evicting them returns the
+// memory at once. Entries are only ever appended, and history evicts
+// oldest-first, so slabs empty out roughly in allocation order. Entries
+// that outlive their neighbours (promoted, pinned) are re-stored into the
+// current slab, so a few survivors don't keep an old slab alive; see also
+// EntryList::compact.
+class EntryArena {
+public:
+    explicit EntryArena(int slabSize = 64 * 1024);
+    ~EntryArena();
+
+    EntryArena(const EntryArena &) = delete;
+    EntryArena &operator=(const EntryArena &) = delete;
+
+    // Writer thread only
+    Utf8Entry store(QByteArrayView utf8, quint32 hash);
+    Utf8Entry store(const QString &text);
+    // Copies entry into the current slab; one with a slab of its own, or
+    // already in the current one, is returned as is
+    Utf8Entry restore(const Utf8Entry &entry);
+    // The shared slab entry lives in, or nullptr for its own or the current one
+    const void *sharedSlabOf(const Utf8Entry &entry) const;
+    int slabBytes() const { return slabSize; }
+
+    // Process-wide, across all arenas and slabs still referenced by snapshots
+    static qint64 allocatedBytes();
+    static qint64 liveSlabCount();
+
+private:
+    Utf8Entry::Slab *current = nullptr;
+    int slabSize;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "TimerWheel.h"
+
+// When history entries are due to be forgotten, owned by the capture
+// worker. Two policies, each off at 0: a maximum age for every entry, and
+// a short lifetime for entries their owner marked as passwords (see
+// ClipboardProbe::Signature::concealed). An entry's age counts from when it
+// was last captured; once marked, an entry stays marked.
+//
+// Deadlines are found through a TimerWheel with one-second ticks, so the
+// worker sleeps until the next one instead of scanning history, and a
+// batch of entries falling due together is taken at once. Capture times
+// are saved beside the history store like frecency keys; an entry without
+// one is aged from when it was first seen.
+class ExpiryIndex {
+public:
+    ExpiryIndex();
+
+    // Seconds since the epoch
+    static qint64 now();
+
+    void setPolicy(qint64 maxAgeSeconds, qint64 concealedSeconds);
+    // Starts an entry's clock again (a capture or re-copy)
+    void track(quint32 hash, bool concealed, qint64 time = now());
+    // Starts the clock of an entry that has none
+    void seed(quint32 hash, qint64 time = now());
+    bool contains(quint32 hash) const { return entries.contains(hash); }
+    bool isConcealed(quint32 hash) const { return entries.value(hash).concealed; }
+    // When the entry was last captured, or 0 when it has no clock
+    qint64 capturedAt(quint32 hash) const { return entries.value(hash).capturedAt; }
+    qint64 maxAgeSeconds() const { return maxAge; }
+    void remove(quint32 hash) { entries.remove(hash); }
+    void clear();
+    int size() const { return entries.size(); }
+
+    // Drops the entries for which stale(hash) is true
+    template <typename F>
+    void removeIf(F stale) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (stale(it.key())) {
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // Entries whose time is up, each returned once and forgotten here
+    QVector<quint32> takeExpired(qint64 time = now());
+    // Until the next deadline, or -1 when nothing is due to expire
+    qint64 msUntilNext() const;
+
+    bool load(const QString &path);
+    bool save(const QString &path) const;
+    qint64 memoryBytes() const;
+
+private:
+    struct Entry {
+        qint64 capturedAt = 0;
+        bool concealed = false;
+    };
+
+    // -1 when no policy applies to the entry
+    qint64 deadlineOf(const Entry &entry) const;
+    void schedule(quint32 hash, const Entry &entry);
+    void reschedule();
+
+    QHash<quint32, Entry> entries;
+    TimerWheel wheel;
+    qint64 maxAge = 0;
+    qint64 concealedLifetime = 0;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <algorithm>
+
+// Frecency: how often an entry was used, with each use decaying by half
+// every kHalfLifeHours. Scores are kept in the log domain, as
+// key = log2(sum of 2^(t_use / halfLife)), so a key never has to be
+// re-scored as time passes: every entry decays at the same rate, and the
+// order of keys is the order of their decayed scores at any later moment.
+// A use is then one O(1) log-add on that entry's key.
+//
+// Keys are per content hash, like the pipeline's duplicate index, and are
+// owned by the capture worker. It stamps each history entry's key into the
+// published snapshot, where any reader can rank entries without a lookup.
+class FrecencyIndex {
+public:
+    static const int kHalfLifeHours = 72;
+
+    // The current time in half-lives since a fixed epoch
+    static double now();
+
+    // Records a use at time and returns the entry's new key
+    float bump(quint32 hash, double time = now(), double weight = 1.0);
+    // Gives an entry with no recorded use the key of a single use at time
+    float seed(quint32 hash, double time);
+    // Takes key from another copy of the history (an import). Keeps the higher
+    // one rather than adding, so importing the same uses twice counts them once.
+    float merge(quint32 hash, float key);
+    bool contains(quint32 hash) const { return keys.contains(hash); }
+    float key(quint32 hash) const { return keys.value(hash); }
+    void remove(quint32 hash) { keys.remove(hash); }
+    void clear() { keys.clear(); }
+    int size() const { return keys.size(); }
+    qint64 memoryBytes() const;
+
+    // Drops the keys of entries for which stale(hash) is true
+    template <typename F>
+    void removeIf(F stale) {
+        for (auto it = keys.begin(); it != keys.end();) {
+            if (stale(it.key())) {
+                it = keys.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // Keys are advisory, so they are saved beside the history store rather
+    // than journaled; a crash loses at most the uses since the last save
+    bool load(const QString &path);
+    bool save(const QString &path) const;
+
+private:
+    QHash<quint32, float> keys;
+};
+
+// Max-heap of rows by frecency key, newer entry first on ties. Building it
+// is O(N) and each row taken is O(log N), so showing the top K rows of a
+// ranked view costs O(N + K log N) instead of sorting everything.
+class FrecencyHeap {
+public:
+    struct Item {
+        float key;
+        int entry;
+    };
+
+    void assign(QVector<Item> &&rows) {
+        items = std::move(rows);
+        std::make_heap(items.begin(), items.end(), lower);
+    }
+    bool isEmpty() const { return items.isEmpty(); }
+    int size() const { return items.size(); }
+    void clear() { items.clear(); }
+    qint64 memoryBytes() const { return qint64(items.capacity()) * qint64(sizeof(Item)); }
+
+    // Pops up to count rows, best first
+    QVector<Item> take(int count) {
+        QVector<Item> top;
+        top.reserve(qMin(count, int(items.size())));
+        while (count-- > 0 && !items.isEmpty()) {
+            std::pop_heap(items.begin(), items.end(), lower);
+            top.append(items.takeLast());
+        }
+        return top;
+    }
+
+    // True when a ranks below b
+    static bool lower(const Item &a, const Item &b) {
+        return a.key < b.key || (a.key == b.key && a.entry > b.entry);
+    }
+
+private:
+    QVector<Item> items;
+};
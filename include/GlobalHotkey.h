@@ -3,6 +3,8 @@
 #include <QKeySequence>
 #include <QHash>
 
+class QSocketNotifier;
+
 #ifdef Q_OS_MAC
 #include <Carbon/Carbon.h>
 #endif
@@ -35,6 +37,9 @@ public:
     // Check if hotkey is supported on this platform
     static bool isSupported();
 
+    // Inject a platform paste keystroke (Cmd+V / Ctrl+V) into the focused window
+    bool synthesizePaste();
+
 signals:
     void hotkeyPressed(int id);
 
@@ -43,6 +48,9 @@ private:
         QKeySequence keySequence;
         int id;
         bool registered;
+#ifdef Q_OS_MAC
+        EventHotKeyRef ref = nullptr;
+#endif
     };
 
     QHash<int, HotkeyInfo> hotkeys;
@@ -67,7 +75,11 @@ private:
     Display *display;
     Window rootWindow;
     static GlobalHotkey *instance;
-    static void handleXEvent(XEvent *event);
+    QSocketNotifier *eventNotifier;
+    QHash<quint64, int> grabbedKeys; // (keycode << 32 | modifiers) -> our ID
+    void processXEvents();
+    void handleXEvent(XEvent *event);
+    static quint64 grabKey(unsigned int keyCode, unsigned int modifiers);
     int keyCodeForQtKey(int qtKey);
     int modifierFlagsForQtModifiers(Qt::KeyboardModifiers modifiers);
 #endif
@@ -0,0 +1,122 @@
+#pragma once
+#include <QByteArray>
+#include <QCache>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include "HistorySearch.h"
+
+// Cold tier of the history: entries trimmed from the in-memory hot tier are
+// kept in immutable, compressed segment files instead of being dropped.
+//
+// Evicted entries first go to a staging file (length + checksum records,
+// fsynced with the journal batch). Once it reaches kSegmentBytes or the day
+// changes, it is sealed into "seg-NNNNNNNN.xcs": a header with the entry
+// count, time range and a Bloom filter over the case-folded UTF-8 trigrams
+// of every entry, followed by the qCompress'ed entries. Segments are never
+// rewritten, so readers need no coordination beyond the segment list.
+//
+// A cold search folds the needle the same way and skips every segment whose
+// filter lacks one of its trigrams, reading only that segment's header.
+// Only segments that may match are decompressed. Needles shorter than a
+// trigram cannot be filtered and scan every segment.
+//
+// Entries age from when they were archived. Past an expiry cutoff they are
+// no longer read, are left out when staging is sealed, and a segment is
+// deleted once its newest entry is past it.
+//
+// append(), flush(), open() and clear() belong to the capture worker;
+// search() and the counters may be called from any thread.
+class HistoryArchive {
+public:
+    struct SearchStats {
+        int segments = 0;
+        int segmentsSkipped = 0;
+        qint64 compressedBytesRead = 0;
+        int matches = 0;
+        bool complete = true;
+    };
+
+    explicit HistoryArchive(const QString &directory);
+
+    QString directory() const { return dir; }
+    bool open();
+    // archivedAt is in seconds since the epoch; 0 means now
+    void append(QByteArrayView utf8, qint64 archivedAt = 0);
+    // Writes staged records; seals the staging file when it is due
+    void flush();
+    void clear();
+    // Forgets entries archived before cutoff (seconds since the epoch); 0 keeps all
+    void expireBefore(qint64 cutoff);
+
+    bool isEmpty() const;
+    qint64 entryCount() const { return entries.load(std::memory_order_relaxed); }
+    int segmentCount() const;
+    // Unsealed entries and cached filters held in memory
+    qint64 memoryBytes() const;
+    // Records not yet written to the staging file; capture worker only
+    qint64 pendingBytes() const { return pendingRecords.capacity(); }
+
+    // Case-insensitive substring search, newest first. onHits is called per
+    // segment with its matches (SearchHit::archivedUtf8 set, entry = -1).
+    // Stops after limit hits or when cancelled is set; useFilters=false
+    // scans every segment (for comparison).
+    SearchStats search(const QString &text, int limit, const std::atomic<bool> &cancelled,
+                       const std::function<void(const QVector<SearchHit> &)> &onHits,
+                       bool useFilters = true) const;
+
+    // Calls f(utf8, archivedAt) for every entry, oldest first; stops if f
+    // returns false. False if a segment could not be read.
+    bool forEachEntry(const std::function<bool(const QByteArray &, qint64)> &f) const;
+
+    static QByteArray foldForFilter(const QString &text);
+
+    static const int kSegmentBytes = 1024 * 1024;
+
+private:
+    struct Segment {
+        quint32 sequence = 0;
+        int count = 0;
+        QString path;
+        qint64 lastAt = 0;      // newest entry's archive time
+    };
+    struct Filter {
+        QByteArray bits;
+        int hashes = 0;
+    };
+    struct Staged {
+        QByteArray utf8;
+        qint64 archivedAt = 0;
+    };
+
+    QString segmentPath(quint32 sequence) const;
+    QString stagingPath() const;
+    bool recoverStaging();
+    bool seal();
+    // Truncates the staging file once its entries are sealed or dropped
+    bool resetStaging();
+    bool loadFilter(const Segment &segment, Filter *filter) const;
+    static bool readSegment(const Segment &segment, QVector<Staged> *items, qint64 *compressedBytes);
+    static QByteArray buildFilter(const QVector<Staged> &items, int *hashes);
+    static bool mayContain(const Filter &filter, const QVector<quint32> &trigrams);
+    static QVector<quint32> trigramsOf(const QByteArray &folded);
+    static void matchEntry(const QByteArray &utf8, const QString &text, QVector<SearchHit> *hits);
+
+    QString dir;
+    QFile staging;
+    QByteArray pendingRecords;
+    qint64 stagedBytes = 0;
+    qint64 stagingDay = -1;
+    quint32 nextSequence = 1;
+
+    // Shared with searching threads
+    mutable QMutex mutex;
+    QVector<Segment> segments;          // oldest first
+    QVector<Staged> staged;             // not yet sealed, oldest first
+    mutable QCache<quint32, Filter> filters;
+    std::atomic<qint64> entries{0};
+    std::atomic<qint64> cutoff{0};
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <QByteArray>
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+#include "HistorySnapshot.h"
+
+class HistoryArchive;
+
+// Portable backup of the history, for restoring it or moving it to another
+// machine. An export file ("XCEX") is a header followed by one record per
+// entry and an end record holding the entry count:
+//
+//   header  magic, version, created (ms since epoch)
+//   record  tier, flags, frecency key, timestamp, stored length, checksum,
+//           source length, body, source app
+//   end     tier 0, entry count
+//
+// Bodies are UTF-8; those over kCompressThreshold are stored qCompress'ed.
+// Frecency keys are absolute (see FrecencyIndex), so they stay meaningful on
+// another machine. The timestamp of a hot entry is its capture time and a
+// flag marks passwords, so an import ages them as the exporting side would
+// have. Version 1 files, without source apps, are still read.
+//
+// Archived entries come first, oldest first, so an import can append them
+// to its own archive in order; then history and selections, newest first,
+// then pins.
+//
+// Both sides stream through a fixed-size buffer: neither holds more than one
+// record beyond it, whatever the size of the file.
+class HistoryExport {
+public:
+    enum class Tier : quint8 {
+        End = 0,
+        History = 1,
+        Selection = 2,
+        Pinned = 3,
+        Archived = 4
+    };
+
+    struct Record {
+        Tier tier = Tier::History;
+        QByteArray utf8;
+        float frecency = 0;     // 0 = no recorded use
+        qint64 timestamp = 0;   // seconds; archived entries: archived at, others: captured at; 0 = unknown
+        bool concealed = false; // marked as a password
+        QString source;         // app it was copied from; empty = unknown
+    };
+
+    struct Stats {
+        qint64 entries = 0;     // written, or read
+        qint64 added = 0;       // import: new hot, selection and pinned entries
+        qint64 archived = 0;    // import: entries appended to the archive
+        qint64 duplicates = 0;  // import: already present
+        qint64 skipped = 0;     // import: no room, or the archive is off
+        qint64 bytes = 0;
+        qint64 elapsedMs = 0;
+        bool ok = false;
+        bool complete = false;  // import: the end record was reached
+        QString error;
+
+        qint64 entriesPerSecond() const { return elapsedMs > 0 ? entries * 1000 / elapsedMs : entries; }
+    };
+
+    class Writer {
+    public:
+        explicit Writer(const QString &path);
+
+        bool open();
+        bool write(Tier tier, QByteArrayView utf8, float frecency = 0, qint64 timestamp = 0,
+                   bool concealed = false, const QString &source = QString());
+        // Writes the end record and atomically replaces the file
+        bool finish();
+        QString errorString() const { return file.errorString(); }
+        qint64 count() const { return records; }
+        qint64 bytesWritten() const { return written; }
+
+    private:
+        bool flushBuffer();
+
+        QSaveFile file;
+        QByteArray buffer;
+        qint64 records = 0;
+        qint64 written = 0;
+    };
+
+    class Reader {
+    public:
+        explicit Reader(const QString &path);
+
+        bool open();
+        // Next entry; false at the end record, at the end of a truncated
+        // file, or on a damaged record (see isComplete and errorString)
+        bool next(Record *record);
+        bool isComplete() const { return complete; }
+        QString errorString() const { return error; }
+        qint64 bytesRead() const { return consumed; }
+
+    private:
+        bool fill(qsizetype needed);
+
+        QFile file;
+        QByteArray buffer;
+        quint32 version = 0;
+        qsizetype offset = 0;
+        qint64 consumed = 0;
+        qint64 records = 0;
+        bool complete = false;
+        QString error;
+    };
+
+    // Writes pins, history, selections and, when given, the archive. Safe
+    // off the GUI thread: the snapshot is immutable and the archive's reads
+    // are thread-safe.
+    static bool write(const QString &path, const HistorySnapshot &snapshot,
+                      const HistoryArchive *archive, Stats *stats);
+
+    static const int kCompressThreshold = 4096;
+    static const int kBufferBytes = 256 * 1024;
+};
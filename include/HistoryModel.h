@@ -0,0 +1,151 @@
+#pragma once
+#include <QAbstractListModel>
+#include <QCache>
+#include <QHash>
+#include <QIcon>
+#include <QSet>
+#include <QVector>
+#include "HistorySnapshot.h"
+#include "HistorySearch.h"
+#include "Frecency.h"
+
+// List model over a published history snapshot. Rows are never copied into
+// the view: DisplayRole decodes a bounded preview of a UTF-8 entry when a
+// row is shown, and EntryTextRole decodes the full text for copy and paste.
+// Near-duplicate groups collapse behind their newest entry unless expanded.
+// While filtering, each row carries its match ranges, found once by the
+// filter or the regex search; a row whose first match lies past its head is
+// previewed from the match's line instead. Ranked by frecency, rows come
+// off a heap a page at a time as the view scrolls (fetchMore), so only what
+// is shown is ever ordered. Pinned entries head every view except a regex
+// search, in pin order. A plain filter may also be answered from the cold
+// archive; those rows follow the live ones and are read-only. A kind filter
+// keeps rows by the kinds the capture worker stored with each entry, a bit
+// test per entry, and rows are iconed (secrets masked) by kind. A source
+// filter likewise keeps rows copied from one application, by the app id
+// stored with each entry; archived rows have no source and drop out.
+class HistoryModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    enum Role {
+        EntryTextRole = Qt::UserRole,
+        SimilarCountRole,       // on a group's newest entry: how many older clips it hides
+        SimilarMemberRole,      // an older clip shown under its expanded group
+        MatchRangesRole,        // QVector<TextRange> to highlight in DisplayRole text
+        PinnedRole              // a row of the pinned section
+    };
+
+    explicit HistoryModel(QObject *parent = nullptr);
+
+    void setSnapshot(const HistorySnapshotRef &snapshot);
+    void setFilter(const QString &filter);
+    // Regex search mode: rows are the snapshot's matches, inserted in
+    // history order as HistorySearch streams them in
+    void beginSearch(const HistorySnapshotRef &snapshot);
+    void addMatches(const QVector<SearchHit> &hits);
+    void endSearch();
+    bool isSearching() const { return searching; }
+    // Archive hits for the current filter, appended after the live rows
+    void addArchiveMatches(const QVector<SearchHit> &hits);
+    bool isArchived(int row) const { return tierOf(row) == Tier::Archived; }
+    bool isPinned(int row) const { return tierOf(row) == Tier::Pinned; }
+    // Most frecent first instead of most recent first; groups are not collapsed
+    void setRankByFrecency(bool enabled);
+    // Only entries of any of these kinds; 0 shows every entry. Rows are flat.
+    void setKindFilter(ContentClassifier::Kinds kinds);
+    ContentClassifier::Kinds kindFilter() const { return kinds; }
+    // Only entries copied from this application; empty shows every entry. Rows are flat.
+    void setSourceFilter(const QString &app);
+    QString sourceFilter() const { return sourceApp; }
+    // Applications the current snapshot's entries came from
+    QStringList sourceApps() const;
+    QString sourceAt(int row) const;
+    QString entryText(int row) const;
+    // The stored body, for views that page through it instead of decoding it
+    Utf8Entry entryAt(int row) const;
+    ContentClassifier::Kinds kindsAt(int row) const;
+    // Where the row's first match starts in its full text (UTF-16), or -1
+    int firstMatchAt(int row) const;
+    // Expands or collapses the near-duplicate group of the given row
+    void toggleGroup(int row);
+    bool isGroupExpanded(int row) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    static bool isFileEntry(const QString &text);
+    // Maps ranges (in preview offsets) to the returned text when given
+    static QString formatForDisplay(const QString &preview, bool truncated, int maxLines,
+                                    QVector<TextRange> *ranges = nullptr);
+
+private:
+    struct Row {
+        QString display;
+        QIcon icon;
+        QVector<TextRange> highlights;  // in display offsets
+    };
+
+    // Where a row's entry lives; entry indexes the snapshot list or archive hits
+    enum class Tier : quint8 {
+        History,
+        Pinned,
+        Archived
+    };
+
+    struct ViewRow {
+        int entry;
+        int similar;
+        bool member;
+        float rank = 0;
+        Tier tier = Tier::History;
+    };
+
+    // Identifies an entry across tiers, for the row cache and match ranges
+    static qint64 keyOf(Tier tier, int entry) { return (qint64(tier) << 32) | quint32(entry); }
+    static qint64 keyOf(const ViewRow &row) { return keyOf(row.tier, row.entry); }
+
+    void clearArchived();
+    Tier tierOf(int row) const;
+    QVector<TextRange> findMatches(const Utf8Entry &body) const;
+    bool matchesKind(ContentClassifier::Kinds entryKinds) const { return kinds == 0 || (entryKinds & kinds); }
+    bool matchesSource(quint16 entrySource) const {
+        return sourceApp.isEmpty() || (entrySource != 0 && entrySource == sourceId);
+    }
+    bool matches(const HistoryEntry &entry) const { return matchesKind(entry.kinds) && matchesSource(entry.source); }
+    bool isFiltered() const { return kinds != 0 || !sourceApp.isEmpty(); }
+    // Resolves the source filter against the snapshot's app table
+    void resolveSource();
+    static QIcon iconFor(ContentClassifier::Kinds entryKinds, const Utf8Entry &entry);
+    const Row *rowAt(int row) const;
+    QString matchPreview(const Utf8Entry &entry, QVector<TextRange> *ranges, bool *truncated) const;
+    void rebuildRows();
+    // Reports the view rows and row cache to MemoryAccounting
+    void accountMemory() const;
+    static qint64 rowBytes(const Row &row);
+
+    HistorySnapshotRef snapshot;
+    QString filter;
+    QVector<ViewRow> viewRows;
+    QSet<quint32> expandedGroups;
+    QHash<qint64, QVector<TextRange>> matchRanges;  // by keyOf(), while filtering
+    bool searching = false;
+    bool ranked = false;
+    ContentClassifier::Kinds kinds = 0;
+    QString sourceApp;
+    quint16 sourceId = 0;   // sourceApp's id in the snapshot; 0 when no entry has it
+    FrecencyHeap rankedRows;  // ranked rows not yet fetched into viewRows
+    mutable QCache<qint64, Row> rows;   // cost is rowBytes()
+    // Archive hits, kept in their own arena
+    EntryArena archivedArena;
+    QVector<Utf8Entry> archived;
+    int archivedRows = 0;   // trailing viewRows that are archived
+
+    static const int kPreviewLines = 4;
+    static const int kPreviewBytes = 4096;
+    static const int kRowCacheBytes = 1024 * 1024;
+    static const int kRankedPage = 100;
+    static const int kMatchContext = 40;  // characters kept before a match deep in a long line
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include <QObject>
+#include <QCache>
+#include <QDeadlineTimer>
+#include <QRegularExpression>
+#include <QThreadPool>
+#include <QMetaType>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include "HistorySnapshot.h"
+
+// A match in an entry's decoded text, in UTF-16 code units
+struct TextRange {
+    int start = 0;
+    int length = 0;
+};
+Q_DECLARE_METATYPE(TextRange)
+
+// One matching entry with the ranges to highlight, first match first
+struct SearchHit {
+    int entry = -1;             // index into the searched snapshot; -1 when archived
+    QVector<TextRange> ranges;
+    QByteArray archivedUtf8;    // body of a hit from the cold archive
+};
+
+class HistoryArchive;
+
+// Regular-expression search over a history snapshot.
+//
+// Patterns are compiled (and JIT-optimized) once and kept in a small cache,
+// so retyping or toggling back to a pattern costs nothing. A query splits the
+// snapshot into contiguous shards that run on a private thread pool and
+// stream sorted match batches back to the owning thread. Each hit carries
+// its match offsets, so views can highlight without matching again. Starting a new
+// query cancels the previous one, and every query stops at its time budget.
+// Both checks happen between entries; a single backtracking-heavy match is
+// bounded by PCRE2's match limit instead, and never blocks the caller.
+class HistorySearch : public QObject {
+    Q_OBJECT
+
+public:
+    explicit HistorySearch(QObject *parent = nullptr);
+    ~HistorySearch() override;
+
+    // Starts searching the snapshot's history and returns the query's
+    // generation, or 0 if the pattern does not compile (see errorString())
+    quint64 start(const HistorySnapshotRef &snapshot, const QString &pattern);
+    void cancel();
+
+    // Plain-text search of the cold archive, newest first. It runs on its
+    // own thread, so it never queues behind regex shards, and starting one
+    // cancels the previous archive query.
+    quint64 startArchive(const HistoryArchive *archive, const QString &text, int limit = kArchiveLimit);
+    void cancelArchive();
+
+    QString errorString() const { return error; }
+    void setTimeBudget(int msecs) { budget = msecs; }
+    int timeBudget() const { return budget; }
+    int threadCount() const { return pool.maxThreadCount(); }
+
+    // Highlighting more than this many matches per entry tells the user nothing new
+    static const int kMaxRangesPerEntry = 32;
+    static const int kArchiveLimit = 500;
+
+signals:
+    // Hits in the searched snapshot; entry indexes ascend within a batch, and
+    // no other batch has indexes between a batch's first and last
+    void matchesFound(quint64 generation, const QVector<SearchHit> &hits);
+    // complete is false when the query ran out of its time budget
+    void finished(quint64 generation, bool complete);
+    void archiveMatchesFound(quint64 generation, const QVector<SearchHit> &hits);
+    // segmentsSkipped were ruled out by their trigram filters without decompressing
+    void archiveFinished(quint64 generation, int matches, int segments, int segmentsSkipped);
+
+private:
+    struct Query {
+        quint64 generation = 0;
+        QRegularExpression regex;
+        HistorySnapshotRef snapshot;
+        QDeadlineTimer deadline;
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> expired{false};
+        std::atomic<int> pending{0};
+    };
+    using QueryPtr = std::shared_ptr<Query>;
+
+    bool compile(const QString &pattern, QRegularExpression *regex);
+    void runShard(const QueryPtr &query, int first, int last);
+    void post(const QueryPtr &query, const QVector<SearchHit> &hits);
+
+    QThreadPool pool;
+    QThreadPool archivePool;
+    QCache<QString, QRegularExpression> patterns;
+    QueryPtr current;
+    QueryPtr currentArchive;
+    quint64 generation = 0;
+    int budget = 2000;
+    QString error;
+
+    static const int kMinShardSize = 512;
+    static const int kBatchSize = 64;
+    static const int kFlushMsecs = 30;
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <initializer_list>
+#include <memory>
+#include "ContentClassifier.h"
+#include "EntryArena.h"
+#include "SnapshotPublisher.h"
+
+// Per-entry record kept in history lists: the body plus capture-time metadata
+struct HistoryEntry {
+    Utf8Entry body;
+    quint32 group = 0;  // near-duplicate group shared with similar entries; 0 = none
+    float frecency = 0; // FrecencyIndex key; higher ranks first
+    ContentClassifier::Kinds kinds = 0;  // set by the capture worker's classify stage
+    quint16 source = 0; // SourceIndex id of the app it was copied from; 0 = unknown
+    bool concealed = false;  // marked as a password by its owner (see ExpiryIndex)
+    qint64 capturedAt = 0;   // ExpiryIndex capture time in seconds; 0 = unknown
+};
+
+// Persistent (copy-on-write) list of history entries, newest first.
+// Entries are kept in small immutable chunks behind shared pointers, so
+// copying a list is O(1) and an edit copies only the chunk it touches plus
+// the spine of chunk pointers. Successive versions share everything else.
+// Bodies are UTF-8 arena entries; at() and toList() decode on demand.
+class EntryList {
+public:
+    EntryList() = default;
+    static EntryList fromList(const QStringList &entries, EntryArena &arena);
+    static EntryList fromEntries(const QVector<HistoryEntry> &entries);
+
+    int size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+    HistoryEntry entry(int index) const;
+    QString at(int index) const;
+    bool contains(QByteArrayView utf8, quint32 hash) const;
+    int indexOf(QByteArrayView utf8, quint32 hash) const;
+    QStringList toList() const;
+    qint64 payloadBytes() const;
+    // Entry records and chunk spine; bodies are counted by their arena.
+    // Chunks shared with older versions are counted as this list's own.
+    qint64 metadataBytes() const;
+
+    // Calls f(const HistoryEntry &) for each entry in order; stops if f returns false
+    template <typename F>
+    void forEach(F f) const {
+        for (const ChunkPtr &chunk : chunks) {
+            for (const HistoryEntry &entry : *chunk) {
+                if (!f(entry)) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Same, for entries [first, last) only; chunks before first are skipped whole
+    template <typename F>
+    void forEachInRange(int first, int last, F f) const {
+        int offset = 0;
+        for (const ChunkPtr &chunk : chunks) {
+            const int size = chunk->size();
+            for (int i = qMax(first - offset, 0); i < size && offset + i < last; ++i) {
+                if (!f(chunk->at(i))) {
+                    return;
+                }
+            }
+            offset += size;
+            if (offset >= last) {
+                return;
+            }
+        }
+    }
+
+    void prepend(const HistoryEntry &entry);
+    // Copies only the chunk holding index
+    void replace(int index, const HistoryEntry &entry);
+    int removeAll(QByteArrayView utf8, quint32 hash);
+    void truncate(int size);
+    void clear();
+
+    // Re-stores the bodies left in shared slabs less than 1/kSparseSlab live,
+    // counted across all of lists, so the slabs can be freed. Only chunks
+    // holding a moved body are copied. Writer thread only; returns the
+    // number of bodies moved.
+    static int compact(EntryArena &arena, std::initializer_list<EntryList *> lists);
+
+    // True when both lists are the same version (no element compare needed)
+    bool isSharedWith(const EntryList &other) const;
+    int chunkCount() const { return chunks.size(); }
+
+private:
+    using Chunk = QVector<HistoryEntry>;
+    using ChunkPtr = std::shared_ptr<const Chunk>;
+
+    QVector<ChunkPtr> chunks;
+    int count = 0;
+
+    static const int kChunkSize = 64;
+    static const int kSparseSlab = 4;
+};
+
+// One immutable, versioned view of the worker-owned history
+struct HistorySnapshot {
+    quint64 version = 0;
+    EntryList history;
+    EntryList selections;
+    EntryList pins;     // pinned entries, top first; never trimmed or re-sorted
+    QStringList sourceApps;  // names of HistoryEntry::source ids, at id - 1
+
+    QString sourceApp(quint16 id) const { return id > 0 ? sourceApps.value(id - 1) : QString(); }
+};
+
+using HistorySnapshotPublisher = SnapshotPublisher<HistorySnapshot>;
+using HistorySnapshotRef = HistorySnapshotPublisher::Ref;
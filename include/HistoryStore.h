@@ -0,0 +1,99 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QFile>
+
+// Crash-consistent history persistence.
+// State lives in a snapshot file that is only ever replaced by atomic rename
+// (QSaveFile) plus an append-only journal of checksummed operation records.
+// Recovery loads the snapshot and replays journal records up to the first
+// incomplete or corrupt one, then truncates that torn tail so new appends
+// start on a clean record boundary. Snapshot and journal carry a generation
+// number so a journal already folded into a newer snapshot is never replayed.
+class HistoryStore {
+public:
+    enum class List : quint8 {
+        History = 0,
+        Selections = 1
+    };
+
+    struct State {
+        QStringList history;
+        QStringList selections;
+    };
+
+    struct RecoveryStats {
+        bool snapshotFound = false;
+        bool snapshotValid = false;
+        int journalRecords = 0;
+        qint64 discardedBytes = 0;
+        qint64 recoveryMs = 0;
+    };
+
+    explicit HistoryStore(const QString &directory = QString());
+    ~HistoryStore();
+
+    static QString defaultDirectory();
+    QString directory() const;
+    bool exists() const;
+
+    // Reads snapshot + journal into state; may run on a worker thread before open()
+    bool recover(State *state, RecoveryStats *stats = nullptr);
+    // A read-only store recovers without repairing torn tails and never writes;
+    // for instances following another instance's store
+    void setReadOnly(bool readOnly);
+    bool isReadOnly() const { return readOnly; }
+
+    // Opens the journal for appending; record calls are ignored until then
+    bool open();
+    bool isOpen() const;
+    void close();
+
+    void recordPrepend(List list, const QString &text);
+    // Same as recordPrepend for a payload already packed with qCompress(text.toUtf8())
+    void recordPrependCompressed(List list, const QByteArray &compressedUtf8);
+    void recordRemove(List list, const QString &text);
+    void recordClear(List list);
+    void recordTruncate(List list, int size);
+
+    // Writes pending records and fsyncs the journal; false on I/O error.
+    // committed, when given, receives the framed records just written.
+    bool commit(QByteArray *committed = nullptr);
+    // Records buffered since the last commit
+    qint64 pendingBytes() const { return pendingRecords.capacity(); }
+
+    // Atomically replaces the snapshot with state and starts a fresh journal
+    bool writeSnapshot(const State &state);
+    bool needsCompaction() const;
+    void setCompactionThreshold(qint64 bytes);
+
+    static void applyRecord(State *state, const QByteArray &payload);
+    // Applies framed records up to the first torn or corrupt one; returns the bytes consumed
+    static qint64 replayRecords(State *state, QByteArrayView records, int *applied = nullptr);
+    // Flushes file data to stable storage (fsync / _commit)
+    static bool syncToDisk(QFileDevice &file);
+
+private:
+    enum class Op : quint8 {
+        Prepend = 1,
+        Remove = 2,
+        Clear = 3,
+        Truncate = 4,
+        PrependCompressed = 5
+    };
+
+    QString snapshotPath() const;
+    QString journalPath() const;
+    bool loadSnapshot(State *state, RecoveryStats *stats);
+    bool replayJournal(State *state, RecoveryStats *stats);
+    bool startJournal();
+    void appendRecord(const QByteArray &payload);
+
+    QString dir;
+    QFile journal;
+    QByteArray pendingRecords;
+    quint64 generation = 0;
+    qint64 compactionThreshold = 1024 * 1024;
+    bool readOnly = false;
+};
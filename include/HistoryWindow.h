@@ -1,6 +1,6 @@
 #pragma once
 #include <QWidget>
-#include <QListWidget>
+#include <QListView>
 #include <QVBoxLayout>
 #include <QLineEdit>
 #include <QMenu>
@@ -11,9 +11,16 @@
 #include <QLabel>
 #include <QGraphicsOpacityEffect>
 #include <QPropertyAnimation>
+#include "HistorySnapshot.h"
+#include "HistorySearch.h"
 
 
 class ClipboardManager; // forward declaration
+class HistoryModel;
+class QCheckBox;
+class QComboBox;
+class QSplitter;
+class PreviewPane;
 
 
 
@@ -43,7 +50,7 @@ public:
     explicit HistoryWindow(ClipboardManager *manager, QWidget *parent = nullptr);
 
 public slots:
-    void updateHistory(const QStringList &history);
+    void updateHistory(const HistorySnapshotRef &snapshot);
     void filterHistory(const QString &filter);
     void showWindow(); // Show window without hiding on copy
 
@@ -52,30 +59,55 @@ protected:
     void contextMenuEvent(QContextMenuEvent *event) override;
 
 private slots:
-    void onItemDoubleClicked(QListWidgetItem *item);
+    void onItemDoubleClicked(const QModelIndex &index);
     void copySelectedItem();
     void copySelectedItemAsFiles();
     void removeSelectedItem();
     void clearAllItems();
+    void toggleSimilarItems();
+    void togglePinnedItem();
     void onDeleteItemRequested(int row);
-    void onItemClicked(QListWidgetItem *item);
+    void onItemClicked(const QModelIndex &index);
+    void onRegexToggled(bool enabled);
+    void onRankToggled(bool enabled);
+    void onKindFilterChanged(int index);
+    void onSourceFilterChanged(int index);
+    void onCurrentRowChanged(const QModelIndex &current);
+    void onPreviewProgress(int lines, bool complete);
+    void onSearchMatches(quint64 generation, const QVector<SearchHit> &hits);
+    void onSearchFinished(quint64 generation, bool complete);
+    void onArchiveMatches(quint64 generation, const QVector<SearchHit> &hits);
+    void onArchiveFinished(quint64 generation, int matches, int segments, int segmentsSkipped);
 
 private:
     void setupUI();
     void setupContextMenu();
     bool isFileEntry(const QString &text) const;
-    QString formatTextForDisplay(const QString &text) const;
-    QString truncateText(const QString &text, int maxLines = 4) const;
-    void createListItem(const QString &text, int index);
+    QString currentEntryText() const;
+    void startRegexSearch();
+    void startArchiveSearch();
+    // Lists the apps the shown history came from, keeping the current choice
+    void refreshSourceFilter();
     void showCopyNotification();
     
-    QStringList originalHistory;
-    QStringList filteredHistory;
-    
-    QListWidget *listWidget;
+    HistoryModel *historyModel;
+    QListView *listView;
+    QSplitter *splitter;
+    PreviewPane *previewPane;
+    QLabel *previewStatusLabel;
     QLineEdit *searchBox;
+    QCheckBox *regexCheckBox;
+    QCheckBox *rankCheckBox;
+    QComboBox *kindFilterBox;
+    QComboBox *sourceFilterBox;
+    QLabel *searchStatusLabel;
+    HistorySearch *historySearch;
+    HistorySnapshotRef currentSnapshot;
+    int searchMatchCount = 0;
     ClipboardManager *clipboardManager;
     QMenu *contextMenu;
+    QAction *toggleSimilarAction;
+    QAction *togglePinAction;
     HistoryItemDelegate *itemDelegate;
     QTimer *hideTimer;
     bool shouldHideAfterCopy;
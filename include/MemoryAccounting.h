@@ -0,0 +1,79 @@
+#pragma once
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+// Process-wide byte counts per subsystem, current and peak, so the limits
+// set in preferences can be checked against what they actually cost.
+//
+// Entry payloads are counted exactly, as arena slabs come and go. The rest
+// are gauges: each subsystem has one owner that reports an estimate of its
+// footprint (element size times capacity, plus the bytes behind each
+// element where they are its own) whenever it has changed shape. Container
+// and allocator overhead beyond that is left out, which is why the total
+// is lower than the resident set.
+//
+// Any thread may report or read; the counters are relaxed atomics.
+class MemoryAccounting {
+public:
+    enum class Subsystem {
+        EntryPayloads,      // arena slabs, from any arena still referenced
+        Indexes,            // capture worker: dedup, similarity and frecency indexes, entry lists
+        Archive,            // cold archive entries not yet sealed, cached segment filters
+        Persistence,        // journal, archive and ring records waiting to be written
+        ModelRows,          // history window: visible rows, match ranges, archive hits
+        RowCache,           // history window: decoded display text of recently shown rows
+        PreviewIndex,       // preview pane line index
+        Count
+    };
+
+    struct Usage {
+        Subsystem subsystem;
+        QString name;
+        qint64 current = 0;
+        qint64 peak = 0;
+    };
+
+    static void set(Subsystem subsystem, qint64 bytes);
+    static void add(Subsystem subsystem, qint64 bytes);
+    static qint64 current(Subsystem subsystem);
+    static qint64 peak(Subsystem subsystem);
+    static QVector<Usage> usage();
+    // Sum of the current counts
+    static qint64 total();
+    static QString name(Subsystem subsystem);
+
+    // Resident set of the whole process, from /proc; false where unavailable
+    static bool residentBytes(qint64 *current, qint64 *peak);
+
+    // "12.3 MB" style, for display
+    static QString formatBytes(qint64 bytes);
+
+    // Estimates for Qt containers: the element storage they have reserved
+    template <typename T>
+    static qint64 vectorBytes(const QVector<T> &vector) {
+        return qint64(vector.capacity()) * qint64(sizeof(T));
+    }
+    template <typename K, typename V>
+    static qint64 hashBytes(const QHash<K, V> &hash) {
+        // Qt 6 hashes store nodes in spans with a one-byte offset per slot
+        return qint64(hash.capacity()) * qint64(sizeof(K) + sizeof(V) + 1);
+    }
+    static qint64 stringBytes(const QString &text) {
+        return qint64(text.capacity()) * qint64(sizeof(QChar));
+    }
+    static qint64 byteArrayBytes(const QByteArray &bytes) {
+        return bytes.capacity();
+    }
+
+private:
+    struct Counter {
+        std::atomic<qint64> current{0};
+        std::atomic<qint64> peak{0};
+    };
+
+    static void raisePeak(Counter &counter, qint64 bytes);
+    static Counter counters[int(Subsystem::Count)];
+};
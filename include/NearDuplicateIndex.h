@@ -0,0 +1,61 @@
+#pragma once
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QVector>
+
+// Incremental near-duplicate detection for captured text.
+//
+// normalize() folds differences that never matter to a user (CRLF vs LF,
+// trailing whitespace, trailing blank lines). fingerprint() is a 64-bit
+// SimHash over word unigrams and bigrams with digit runs masked, so clips
+// that differ only by a timestamp or counter land a few bits apart.
+// Fingerprints are indexed in 8 LSH bands of 8 bits: any two within
+// Hamming distance 7 agree on at least one band, so a lookup only scans
+// the eight matching buckets instead of every entry.
+class NearDuplicateIndex {
+public:
+    static const int kMaxThreshold = 7;
+
+    explicit NearDuplicateIndex(int threshold = 3);
+
+    void setThreshold(int bits);
+    int threshold() const { return maxDistance; }
+
+    static QByteArray normalize(QByteArrayView utf8);
+    // Returns false when the text is too short for a meaningful fingerprint
+    static bool fingerprint(QByteArrayView normalized, quint64 *result);
+
+    // Adds an entry and returns its group: the group of the closest indexed
+    // entry within the threshold, or a new one
+    quint32 insert(quint32 key, quint64 fingerprint);
+    void remove(quint32 key);
+    void clear();
+    int size() const { return nodes.size(); }
+    // Estimated footprint of the nodes and band buckets
+    qint64 memoryBytes() const;
+
+private:
+    struct Slot {
+        quint64 fingerprint;
+        quint32 key;
+        quint32 group;
+    };
+    struct Node {
+        quint64 fingerprint = 0;
+        quint32 group = 0;
+        int count = 0;  // content-hash collisions share a node
+    };
+
+    static const int kBands = 8;
+    static const int kBucketsPerBand = 256;
+
+    static int bandValue(quint64 fingerprint, int band) {
+        return int((fingerprint >> (band * 8)) & 0xFF);
+    }
+
+    int maxDistance;
+    quint32 nextGroup = 0;
+    QHash<quint32, Node> nodes;
+    QVector<Slot> buckets[kBands][kBucketsPerBand];
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// Pinned entries live in their own small file beside the history store.
+// Pins are few and change rarely, so the file is rewritten whole on each
+// change (QSaveFile) instead of being journaled. It holds nothing else,
+// so it can be read before history recovery begins and pins are shown
+// before the history is back.
+class PinStore {
+public:
+    explicit PinStore(const QString &path);
+
+    QString path() const { return file; }
+    // Pin order, top first; false and empty when missing or unreadable
+    bool load(QVector<QByteArray> *bodies) const;
+    bool save(const QVector<QByteArrayView> &bodies) const;
+
+    static const int kMaxPins = 1000;
+
+private:
+    QString file;
+};
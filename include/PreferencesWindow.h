@@ -8,6 +8,10 @@
 #include <QLabel>
 #include <QGroupBox>
 #include <QKeySequenceEdit>
+#include <QComboBox>
+#include <QLineEdit>
+
+class QTimer;
 
 class ClipboardManager;
 
@@ -20,6 +24,7 @@ public:
 private slots:
     void saveSettings();
     void loadSettings();
+    void refreshMemoryUsage();
 
 private:
     void setupUI();
@@ -27,10 +32,26 @@ private:
     ClipboardManager *clipboardManager;
     
     QSpinBox *historySizeSpinBox;
+    QCheckBox *archiveEvictedCheckBox;
+    QSpinBox *maxAgeSpinBox;
+    QSpinBox *concealedLifetimeSpinBox;
+    QLineEdit *excludedAppsEdit;
+    QCheckBox *recordTraceCheckBox;
     QCheckBox *autoStartCheckBox;
     QCheckBox *showTrayIconCheckBox;
     QCheckBox *globalHotkeyEnabledCheckBox;
     QKeySequenceEdit *globalHotkeyEdit;
+    QCheckBox *pasteHotkeysEnabledCheckBox;
+    QCheckBox *synthesizePasteCheckBox;
+    QCheckBox *trackSelectionCheckBox;
+    QSpinBox *selectionQuietSpinBox;
+    QComboBox *debouncePolicyComboBox;
+    QSpinBox *debounceWindowSpinBox;
+    QCheckBox *normalizeDuplicatesCheckBox;
+    QCheckBox *collapseSimilarCheckBox;
+    QSpinBox *similarThresholdSpinBox;
+    QLabel *memoryLabel;
+    QTimer *memoryTimer;
     QPushButton *saveButton;
     QPushButton *cancelButton;
 };
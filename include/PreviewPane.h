@@ -0,0 +1,72 @@
+#pragma once
+#include <QAbstractScrollArea>
+#include <QThreadPool>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include "EntryArena.h"
+
+// Read-only view of one whole entry, however large. The body is read in
+// place from its arena slab, which the held handle keeps alive; only the
+// lines in view are ever decoded and drawn.
+//
+// Line starts are indexed on a background thread and posted a chunk at a
+// time, so the first screen shows at once and the scroll range grows while
+// a 100 MB clip is still being indexed. A line longer than kMaxLineBytes is
+// broken into display lines at a UTF-8 boundary, so a clip that is one huge
+// line pages like any other. Scrolling is by display line; given a match,
+// the pane scrolls to the line holding it as soon as that line is indexed.
+class PreviewPane : public QAbstractScrollArea {
+    Q_OBJECT
+
+public:
+    explicit PreviewPane(QWidget *parent = nullptr);
+    ~PreviewPane() override;
+
+    // A masked entry (a secret) shows a placeholder instead of its body.
+    // matchOffset: where a match starts in the decoded text (UTF-16), or -1.
+    void setEntry(const Utf8Entry &entry, bool masked = false, int matchOffset = -1);
+    void clear();
+    int lineCount() const { return int(lineStarts.size()); }
+    bool isIndexed() const { return indexed; }
+    int firstVisibleLine() const;
+
+    static const int kMaxLineBytes = 4096;
+    static const int kIndexChunkBytes = 1024 * 1024;
+    static const int kMargin = 4;
+
+signals:
+    // Display lines indexed so far; complete once the whole body is
+    void indexProgress(int lines, bool complete);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    struct Job {
+        Utf8Entry entry;
+        int matchOffset = -1;
+        std::atomic<bool> cancelled{false};
+    };
+    using JobPtr = std::shared_ptr<Job>;
+
+    void cancelIndex();
+    void runIndex(const JobPtr &job);
+    void addLines(const JobPtr &job, const QVector<qint32> &starts, int widest, bool complete);
+    // Scrolls to scrollTarget once the line holding it is indexed
+    void scrollToTarget();
+    QString lineText(int line) const;
+    void updateScrollBars();
+    void accountMemory() const;
+
+    QThreadPool pool;
+    JobPtr current;
+    Utf8Entry entry;
+    bool masked = false;
+    QVector<qint32> lineStarts;     // byte offset of each display line, ascending
+    bool indexed = true;
+    int widestLine = 0;             // bytes, among the lines indexed so far
+    qint32 scrollTarget = -1;       // byte offset to scroll to; -1 once there
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <QByteArray>
+#include <QSharedMemory>
+#include <QString>
+#include <atomic>
+#include <functional>
+
+// Shared-memory mirror of the history journal, for instances of Xclipy that
+// share one store (one per X display). The instance holding the store's
+// writer lock appends each committed batch of journal records; the others
+// follow it by replaying those records from the mapped segment in place,
+// instead of copying them through a socket or re-reading the store.
+//
+// The segment is a byte ring behind a small header. head counts every byte
+// ever appended, so a reader's cursor is a plain offset: the bytes in
+// [cursor, head) are new, and a reader that falls more than a ring behind
+// has been lapped and must resync from the store. A new writer bumps the
+// epoch, which sends every reader back to the store as well. Journal
+// records are idempotent under replay of a suffix, so a resync may overlap
+// what the ring still holds.
+//
+// Readers never lock: a batch is validated against head after it is read
+// and discarded if the writer may have overwritten it meanwhile.
+class SharedHistoryRing {
+public:
+    enum class Batch : quint8 {
+        Records = 1,    // framed journal records, as written to the journal
+        Pins = 2        // the pin file changed
+    };
+
+    enum class ReadResult {
+        Ok,
+        Resync,         // lapped, or a different writer: reload from the store
+        Detached        // no writer has created the segment yet
+    };
+
+    explicit SharedHistoryRing(const QString &key);
+    ~SharedHistoryRing();
+
+    // Writer side: creates the segment, or takes over a stale one
+    bool createAsWriter();
+    void append(Batch kind, QByteArrayView data = QByteArrayView());
+    // Sends every reader back to the store, after a change made by rewriting
+    // the snapshot rather than through the journal
+    void invalidate();
+
+    // Reader side. f sees each batch in place; it may be called for a batch
+    // that is then reported as lapped, so callers resync on Resync.
+    bool attachAsReader();
+    bool isAttached() const;
+    quint64 epoch() const;
+    quint64 head() const;
+    ReadResult read(quint64 epoch, quint64 *cursor,
+                    const std::function<void(Batch, QByteArrayView)> &f);
+
+    static QString keyFor(const QString &storeDirectory);
+
+    static const int kCapacity = 4 * 1024 * 1024;
+
+private:
+    struct Header;
+
+    Header *header() const;
+    char *ring() const;
+    void copyIn(quint64 position, const char *data, qint64 size);
+    void copyOut(quint64 position, char *data, qint64 size) const;
+
+    QSharedMemory memory;
+    bool writer = false;
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <QLockFile>
+#include <QObject>
+#include <QString>
+#include <memory>
+
+class QLocalServer;
+
+// At most one Xclipy per user and display. The first instance holds a lock
+// file and listens on a local socket; a later start on the same display
+// asks it to show its history window and exits. Instances on different
+// displays coexist and share one history store (see CapturePipeline).
+class SingleInstance : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SingleInstance(QObject *parent = nullptr);
+    ~SingleInstance();
+
+    // True when this process is the instance for its display
+    bool acquire();
+    // Asks the running instance to show itself; false if it did not answer
+    bool activateRunning(int timeoutMs = 1000);
+
+    QString scope() const { return scopeName; }
+
+signals:
+    void activationRequested();
+
+private:
+    QString scopeName;
+    std::unique_ptr<QLockFile> lock;
+    QLocalServer *server = nullptr;
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <QtGlobal>
+#include <atomic>
+#include <utility>
+
+// Single-writer publication of immutable values with RCU-style reclamation.
+//
+// The current node pointer and a count of readers that borrowed it live in
+// one atomic word, so acquire() is a single fetch_add (wait-free). A reader
+// returns its borrow to that word if the node is still current; once the
+// writer has swapped in a newer node it folds the outstanding borrows into the
+// retired node's own reference count, and whoever drops that count to zero
+// deletes it. Ref copies take a reference on the node count directly.
+// Readers are never blocked by the writer and never touch a lock.
+template <typename T>
+class SnapshotPublisher {
+    // Held by the publisher while a node is current. Readers whose release
+    // races ahead of retire() cannot drive the count to zero before the
+    // borrows are folded in.
+    static constexpr qint64 kPublisherBias = qint64(1) << 40;
+
+    struct Node {
+        explicit Node(T &&v) : value(std::move(v)) {}
+        T value;
+        std::atomic<qint64> refs{kPublisherBias};
+    };
+
+#if QT_POINTER_SIZE == 8
+    // x86-64 and arm64 user-space pointers fit in 48 bits
+    static constexpr int kCountShift = 48;
+#else
+    static constexpr int kCountShift = 32;
+#endif
+    static constexpr quint64 kOne = quint64(1) << kCountShift;
+    static constexpr quint64 kPointerMask = kOne - 1;
+
+    static Node *nodeOf(quint64 word) {
+        return reinterpret_cast<Node *>(quintptr(word & kPointerMask));
+    }
+
+    static void unref(Node *node, qint64 count) {
+        if (node->refs.fetch_sub(count, std::memory_order_acq_rel) == count) {
+            delete node;
+        }
+    }
+
+public:
+    class Ref {
+    public:
+        Ref() = default;
+        Ref(const Ref &other) : owner(nullptr), node(other.node) {
+            if (node) {
+                node->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        Ref(Ref &&other) noexcept : owner(other.owner), node(other.node) {
+            other.owner = nullptr;
+            other.node = nullptr;
+        }
+        Ref &operator=(Ref other) noexcept {
+            std::swap(owner, other.owner);
+            std::swap(node, other.node);
+            return *this;
+        }
+        ~Ref() {
+            release();
+        }
+
+        const T *operator->() const { return &node->value; }
+        const T &operator*() const { return node->value; }
+        bool isNull() const { return node == nullptr; }
+
+    private:
+        friend class SnapshotPublisher;
+        Ref(const SnapshotPublisher *publisher, Node *n) : owner(publisher), node(n) {}
+
+        void release() {
+            if (!node) {
+                return;
+            }
+            if (owner) {
+                // Hand the borrow back to the publisher word while this node is current
+                quint64 word = owner->current.load(std::memory_order_acquire);
+                while (nodeOf(word) == node && (word >> kCountShift) > 0) {
+                    if (owner->current.compare_exchange_weak(word, word - kOne,
+                                                             std::memory_order_acq_rel)) {
+                        node = nullptr;
+                        return;
+                    }
+                }
+            }
+            // Retired (or a copy): the borrow was folded into the node count
+            unref(node, 1);
+            node = nullptr;
+        }
+
+        const SnapshotPublisher *owner = nullptr;
+        Node *node = nullptr;
+    };
+
+    explicit SnapshotPublisher(T initial = T()) {
+        current.store(quint64(quintptr(new Node(std::move(initial)))), std::memory_order_release);
+    }
+
+    ~SnapshotPublisher() {
+        retire(current.exchange(0, std::memory_order_acq_rel));
+    }
+
+    SnapshotPublisher(const SnapshotPublisher &) = delete;
+    SnapshotPublisher &operator=(const SnapshotPublisher &) = delete;
+
+    // Any thread; wait-free
+    Ref acquire() const {
+        quint64 word = current.fetch_add(kOne, std::memory_order_acq_rel);
+        return Ref(this, nodeOf(word));
+    }
+
+    // Writer thread only
+    void publish(T value) {
+        Node *node = new Node(std::move(value));
+        Q_ASSERT((quint64(quintptr(node)) & ~kPointerMask) == 0);
+        retire(current.exchange(quint64(quintptr(node)), std::memory_order_acq_rel));
+    }
+
+private:
+    static void retire(quint64 word) {
+        Node *node = nodeOf(word);
+        if (!node) {
+            return;
+        }
+        // Outstanding borrows become node references; drop the publisher's bias
+        qint64 borrowed = qint64(word >> kCountShift);
+        unref(node, kPublisherBias - borrowed);
+    }
+
+    mutable std::atomic<quint64> current{0};
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+// Which application each history entry was copied from, owned by the
+// capture worker. Application names (see ClipboardProbe::Source) are
+// interned into small ids, which the worker stamps into each published
+// HistoryEntry next to its kinds; the snapshot carries the name table, so
+// a view filters by app with an integer compare per entry.
+//
+// Ids are per content hash, like frecency keys, and saved beside the
+// history store the same way; a re-copy from another app moves the entry
+// to that app. Names are never dropped, so an id stays valid for every
+// snapshot that has seen it.
+class SourceIndex {
+public:
+    static const int kMaxApps = 0xffff;
+
+    // Records that hash was copied from app and returns the entry's id;
+    // an unknown (empty) app keeps whatever was recorded before
+    quint16 record(quint32 hash, const QString &app);
+    // Gives hash an id already interned (0 forgets it)
+    void set(quint32 hash, quint16 app);
+    // 0 when unknown
+    quint16 appOf(quint32 hash) const { return entries.value(hash); }
+    // Name of each id, at id - 1
+    QStringList apps() const { return names; }
+    void remove(quint32 hash) { entries.remove(hash); }
+    void clear() { entries.clear(); }
+    int size() const { return entries.size(); }
+
+    // Drops the entries for which stale(hash) is true
+    template <typename F>
+    void removeIf(F stale) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (stale(it.key())) {
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    bool load(const QString &path);
+    bool save(const QString &path) const;
+    qint64 memoryBytes() const;
+
+private:
+    quint16 intern(const QString &app);
+
+    QHash<quint32, quint16> entries;
+    QStringList names;
+    QHash<QString, quint16> ids;
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <QtGlobal>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free single-producer/single-consumer ring buffer.
+// The producer only writes tail, the consumer only writes head; each index is
+// on its own cache line so the two threads don't false-share.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity)
+        : slots(roundUpPowerOfTwo(capacity + 1)), mask(slots.size() - 1) {
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Producer side; false if the queue is full
+    bool tryPush(T &&value) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        const std::size_t next = (t + 1) & mask;
+        if (next == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        slots[t] = std::move(value);
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false if the queue is empty
+    bool tryPop(T &value) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(slots[h]);
+        slots[h] = T();
+        head.store((h + 1) & mask, std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const {
+        return mask;
+    }
+
+private:
+    static std::size_t roundUpPowerOfTwo(std::size_t n) {
+        std::size_t size = 2;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    std::vector<T> slots;
+    const std::size_t mask;
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+};
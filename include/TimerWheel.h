@@ -0,0 +1,51 @@
+#pragma once
+#include <QVector>
+
+// Hierarchical timer wheel (Varghese & Lauck): four levels of 64 slots,
+// each level's slot spanning a whole turn of the level below. A timer goes
+// into the coarsest level that still tells it apart from now and moves
+// down a level each time the wheel reaches its slot, so scheduling is O(1)
+// and each timer is touched at most once per level before it fires.
+// Timers past the top level's reach wait in an overflow list.
+//
+// Time is in integer ticks chosen by the caller. Timers are not cancelled:
+// the owner keeps the authoritative deadline per key and ignores a fired
+// timer whose deadline no longer matches it. Advancing over a long idle
+// stretch skips empty turns instead of visiting every tick.
+class TimerWheel {
+public:
+    struct Timer {
+        quint32 key = 0;
+        qint64 deadline = 0;
+    };
+
+    explicit TimerWheel(qint64 now = 0);
+
+    qint64 now() const { return current; }
+    // A deadline at or before now fires on the next advance
+    void schedule(quint32 key, qint64 deadline);
+    // Moves the wheel to now, appending every timer due by then to expired
+    void advance(qint64 now, QVector<Timer> *expired);
+    // Earliest deadline still in the wheel, or -1 when it is empty
+    qint64 nextDeadline() const;
+    int size() const { return pending; }
+    // Drops every timer and restarts the wheel at now
+    void reset(qint64 now);
+    qint64 memoryBytes() const;
+
+private:
+    static const int kLevels = 4;
+    static const int kSlotBits = 6;
+    static const int kSlots = 1 << kSlotBits;
+
+    static qint64 span(int level) { return qint64(1) << (kSlotBits * level); }
+    void place(const Timer &timer);
+    void cascade(int level);
+
+    QVector<Timer> slots[kLevels][kSlots];
+    int counts[kLevels] = {};
+    QVector<Timer> due;         // deadline already reached when scheduled
+    QVector<Timer> overflow;    // beyond the top level
+    qint64 current;
+    int pending = 0;
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include "ContentClassifier.h"
+
+// Anonymized trace of what the capture engine was asked to do, recorded
+// when the user opts in, so real clipboard workloads can be replayed
+// against the engine without X:
+//   Xclipy --benchmark replay --trace=<path>
+//
+// A trace ("XCTR") is a header followed by fixed-size records:
+//
+//   header  magic, version, created (ms since epoch)
+//   record  time since start (ns), content hash, size, parts, kinds, event, formats
+//
+// No content is kept. Hashes are seeded with a random salt that is never
+// written, so within a trace they tell which clips are equal, but they
+// cannot be checked against a guess. Sizes, line counts, kinds and the
+// advertised formats are kept, which is what storage, dedup and search
+// costs depend on. Near-duplicate similarity is not: it would need the
+// content's fingerprint, which leaks too much of it.
+class WorkloadTrace {
+public:
+    enum class Event : quint8 {
+        Text = 1,
+        Files = 2,
+        Selection = 3,
+        Remove = 4,
+        Pin = 5,
+        Unpin = 6,
+        Use = 7,
+        Clear = 8
+    };
+
+    // Formats the owner advertised
+    enum Format : quint8 {
+        FormatText = 0x01,
+        FormatFiles = 0x02,
+        FormatConcealed = 0x04, // marked as a password
+        FormatUnknown = 0x80    // the platform couldn't tell
+    };
+
+    struct Record {
+        qint64 atNs = 0;        // since the trace started
+        quint32 hash = 0;
+        quint32 size = 0;       // UTF-8 bytes
+        quint32 parts = 0;      // lines; for files, paths
+        ContentClassifier::Kinds kinds = 0;
+        Event event = Event::Text;
+        quint8 formats = 0;
+    };
+
+    class Recorder {
+    public:
+        bool open(const QString &path);
+        void close();
+        bool isOpen() const { return file.isOpen(); }
+        QString path() const { return file.fileName(); }
+        // kinds: the capture worker's, as stored with the entry
+        void record(Event event, QByteArrayView utf8, ContentClassifier::Kinds kinds, quint8 formats);
+        void record(Event event);
+        qint64 count() const { return records; }
+
+    private:
+        void write(const Record &record);
+
+        QFile file;
+        QElapsedTimer clock;
+        quint32 salt = 0;
+        qint64 records = 0;
+    };
+
+    class Reader {
+    public:
+        explicit Reader(const QString &path);
+
+        bool open();
+        // False at the end, or on a damaged file (see errorString)
+        bool next(Record *record);
+        QString errorString() const { return error; }
+
+    private:
+        QFile file;
+        QString error;
+    };
+
+    // Deterministic stand-in content: equal hashes give equal text, of the
+    // recorded size and line count and shaped like the recorded kinds
+    static QString synthesize(const Record &record);
+    static QStringList synthesizeFiles(const Record &record);
+
+    // Where recordings go, one file per run
+    static QString defaultDirectory();
+    static QString newTracePath();
+};
@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# Benchmark script for Xclipy
+# Runs the headless capture-engine benchmarks built into the Xclipy binary.
+#
+# Usage: scripts/benchmark.sh [NAME] [--option=value ...]
+#        XCLIPY_BIN=/path/to/Xclipy scripts/benchmark.sh selection-burst --bursts=5000
+#        scripts/benchmark.sh selection-burst --policy=leading --poll=250
+#        scripts/benchmark.sh replay --trace=~/.local/share/Xclipy/traces/trace-<date>.xct
+#
+# replay is left out of the default run: it needs a recorded workload trace.
+
+set -e
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "$SCRIPT_DIR")"
+
+# Locate the binary (qmake build, CMake build, or macOS bundle)
+if [ -z "$XCLIPY_BIN" ]; then
+    for candidate in \
+        "$PROJECT_ROOT/build/Xclipy" \
+        "$PROJECT_ROOT/build/Xclipy.app/Contents/MacOS/Xclipy" \
+        "$PROJECT_ROOT/build-cmake/Xclipy"; do
+        if [ -x "$candidate" ]; then
+            XCLIPY_BIN="$candidate"
+            break
+        fi
+    done
+fi
+
+if [ -z "$XCLIPY_BIN" ] || [ ! -x "$XCLIPY_BIN" ]; then
+    echo -e "${RED}✗ Xclipy binary not found${NC}"
+    echo "Build first with ./scripts/build.sh or set XCLIPY_BIN"
+    exit 1
+fi
+
+BENCHMARKS="selection-burst journal-crash pipeline-churn snapshot-stress entry-memory near-duplicates regex-search frecency-topk archive-search shared-ring export-import classify expiry-wheel"
+
+if [ $# -gt 0 ]; then
+    BENCHMARKS="$1"
+    shift
+fi
+
+for name in $BENCHMARKS; do
+    echo -e "${BLUE}Running benchmark: $name${NC}"
+    if "$XCLIPY_BIN" --benchmark "$name" "$@"; then
+        echo -e "${GREEN}✓ $name passed${NC}"
+    else
+        echo -e "${RED}✗ $name failed${NC}"
+        exit 1
+    fi
+    echo ""
+done
@@ -0,0 +1,206 @@
+#!/bin/bash
+
+# End-to-end capture harness for Xclipy
+# Starts Xclipy on a private Xvfb display with a throwaway home, drives the
+# CLIPBOARD from a synthetic owner (Xclipy --drive-clipboard) and reports
+# capture latency percentiles, dropped and duplicated captures, CPU time and
+# RSS. Needs no network and no running desktop.
+#
+# Usage: scripts/e2e-capture.sh [--rate=50] [--size=256] [--count=500] [--burst=1]
+#                               [--policy=immediate|leading|trailing] [--window=150]
+#                               [--max-drop=<percent>] [--keep]
+#        XCLIPY_BIN=/path/to/Xclipy scripts/e2e-capture.sh --rate=200 --size=65536
+#
+# The debounce policy defaults to immediate, so drops measure the capture
+# path itself; the app's own default (trailing) folds bursts on purpose.
+
+set -e
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "$SCRIPT_DIR")"
+
+RATE=50
+SIZE=256
+COUNT=500
+BURST=1
+POLICY=immediate
+WINDOW=150
+MAX_DROP=""
+KEEP=0
+for arg in "$@"; do
+    case "$arg" in
+        --rate=*) RATE="${arg#*=}" ;;
+        --size=*) SIZE="${arg#*=}" ;;
+        --count=*) COUNT="${arg#*=}" ;;
+        --burst=*) BURST="${arg#*=}" ;;
+        --policy=*) POLICY="${arg#*=}" ;;
+        --window=*) WINDOW="${arg#*=}" ;;
+        --max-drop=*) MAX_DROP="${arg#*=}" ;;
+        --keep) KEEP=1 ;;
+        *) echo "Unknown option: $arg"; exit 2 ;;
+    esac
+done
+
+# Locate the binary (qmake build or CMake build)
+if [ -z "$XCLIPY_BIN" ]; then
+    for candidate in \
+        "$PROJECT_ROOT/build/Xclipy" \
+        "$PROJECT_ROOT/build-cmake/Xclipy"; do
+        if [ -x "$candidate" ]; then
+            XCLIPY_BIN="$candidate"
+            break
+        fi
+    done
+fi
+
+if [ -z "$XCLIPY_BIN" ] || [ ! -x "$XCLIPY_BIN" ]; then
+    echo -e "${RED}✗ Xclipy binary not found${NC}"
+    echo "Build first with ./scripts/build.sh or set XCLIPY_BIN"
+    exit 1
+fi
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+    echo -e "${RED}✗ Xvfb not found${NC}"
+    echo "Install it with: sudo apt-get install xvfb"
+    exit 1
+fi
+
+# Everything the app writes goes to a private directory: settings, history, lock
+WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/xclipy-e2e.XXXXXX")"
+chmod 700 "$WORK_DIR"
+XVFB_PID=""
+APP_PID=""
+cleanup() {
+    [ -n "$APP_PID" ] && kill "$APP_PID" 2>/dev/null && wait "$APP_PID" 2>/dev/null
+    [ -n "$XVFB_PID" ] && kill "$XVFB_PID" 2>/dev/null && wait "$XVFB_PID" 2>/dev/null
+    if [ "$KEEP" = 1 ]; then
+        echo "Logs kept in $WORK_DIR"
+    else
+        rm -rf "$WORK_DIR"
+    fi
+}
+trap cleanup EXIT
+
+export HOME="$WORK_DIR/home"
+export XDG_CONFIG_HOME="$HOME/.config"
+export XDG_DATA_HOME="$HOME/.local/share"
+export XDG_CACHE_HOME="$HOME/.cache"
+export XDG_RUNTIME_DIR="$WORK_DIR/runtime"
+export QT_QPA_PLATFORM=xcb
+mkdir -p "$XDG_CONFIG_HOME/Xclipy" "$XDG_DATA_HOME" "$XDG_CACHE_HOME" "$XDG_RUNTIME_DIR"
+chmod 700 "$XDG_RUNTIME_DIR"
+cat > "$XDG_CONFIG_HOME/Xclipy/Xclipy.conf" <<EOF
+[General]
+captureDebouncePolicy=$POLICY
+captureDebounceWindow=$WINDOW
+globalHotkeyEnabled=false
+showTrayIcon=false
+EOF
+
+# Let Xvfb pick a free display and tell us which
+echo -e "${BLUE}Starting Xvfb${NC}"
+Xvfb -displayfd 3 -screen 0 1280x800x24 -nolisten tcp 3>"$WORK_DIR/display" >"$WORK_DIR/xvfb.log" 2>&1 &
+XVFB_PID=$!
+for _ in $(seq 50); do
+    [ -s "$WORK_DIR/display" ] && break
+    sleep 0.1
+done
+if [ ! -s "$WORK_DIR/display" ]; then
+    echo -e "${RED}✗ Xvfb did not start${NC}"
+    cat "$WORK_DIR/xvfb.log"
+    exit 1
+fi
+export DISPLAY=":$(head -n1 "$WORK_DIR/display")"
+
+echo -e "${BLUE}Starting Xclipy on $DISPLAY${NC}"
+XCLIPY_CAPTURE_LOG="$WORK_DIR/captured.log" "$XCLIPY_BIN" >"$WORK_DIR/app.log" 2>&1 &
+APP_PID=$!
+for _ in $(seq 100); do
+    grep -q "time-to-history-ready" "$WORK_DIR/app.log" 2>/dev/null && break
+    if ! kill -0 "$APP_PID" 2>/dev/null; then
+        echo -e "${RED}✗ Xclipy exited during startup${NC}"
+        cat "$WORK_DIR/app.log"
+        exit 1
+    fi
+    sleep 0.1
+done
+
+# utime + stime, in clock ticks
+cpu_ticks() {
+    awk '{ sub(/^.*\) /, ""); print $12 + $13 }' "/proc/$1/stat"
+}
+CLK_TCK="$(getconf CLK_TCK)"
+CPU_BEFORE="$(cpu_ticks "$APP_PID")"
+
+echo -e "${BLUE}Driving $COUNT changes at $RATE/s (burst $BURST, $SIZE bytes)${NC}"
+"$XCLIPY_BIN" --drive-clipboard --log="$WORK_DIR/driven.log" \
+    --rate="$RATE" --size="$SIZE" --count="$COUNT" --burst="$BURST" >"$WORK_DIR/driver.log" 2>&1
+
+CPU_AFTER="$(cpu_ticks "$APP_PID")"
+RSS_KB="$(awk '/^VmRSS:/ { print $2 }' "/proc/$APP_PID/status")"
+PEAK_RSS_KB="$(awk '/^VmHWM:/ { print $2 }' "/proc/$APP_PID/status")"
+touch "$WORK_DIR/captured.log"
+
+# Match captures to changes by content hash; latency is capture time - change time
+awk -v tck="$CLK_TCK" -v cpu="$((CPU_AFTER - CPU_BEFORE))" -v rss="$RSS_KB" -v peak="$PEAK_RSS_KB" \
+    -v rate="$RATE" -v size="$SIZE" -v burst="$BURST" -v policy="$POLICY" \
+    -v latencies="$WORK_DIR/latencies" '
+    FNR == NR { driven[$2] = $1; total++; next }
+    {
+        if (!($2 in driven)) { foreign++; next }
+        if ($2 in seen) { duplicated++; next }
+        seen[$2] = 1
+        captured++
+        printf "%.3f\n", ($1 - driven[$2]) / 1e6 > latencies
+    }
+    END {
+        close(latencies)
+        dropped = total - captured
+        print "benchmark: e2e-capture"
+        print "policy: " policy
+        print "rate: " rate
+        print "burst: " burst
+        print "size: " size
+        print "driven: " total
+        print "captured: " captured + 0
+        print "dropped: " dropped
+        printf "drop_rate_percent: %.2f\n", total ? 100 * dropped / total : 0
+        print "duplicated: " duplicated + 0
+        print "foreign: " foreign + 0
+        printf "cpu_ms: %d\n", cpu * 1000 / tck
+        print "rss_kb: " rss
+        print "peak_rss_kb: " peak
+    }' "$WORK_DIR/driven.log" "$WORK_DIR/captured.log" > "$WORK_DIR/report"
+touch "$WORK_DIR/latencies"
+sort -n "$WORK_DIR/latencies" | awk '
+    { v[NR] = $1 }
+    END {
+        if (NR == 0) { print "latency_ms_p50: n/a"; exit }
+        split("50 90 99", ps, " ")
+        for (i = 1; i <= 3; i++) {
+            idx = int((ps[i] / 100) * NR + 0.999999)
+            if (idx < 1) idx = 1
+            printf "latency_ms_p%s: %s\n", ps[i], v[idx]
+        }
+        printf "latency_ms_max: %s\n", v[NR]
+    }' >> "$WORK_DIR/report"
+cat "$WORK_DIR/report"
+
+DROP_RATE="$(awk '/^drop_rate_percent:/ { print $2 }' "$WORK_DIR/report")"
+CAPTURED="$(awk '/^captured:/ { print $2 }' "$WORK_DIR/report")"
+if [ "$CAPTURED" = 0 ]; then
+    echo -e "${RED}✗ Nothing was captured${NC}"
+    KEEP=1
+    exit 1
+fi
+if [ -n "$MAX_DROP" ] && awk -v d="$DROP_RATE" -v m="$MAX_DROP" 'BEGIN { exit !(d > m) }'; then
+    echo -e "${RED}✗ Drop rate $DROP_RATE% is over $MAX_DROP%${NC}"
+    exit 1
+fi
+echo -e "${GREEN}✓ e2e-capture passed${NC}"
@@ -0,0 +1,1555 @@
+#include "../include/Benchmarks.h"
+#include "../include/ChangeCoalescer.h"
+#include "../include/HistoryStore.h"
+#include "../include/CapturePipeline.h"
+#include "../include/HistorySnapshot.h"
+#include "../include/EntryArena.h"
+#include "../include/NearDuplicateIndex.h"
+#include "../include/HistorySearch.h"
+#include "../include/Frecency.h"
+#include "../include/HistoryArchive.h"
+#include "../include/SharedHistoryRing.h"
+#include "../include/HistoryExport.h"
+#include "../include/ContentClassifier.h"
+#include "../include/WorkloadTrace.h"
+#include "../include/MemoryAccounting.h"
+#include "../include/TimerWheel.h"
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+QTextStream &out() {
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+// Parses "--key=value" options following the benchmark name
+QHash<QString, QString> parseOptions(const QStringList &arguments, int first) {
+    QHash<QString, QString> options;
+    for (int i = first; i < arguments.size(); ++i) {
+        const QString &arg = arguments.at(i);
+        if (!arg.startsWith("--")) {
+            continue;
+        }
+        int eq = arg.indexOf('=');
+        if (eq > 2) {
+            options.insert(arg.mid(2, eq - 2), arg.mid(eq + 1));
+        } else {
+            options.insert(arg.mid(2), QString("1"));
+        }
+    }
+    return options;
+}
+
+int intOption(const QHash<QString, QString> &options, const QString &key, int defaultValue) {
+    bool ok = false;
+    int value = options.value(key).toInt(&ok);
+    return ok ? value : defaultValue;
+}
+
+// Replays synthetic bursts of clipboard/selection changes through the
+// coalescer. Each burst is a drag emitting `changes` updates every `interval`
+// ms, followed by `gap` ms of idle time. The settle timer and the manager's
+// periodic poll (`poll` ms) are simulated exactly as the manager schedules
+// them, so the recorded count is deterministic. A value counts as recorded
+// when it is committed, or when a poll finds one not yet seen; every burst
+// must leave exactly one record (Immediate: one per change). Runs each
+// policy listed in `policy` (default "trailing,leading").
+int selectionBurstCase(ChangeCoalescer::Policy policy, const QString &policyName,
+                       const QHash<QString, QString> &options) {
+    const int bursts = intOption(options, "bursts", 1000);
+    const int changesPerBurst = intOption(options, "changes", 200);
+    const int intervalMs = intOption(options, "interval", 5);
+    const int gapMs = intOption(options, "gap", 1000);
+    const int quietMs = intOption(options, "quiet", 400);
+    const int pollMs = qMax(1, intOption(options, "poll", 500));
+    const int ringSize = intOption(options, "ring", 20);
+
+    ChangeCoalescer coalescer(quietMs);
+    coalescer.setPolicy(policy);
+    QStringList ring;
+    qint64 now = 0;
+    qint64 timerDeadline = -1;
+    qint64 nextPoll = pollMs;
+    qint64 lastChange = 0;
+    qint64 maxCommitLatency = 0;
+    int current = -1;   // the value the clipboard holds
+    int seen = -1;      // the value the manager last read or marked as seen
+    quint64 recorded = 0;
+    QElapsedTimer wall;
+    wall.start();
+
+    auto recordCurrent = [&](qint64 at) {
+        seen = current;
+        ++recorded;
+        maxCommitLatency = qMax(maxCommitLatency, at - lastChange);
+        QString selection = QString("selection %1").arg(current);
+        ring.removeAll(selection);
+        ring.prepend(selection);
+        while (ring.size() > ringSize) {
+            ring.removeLast();
+        }
+    };
+
+    // Settle timer and poll, in time order, up to and including until
+    auto runUntil = [&](qint64 until) {
+        while (true) {
+            const bool timerFirst = timerDeadline >= 0 && timerDeadline <= nextPoll;
+            const qint64 fireAt = timerFirst ? timerDeadline : nextPoll;
+            if (fireAt > until) {
+                return;
+            }
+            if (!timerFirst) {
+                nextPoll += pollMs;
+                // A burst in flight is left to the debouncer
+                if (!coalescer.hasPending() && current != seen) {
+                    recordCurrent(fireAt);
+                }
+                continue;
+            }
+            timerDeadline = -1;
+            if (coalescer.takeSettled(fireAt)) {
+                recordCurrent(fireAt);
+            } else if (!coalescer.hasPending()) {
+                // Leading settled: what the burst ended on is seen, not recorded
+                seen = current;
+            } else {
+                qint64 remaining = coalescer.msUntilSettled(fireAt);
+                if (remaining >= 0) {
+                    timerDeadline = fireAt + remaining;
+                }
+            }
+        }
+    };
+
+    for (int burst = 0; burst < bursts; ++burst) {
+        qint64 burstEnd = now;
+        for (int change = 0; change < changesPerBurst; ++change) {
+            runUntil(now);
+            ++current;
+            lastChange = now;
+            if (coalescer.noteChange(now)) {
+                recordCurrent(now);
+            }
+            const qint64 remaining = coalescer.msUntilSettled(now);
+            timerDeadline = remaining >= 0 ? now + remaining : -1;
+            burstEnd = now;
+            now += intervalMs;
+        }
+        runUntil(burstEnd + gapMs);
+        now = burstEnd + gapMs;
+    }
+    runUntil(now + qMax(quietMs, pollMs));
+
+    qint64 elapsedNs = wall.nsecsElapsed();
+    quint64 changes = coalescer.changeCount();
+    quint64 commits = coalescer.commitCount();
+    const quint64 expected = policy == ChangeCoalescer::Policy::Immediate ? changes : quint64(bursts);
+
+    out() << "benchmark: selection-burst\n";
+    out() << "policy: " << policyName << "\n";
+    out() << "bursts: " << bursts << "\n";
+    out() << "changes: " << changes << "\n";
+    out() << "commits: " << commits << "\n";
+    out() << "recorded: " << recorded << "\n";
+    out() << "suppressed: " << (changes - commits) << "\n";
+    out() << "ring_entries: " << ring.size() << "\n";
+    out() << "simulated_ms: " << now << "\n";
+    out() << "commit_latency_ms: " << maxCommitLatency << "\n";
+    out() << "wall_ms: " << elapsedNs / 1000000.0 << "\n";
+    out() << "ns_per_change: " << (changes ? double(elapsedNs) / changes : 0.0) << "\n";
+    out().flush();
+
+    // One record per burst is the contract; a poll picking up a suppressed value is a regression
+    return commits == expected && recorded == expected ? 0 : 1;
+}
+
+int selectionBurst(const QHash<QString, QString> &options) {
+    int result = 0;
+    for (const QString &name : options.value("policy", "trailing,leading").split(',', Qt::SkipEmptyParts)) {
+        ChangeCoalescer::Policy policy = ChangeCoalescer::Policy::Trailing;
+        if (name == "leading") {
+            policy = ChangeCoalescer::Policy::Leading;
+        } else if (name == "immediate") {
+            policy = ChangeCoalescer::Policy::Immediate;
+        } else if (name != "trailing") {
+            out() << "Unknown policy: " << name << "\n";
+            return 1;
+        }
+        result |= selectionBurstCase(policy, name, options);
+    }
+    return result;
+}
+
+// Child process for journal-crash: appends "entry N" records one commit at a
+// time and acknowledges each on stdout only after it has been fsynced.
+int journalWriter(const QHash<QString, QString> &options) {
+    const QString dir = options.value("dir");
+    const int records = intOption(options, "records", 5000);
+    const int compactEvery = intOption(options, "compact-every", 250);
+    if (dir.isEmpty()) {
+        return 2;
+    }
+
+    HistoryStore store(dir);
+    HistoryStore::State state;
+    store.recover(&state);
+    if (!store.open()) {
+        return 1;
+    }
+
+    QTextStream ack(stdout);
+    for (int i = 0; i < records; ++i) {
+        QString text = QString("entry %1").arg(i);
+        state.history.prepend(text);
+        store.recordPrepend(HistoryStore::List::History, text);
+        if (!store.commit()) {
+            return 1;
+        }
+        ack << "ack " << i << "\n";
+        ack.flush();
+        if (compactEvery > 0 && (i + 1) % compactEvery == 0 && !store.writeSnapshot(state)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Fault-injection harness for HistoryStore. Each iteration starts a writer,
+// SIGKILLs it at a random moment (including mid-snapshot), optionally tears
+// the journal tail, then recovers and checks that:
+//   - recovered history is a consistent prefix "entry k-1" .. "entry 0"
+//   - kill and garbage-tail modes lose no acknowledged record
+//   - truncation mode loses only records past the cut
+int journalCrash(const QHash<QString, QString> &options) {
+    const int iterations = intOption(options, "iterations", 50);
+    const int records = intOption(options, "records", 5000);
+    const int maxDelayMs = intOption(options, "max-delay", 300);
+    QRandomGenerator rng(quint32(intOption(options, "seed", 1)));
+
+    int violations = 0;
+    qint64 lostAcknowledged = 0;
+    qint64 truncationLoss = 0;
+    qint64 maxRecoveryNs = 0;
+    qint64 totalRecoveryNs = 0;
+    qint64 discardedBytes = 0;
+
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        QTemporaryDir tmp;
+        if (!tmp.isValid()) {
+            QTextStream(stderr) << "Cannot create temporary directory\n";
+            return 2;
+        }
+
+        QProcess writer;
+        writer.start(QCoreApplication::applicationFilePath(),
+                     { "--benchmark", "journal-writer", "--dir=" + tmp.path(),
+                       "--records=" + QString::number(records) });
+        if (!writer.waitForStarted()) {
+            QTextStream(stderr) << "Cannot start writer process\n";
+            return 2;
+        }
+        writer.waitForFinished(int(rng.bounded(1, maxDelayMs + 1)));
+        writer.kill();
+        writer.waitForFinished();
+
+        int lastAck = -1;
+        const QList<QByteArray> lines = writer.readAllStandardOutput().split('\n');
+        for (const QByteArray &line : lines) {
+            if (line.startsWith("ack ")) {
+                lastAck = line.mid(4).toInt();
+            }
+        }
+
+        // Mode 0: plain kill. Mode 1: garbage tail. Mode 2: truncate at a random offset.
+        int mode = int(rng.bounded(3));
+        QFile journal(tmp.path() + "/history.journal");
+        if (mode == 1 && journal.open(QIODevice::Append)) {
+            QByteArray garbage(int(rng.bounded(1, 64)), '\0');
+            for (char &byte : garbage) {
+                byte = char(rng.bounded(256));
+            }
+            journal.write(garbage);
+            journal.close();
+        } else if (mode == 2 && journal.size() > 16) {
+            journal.resize(16 + qint64(rng.bounded(quint32(journal.size() - 16))));
+        }
+
+        HistoryStore store(tmp.path());
+        HistoryStore::State state;
+        HistoryStore::RecoveryStats stats;
+        QElapsedTimer timer;
+        timer.start();
+        store.recover(&state, &stats);
+        qint64 recoveryNs = timer.nsecsElapsed();
+        maxRecoveryNs = qMax(maxRecoveryNs, recoveryNs);
+        totalRecoveryNs += recoveryNs;
+        discardedBytes += stats.discardedBytes;
+
+        const int recovered = int(state.history.size());
+        for (int i = 0; i < recovered; ++i) {
+            if (state.history.at(i) != QString("entry %1").arg(recovered - 1 - i)) {
+                ++violations;
+                break;
+            }
+        }
+        // At most one record may be committed but not yet acknowledged
+        if (recovered > lastAck + 2) {
+            ++violations;
+        }
+        if (recovered < lastAck + 1) {
+            if (mode == 2) {
+                truncationLoss += lastAck + 1 - recovered;
+            } else {
+                lostAcknowledged += lastAck + 1 - recovered;
+                ++violations;
+            }
+        }
+    }
+
+    out() << "benchmark: journal-crash\n";
+    out() << "iterations: " << iterations << "\n";
+    out() << "violations: " << violations << "\n";
+    out() << "lost_acknowledged: " << lostAcknowledged << "\n";
+    out() << "truncation_loss_records: " << truncationLoss << "\n";
+    out() << "discarded_bytes: " << discardedBytes << "\n";
+    out() << "recovery_ms_avg: " << (iterations ? totalRecoveryNs / 1e6 / iterations : 0.0) << "\n";
+    out() << "recovery_ms_max: " << maxRecoveryNs / 1e6 << "\n";
+    out().flush();
+
+    return violations == 0 ? 0 : 1;
+}
+
+// Pushes a churn of captures through the capture pipeline as fast as the
+// producer can go and reports per-stage latency. Every `dup-every`th capture
+// repeats an earlier entry to exercise the dedup index.
+int pipelineChurn(const QHash<QString, QString> &options) {
+    const int captures = intOption(options, "captures", 20000);
+    const int payloadBytes = intOption(options, "payload", 256);
+    const int dupEvery = intOption(options, "dup-every", 10);
+    const int maxHistory = intOption(options, "max-history", 1000);
+
+    QTemporaryDir tmp;
+    if (!tmp.isValid()) {
+        QTextStream(stderr) << "Cannot create temporary directory\n";
+        return 2;
+    }
+
+    CapturePipeline pipeline(tmp.path());
+    int published = 0;
+    QObject::connect(&pipeline, &CapturePipeline::historyPublished,
+                     [&published](quint64) { ++published; });
+    pipeline.start(maxHistory, 20);
+
+    const QString filler(qMax(0, payloadBytes - 16), QChar('x'));
+    QElapsedTimer wall;
+    wall.start();
+    for (int i = 0; i < captures; ++i) {
+        int id = (dupEvery > 0 && i % dupEvery == dupEvery - 1) ? i / 2 : i;
+        QString text = QString("capture %1 ").arg(id) + filler;
+        while (!pipeline.submitText(text)) {
+            QThread::yieldCurrentThread();
+        }
+    }
+    // Stop drains the queue in order, then deliver the queued publishes
+    pipeline.stop();
+    qint64 elapsedNs = wall.nsecsElapsed();
+    QCoreApplication::processEvents();
+
+    out() << "benchmark: pipeline-churn\n";
+    out() << "captures: " << captures << "\n";
+    out() << "duplicates: " << pipeline.duplicateCount() << "\n";
+    out() << "queue_full_events: " << pipeline.droppedCount() << "\n";
+    out() << "publishes: " << published << "\n";
+    out() << "wall_ms: " << elapsedNs / 1e6 << "\n";
+    out() << "captures_per_sec: " << (elapsedNs ? captures * 1e9 / elapsedNs : 0.0) << "\n";
+    for (const CapturePipeline::StageStats &stage : pipeline.stageStats()) {
+        double avgUs = stage.count ? stage.totalNs / 1000.0 / stage.count : 0.0;
+        out() << "stage_" << stage.name << "_avg_us: " << avgUs << "\n";
+        out() << "stage_" << stage.name << "_max_us: " << stage.maxNs / 1000.0 << "\n";
+    }
+    out().flush();
+    return 0;
+}
+
+// Live snapshot count, to check that retired versions are all reclaimed
+std::atomic<qint64> liveSnapshots{0};
+
+struct TrackedSnapshot {
+    TrackedSnapshot() { ++liveSnapshots; }
+    TrackedSnapshot(const TrackedSnapshot &other) : snapshot(other.snapshot) { ++liveSnapshots; }
+    TrackedSnapshot(TrackedSnapshot &&other) noexcept : snapshot(std::move(other.snapshot)) { ++liveSnapshots; }
+    ~TrackedSnapshot() { --liveSnapshots; }
+    HistorySnapshot snapshot;
+};
+
+// Version v holds "entry v" down to "entry v-n+1" with n = min(v, maxHistory)
+bool snapshotConsistent(const HistorySnapshot &snapshot, int maxHistory) {
+    const qint64 expected = qMin<qint64>(qint64(snapshot.version), maxHistory);
+    if (snapshot.history.size() != expected) {
+        return false;
+    }
+    qint64 next = qint64(snapshot.version);
+    bool ok = true;
+    snapshot.history.forEach([&next, &ok](const HistoryEntry &entry) {
+        ok = entry.body.toString() == QString("entry %1").arg(next--);
+        return ok;
+    });
+    return ok;
+}
+
+// Concurrency stress for snapshot publication. One writer builds versions
+// by prepend + trim on a structurally shared list and publishes each one;
+// `readers` threads take snapshots in a tight loop, check every entry of the
+// version they got, and hold a few of them across later publishes. Any torn
+// or reclaimed-too-early snapshot shows up as a violation.
+int snapshotStress(const QHash<QString, QString> &options) {
+    const int versions = intOption(options, "versions", 200000);
+    const int readerCount = qMax(1, intOption(options, "readers", 4));
+    const int maxHistory = qMax(1, intOption(options, "max-history", 500));
+    const int held = qMax(1, intOption(options, "held", 8));
+
+    std::atomic<bool> done{false};
+    std::atomic<quint64> reads{0};
+    std::atomic<quint64> violations{0};
+    std::atomic<qint64> maxAcquireNs{0};
+    qint64 publishTotalNs = 0;
+    qint64 publishMaxNs = 0;
+    QElapsedTimer wall;
+
+    {
+        SnapshotPublisher<TrackedSnapshot> publisher;
+        using Ref = SnapshotPublisher<TrackedSnapshot>::Ref;
+
+        QVector<QThread *> threads;
+        for (int r = 0; r < readerCount; ++r) {
+            threads.append(QThread::create([&, r]() {
+                QVector<Ref> kept(held);
+                quint64 lastVersion = 0;
+                quint64 localReads = 0;
+                qint64 localMax = 0;
+                QElapsedTimer timer;
+                timer.start();
+                while (!done.load(std::memory_order_acquire)) {
+                    qint64 start = timer.nsecsElapsed();
+                    Ref ref = publisher.acquire();
+                    localMax = qMax(localMax, timer.nsecsElapsed() - start);
+
+                    const HistorySnapshot &snapshot = ref->snapshot;
+                    if (snapshot.version < lastVersion || !snapshotConsistent(snapshot, maxHistory)) {
+                        ++violations;
+                    }
+                    lastVersion = snapshot.version;
+
+                    // Older versions must stay intact while held
+                    Ref &slot = kept[int((localReads + r) % held)];
+                    if (!slot.isNull() && !snapshotConsistent(slot->snapshot, maxHistory)) {
+                        ++violations;
+                    }
+                    slot = ref;
+                    ++localReads;
+                }
+                reads += localReads;
+                qint64 previous = maxAcquireNs.load();
+                while (localMax > previous && !maxAcquireNs.compare_exchange_weak(previous, localMax)) {
+                }
+            }));
+            threads.last()->start();
+        }
+
+        wall.start();
+        EntryArena arena;
+        EntryList history;
+        for (int v = 1; v <= versions; ++v) {
+            qint64 start = wall.nsecsElapsed();
+            HistoryEntry entry;
+            entry.body = arena.store(QString("entry %1").arg(v));
+            history.prepend(entry);
+            history.truncate(maxHistory);
+            TrackedSnapshot next;
+            next.snapshot.version = quint64(v);
+            next.snapshot.history = history;
+            publisher.publish(std::move(next));
+            qint64 ns = wall.nsecsElapsed() - start;
+            publishTotalNs += ns;
+            publishMaxNs = qMax(publishMaxNs, ns);
+        }
+        done.store(true, std::memory_order_release);
+        for (QThread *thread : threads) {
+            thread->wait();
+            delete thread;
+        }
+    }
+    const qint64 elapsedNs = wall.nsecsElapsed();
+    const qint64 leaked = liveSnapshots.load();
+
+    out() << "benchmark: snapshot-stress\n";
+    out() << "versions: " << versions << "\n";
+    out() << "readers: " << readerCount << "\n";
+    out() << "reads: " << reads.load() << "\n";
+    out() << "reads_per_sec: " << (elapsedNs ? reads.load() * 1e9 / elapsedNs : 0.0) << "\n";
+    out() << "publish_avg_us: " << publishTotalNs / 1000.0 / versions << "\n";
+    out() << "publish_max_us: " << publishMaxNs / 1000.0 << "\n";
+    out() << "acquire_max_us: " << maxAcquireNs.load() / 1000.0 << "\n";
+    out() << "violations: " << violations.load() << "\n";
+    out() << "leaked_snapshots: " << leaked << "\n";
+    out().flush();
+
+    return violations.load() == 0 && leaked == 0 ? 0 : 1;
+}
+
+// Heap cost of one QString body: handle plus a malloc'd QArrayData header
+// and UTF-16 payload with terminator, rounded to the allocator's 16 bytes
+qint64 qstringFootprint(const QString &text) {
+    const qint64 block = 16 + 2 * (qint64(text.size()) + 1) + 8;
+    return qint64(sizeof(QString)) + ((block + 15) / 16) * 16;
+}
+
+struct ChurnResult {
+    int entries = 0;
+    qint64 arenaBytes = 0;      // slabs plus entry records
+    qint64 qstringBytes = 0;    // the same live entries as QString
+    qint64 slabs = 0;
+};
+
+QString clipText(const QStringList &fragments, QRandomGenerator &random, int serial) {
+    QString text;
+    const int parts = 1 + int(random.bounded(12));
+    for (int p = 0; p < parts; ++p) {
+        text += fragments.at(int(random.bounded(fragments.size())));
+    }
+    return text + QString::number(serial);
+}
+
+// Steady state after churn: captures past a full history, some re-copies of
+// older entries and pins taken from history along the way. With restoring
+// on, promoted and pinned bodies are re-stored and the lists are compacted
+// once per history's worth of captures, as the capture worker does.
+ChurnResult churnSteadyState(const QStringList &fragments, int entries, int captures, int pinCount,
+                             int promotePercent, bool restoring, quint32 seed) {
+    QRandomGenerator random(seed);
+    const qint64 bytesBefore = EntryArena::allocatedBytes();
+    const qint64 slabsBefore = EntryArena::liveSlabCount();
+    ChurnResult result;
+    EntryArena arena;
+    QVector<HistoryEntry> history;
+    QVector<HistoryEntry> pins;
+    const int pinEvery = pinCount > 0 ? qMax(1, captures / pinCount) : 0;
+    for (int i = 0; i < captures; ++i) {
+        if (pinEvery && i % pinEvery == pinEvery - 1 && pins.size() < pinCount && !history.isEmpty()) {
+            HistoryEntry entry = history.takeAt(int(random.bounded(history.size())));
+            if (restoring) {
+                entry.body = arena.restore(entry.body);
+            }
+            pins.append(entry);
+        } else if (!history.isEmpty() && int(random.bounded(100)) < promotePercent) {
+            HistoryEntry entry = history.takeAt(int(random.bounded(history.size())));
+            if (restoring) {
+                entry.body = arena.restore(entry.body);
+            }
+            history.prepend(entry);
+        } else {
+            HistoryEntry entry;
+            entry.body = arena.store(clipText(fragments, random, i));
+            history.prepend(entry);
+            if (history.size() > entries) {
+                history.removeLast();
+            }
+        }
+        if (restoring && i % entries == entries - 1) {
+            EntryList historyList = EntryList::fromEntries(history);
+            EntryList pinList = EntryList::fromEntries(pins);
+            EntryList::compact(arena, {&historyList, &pinList});
+            history.clear();
+            pins.clear();
+            historyList.forEach([&history](const HistoryEntry &entry) { history.append(entry); return true; });
+            pinList.forEach([&pins](const HistoryEntry &entry) { pins.append(entry); return true; });
+        }
+    }
+    const auto tally = [&result](const HistoryEntry &entry) {
+        result.qstringBytes += qstringFootprint(entry.body.toString());
+    };
+    std::for_each(history.cbegin(), history.cend(), tally);
+    std::for_each(pins.cbegin(), pins.cend(), tally);
+    result.entries = history.size() + pins.size();
+    result.arenaBytes = EntryArena::allocatedBytes() - bytesBefore + qint64(sizeof(HistoryEntry)) * result.entries;
+    result.slabs = EntryArena::liveSlabCount() - slabsBefore;
+    return result;
+}
+
+// Compares bytes per entry for a clipboard-like corpus (code, URLs, shell
+// commands, some non-ASCII prose) held as QString versus UTF-8 arena
+// entries, and the cost of decoding only the visible rows. A fresh fill
+// flatters the arena, so the same comparison is repeated after churn with
+// re-copies and pins, with and without re-storing survivors.
+int entryMemory(const QHash<QString, QString> &options) {
+    const int entries = intOption(options, "entries", 1000);
+    const int visible = intOption(options, "visible", 20);
+    const int captures = intOption(options, "churn", entries * 20);
+    const int pinCount = intOption(options, "pins", 200);
+    const int promotePercent = intOption(options, "promote", 10);
+    const quint32 seed = quint32(intOption(options, "seed", 1));
+    QRandomGenerator random(seed);
+
+    const QStringList fragments = {
+        "const auto result = std::find_if(items.begin(), items.end(), predicate);\n",
+        "https://example.com/api/v2/search?q=clipboard&page=3&sort=recent",
+        "git log --oneline --graph --decorate | head -n 40",
+        "for f in *.log; do gzip -9 \"$f\"; done",
+        "    if (!parser.parse(input, &error)) {\n        return false;\n    }\n",
+        "Grüße aus Köln — naïve café façade\n",
+        "/home/user/projects/xclipy/src/ClipboardManager.cpp"
+    };
+    QStringList corpus;
+    for (int i = 0; i < entries; ++i) {
+        corpus.append(clipText(fragments, random, i));
+    }
+
+    qint64 qstringBytes = 0;
+    for (const QString &text : corpus) {
+        qstringBytes += qstringFootprint(text);
+    }
+
+    const qint64 arenaBefore = EntryArena::allocatedBytes();
+    EntryArena arena;
+    EntryList list = EntryList::fromList(corpus, arena);
+    const qint64 arenaBytes = EntryArena::allocatedBytes() - arenaBefore
+        + qint64(sizeof(HistoryEntry)) * list.size();
+    corpus.clear();
+
+    QElapsedTimer timer;
+    timer.start();
+    int decodedChars = 0;
+    for (int i = 0; i < qMin(visible, list.size()); ++i) {
+        decodedChars += int(list.entry(i).body.preview(4, 4096).size());
+    }
+    const qint64 visibleNs = timer.nsecsElapsed();
+    timer.restart();
+    decodedChars += int(list.toList().size());
+    const qint64 fullNs = timer.nsecsElapsed();
+    Q_UNUSED(decodedChars)
+
+    out() << "benchmark: entry-memory\n";
+    out() << "entries: " << list.size() << "\n";
+    out() << "payload_utf8_bytes: " << list.payloadBytes() << "\n";
+    out() << "qstring_bytes_per_entry: " << (list.size() ? double(qstringBytes) / list.size() : 0.0) << "\n";
+    out() << "arena_bytes_per_entry: " << (list.size() ? double(arenaBytes) / list.size() : 0.0) << "\n";
+    out() << "arena_slabs: " << EntryArena::liveSlabCount() << "\n";
+    out() << "visible_preview_decode_us: " << visibleNs / 1000.0 << "\n";
+    out() << "full_decode_us: " << fullNs / 1000.0 << "\n";
+
+    const auto perEntry = [](qint64 bytes, int count) { return count ? double(bytes) / count : 0.0; };
+    const ChurnResult kept = churnSteadyState(fragments, entries, captures, pinCount, promotePercent, false, seed);
+    const ChurnResult restored = churnSteadyState(fragments, entries, captures, pinCount, promotePercent, true, seed);
+    out() << "churn_captures: " << captures << "\n";
+    out() << "churn_entries: " << restored.entries << "\n";
+    out() << "churn_qstring_bytes_per_entry: " << perEntry(restored.qstringBytes, restored.entries) << "\n";
+    out() << "churn_arena_bytes_per_entry: " << perEntry(kept.arenaBytes, kept.entries) << "\n";
+    out() << "churn_arena_slabs: " << kept.slabs << "\n";
+    out() << "churn_restored_bytes_per_entry: " << perEntry(restored.arenaBytes, restored.entries) << "\n";
+    out() << "churn_restored_slabs: " << restored.slabs << "\n";
+    out().flush();
+    return 0;
+}
+
+// Feeds a history-sized stream of log-like clips, a third of which repeat an
+// earlier clip with a new timestamp, through the near-duplicate index and
+// reports the per-capture cost and how many repeats were grouped.
+int nearDuplicates(const QHash<QString, QString> &options) {
+    const int entries = intOption(options, "entries", 100000);
+    const int threshold = intOption(options, "threshold", 3);
+    QRandomGenerator random(quint32(intOption(options, "seed", 1)));
+
+    const QStringList words = {
+        "request", "failed", "connection", "timeout", "user", "session", "cache",
+        "miss", "retry", "worker", "queue", "flush", "commit", "rollback", "index",
+        "build", "deploy", "token", "expired", "handler", "socket", "closed"
+    };
+    NearDuplicateIndex index(threshold);
+    QVector<QByteArray> originals;
+    QVector<quint32> originalGroups;
+    int repeats = 0;
+    int grouped = 0;
+    qint64 totalNs = 0;
+    qint64 maxNs = 0;
+    QElapsedTimer timer;
+
+    for (int i = 0; i < entries; ++i) {
+        const bool repeat = !originals.isEmpty() && random.bounded(3) == 0;
+        const int source = repeat ? int(random.bounded(originals.size())) : -1;
+        QByteArray text = QByteArray("2024-05-") + QByteArray::number(10 + random.bounded(20))
+            + " " + QByteArray::number(random.bounded(24)) + ":" + QByteArray::number(random.bounded(60)) + " ";
+        if (repeat) {
+            text += originals.at(source);
+        } else {
+            QByteArray body;
+            const int length = 6 + int(random.bounded(20));
+            for (int w = 0; w < length; ++w) {
+                body += words.at(int(random.bounded(words.size()))).toUtf8() + ' ';
+            }
+            text += body;
+            originals.append(body);
+        }
+
+        timer.start();
+        quint64 fingerprint = 0;
+        quint32 group = 0;
+        if (NearDuplicateIndex::fingerprint(NearDuplicateIndex::normalize(text), &fingerprint)) {
+            group = index.insert(quint32(qHash(text)), fingerprint);
+        }
+        const qint64 ns = timer.nsecsElapsed();
+        totalNs += ns;
+        maxNs = qMax(maxNs, ns);
+
+        if (repeat) {
+            ++repeats;
+            if (group != 0 && group == originalGroups.at(source)) {
+                ++grouped;
+            }
+        } else {
+            originalGroups.append(group);
+        }
+    }
+
+    out() << "benchmark: near-duplicates\n";
+    out() << "entries: " << entries << "\n";
+    out() << "indexed: " << index.size() << "\n";
+    out() << "threshold_bits: " << index.threshold() << "\n";
+    out() << "avg_insert_us: " << (entries ? totalNs / 1000.0 / entries : 0.0) << "\n";
+    out() << "max_insert_us: " << maxNs / 1000.0 << "\n";
+    out() << "repeats: " << repeats << "\n";
+    out() << "repeats_grouped: " << grouped << "\n";
+    out().flush();
+    return 0;
+}
+
+// Runs one query to completion on the event loop; returns its wall time
+struct SearchRun {
+    qint64 firstBatchUs = -1;
+    qint64 totalUs = 0;
+    int matches = 0;
+    bool complete = false;
+};
+
+SearchRun runSearch(HistorySearch &search, const HistorySnapshotRef &snapshot, const QString &pattern) {
+    SearchRun run;
+    QEventLoop loop;
+    QElapsedTimer timer;
+    timer.start();
+    QMetaObject::Connection onMatches = QObject::connect(&search, &HistorySearch::matchesFound,
+        [&run, &timer](quint64, const QVector<SearchHit> &hits) {
+            if (run.firstBatchUs < 0) {
+                run.firstBatchUs = timer.nsecsElapsed() / 1000;
+            }
+            run.matches += hits.size();
+        });
+    QMetaObject::Connection onFinished = QObject::connect(&search, &HistorySearch::finished,
+        [&run, &loop](quint64, bool complete) {
+            run.complete = complete;
+            loop.quit();
+        });
+    if (search.start(snapshot, pattern) != 0) {
+        loop.exec();
+    }
+    run.totalUs = timer.nsecsElapsed() / 1000;
+    QObject::disconnect(onMatches);
+    QObject::disconnect(onFinished);
+    return run;
+}
+
+// Regex search over a synthetic history with JWTs and IP addresses mixed
+// into ordinary clips: first-batch latency, total time, the cost of a
+// cached recompile, how quickly a superseded query gives way, and whether
+// a catastrophic pattern is stopped by the time budget.
+int regexSearch(const QHash<QString, QString> &options) {
+    const int entries = intOption(options, "entries", 100000);
+    const int budget = intOption(options, "budget", 250);
+    QRandomGenerator random(quint32(intOption(options, "seed", 1)));
+
+    const QStringList fragments = {
+        "git rebase -i HEAD~3 && git push --force-with-lease\n",
+        "SELECT id, name FROM users WHERE created_at > now() - interval '1 day';\n",
+        "The quick brown fox jumps over the lazy dog. ",
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa!",
+        "    return std::accumulate(values.begin(), values.end(), 0);\n"
+    };
+    QStringList corpus;
+    for (int i = 0; i < entries; ++i) {
+        QString text = fragments.at(int(random.bounded(fragments.size())));
+        switch (random.bounded(10)) {
+        case 0:
+            text += QString("eyJhbGciOiJIUzI1NiJ9.eyJzdWIiOiI%1In0.c2lnbmF0dXJl%2").arg(i).arg(random.bounded(1000));
+            break;
+        case 1:
+            text += QString("ssh root@10.%1.%2.%3").arg(random.bounded(256)).arg(random.bounded(256)).arg(random.bounded(256));
+            break;
+        default:
+            text += QString::number(i);
+            break;
+        }
+        corpus.append(text);
+    }
+
+    EntryArena arena;
+    HistorySnapshotPublisher publisher;
+    HistorySnapshot snapshot;
+    snapshot.history = EntryList::fromList(corpus, arena);
+    publisher.publish(snapshot);
+    const HistorySnapshotRef ref = publisher.acquire();
+    corpus.clear();
+
+    HistorySearch search;
+    search.setTimeBudget(10000);
+    const QString jwt = "eyJ[\\w-]+\\.[\\w-]+\\.[\\w-]+";
+    const QString ip = "\\b(?:\\d{1,3}\\.){3}\\d{1,3}\\b";
+    const SearchRun jwtRun = runSearch(search, ref, jwt);
+    const SearchRun ipRun = runSearch(search, ref, ip);
+    const SearchRun cachedRun = runSearch(search, ref, jwt);
+
+    // A keystroke arriving mid-query: the second query must not wait for the first
+    QElapsedTimer timer;
+    timer.start();
+    search.start(ref, "(\\w+\\s?)+\\d{9}$");
+    const SearchRun supersededRun = runSearch(search, ref, ip);
+    const qint64 supersedeUs = timer.nsecsElapsed() / 1000;
+
+    search.setTimeBudget(budget);
+    const SearchRun catastrophicRun = runSearch(search, ref, "(a+)+$");
+
+    out() << "benchmark: regex-search\n";
+    out() << "entries: " << ref->history.size() << "\n";
+    out() << "threads: " << search.threadCount() << "\n";
+    out() << "jwt_matches: " << jwtRun.matches << "\n";
+    out() << "jwt_first_batch_ms: " << jwtRun.firstBatchUs / 1000.0 << "\n";
+    out() << "jwt_total_ms: " << jwtRun.totalUs / 1000.0 << "\n";
+    out() << "ip_matches: " << ipRun.matches << "\n";
+    out() << "ip_total_ms: " << ipRun.totalUs / 1000.0 << "\n";
+    out() << "cached_pattern_total_ms: " << cachedRun.totalUs / 1000.0 << "\n";
+    out() << "superseded_query_total_ms: " << supersedeUs / 1000.0 << "\n";
+    out() << "superseded_matches_ok: " << (supersededRun.matches == ipRun.matches ? "yes" : "no") << "\n";
+    out() << "budget_ms: " << budget << "\n";
+    out() << "catastrophic_complete: " << (catastrophicRun.complete ? "yes" : "no") << "\n";
+    out() << "catastrophic_total_ms: " << catastrophicRun.totalUs / 1000.0 << "\n";
+    out().flush();
+    return supersededRun.matches == ipRun.matches ? 0 : 1;
+}
+
+// Frecency upkeep and retrieval: the cost of recording a use, and of
+// producing the top K rows from a heap versus fully sorting the history.
+// The two orderings must agree.
+int frecencyTopK(const QHash<QString, QString> &options) {
+    const int entries = intOption(options, "entries", 100000);
+    const int k = intOption(options, "k", 50);
+    const int uses = intOption(options, "uses", 200000);
+    QRandomGenerator random(quint32(intOption(options, "seed", 1)));
+
+    // Skewed uses over the past month: a few entries are used far more often
+    FrecencyIndex index;
+    const double now = FrecencyIndex::now();
+    const double month = 30 * 24.0 / FrecencyIndex::kHalfLifeHours;
+    for (int i = 0; i < entries; ++i) {
+        index.seed(quint32(i), now - month * random.generateDouble());
+    }
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < uses; ++i) {
+        const double u = random.generateDouble();
+        index.bump(quint32(u * u * u * entries), now - month * random.generateDouble());
+    }
+    const qint64 bumpNs = timer.nsecsElapsed();
+
+    QVector<FrecencyHeap::Item> items;
+    items.reserve(entries);
+    for (int i = 0; i < entries; ++i) {
+        items.append(FrecencyHeap::Item{index.key(quint32(i)), i});
+    }
+    QVector<FrecencyHeap::Item> sorted = items;
+
+    timer.restart();
+    FrecencyHeap heap;
+    heap.assign(std::move(items));
+    const QVector<FrecencyHeap::Item> top = heap.take(k);
+    const qint64 heapNs = timer.nsecsElapsed();
+
+    timer.restart();
+    std::sort(sorted.begin(), sorted.end(), [](const FrecencyHeap::Item &a, const FrecencyHeap::Item &b) {
+        return FrecencyHeap::lower(b, a);
+    });
+    const qint64 sortNs = timer.nsecsElapsed();
+
+    bool agree = top.size() == qMin(k, entries);
+    for (int i = 0; agree && i < top.size(); ++i) {
+        agree = top.at(i).entry == sorted.at(i).entry;
+    }
+
+    out() << "benchmark: frecency-topk\n";
+    out() << "entries: " << entries << "\n";
+    out() << "k: " << k << "\n";
+    out() << "bump_ns_avg: " << (uses ? double(bumpNs) / uses : 0.0) << "\n";
+    out() << "heap_topk_us: " << heapNs / 1000.0 << "\n";
+    out() << "full_sort_us: " << sortNs / 1000.0 << "\n";
+    out() << "orders_agree: " << (agree ? "yes" : "no") << "\n";
+    out().flush();
+    return agree ? 0 : 1;
+}
+
+// Entry expiry: a week of captures, most kept for the maximum age and a few
+// marked as passwords with a one-minute lifetime. The timer wheel wakes
+// only at deadlines; the baseline wakes every scan interval and checks
+// every live entry. Every timer must fire exactly at its deadline.
+int expiryWheel(const QHash<QString, QString> &options) {
+    const int entries = intOption(options, "entries", 100000);
+    const qint64 span = intOption(options, "span", 7 * 24 * 60 * 60);
+    const qint64 maxAge = intOption(options, "max-age", 7 * 24 * 60 * 60);
+    const int concealedPercent = intOption(options, "concealed", 1);
+    const qint64 scanInterval = qMax(1, intOption(options, "scan-interval", 60));
+    QRandomGenerator random(quint32(intOption(options, "seed", 1)));
+
+    const qint64 start = 1700000000;
+    QVector<TimerWheel::Timer> timers;
+    timers.reserve(entries);
+    for (int i = 0; i < entries; ++i) {
+        const qint64 capturedAt = start + qint64(random.bounded(quint32(qMax<qint64>(1, span))));
+        const bool concealed = int(random.bounded(100)) < concealedPercent;
+        timers.append(TimerWheel::Timer{quint32(i), capturedAt + (concealed ? 60 : maxAge)});
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    TimerWheel wheel(start);
+    for (const TimerWheel::Timer &t : timers) {
+        wheel.schedule(t.key, t.deadline);
+    }
+    const qint64 scheduleNs = timer.nsecsElapsed();
+
+    timer.restart();
+    qint64 wakeups = 0;
+    qint64 fired = 0;
+    bool onTime = true;
+    QVector<TimerWheel::Timer> expired;
+    while (wheel.size() > 0) {
+        const qint64 next = wheel.nextDeadline();
+        expired.clear();
+        wheel.advance(next, &expired);
+        ++wakeups;
+        for (const TimerWheel::Timer &t : expired) {
+            onTime = onTime && t.deadline == next;
+        }
+        fired += expired.size();
+    }
+    const qint64 wheelNs = timer.nsecsElapsed();
+
+    // Baseline: periodic scan of the live entries
+    timer.restart();
+    QVector<qint64> live;
+    live.reserve(entries);
+    for (const TimerWheel::Timer &t : timers) {
+        live.append(t.deadline);
+    }
+    qint64 scans = 0;
+    qint64 visits = 0;
+    qint64 lateSeconds = 0;
+    for (qint64 now = start; !live.isEmpty(); now += scanInterval) {
+        ++scans;
+        for (int i = 0; i < live.size();) {
+            ++visits;
+            if (live.at(i) <= now) {
+                lateSeconds += now - live.at(i);
+                live[i] = live.last();
+                live.removeLast();
+            } else {
+                ++i;
+            }
+        }
+    }
+    const qint64 scanNs = timer.nsecsElapsed();
+
+    out() << "benchmark: expiry-wheel\n";
+    out() << "entries: " << entries << "\n";
+    out() << "span_s: " << span << "\n";
+    out() << "schedule_ns_avg: " << (entries ? double(scheduleNs) / entries : 0.0) << "\n";
+    out() << "wheel_wakeups: " << wakeups << "\n";
+    out() << "wheel_ms: " << wheelNs / 1e6 << "\n";
+    out() << "wheel_ns_per_expiry: " << (fired ? double(wheelNs) / fired : 0.0) << "\n";
+    out() << "wheel_memory_bytes: " << wheel.memoryBytes() << "\n";
+    out() << "scan_interval_s: " << scanInterval << "\n";
+    out() << "scan_wakeups: " << scans << "\n";
+    out() << "scan_visits: " << visits << "\n";
+    out() << "scan_ms: " << scanNs / 1e6 << "\n";
+    out() << "scan_avg_late_s: " << (entries ? double(lateSeconds) / entries : 0.0) << "\n";
+    out() << "all_fired_on_time: " << (onTime && fired == entries ? "yes" : "no") << "\n";
+    out().flush();
+    return onTime && fired == entries ? 0 : 1;
+}
+
+// Cold-tier search: archives synthetic evicted entries into sealed segments,
+// plants a rare token in a few of them, then looks it up with and without
+// the per-segment trigram filters. Both must find the same entries; the
+// filtered search should decompress only the segments that hold them.
+int archiveSearch(const QHash<QString, QString> &options) {
+    const int entries = intOption(options, "entries", 200000);
+    const int planted = intOption(options, "planted", 3);
+    QRandomGenerator random(quint32(intOption(options, "seed", 1)));
+
+    QTemporaryDir tmp;
+    if (!tmp.isValid()) {
+        QTextStream(stderr) << "Cannot create temporary directory\n";
+        return 1;
+    }
+    HistoryArchive archive(tmp.path() + "/archive");
+    if (!archive.open()) {
+        return 1;
+    }
+
+    const QStringList words = {"commit", "deploy", "review", "release", "branch", "docker",
+                               "kubectl", "select", "update", "config", "server", "client"};
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < entries; ++i) {
+        QString text;
+        const int count = 4 + int(random.bounded(12));
+        for (int w = 0; w < count; ++w) {
+            text += words.at(int(random.bounded(words.size()))) + ' ';
+        }
+        text += QString::number(i);
+        if (planted > 0 && i % (entries / planted + 1) == entries / (2 * planted)) {
+            text += " zq-needle-7x";
+        }
+        archive.append(text.toUtf8());
+        if (i % 256 == 255) {
+            archive.flush();    // one journal batch
+        }
+    }
+    archive.flush();
+    const qint64 archiveNs = timer.nsecsElapsed();
+
+    const std::atomic<bool> cancelled{false};
+    const auto ignore = [](const QVector<SearchHit> &) {};
+    timer.restart();
+    const HistoryArchive::SearchStats filtered = archive.search("ZQ-NEEDLE-7X", entries, cancelled, ignore);
+    const qint64 filteredNs = timer.nsecsElapsed();
+    timer.restart();
+    const HistoryArchive::SearchStats scanned = archive.search("ZQ-NEEDLE-7X", entries, cancelled, ignore, false);
+    const qint64 scannedNs = timer.nsecsElapsed();
+
+    out() << "benchmark: archive-search\n";
+    out() << "entries: " << archive.entryCount() << "\n";
+    out() << "segments: " << archive.segmentCount() << "\n";
+    out() << "archive_us_per_entry: " << (entries ? archiveNs / 1000.0 / entries : 0.0) << "\n";
+    out() << "filtered_matches: " << filtered.matches << "\n";
+    out() << "filtered_segments_skipped: " << filtered.segmentsSkipped << "\n";
+    out() << "filtered_compressed_bytes_read: " << filtered.compressedBytesRead << "\n";
+    out() << "filtered_ms: " << filteredNs / 1e6 << "\n";
+    out() << "scan_matches: " << scanned.matches << "\n";
+    out() << "scan_compressed_bytes_read: " << scanned.compressedBytesRead << "\n";
+    out() << "scan_ms: " << scannedNs / 1e6 << "\n";
+    out() << "matches_agree: " << (filtered.matches == scanned.matches ? "yes" : "no") << "\n";
+    out().flush();
+    return filtered.matches == scanned.matches ? 0 : 1;
+}
+
+// Cross-instance sharing: a writer thread commits journal batches and mirrors
+// them into a SharedHistoryRing while a reader follows the ring in place, as
+// a follower instance does, resyncing from the store when lapped. Both must
+// end with the history recovered from the store.
+int sharedRing(const QHash<QString, QString> &options) {
+    const int records = intOption(options, "records", 50000);
+    const int batch = qMax(1, intOption(options, "batch", 8));
+    const int maxHistory = intOption(options, "max-history", 500);
+
+    QTemporaryDir tmp;
+    if (!tmp.isValid()) {
+        QTextStream(stderr) << "Cannot create temporary directory\n";
+        return 1;
+    }
+    const QString key = SharedHistoryRing::keyFor(tmp.path()) + "-bench";
+    SharedHistoryRing writerRing(key);
+    if (!writerRing.createAsWriter()) {
+        return 1;
+    }
+    HistoryStore store(tmp.path());
+    if (!store.open()) {
+        return 1;
+    }
+
+    std::atomic<bool> done{false};
+    quint64 batchesRead = 0;
+    quint64 resyncs = 0;
+    HistoryStore::State followed;
+    QThread *reader = QThread::create([&]() {
+        SharedHistoryRing ring(key);
+        HistoryStore view(tmp.path());
+        view.setReadOnly(true);
+        ring.attachAsReader();
+        quint64 epoch = ring.epoch();
+        quint64 cursor = ring.head();
+        view.recover(&followed);
+        for (;;) {
+            const bool last = done.load(std::memory_order_acquire);
+            const auto result = ring.read(epoch, &cursor, [&](SharedHistoryRing::Batch, QByteArrayView data) {
+                HistoryStore::replayRecords(&followed, data);
+                ++batchesRead;
+            });
+            if (result == SharedHistoryRing::ReadResult::Resync) {
+                ++resyncs;
+                epoch = ring.epoch();
+                cursor = ring.head();
+                view.recover(&followed);
+                continue;
+            }
+            if (last) {
+                break;
+            }
+            QThread::yieldCurrentThread();
+        }
+    });
+    reader->start();
+
+    HistoryStore::State state;
+    QByteArray committed;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < records; ++i) {
+        const QString text = QString("shared entry %1").arg(i);
+        state.history.prepend(text);
+        store.recordPrepend(HistoryStore::List::History, text);
+        if (state.history.size() > maxHistory) {
+            state.history = state.history.mid(0, maxHistory);
+            store.recordTruncate(HistoryStore::List::History, maxHistory);
+        }
+        if (i % batch == batch - 1 || i == records - 1) {
+            if (!store.commit(&committed)) {
+                return 1;
+            }
+            writerRing.append(SharedHistoryRing::Batch::Records, committed);
+            committed.clear();
+        }
+    }
+    const qint64 writeNs = timer.nsecsElapsed();
+    done.store(true, std::memory_order_release);
+    reader->wait();
+    delete reader;
+    store.close();
+
+    const bool agree = followed.history == state.history;
+    out() << "benchmark: shared-ring\n";
+    out() << "records: " << records << "\n";
+    out() << "batches_read: " << batchesRead << "\n";
+    out() << "resyncs: " << resyncs << "\n";
+    out() << "write_us_per_record: " << (records ? writeNs / 1000.0 / records : 0.0) << "\n";
+    out() << "history_agrees: " << (agree ? "yes" : "no") << "\n";
+    out().flush();
+    return agree ? 0 : 1;
+}
+
+// Backup round trip: writes an export with `entries` archived entries and
+// `hot` history entries, imports it into an empty pipeline, then imports it
+// again. The second import must find everything already present.
+int exportImport(const QHash<QString, QString> &options) {
+    const int entries = intOption(options, "entries", 1000000);
+    const int hot = intOption(options, "hot", 2000);
+    const int maxHistory = intOption(options, "max-history", 1000);
+    const int payloadBytes = intOption(options, "payload", 64);
+
+    QTemporaryDir tmp;
+    if (!tmp.isValid()) {
+        QTextStream(stderr) << "Cannot create temporary directory\n";
+        return 2;
+    }
+    const QString path = tmp.path() + "/history.xce";
+    const QString filler(qMax(0, payloadBytes - 24), QChar('x'));
+    QElapsedTimer timer;
+    timer.start();
+    {
+        HistoryExport::Writer writer(path);
+        if (!writer.open()) {
+            return 1;
+        }
+        for (int i = 0; i < entries; ++i) {
+            writer.write(HistoryExport::Tier::Archived, (QString("archived %1 ").arg(i) + filler).toUtf8(),
+                         0, 1600000000 + i);
+        }
+        const double now = FrecencyIndex::now();
+        for (int i = 0; i < hot; ++i) {
+            writer.write(HistoryExport::Tier::History, (QString("hot %1 ").arg(i) + filler).toUtf8(),
+                         float(now - i * 0.001));
+        }
+        if (!writer.finish()) {
+            return 1;
+        }
+    }
+    const qint64 writeMs = timer.elapsed();
+
+    CapturePipeline pipeline(tmp.path() + "/store");
+    pipeline.setArchiveEvicted(true);
+    pipeline.start(maxHistory, 20);
+    const auto runImport = [&pipeline, &path]() {
+        HistoryExport::Stats result;
+        QEventLoop loop;
+        const QMetaObject::Connection connection = QObject::connect(
+            &pipeline, &CapturePipeline::importFinished, [&result, &loop](const HistoryExport::Stats &stats) {
+                result = stats;
+                loop.quit();
+            });
+        pipeline.importHistory(path);
+        loop.exec();
+        QObject::disconnect(connection);
+        return result;
+    };
+    const HistoryExport::Stats first = runImport();
+    const HistoryExport::Stats second = runImport();
+    pipeline.stop();
+    const int kept = pipeline.snapshot()->history.size();
+
+    const bool ok = first.ok && first.complete && kept == qMin(hot, maxHistory)
+                    && first.archived == entries + qMax(0, hot - maxHistory)
+                    && second.added == 0 && second.archived == 0;
+    out() << "benchmark: export-import\n";
+    out() << "entries: " << first.entries << "\n";
+    out() << "file_bytes: " << first.bytes << "\n";
+    out() << "export_entries_per_sec: " << (writeMs > 0 ? (entries + hot) * 1000LL / writeMs : 0) << "\n";
+    out() << "import_entries_per_sec: " << first.entriesPerSecond() << "\n";
+    out() << "import_added: " << first.added << "\n";
+    out() << "import_archived: " << first.archived << "\n";
+    out() << "reimport_entries_per_sec: " << second.entriesPerSecond() << "\n";
+    out() << "reimport_duplicates: " << second.duplicates << "\n";
+    out() << "history_kept: " << kept << "\n";
+    out() << "merge_correct: " << (ok ? "yes" : "no") << "\n";
+    out().flush();
+    return ok ? 0 : 1;
+}
+
+// Content classification on the capture worker: the byte profile pass with
+// SSE2 against the scalar loop (they must agree), then whole clips of mixed
+// kinds through classify().
+int classify(const QHash<QString, QString> &options) {
+    const int clips = intOption(options, "clips", 20000);
+    const int passes = intOption(options, "passes", 5);
+    QRandomGenerator random(quint32(intOption(options, "seed", 1)));
+
+    const QList<QByteArray> samples = {
+        "https://example.org/docs/page?id=42#top",
+        "someone@example.org",
+        "{\"name\": \"xclipy\", \"tags\": [1, 2, 3], \"ok\": true}",
+        "#3a7bd5",
+        "for (int i = 0; i < n; ++i) {\n    total += values[i];\n}\n",
+        "git log --oneline | grep fix",
+        "/usr/share/applications/xclipy.desktop",
+        "ghp_" + QByteArray(36, 'a'),
+        "The quick brown fox jumps over the lazy dog, again and again.",
+    };
+    QVector<QByteArray> inputs;
+    inputs.reserve(clips);
+    qint64 totalBytes = 0;
+    for (int i = 0; i < clips; ++i) {
+        QByteArray clip = samples.at(random.bounded(int(samples.size())));
+        if (random.bounded(8) == 0) {
+            // Now and then a long prose clip, to measure the scan itself
+            clip = samples.last().repeated(1 + random.bounded(400));
+        }
+        totalBytes += clip.size();
+        inputs.append(clip);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    quint32 simdMarkers = 0;
+    for (int pass = 0; pass < passes; ++pass) {
+        for (const QByteArray &clip : inputs) {
+            simdMarkers ^= ContentClassifier::profile(clip).markers;
+        }
+    }
+    const qint64 simdNs = timer.nsecsElapsed();
+    timer.restart();
+    quint32 scalarMarkers = 0;
+    for (int pass = 0; pass < passes; ++pass) {
+        for (const QByteArray &clip : inputs) {
+            scalarMarkers ^= ContentClassifier::profileScalar(clip).markers;
+        }
+    }
+    const qint64 scalarNs = timer.nsecsElapsed();
+
+    bool agree = simdMarkers == scalarMarkers;
+    for (int i = 0; agree && i < inputs.size(); ++i) {
+        const ContentClassifier::Profile a = ContentClassifier::profile(inputs.at(i));
+        const ContentClassifier::Profile b = ContentClassifier::profileScalar(inputs.at(i));
+        agree = a.markers == b.markers && a.lines == b.lines && a.blanks == b.blanks && a.ascii == b.ascii;
+    }
+
+    QVector<int> perKind(ContentClassifier::kKindCount);
+    timer.restart();
+    for (const QByteArray &clip : inputs) {
+        const ContentClassifier::Kinds kinds = ContentClassifier::classify(clip);
+        for (int k = 0; k < ContentClassifier::kKindCount; ++k) {
+            perKind[k] += (kinds & ContentClassifier::kindAt(k)) ? 1 : 0;
+        }
+    }
+    const qint64 classifyNs = timer.nsecsElapsed();
+
+    const double scannedMb = double(totalBytes) * passes / (1024 * 1024);
+    out() << "benchmark: classify\n";
+    out() << "clips: " << clips << "\n";
+    out() << "bytes: " << totalBytes << "\n";
+    out() << "profile_sse2_mb_per_s: " << (simdNs ? scannedMb * 1e9 / simdNs : 0.0) << "\n";
+    out() << "profile_scalar_mb_per_s: " << (scalarNs ? scannedMb * 1e9 / scalarNs : 0.0) << "\n";
+    out() << "classify_us_avg: " << (clips ? classifyNs / 1000.0 / clips : 0.0) << "\n";
+    for (int k = 0; k < ContentClassifier::kKindCount; ++k) {
+        out() << "kind_" << ContentClassifier::kindName(ContentClassifier::kindAt(k)).toLower().replace(QChar(' '), QChar('_'))
+              << ": " << perKind.at(k) << "\n";
+    }
+    out() << "profiles_agree: " << (agree ? "yes" : "no") << "\n";
+    out().flush();
+    return agree ? 0 : 1;
+}
+
+// Replays a recorded workload trace (see WorkloadTrace) through the capture
+// pipeline. Content is synthesized from each record, so every run over a
+// trace feeds the engine identical input, and the final digest tells
+// whether two builds ended up with the same history. speed=0 replays as fast
+// as the producer can go, 1 in recorded time, 10 ten times faster.
+int replay(const QHash<QString, QString> &options) {
+    const QString path = options.value("trace");
+    const double speed = options.value("speed", "0").toDouble();
+    const int maxHistory = intOption(options, "max-history", 50);
+    const int maxSelections = intOption(options, "max-selections", 20);
+    const bool normalize = intOption(options, "normalize", 0) != 0;
+    const int nearThreshold = intOption(options, "near-threshold", -1);
+
+    WorkloadTrace::Reader reader(path);
+    if (path.isEmpty() || !reader.open()) {
+        QTextStream(stderr) << "Cannot read --trace=" << path << ": " << reader.errorString() << "\n";
+        return 2;
+    }
+    QVector<WorkloadTrace::Record> records;
+    WorkloadTrace::Record record;
+    while (reader.next(&record)) {
+        records.append(record);
+    }
+    if (!reader.errorString().isEmpty()) {
+        QTextStream(stderr) << "Replaying the first " << records.size() << " events: " << reader.errorString() << "\n";
+    }
+
+    QTemporaryDir tmp;
+    if (!tmp.isValid()) {
+        QTextStream(stderr) << "Cannot create temporary directory\n";
+        return 2;
+    }
+    CapturePipeline pipeline(tmp.path());
+    int published = 0;
+    QObject::connect(&pipeline, &CapturePipeline::historyPublished,
+                     [&published](quint64) { ++published; });
+    pipeline.setDedupOptions(normalize, nearThreshold);
+    pipeline.start(maxHistory, maxSelections);
+
+    // Removes, pins and uses name a clip by hash; its content comes from the capture
+    QHash<quint32, WorkloadTrace::Record> captured;
+    const auto contentOf = [&captured](const WorkloadTrace::Record &named) {
+        const WorkloadTrace::Record source = captured.value(named.hash, named);
+        return source.event == WorkloadTrace::Event::Files ? WorkloadTrace::synthesizeFiles(source).join("\n")
+                                                           : WorkloadTrace::synthesize(source);
+    };
+    QVector<int> perEvent(int(WorkloadTrace::Event::Clear) + 1);
+    qint64 bytes = 0;
+    QElapsedTimer wall;
+    wall.start();
+    for (const WorkloadTrace::Record &event : records) {
+        if (speed > 0) {
+            const qint64 waitNs = qint64(event.atNs / speed) - wall.nsecsElapsed();
+            if (waitNs > 0) {
+                QThread::usleep(quint64(waitNs / 1000));
+            }
+        }
+        ++perEvent[int(event.event)];
+        switch (event.event) {
+        case WorkloadTrace::Event::Text:
+        case WorkloadTrace::Event::Selection: {
+            captured.insert(event.hash, event);
+            const QString text = WorkloadTrace::synthesize(event);
+            bytes += event.size;
+            const bool selection = event.event == WorkloadTrace::Event::Selection;
+            const bool concealed = event.formats & WorkloadTrace::FormatConcealed;
+            while (!(selection ? pipeline.submitSelection(text) : pipeline.submitText(text, concealed))) {
+                QThread::yieldCurrentThread();
+            }
+            break;
+        }
+        case WorkloadTrace::Event::Files: {
+            captured.insert(event.hash, event);
+            const QStringList files = WorkloadTrace::synthesizeFiles(event);
+            bytes += event.size;
+            while (!pipeline.submitFiles(files)) {
+                QThread::yieldCurrentThread();
+            }
+            break;
+        }
+        case WorkloadTrace::Event::Remove:
+            pipeline.removeEntry(contentOf(event));
+            break;
+        case WorkloadTrace::Event::Pin:
+            pipeline.pinEntry(contentOf(event));
+            break;
+        case WorkloadTrace::Event::Unpin:
+            pipeline.unpinEntry(contentOf(event));
+            break;
+        case WorkloadTrace::Event::Use:
+            pipeline.touchEntry(contentOf(event));
+            break;
+        case WorkloadTrace::Event::Clear:
+            pipeline.clear();
+            break;
+        }
+    }
+    // Stop drains the queue in order, then deliver the queued publishes
+    pipeline.stop();
+    const qint64 elapsedNs = wall.nsecsElapsed();
+    QCoreApplication::processEvents();
+
+    // Order and content of every tier; equal digests mean equal outcomes
+    const HistorySnapshotRef snapshot = pipeline.snapshot();
+    quint64 digest = 1469598103934665603ull;
+    const auto fold = [&digest](const EntryList &list) {
+        list.forEach([&digest](const HistoryEntry &entry) {
+            digest = (digest ^ entry.body.hash()) * 1099511628211ull;
+            return true;
+        });
+        digest = (digest ^ quint64(list.size())) * 1099511628211ull;
+    };
+    fold(snapshot->history);
+    fold(snapshot->selections);
+    fold(snapshot->pins);
+
+    qint64 storeBytes = 0;
+    QDirIterator files(tmp.path(), QDir::Files, QDirIterator::Subdirectories);
+    while (files.hasNext()) {
+        storeBytes += QFileInfo(files.next()).size();
+    }
+
+    HistorySearch search;
+    search.setTimeBudget(10000);
+    const SearchRun wordRun = runSearch(search, snapshot, "\\b[a-z]{9}\\b");
+    const SearchRun urlRun = runSearch(search, snapshot, "https?://\\S+");
+
+    out() << "benchmark: replay\n";
+    out() << "events: " << records.size() << "\n";
+    out() << "captures: " << perEvent.at(int(WorkloadTrace::Event::Text)) << "\n";
+    out() << "selections: " << perEvent.at(int(WorkloadTrace::Event::Selection)) << "\n";
+    out() << "file_captures: " << perEvent.at(int(WorkloadTrace::Event::Files)) << "\n";
+    out() << "uses: " << perEvent.at(int(WorkloadTrace::Event::Use)) << "\n";
+    out() << "removes: " << perEvent.at(int(WorkloadTrace::Event::Remove)) << "\n";
+    out() << "pin_changes: " << perEvent.at(int(WorkloadTrace::Event::Pin)) + perEvent.at(int(WorkloadTrace::Event::Unpin)) << "\n";
+    out() << "clears: " << perEvent.at(int(WorkloadTrace::Event::Clear)) << "\n";
+    out() << "captured_bytes: " << bytes << "\n";
+    out() << "speed: " << speed << "\n";
+    out() << "wall_ms: " << elapsedNs / 1e6 << "\n";
+    out() << "events_per_sec: " << (elapsedNs ? records.size() * 1e9 / elapsedNs : 0.0) << "\n";
+    out() << "duplicates: " << pipeline.duplicateCount() << "\n";
+    out() << "queue_full_events: " << pipeline.droppedCount() << "\n";
+    out() << "publishes: " << published << "\n";
+    out() << "history_entries: " << snapshot->history.size() << "\n";
+    out() << "selection_entries: " << snapshot->selections.size() << "\n";
+    out() << "pinned_entries: " << snapshot->pins.size() << "\n";
+    out() << "store_bytes: " << storeBytes << "\n";
+    out() << "arena_bytes: " << EntryArena::allocatedBytes() << "\n";
+    for (const MemoryAccounting::Usage &usage : MemoryAccounting::usage()) {
+        const QString key = "memory_" + QString(usage.name).replace(' ', '_');
+        out() << key << "_bytes: " << usage.current << "\n";
+        out() << key << "_peak_bytes: " << usage.peak << "\n";
+    }
+    for (const CapturePipeline::StageStats &stage : pipeline.stageStats()) {
+        const double avgUs = stage.count ? stage.totalNs / 1000.0 / stage.count : 0.0;
+        out() << "stage_" << stage.name << "_avg_us: " << avgUs << "\n";
+        out() << "stage_" << stage.name << "_max_us: " << stage.maxNs / 1000.0 << "\n";
+    }
+    out() << "search_words_ms: " << wordRun.totalUs / 1000.0 << "\n";
+    out() << "search_words_matches: " << wordRun.matches << "\n";
+    out() << "search_urls_ms: " << urlRun.totalUs / 1000.0 << "\n";
+    out() << "search_urls_matches: " << urlRun.matches << "\n";
+    out() << "digest: " << QString::number(digest, 16) << "\n";
+    out().flush();
+    return 0;
+}
+
+}
+
+namespace Benchmarks {
+
+bool isBenchmarkInvocation(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--benchmark") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int run(const QStringList &arguments) {
+    int index = arguments.indexOf("--benchmark");
+    QString name = arguments.value(index + 1);
+    QHash<QString, QString> options = parseOptions(arguments, index + 2);
+
+    if (name == "selection-burst") {
+        return selectionBurst(options);
+    }
+    if (name == "journal-crash") {
+        return journalCrash(options);
+    }
+    if (name == "pipeline-churn") {
+        return pipelineChurn(options);
+    }
+    if (name == "snapshot-stress") {
+        return snapshotStress(options);
+    }
+    if (name == "entry-memory") {
+        return entryMemory(options);
+    }
+    if (name == "near-duplicates") {
+        return nearDuplicates(options);
+    }
+    if (name == "regex-search") {
+        return regexSearch(options);
+    }
+    if (name == "frecency-topk") {
+        return frecencyTopK(options);
+    }
+    if (name == "archive-search") {
+        return archiveSearch(options);
+    }
+    if (name == "shared-ring") {
+        return sharedRing(options);
+    }
+    if (name == "export-import") {
+        return exportImport(options);
+    }
+    if (name == "classify") {
+        return classify(options);
+    }
+    if (name == "expiry-wheel") {
+        return expiryWheel(options);
+    }
+    if (name == "replay") {
+        return replay(options);
+    }
+    if (name == "journal-writer") {
+        return journalWriter(options);
+    }
+
+    QTextStream(stderr) << "Unknown benchmark: " << name << "\n"
+                        << "Available: selection-burst, journal-crash, pipeline-churn, snapshot-stress, entry-memory, near-duplicates, regex-search, frecency-topk, archive-search, shared-ring, export-import, classify, expiry-wheel, replay --trace=<path>\n";
+    return 2;
+}
+
+}
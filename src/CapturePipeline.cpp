@@ -0,0 +1,1478 @@
+#include "../include/CapturePipeline.h"
+#include "../include/MemoryAccounting.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSet>
+#include <QSettings>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+
+// Two independent 32-bit hashes: among millions of imported entries, distinct
+// ones must not collide
+quint64 importKey(QByteArrayView utf8, quint32 hash) {
+    return (quint64(hash) << 32) | quint32(qHash(utf8, size_t(0x9E3779B9)));
+}
+
+// Import results, sent back to the follower that forwarded the import
+QDataStream &operator<<(QDataStream &stream, const HistoryExport::Stats &stats) {
+    return stream << stats.entries << stats.added << stats.archived << stats.duplicates << stats.skipped
+                  << stats.bytes << stats.elapsedMs << stats.ok << stats.complete << stats.error;
+}
+
+QDataStream &operator>>(QDataStream &stream, HistoryExport::Stats &stats) {
+    return stream >> stats.entries >> stats.added >> stats.archived >> stats.duplicates >> stats.skipped
+                  >> stats.bytes >> stats.elapsedMs >> stats.ok >> stats.complete >> stats.error;
+}
+
+}
+
+// An import in progress. Hot-tier candidates are bounded by the limits; the
+// rest of the file streams through to the archive, so memory does not grow
+// with the bodies in the file, only by a 64-bit key per archived entry.
+struct CapturePipeline::ImportJob {
+    ImportJob(const QString &path, quint32 requester) : reader(path), requester(requester) {}
+
+    HistoryExport::Reader reader;
+    quint32 requester;          // reported to that follower instead of here
+    HistoryExport::Stats stats;
+    QElapsedTimer timer;
+    QSet<quint64> seen;         // history candidates
+    QSet<quint64> archived;     // the archive, before and during the import
+    QVector<HistoryExport::Record> history;
+    QVector<HistoryExport::Record> selections;
+    QVector<HistoryExport::Record> pins;
+};
+
+CapturePipeline::CapturePipeline(const QString &storeDirectory, QObject *parent)
+    : QObject(parent),
+      store(storeDirectory),
+      coldArchive(store.directory() + "/archive"),
+      pinStore(store.directory() + "/pins.dat"),
+      sharedRing(SharedHistoryRing::keyFor(store.directory())),
+      queue(1024),
+      worker(nullptr),
+      writerLock(store.directory() + "/writer.lock") {
+    clock.start();
+    // Held only by a live process; a crashed writer's lock is reclaimed by PID
+    writerLock.setStaleLockTime(0);
+}
+
+CapturePipeline::~CapturePipeline() {
+    stop();
+}
+
+void CapturePipeline::start(int maxHistorySize, int maxSelectionHistorySize) {
+    if (worker) {
+        return;
+    }
+    maxHistory = maxHistorySize;
+    maxSelections = maxSelectionHistorySize;
+    // One writer per store; instances on other displays follow it
+    QDir().mkpath(store.directory());
+    following.store(!writerLock.tryLock(0), std::memory_order_relaxed);
+    launch();
+}
+
+void CapturePipeline::launch() {
+    const bool follower = following.load(std::memory_order_relaxed);
+    store.setReadOnly(follower);
+    if (follower) {
+        qInfo() << "History store is owned by another Xclipy instance; following it";
+        connectToWriter();
+        if (!promoteTimer) {
+            promoteTimer = new QTimer(this);
+            connect(promoteTimer, &QTimer::timeout, this, &CapturePipeline::tryPromote);
+        }
+        promoteTimer->start(kPromoteIntervalMs);
+    } else {
+        listenForFollowers();
+    }
+    worker = QThread::create([this, follower]() {
+        if (follower) {
+            runFollower();
+        } else {
+            run();
+        }
+    });
+    worker->start(QThread::LowPriority);
+}
+
+void CapturePipeline::stop() {
+    if (!worker) {
+        return;
+    }
+    Item item;
+    item.type = Item::Type::Stop;
+    push(std::move(item), false);
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+}
+
+bool CapturePipeline::isRecovered() const {
+    return recoveredFlag.load(std::memory_order_acquire);
+}
+
+HistorySnapshotRef CapturePipeline::snapshot() const {
+    return snapshots.acquire();
+}
+
+bool CapturePipeline::push(Item &&item, bool mayDrop) {
+    if (following.load(std::memory_order_relaxed)) {
+        switch (item.type) {
+        case Item::Type::Limits:
+        case Item::Type::Dedup:
+        case Item::Type::ArchiveOption:
+        case Item::Type::Expiry:
+        case Item::Type::Trace:
+        case Item::Type::Stop:
+            break;      // per instance
+        default:
+            // The writer applies it; this instance's trace still records it
+            if (item.type != Item::Type::Import && tracing.load(std::memory_order_relaxed)) {
+                Item traced = item;
+                traced.traceOnly = true;
+                traced.enqueuedNs = clock.nsecsElapsed();
+                if (!queue.tryPush(std::move(traced))) {
+                    ++dropped;
+                } else {
+                    available.release();
+                }
+            }
+            return forward(item);
+        }
+    }
+    item.enqueuedNs = clock.nsecsElapsed();
+    while (!queue.tryPush(std::move(item))) {
+        if (mayDrop) {
+            // Never stall the GUI thread for a capture; the next change will be picked up
+            ++dropped;
+            return false;
+        }
+        QThread::yieldCurrentThread();
+    }
+    available.release();
+    return true;
+}
+
+bool CapturePipeline::submitText(const QString &text, bool concealed, const QString &source, quint8 formats) {
+    Item item;
+    item.type = Item::Type::Text;
+    item.text = text;
+    item.concealed = concealed;
+    item.source = source;
+    item.traceFormats = formats;
+    return push(std::move(item), true);
+}
+
+bool CapturePipeline::submitFiles(const QStringList &files, const QString &source, quint8 formats) {
+    Item item;
+    item.type = Item::Type::Files;
+    item.text = files.join("\n");
+    item.source = source;
+    item.traceFormats = formats;
+    return push(std::move(item), true);
+}
+
+bool CapturePipeline::submitSelection(const QString &text, quint8 formats) {
+    Item item;
+    item.type = Item::Type::Selection;
+    item.text = text;
+    item.traceFormats = formats;
+    return push(std::move(item), true);
+}
+
+void CapturePipeline::removeEntry(const QString &text) {
+    Item item;
+    item.type = Item::Type::Remove;
+    item.text = text;
+    push(std::move(item), false);
+}
+
+void CapturePipeline::pinEntry(const QString &text) {
+    Item item;
+    item.type = Item::Type::Pin;
+    item.text = text;
+    push(std::move(item), false);
+}
+
+void CapturePipeline::unpinEntry(const QString &text) {
+    Item item;
+    item.type = Item::Type::Unpin;
+    item.text = text;
+    push(std::move(item), false);
+}
+
+void CapturePipeline::touchEntry(const QString &text, quint8 formats) {
+    Item item;
+    item.type = Item::Type::Use;
+    item.text = text;
+    item.traceFormats = formats;
+    push(std::move(item), true);
+}
+
+void CapturePipeline::clear() {
+    Item item;
+    item.type = Item::Type::Clear;
+    push(std::move(item), false);
+}
+
+void CapturePipeline::setLimits(int maxHistorySize, int maxSelectionHistorySize) {
+    Item item;
+    item.type = Item::Type::Limits;
+    item.maxHistory = maxHistorySize;
+    item.maxSelections = maxSelectionHistorySize;
+    push(std::move(item), false);
+}
+
+void CapturePipeline::setDedupOptions(bool normalize, int nearDuplicateThreshold) {
+    Item item;
+    item.type = Item::Type::Dedup;
+    item.normalize = normalize;
+    item.threshold = nearDuplicateThreshold;
+    push(std::move(item), false);
+}
+
+void CapturePipeline::setArchiveEvicted(bool enabled) {
+    Item item;
+    item.type = Item::Type::ArchiveOption;
+    item.archive = enabled;
+    push(std::move(item), false);
+}
+
+void CapturePipeline::setExpiry(qint64 maxAgeSeconds, qint64 concealedSeconds) {
+    Item item;
+    item.type = Item::Type::Expiry;
+    item.maxAge = maxAgeSeconds;
+    item.concealedLifetime = concealedSeconds;
+    push(std::move(item), false);
+}
+
+void CapturePipeline::setWorkloadTrace(const QString &path) {
+    tracing.store(!path.isEmpty(), std::memory_order_relaxed);
+    Item item;
+    item.type = Item::Type::Trace;
+    item.text = path;
+    push(std::move(item), false);
+}
+
+void CapturePipeline::importHistory(const QString &path) {
+    Item item;
+    item.type = Item::Type::Import;
+    item.text = path;
+    // A follower forwards it; the writer sends the result back (see reportImport)
+    if (!push(std::move(item), false)) {
+        HistoryExport::Stats stats;
+        stats.error = "Cannot reach the Xclipy instance that owns the history";
+        reportImport(stats, 0);
+    }
+}
+
+QString CapturePipeline::linkName() const {
+    return SharedHistoryRing::keyFor(store.directory()) + "-link";
+}
+
+void CapturePipeline::listenForFollowers() {
+    if (followerServer) {
+        return;
+    }
+    followerServer = new QLocalServer(this);
+    followerServer->setSocketOptions(QLocalServer::UserAccessOption);
+    // We hold the writer lock, so a socket left under this name is stale
+    QLocalServer::removeServer(linkName());
+    if (!followerServer->listen(linkName())) {
+        qWarning() << "Cannot accept captures from other Xclipy instances:" << followerServer->errorString();
+        return;
+    }
+    connect(followerServer, &QLocalServer::newConnection, this, [this]() {
+        while (QLocalSocket *socket = followerServer->nextPendingConnection()) {
+            const quint32 id = ++nextFollowerId;
+            followerLinks.insert(id, socket);
+            connect(socket, &QLocalSocket::disconnected, this, [this, id, socket]() {
+                followerLinks.remove(id);
+                socket->deleteLater();
+            });
+            connect(socket, &QLocalSocket::readyRead, this, [this, socket, id]() {
+                receiveForwarded(socket, id);
+            });
+        }
+    });
+}
+
+void CapturePipeline::connectToWriter() {
+    if (!writerLink) {
+        writerLink = new QLocalSocket(this);
+        connect(writerLink, &QLocalSocket::connected, this, [this]() {
+            writerLink->write(pendingForward);
+            pendingForward.clear();
+        });
+        connect(writerLink, &QLocalSocket::readyRead, this, &CapturePipeline::receiveReplies);
+    }
+    if (writerLink->state() == QLocalSocket::UnconnectedState) {
+        writerLink->connectToServer(linkName());
+    }
+}
+
+// Follower: the writer applies the item; it comes back through the ring
+bool CapturePipeline::forward(const Item &item) {
+    QByteArray frame;
+    QDataStream stream(&frame, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    // The high bits of the type mark a concealed capture and a source app;
+    // a frame without them reads as it always did
+    const bool hasSource = !item.source.isEmpty();
+    stream << quint8(quint8(item.type) | (item.concealed ? kConcealedFlag : 0) | (hasSource ? kSourceFlag : 0))
+           << item.text;
+    if (hasSource) {
+        stream << item.source;
+    }
+    if (writerLink && writerLink->state() == QLocalSocket::ConnectedState) {
+        return writerLink->write(frame) == frame.size();
+    }
+    if (pendingForward.size() + frame.size() > kMaxPendingForward) {
+        ++dropped;
+        return false;
+    }
+    pendingForward.append(frame);
+    connectToWriter();
+    return true;
+}
+
+void CapturePipeline::receiveForwarded(QIODevice *device, quint32 requester) {
+    QDataStream stream(device);
+    stream.setVersion(QDataStream::Qt_6_0);
+    for (;;) {
+        stream.startTransaction();
+        quint8 type = 0;
+        QString text;
+        QString source;
+        stream >> type >> text;
+        if (type & kSourceFlag) {
+            stream >> source;
+        }
+        if (!stream.commitTransaction()) {
+            break;
+        }
+        Item item;
+        item.type = Item::Type(type & ~(kConcealedFlag | kSourceFlag));
+        item.concealed = (type & kConcealedFlag) != 0;
+        item.text = text;
+        item.source = source;
+        item.requester = requester;
+        item.traced = true;
+        switch (item.type) {
+        case Item::Type::Text:
+        case Item::Type::Files:
+        case Item::Type::Selection:
+        case Item::Type::Use:
+            push(std::move(item), true);
+            break;
+        case Item::Type::Remove:
+        case Item::Type::Pin:
+        case Item::Type::Unpin:
+        case Item::Type::Clear:
+        case Item::Type::Import:
+            push(std::move(item), false);
+            break;
+        default:
+            break;      // settings are not shared
+        }
+    }
+}
+
+void CapturePipeline::receiveReplies() {
+    QDataStream stream(writerLink);
+    stream.setVersion(QDataStream::Qt_6_0);
+    for (;;) {
+        stream.startTransaction();
+        quint8 type = 0;
+        HistoryExport::Stats stats;
+        stream >> type;
+        if (Item::Type(type) == Item::Type::Import) {
+            stream >> stats;
+        }
+        if (!stream.commitTransaction()) {
+            break;
+        }
+        if (Item::Type(type) == Item::Type::Import) {
+            emit importFinished(stats);
+        }
+    }
+}
+
+void CapturePipeline::tryPromote() {
+    if (!worker || !following.load(std::memory_order_relaxed) || !writerLock.tryLock(0)) {
+        return;
+    }
+    promoteTimer->stop();
+    stop();
+    following.store(false, std::memory_order_relaxed);
+    qInfo() << "Taking over the history store from an Xclipy instance that exited";
+
+    // Captures that never reached the old writer are ours to apply now
+    QByteArray orphaned;
+    orphaned.swap(pendingForward);
+    if (writerLink) {
+        writerLink->abort();
+        writerLink->deleteLater();
+        writerLink = nullptr;
+    }
+    launch();
+    QBuffer buffer(&orphaned);
+    buffer.open(QIODevice::ReadOnly);
+    receiveForwarded(&buffer);
+}
+
+void CapturePipeline::commitStore() {
+    store.commit(&committedRecords);
+}
+
+void CapturePipeline::run() {
+    // Pins are one small file: show them before the history is recovered
+    loadPins();
+    publish();
+    recoverStore();
+    // Created after recovery, so followers that resync see what recovery rewrote
+    sharedRing.createAsWriter();
+
+    bool running = true;
+    while (running) {
+        // An import runs in slices between batches, so captures never wait behind it
+        bool haveItems = true;
+        if (importJob) {
+            haveItems = available.tryAcquire();
+        } else {
+            // Otherwise asleep until an item comes or the next entry expires.
+            // Capped, as the wait doesn't count time spent suspended, and so
+            // archived entries age even while history is empty.
+            const qint64 untilExpiry = expiry.msUntilNext();
+            if (untilExpiry >= 0 || expiry.maxAgeSeconds() > 0) {
+                const qint64 wait = untilExpiry >= 0 ? qMin<qint64>(untilExpiry, kMaxExpiryWaitMs) : kMaxExpiryWaitMs;
+                haveItems = available.tryAcquire(1, int(wait));
+            } else {
+                available.acquire();
+            }
+        }
+        bool changed = false;
+        Item item;
+        // Drain everything queued so a burst costs one fsync and one publish
+        do {
+            if (!haveItems || !queue.tryPop(item)) {
+                break;
+            }
+            record(Stage::QueueWait, clock.nsecsElapsed() - item.enqueuedNs);
+            if (item.type == Item::Type::Stop) {
+                running = false;
+                break;
+            }
+            changed = process(item) || changed;
+        } while (available.tryAcquire());
+        if (importJob && running) {
+            changed = importSlice() || changed;
+        }
+        if (running) {
+            changed = expireDue() || changed;
+        }
+
+        if (changed) {
+            qint64 start = clock.nsecsElapsed();
+            // While the batch is still buffered, so its peak is seen
+            MemoryAccounting::set(MemoryAccounting::Subsystem::Persistence,
+                                  store.pendingBytes() + coldArchive.pendingBytes());
+            // Archive first: a crash in between may archive an entry twice, never lose it
+            coldArchive.flush();
+            // Pins before the journal: a pin must be durable before its history slot is dropped
+            const bool pinsMoved = pinsChanged;
+            if (pinsMoved) {
+                savePins();
+            }
+            commitStore();
+            if (!committedRecords.isEmpty()) {
+                MemoryAccounting::add(MemoryAccounting::Subsystem::Persistence,
+                                      MemoryAccounting::byteArrayBytes(committedRecords));
+                sharedRing.append(SharedHistoryRing::Batch::Records, committedRecords);
+                committedRecords.clear();
+            }
+            if (pinsMoved) {
+                sharedRing.append(SharedHistoryRing::Batch::Pins);
+            }
+            if (expirySaveDue) {
+                expiry.save(expiryPath());
+                expirySaveDue = false;
+            }
+            if (snapshotDue || store.needsCompaction()) {
+                // Bodies are compacted with the journal; contents are unchanged
+                const int moved = EntryList::compact(arena, {&history, &selections, &pins});
+                if (moved > 0) {
+                    qDebug() << "Moved" << moved << "entry bodies off sparse slabs";
+                }
+                HistoryStore::State state;
+                state.history = history.toList();
+                state.selections = selections.toList();
+                store.writeSnapshot(state);
+                frecency.save(frecencyPath());
+                expiry.save(expiryPath());
+                sources.save(sourcesPath());
+                if (snapshotDue) {
+                    sharedRing.invalidate();
+                    snapshotDue = false;
+                }
+            }
+            record(Stage::Persist, clock.nsecsElapsed() - start);
+            publish();
+        }
+    }
+    if (importJob) {
+        qWarning() << "Import interrupted after" << importJob->stats.entries << "entries";
+        importJob.reset();
+    }
+    frecency.save(frecencyPath());
+    expiry.save(expiryPath());
+    sources.save(sourcesPath());
+    store.close();
+}
+
+void CapturePipeline::loadPins() {
+    QVector<QByteArray> bodies;
+    pinStore.load(&bodies);
+    QVector<HistoryEntry> entries;
+    entries.reserve(bodies.size());
+    for (const QByteArray &utf8 : bodies) {
+        HistoryEntry entry;
+        entry.body = arena.store(utf8, Utf8Entry::hashOf(utf8));
+        entry.kinds = ContentClassifier::classify(utf8);
+        entries.append(entry);
+    }
+    pins = EntryList::fromEntries(entries);
+}
+
+bool CapturePipeline::removePinned(QStringList *list) const {
+    bool removed = false;
+    pins.forEach([list, &removed](const HistoryEntry &entry) {
+        removed = list->removeAll(entry.body.toString()) > 0 || removed;
+        return true;
+    });
+    return removed;
+}
+
+void CapturePipeline::runFollower() {
+    loadPins();
+    publish();
+    frecency.load(frecencyPath());
+    sharedRing.attachAsReader();
+    HistoryStore::RecoveryStats stats;
+    resync(&stats);
+    publishRecovered(stats, false);
+
+    bool running = true;
+    while (running) {
+        // Local items wake the worker; otherwise it polls the writer's ring
+        bool changed = false;
+        if (available.tryAcquire(1, kFollowIntervalMs)) {
+            Item item;
+            do {
+                if (!queue.tryPop(item)) {
+                    break;
+                }
+                record(Stage::QueueWait, clock.nsecsElapsed() - item.enqueuedNs);
+                if (item.type == Item::Type::Stop) {
+                    running = false;
+                    break;
+                }
+                changed = process(item) || changed;
+            } while (available.tryAcquire());
+        }
+        changed = follow() || changed;
+        if (changed) {
+            publish();
+        }
+    }
+}
+
+// Replays the writer's new journal batches from the ring, in place
+bool CapturePipeline::follow() {
+    if (!sharedRing.isAttached() && !sharedRing.attachAsReader()) {
+        return false;
+    }
+    bool records = false;
+    bool pinsMoved = false;
+    const SharedHistoryRing::ReadResult result = sharedRing.read(ringEpoch, &ringCursor,
+        [this, &records, &pinsMoved](SharedHistoryRing::Batch kind, QByteArrayView data) {
+            if (kind == SharedHistoryRing::Batch::Records) {
+                HistoryStore::replayRecords(&followed, data);
+                records = true;
+            } else if (kind == SharedHistoryRing::Batch::Pins) {
+                pinsMoved = true;
+            }
+        });
+    if (result == SharedHistoryRing::ReadResult::Resync) {
+        resync(nullptr);
+        return true;
+    }
+    if (pinsMoved) {
+        loadPins();
+    }
+    if (records || pinsMoved) {
+        adoptFollowed();
+    }
+    return records || pinsMoved;
+}
+
+void CapturePipeline::resync(HistoryStore::RecoveryStats *stats) {
+    // Ring position first: whatever commits after it is replayed from the
+    // ring as well, which journal records tolerate
+    ringEpoch = sharedRing.epoch();
+    ringCursor = sharedRing.head();
+    store.recover(&followed, stats);
+    // The writer saves source apps with each snapshot; newer captures have none here
+    sources.load(sourcesPath());
+    loadPins();
+    adoptFollowed();
+}
+
+void CapturePipeline::adoptFollowed() {
+    HistoryStore::State state = followed;
+    removePinned(&state.history);
+    // Most entries are unchanged between batches; keep their classification
+    QHash<quint32, ContentClassifier::Kinds> classified;
+    history.forEach([&classified](const HistoryEntry &entry) {
+        classified.insert(entry.body.hash(), entry.kinds);
+        return true;
+    });
+    history = EntryList::fromList(state.history, arena);
+    selections = EntryList::fromList(state.selections, arena);
+    rebuildIndexes(&classified);
+}
+
+void CapturePipeline::savePins() {
+    QVector<QByteArrayView> bodies;
+    bodies.reserve(pins.size());
+    pins.forEach([&bodies](const HistoryEntry &entry) {
+        bodies.append(entry.body.bytes());
+        return true;
+    });
+    pinStore.save(bodies);
+    pinsChanged = false;
+}
+
+void CapturePipeline::recoverStore() {
+    HistoryStore::State state;
+    HistoryStore::RecoveryStats stats;
+    bool migrated = false;
+    if (store.exists()) {
+        store.recover(&state, &stats);
+    } else {
+        // Upgrade path: history used to live in QSettings (reentrant, so safe here)
+        QSettings legacyStore(QSettings::IniFormat, QSettings::UserScope, "Xclipy", "Xclipy-history");
+        QSettings legacy("Xclipy", "Xclipy");
+        QSettings &source = legacyStore.contains("history") ? legacyStore : legacy;
+        migrated = source.contains("history") || source.contains("selectionHistory");
+        state.history = source.value("history").toStringList();
+        state.selections = source.value("selectionHistory").toStringList();
+    }
+
+    // A crash between saving the pins and committing the journal leaves a
+    // pinned entry in history too; the pin wins
+    const bool repinned = removePinned(&state.history);
+
+    bool trimmed = state.history.size() > maxHistory || state.selections.size() > maxSelections;
+    if (trimmed) {
+        state.history = state.history.mid(0, maxHistory);
+        state.selections = state.selections.mid(0, maxSelections);
+    }
+    history = EntryList::fromList(state.history, arena);
+    selections = EntryList::fromList(state.selections, arena);
+    frecency.load(frecencyPath());
+    sources.load(sourcesPath());
+    // Entries past their time are removed by the first batch
+    expiry.load(expiryPath());
+    history.forEach([this](const HistoryEntry &entry) {
+        expiry.seed(entry.body.hash());
+        return true;
+    });
+    rebuildIndexes();
+    // Keys of entries removed after the last save would otherwise linger
+    frecency.removeIf([this](quint32 hash) { return !hashIndex.contains(hash); });
+    sources.removeIf([this](quint32 hash) { return !hashIndex.contains(hash); });
+    expiry.removeIf([this](quint32 hash) { return !hashIndex.contains(hash); });
+
+    store.open();
+    coldArchive.open();
+    if (migrated || trimmed || repinned) {
+        store.writeSnapshot(state);
+    }
+    publishRecovered(stats, migrated);
+}
+
+void CapturePipeline::publishRecovered(const HistoryStore::RecoveryStats &stats, bool migrated) {
+    // Publish first so receivers of recovered() already see the recovered history
+    publish();
+    recoveredFlag.store(true, std::memory_order_release);
+    QMetaObject::invokeMethod(this, [this, stats, migrated]() {
+        emit recovered(stats, migrated);
+    }, Qt::QueuedConnection);
+}
+
+bool CapturePipeline::process(Item &item) {
+    // Captures are traced by capture(), which knows the kinds of what it kept
+    const bool capturing = item.type == Item::Type::Text || item.type == Item::Type::Files
+                           || item.type == Item::Type::Selection;
+    if (trace.isOpen() && (item.traceOnly || !capturing)) {
+        traceItem(item, item.text.toUtf8(), nullptr);
+    }
+    if (item.traceOnly) {
+        return false;
+    }
+    switch (item.type) {
+    case Item::Type::Text:
+    case Item::Type::Files:
+        capture(item, HistoryStore::List::History);
+        return true;
+    case Item::Type::Selection:
+        capture(item, HistoryStore::List::Selections);
+        return true;
+    case Item::Type::Remove: {
+        const QByteArray utf8 = item.text.toUtf8();
+        const quint32 hash = Utf8Entry::hashOf(utf8);
+        if (pins.removeAll(utf8, hash) > 0) {
+            pinsChanged = true;
+            return true;
+        }
+        if (history.removeAll(utf8, hash) > 0) {
+            unindex(utf8, hash);
+            store.recordRemove(HistoryStore::List::History, item.text);
+            return true;
+        }
+        return false;
+    }
+    case Item::Type::Pin:
+        return pin(item.text);
+    case Item::Type::Unpin:
+        return unpin(item.text);
+    case Item::Type::Use: {
+        const QByteArray utf8 = item.text.toUtf8();
+        const quint32 hash = Utf8Entry::hashOf(utf8);
+        const int index = hashIndex.contains(hash) ? history.indexOf(utf8, hash) : -1;
+        if (index < 0) {
+            return false;
+        }
+        HistoryEntry entry = history.entry(index);
+        entry.frecency = frecency.bump(hash);
+        history.replace(index, entry);
+        return true;
+    }
+    case Item::Type::Clear:
+        // Pins are kept: clearing history is not unpinning
+        history.clear();
+        selections.clear();
+        hashIndex.clear();
+        frecency.clear();
+        expiry.clear();
+        sources.clear();
+        coldArchive.clear();
+        normalizedIndex.clear();
+        nearDuplicates.clear();
+        store.recordClear(HistoryStore::List::History);
+        store.recordClear(HistoryStore::List::Selections);
+        return true;
+    case Item::Type::Limits:
+        maxHistory = item.maxHistory;
+        maxSelections = item.maxSelections;
+        if (following.load(std::memory_order_relaxed)) {
+            return false;   // the writer trims the shared history
+        }
+        trim(HistoryStore::List::History);
+        trim(HistoryStore::List::Selections);
+        return true;
+    case Item::Type::Dedup:
+        if (item.normalize == normalizeDuplicates && item.threshold == nearDuplicateThreshold) {
+            return false;
+        }
+        normalizeDuplicates = item.normalize;
+        nearDuplicateThreshold = item.threshold;
+        rebuildIndexes();
+        return true;
+    case Item::Type::ArchiveOption:
+        archiveEvicted = item.archive;
+        return false;
+    case Item::Type::Expiry:
+        expiry.setPolicy(item.maxAge, item.concealedLifetime);
+        return false;
+    case Item::Type::Trace:
+        if (item.text.isEmpty()) {
+            trace.close();
+        } else {
+            trace.open(item.text);
+        }
+        return false;
+    case Item::Type::Import:
+        startImport(item.text, item.requester);
+        return false;
+    case Item::Type::Stop:
+        break;
+    }
+    return false;
+}
+
+void CapturePipeline::capture(Item &item, HistoryStore::List list) {
+    if (item.text.isEmpty()) {
+        return;
+    }
+
+    qint64 start = clock.nsecsElapsed();
+    // Bodies are kept as UTF-8, so encode once and hash the stored form
+    const QByteArray utf8 = item.text.toUtf8();
+    const quint32 hash = Utf8Entry::hashOf(utf8);
+    qint64 now = clock.nsecsElapsed();
+    record(Stage::Hash, now - start);
+
+    if (list == HistoryStore::List::Selections) {
+        // The selection ring is small and recency-ordered: move to front
+        selections.removeAll(utf8, hash);
+        HistoryEntry entry;
+        entry.body = arena.store(utf8, hash);
+        selections.prepend(entry);
+        store.recordPrepend(list, item.text);
+        trim(list);
+        traceItem(item, utf8, nullptr);
+        return;
+    }
+
+    // Index stage: hash lookup, full compare only on a hash hit. A pinned
+    // clip stays where it is pinned and is not captured again.
+    start = clock.nsecsElapsed();
+    if (pins.contains(utf8, hash)) {
+        record(Stage::Index, clock.nsecsElapsed() - start);
+        ++duplicates;
+        traceItem(item, utf8, nullptr);
+        return;
+    }
+    const int existing = hashIndex.contains(hash) ? history.indexOf(utf8, hash) : -1;
+    if (existing >= 0) {
+        // A re-copy is a use: promote the kept entry to the front, score bumped, age reset
+        HistoryEntry entry = history.entry(existing);
+        // Off its old slab, which the entries around it are leaving
+        entry.body = arena.restore(entry.body);
+        entry.frecency = frecency.bump(hash);
+        entry.source = sources.record(hash, item.source);
+        trackExpiry(&entry, item.concealed);
+        traceItem(item, utf8, &entry.kinds);
+        if (existing == 0) {
+            history.replace(0, entry);
+        } else {
+            history.removeAll(utf8, hash);
+            history.prepend(entry);
+            store.recordRemove(list, item.text);
+            recordPrepend(item.text, utf8);
+        }
+    }
+    now = clock.nsecsElapsed();
+    record(Stage::Index, now - start);
+    if (existing >= 0) {
+        ++duplicates;
+        return;
+    }
+
+    // Similarity stage: normalized dedup and near-duplicate grouping via the LSH index
+    start = now;
+    HistoryEntry entry;
+    bool admitted = indexEntry(utf8, hash, false, &entry.group);
+    now = clock.nsecsElapsed();
+    record(Stage::Similarity, now - start);
+    if (!admitted) {
+        ++duplicates;
+        traceItem(item, utf8, nullptr);
+        return;
+    }
+
+    // Classify stage: only clips that are kept, once, so filters never rescan
+    start = now;
+    entry.kinds = ContentClassifier::classify(utf8);
+    if (item.type == Item::Type::Files) {
+        entry.kinds |= ContentClassifier::FilePath;
+    }
+    if (item.concealed) {
+        entry.kinds |= ContentClassifier::Secret;  // masked like a recognized token
+    }
+    now = clock.nsecsElapsed();
+    record(Stage::Classify, now - start);
+
+    entry.body = arena.store(utf8, hash);
+    entry.frecency = frecency.bump(hash);
+    entry.source = sources.record(hash, item.source);
+    trackExpiry(&entry, item.concealed);
+    history.prepend(entry);
+    traceItem(item, utf8, &entry.kinds);
+
+    start = now;
+    recordPrepend(item.text, utf8);
+    record(Stage::Compress, clock.nsecsElapsed() - start);
+
+    trim(list);
+}
+
+// Only captures carry new content; the other events name an earlier clip
+void CapturePipeline::traceItem(const Item &item, QByteArrayView utf8, const ContentClassifier::Kinds *kinds) {
+    if (!trace.isOpen() || item.traced) {
+        return;
+    }
+    WorkloadTrace::Event event;
+    ContentClassifier::Kinds recorded = 0;
+    switch (item.type) {
+    case Item::Type::Text:
+        event = WorkloadTrace::Event::Text;
+        recorded = kinds ? *kinds : ContentClassifier::classify(utf8);
+        break;
+    case Item::Type::Selection:
+        event = WorkloadTrace::Event::Selection;
+        recorded = kinds ? *kinds : ContentClassifier::classify(utf8);
+        break;
+    case Item::Type::Files:
+        event = WorkloadTrace::Event::Files;
+        recorded = ContentClassifier::FilePath | ContentClassifier::Classified;
+        break;
+    case Item::Type::Remove:
+        event = WorkloadTrace::Event::Remove;
+        break;
+    case Item::Type::Pin:
+        event = WorkloadTrace::Event::Pin;
+        break;
+    case Item::Type::Unpin:
+        event = WorkloadTrace::Event::Unpin;
+        break;
+    case Item::Type::Use:
+        event = WorkloadTrace::Event::Use;
+        break;
+    case Item::Type::Clear:
+        trace.record(WorkloadTrace::Event::Clear);
+        return;
+    default:
+        return;
+    }
+    trace.record(event, utf8, recorded,
+                 quint8(item.traceFormats | (item.concealed ? WorkloadTrace::FormatConcealed : 0)));
+}
+
+void CapturePipeline::recordPrepend(const QString &text, const QByteArray &utf8) {
+    if (text.size() > kCompressThreshold) {
+        store.recordPrependCompressed(HistoryStore::List::History, qCompress(utf8));
+    } else {
+        store.recordPrepend(HistoryStore::List::History, text);
+    }
+}
+
+QString CapturePipeline::frecencyPath() const {
+    return store.directory() + "/frecency.dat";
+}
+
+QString CapturePipeline::expiryPath() const {
+    return store.directory() + "/expiry.dat";
+}
+
+QString CapturePipeline::sourcesPath() const {
+    return store.directory() + "/sources.dat";
+}
+
+void CapturePipeline::trackExpiry(HistoryEntry *entry, bool concealed, qint64 time) {
+    expiry.track(entry->body.hash(), concealed, time);
+    expirySaveDue = expirySaveDue || concealed;
+    stampExpiry(entry);
+}
+
+void CapturePipeline::stampExpiry(HistoryEntry *entry) const {
+    entry->concealed = expiry.isConcealed(entry->body.hash());
+    entry->capturedAt = expiry.capturedAt(entry->body.hash());
+}
+
+bool CapturePipeline::expireDue() {
+    // Archived entries age from when they were archived; they never reach the journal
+    const qint64 maxAge = expiry.maxAgeSeconds();
+    coldArchive.expireBefore(maxAge > 0 ? ExpiryIndex::now() - maxAge : 0);
+
+    const QVector<quint32> due = expiry.takeExpired();
+    if (due.isEmpty()) {
+        return false;
+    }
+    const QSet<quint32> hashes(due.cbegin(), due.cend());
+    QVector<Utf8Entry> bodies;
+    history.forEach([&hashes, &bodies](const HistoryEntry &entry) {
+        if (hashes.contains(entry.body.hash())) {
+            bodies.append(entry.body);
+        }
+        return true;
+    });
+    for (const Utf8Entry &body : bodies) {
+        history.removeAll(body.bytes(), body.hash());
+        unindex(body.bytes(), body.hash());
+        store.recordRemove(HistoryStore::List::History, body.toString());
+    }
+    qDebug() << "Expired" << bodies.size() << "history entries";
+    return !bodies.isEmpty();
+}
+
+void CapturePipeline::trim(HistoryStore::List list) {
+    if (list == HistoryStore::List::Selections) {
+        if (selections.size() > maxSelections) {
+            selections.truncate(maxSelections);
+            store.recordTruncate(list, maxSelections);
+        }
+        return;
+    }
+
+    if (history.size() > maxHistory) {
+        int index = 0;
+        history.forEach([this, &index](const HistoryEntry &entry) {
+            if (index++ >= maxHistory) {
+                // Before unindex forgets it; a password never goes to the archive
+                if (archiveEvicted && !expiry.isConcealed(entry.body.hash())) {
+                    coldArchive.append(entry.body.bytes());
+                }
+                unindex(entry.body.bytes(), entry.body.hash());
+            }
+            return true;
+        });
+        history.truncate(maxHistory);
+        store.recordTruncate(list, maxHistory);
+    }
+}
+
+void CapturePipeline::startImport(const QString &path, quint32 requester) {
+    auto job = std::make_unique<ImportJob>(path, requester);
+    job->timer.start();
+    if (importJob) {
+        job->stats.error = "Another import is still running";
+    } else if (!job->reader.open()) {
+        job->stats.error = job->reader.errorString();
+    }
+    if (!job->stats.error.isEmpty()) {
+        qWarning() << "Cannot import history from" << path << ":" << job->stats.error;
+        reportImport(job->stats, requester);
+        return;
+    }
+    if (archiveEvicted) {
+        // Against what the archive already holds, so restoring a backup twice adds nothing
+        coldArchive.forEachEntry([&job](const QByteArray &utf8, qint64) {
+            job->archived.insert(importKey(utf8, Utf8Entry::hashOf(utf8)));
+            return true;
+        });
+    }
+    importJob = std::move(job);
+}
+
+// Reads up to kImportSlice records. Archived entries are appended as they are
+// read, so each slice is one archive batch; hot-tier candidates wait for
+// finishImport, which merges them against the live indexes.
+bool CapturePipeline::importSlice() {
+    ImportJob &job = *importJob;
+    bool changed = false;
+    HistoryExport::Record record;
+    for (int i = 0; i < kImportSlice; ++i) {
+        if (!job.reader.next(&record)) {
+            return finishImport() || changed;
+        }
+        ++job.stats.entries;
+        const quint32 hash = Utf8Entry::hashOf(record.utf8);
+        switch (record.tier) {
+        case HistoryExport::Tier::History:
+            if (job.history.size() >= maxHistory) {
+                // Older than every candidate that can still fit
+                changed = archiveImported(job, record, hash) || changed;
+            } else if (job.seen.contains(importKey(record.utf8, hash))) {
+                ++job.stats.duplicates;
+            } else {
+                job.seen.insert(importKey(record.utf8, hash));
+                job.history.append(std::move(record));
+            }
+            break;
+        case HistoryExport::Tier::Selection:
+            if (job.selections.size() >= maxSelections) {
+                ++job.stats.skipped;
+            } else {
+                job.selections.append(std::move(record));
+            }
+            break;
+        case HistoryExport::Tier::Pinned:
+            if (job.pins.size() >= PinStore::kMaxPins) {
+                ++job.stats.skipped;
+            } else {
+                job.pins.append(std::move(record));
+            }
+            break;
+        case HistoryExport::Tier::Archived:
+            changed = archiveImported(job, record, hash) || changed;
+            break;
+        case HistoryExport::Tier::End:
+            break;
+        }
+        record = HistoryExport::Record();
+    }
+    return changed;
+}
+
+bool CapturePipeline::archiveImported(ImportJob &job, const HistoryExport::Record &record, quint32 hash) {
+    // Passwords stay out of the archive, as in trim()
+    if (!archiveEvicted || record.concealed) {
+        ++job.stats.skipped;
+        return false;
+    }
+    const quint64 key = importKey(record.utf8, hash);
+    if (job.archived.contains(key) || pins.contains(record.utf8, hash)
+        || (hashIndex.contains(hash) && history.indexOf(record.utf8, hash) >= 0)) {
+        ++job.stats.duplicates;
+        return false;
+    }
+    job.archived.insert(key);
+    // A history record's timestamp is its capture time; it is archived now
+    coldArchive.append(record.utf8, record.tier == HistoryExport::Tier::Archived ? record.timestamp : 0);
+    ++job.stats.archived;
+    return true;
+}
+
+bool CapturePipeline::finishImport() {
+    std::unique_ptr<ImportJob> job = std::move(importJob);
+    HistoryExport::Stats &stats = job->stats;
+    bool changed = false;
+
+    // Imported entries go after the kept ones, so what was copied here stays
+    // in front. Frecency keys are merged either way; capture times and source
+    // apps come with the record, and entries without one age from now.
+    QVector<HistoryEntry> merged;
+    merged.reserve(history.size() + job->history.size());
+    history.forEach([&merged](const HistoryEntry &entry) {
+        merged.append(entry);
+        return true;
+    });
+    for (const HistoryExport::Record &record : job->history) {
+        const quint32 hash = Utf8Entry::hashOf(record.utf8);
+        if (pins.contains(record.utf8, hash)) {
+            ++stats.duplicates;
+            continue;
+        }
+        if (hashIndex.contains(hash) && history.indexOf(record.utf8, hash) >= 0) {
+            if (record.frecency != 0) {
+                frecency.merge(hash, record.frecency);
+                changed = true;
+            }
+            ++stats.duplicates;
+            continue;
+        }
+        if (merged.size() >= maxHistory) {
+            changed = archiveImported(*job, record, hash) || changed;
+            continue;
+        }
+        HistoryEntry entry;
+        if (!indexEntry(record.utf8, hash, false, &entry.group)) {
+            ++stats.duplicates;
+            continue;
+        }
+        entry.body = arena.store(record.utf8, hash);
+        entry.kinds = ContentClassifier::classify(record.utf8);
+        if (record.concealed) {
+            entry.kinds |= ContentClassifier::Secret;
+        }
+        entry.frecency = record.frecency != 0 ? frecency.merge(hash, record.frecency)
+                                              : frecency.seed(hash, FrecencyIndex::now() - 1.0);
+        entry.source = sources.record(hash, record.source);
+        if (record.timestamp > 0) {
+            trackExpiry(&entry, record.concealed, record.timestamp);
+        } else {
+            expiry.seed(hash);
+            stampExpiry(&entry);
+        }
+        merged.append(entry);
+        ++stats.added;
+        changed = true;
+    }
+    if (changed) {
+        for (HistoryEntry &entry : merged) {
+            entry.frecency = frecency.key(entry.body.hash());
+        }
+        history = EntryList::fromEntries(merged);
+    }
+
+    QVector<HistoryEntry> mergedSelections;
+    selections.forEach([&mergedSelections](const HistoryEntry &entry) {
+        mergedSelections.append(entry);
+        return true;
+    });
+    bool selectionsChanged = false;
+    for (const HistoryExport::Record &record : job->selections) {
+        const quint32 hash = Utf8Entry::hashOf(record.utf8);
+        const bool present = std::any_of(mergedSelections.cbegin(), mergedSelections.cend(),
+                                         [&record, hash](const HistoryEntry &entry) {
+                                             return entry.body.equals(record.utf8, hash);
+                                         });
+        if (present) {
+            ++stats.duplicates;
+        } else if (mergedSelections.size() >= maxSelections) {
+            ++stats.skipped;
+        } else {
+            HistoryEntry entry;
+            entry.body = arena.store(record.utf8, hash);
+            mergedSelections.append(entry);
+            ++stats.added;
+            selectionsChanged = true;
+        }
+    }
+    if (selectionsChanged) {
+        selections = EntryList::fromEntries(mergedSelections);
+        changed = true;
+    }
+
+    // pin() prepends, so the oldest pin goes first to keep the exported order
+    for (int i = job->pins.size() - 1; i >= 0; --i) {
+        const QByteArray &utf8 = job->pins.at(i).utf8;
+        if (pins.contains(utf8, Utf8Entry::hashOf(utf8))) {
+            ++stats.duplicates;
+        } else if (pin(QString::fromUtf8(utf8))) {
+            ++stats.added;
+            changed = true;
+        } else {
+            ++stats.skipped;
+        }
+    }
+
+    // Appends to the hot tiers are not journal operations: snapshot once
+    snapshotDue = changed;
+    stats.complete = job->reader.isComplete();
+    stats.error = job->reader.errorString();
+    stats.ok = stats.error.isEmpty();
+    stats.bytes = job->reader.bytesRead();
+    stats.elapsedMs = job->timer.elapsed();
+    qInfo() << "Imported" << stats.entries << "entries in" << stats.elapsedMs << "ms,"
+            << stats.entriesPerSecond() << "entries/s:" << stats.added << "added,"
+            << stats.archived << "archived," << stats.duplicates << "duplicates,"
+            << stats.skipped << "skipped";
+    if (!stats.ok) {
+        qWarning() << "Import stopped early:" << stats.error;
+    }
+    reportImport(stats, job->requester);
+    return true;
+}
+
+// To the instance whose user asked for the import, which may be a follower
+void CapturePipeline::reportImport(const HistoryExport::Stats &stats, quint32 requester) {
+    QMetaObject::invokeMethod(this, [this, stats, requester]() {
+        if (requester == 0) {
+            emit importFinished(stats);
+            return;
+        }
+        QLocalSocket *socket = followerLinks.value(requester);
+        if (!socket) {
+            qInfo() << "The instance that asked for the import has exited";
+            return;
+        }
+        QByteArray frame;
+        QDataStream stream(&frame, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream << quint8(Item::Type::Import) << stats;
+        socket->write(frame);
+    }, Qt::QueuedConnection);
+}
+
+bool CapturePipeline::pin(const QString &text) {
+    const QByteArray utf8 = text.toUtf8();
+    const quint32 hash = Utf8Entry::hashOf(utf8);
+    if (text.isEmpty() || pins.contains(utf8, hash) || pins.size() >= PinStore::kMaxPins) {
+        return false;
+    }
+    // Moved into the current slab: the pin outlives the history around it
+    const int index = hashIndex.contains(hash) ? history.indexOf(utf8, hash) : -1;
+    HistoryEntry entry;
+    entry.body = index >= 0 ? arena.restore(history.entry(index).body) : arena.store(utf8, hash);
+    entry.kinds = index >= 0 ? history.entry(index).kinds : ContentClassifier::classify(utf8);
+    entry.source = index >= 0 ? history.entry(index).source : 0;
+    if (index >= 0) {
+        history.removeAll(utf8, hash);
+        unindex(utf8, hash);
+        store.recordRemove(HistoryStore::List::History, text);
+    }
+    pins.prepend(entry);
+    pinsChanged = true;
+    return true;
+}
+
+bool CapturePipeline::unpin(const QString &text) {
+    const QByteArray utf8 = text.toUtf8();
+    const quint32 hash = Utf8Entry::hashOf(utf8);
+    const int index = pins.indexOf(utf8, hash);
+    if (index < 0) {
+        return false;
+    }
+    HistoryEntry entry = pins.entry(index);
+    pins.removeAll(utf8, hash);
+    pinsChanged = true;
+
+    // Back to the front of history, as if just copied
+    indexEntry(utf8, hash, true, &entry.group);
+    entry.frecency = frecency.bump(hash);
+    sources.set(hash, entry.source);
+    trackExpiry(&entry, false);
+    history.prepend(entry);
+    recordPrepend(text, utf8);
+    // Durable in history before the pin file drops it; a crash in between keeps the pin
+    commitStore();
+    trim(HistoryStore::List::History);
+    return true;
+}
+
+// Indexes a new history body. Returns false when normalized dedup finds it
+// equal to a kept entry; during a rebuild such entries are kept and counted.
+bool CapturePipeline::indexEntry(QByteArrayView utf8, quint32 hash, bool rebuilding, quint32 *group) {
+    *group = 0;
+    if (normalizeDuplicates || nearDuplicateThreshold >= 0) {
+        const QByteArray normalized = NearDuplicateIndex::normalize(utf8);
+        if (normalizeDuplicates) {
+            const quint64 key = qHash(normalized);
+            if (!rebuilding && normalizedIndex.contains(key)) {
+                return false;
+            }
+            ++normalizedIndex[key];
+        }
+        quint64 fingerprint = 0;
+        if (nearDuplicateThreshold >= 0 && NearDuplicateIndex::fingerprint(normalized, &fingerprint)) {
+            *group = nearDuplicates.insert(hash, fingerprint);
+        }
+    }
+    ++hashIndex[hash];
+    return true;
+}
+
+void CapturePipeline::unindex(QByteArrayView utf8, quint32 hash) {
+    auto it = hashIndex.find(hash);
+    if (it != hashIndex.end() && --it.value() <= 0) {
+        hashIndex.erase(it);
+        frecency.remove(hash);
+        expiry.remove(hash);
+        sources.remove(hash);
+    }
+    if (normalizeDuplicates) {
+        auto normalized = normalizedIndex.find(qHash(NearDuplicateIndex::normalize(utf8)));
+        if (normalized != normalizedIndex.end() && --normalized.value() <= 0) {
+            normalizedIndex.erase(normalized);
+        }
+    }
+    nearDuplicates.remove(hash);
+}
+
+void CapturePipeline::rebuildIndexes(const QHash<quint32, ContentClassifier::Kinds> *classified) {
+    hashIndex.clear();
+    normalizedIndex.clear();
+    nearDuplicates.clear();
+    nearDuplicates.setThreshold(nearDuplicateThreshold);
+
+    QVector<HistoryEntry> entries;
+    entries.reserve(history.size());
+    history.forEach([&entries](const HistoryEntry &entry) {
+        entries.append(entry);
+        return true;
+    });
+    // Oldest first, so groups form exactly as they would have at capture time.
+    // Entries without a saved score rank as one use a half-life ago, in
+    // capture order, below anything used since.
+    const double seedTime = FrecencyIndex::now() - 1.0;
+    for (int i = entries.size() - 1; i >= 0; --i) {
+        HistoryEntry &entry = entries[i];
+        indexEntry(entry.body.bytes(), entry.body.hash(), true, &entry.group);
+        if (classified && classified->contains(entry.body.hash())) {
+            entry.kinds = classified->value(entry.body.hash());
+        } else if (!(entry.kinds & ContentClassifier::Classified)) {
+            entry.kinds = ContentClassifier::classify(entry.body.bytes());
+        }
+        entry.frecency = frecency.seed(entry.body.hash(), seedTime - double(i) / entries.size());
+        entry.source = sources.appOf(entry.body.hash());
+        stampExpiry(&entry);
+    }
+    history = EntryList::fromEntries(entries);
+}
+
+void CapturePipeline::publish() {
+    // Copies share every chunk; the next edit copies only what it touches
+    HistorySnapshot next;
+    next.version = ++version;
+    next.history = history;
+    next.selections = selections;
+    next.pins = pins;
+    next.sourceApps = sources.apps();
+    snapshots.publish(std::move(next));
+    accountMemory();
+
+    const quint64 publishedVersion = version;
+    qint64 publishedAt = clock.nsecsElapsed();
+    QMetaObject::invokeMethod(this, [this, publishedVersion, publishedAt]() {
+        record(Stage::Publish, clock.nsecsElapsed() - publishedAt);
+        emit historyPublished(publishedVersion);
+    }, Qt::QueuedConnection);
+}
+
+void CapturePipeline::accountMemory() {
+    using Subsystem = MemoryAccounting::Subsystem;
+    const qint64 indexes = MemoryAccounting::hashBytes(hashIndex) + MemoryAccounting::hashBytes(normalizedIndex)
+                           + nearDuplicates.memoryBytes() + frecency.memoryBytes() + expiry.memoryBytes()
+                           + sources.memoryBytes()
+                           + history.metadataBytes() + selections.metadataBytes() + pins.metadataBytes();
+    MemoryAccounting::set(Subsystem::Indexes, indexes);
+    MemoryAccounting::set(Subsystem::Archive, coldArchive.memoryBytes());
+    MemoryAccounting::set(Subsystem::Persistence, store.pendingBytes() + coldArchive.pendingBytes()
+                                                  + MemoryAccounting::byteArrayBytes(committedRecords));
+}
+
+void CapturePipeline::record(Stage stage, qint64 ns) {
+    StageCounter &counter = counters[int(stage)];
+    counter.count.fetch_add(1, std::memory_order_relaxed);
+    counter.totalNs.fetch_add(ns, std::memory_order_relaxed);
+    qint64 previous = counter.maxNs.load(std::memory_order_relaxed);
+    while (ns > previous && !counter.maxNs.compare_exchange_weak(previous, ns, std::memory_order_relaxed)) {
+    }
+}
+
+QVector<CapturePipeline::StageStats> CapturePipeline::stageStats() const {
+    QVector<StageStats> stats;
+    for (int i = 0; i < int(Stage::Count); ++i) {
+        StageStats s;
+        s.name = stageName(Stage(i));
+        s.count = counters[i].count.load(std::memory_order_relaxed);
+        s.totalNs = counters[i].totalNs.load(std::memory_order_relaxed);
+        s.maxNs = counters[i].maxNs.load(std::memory_order_relaxed);
+        stats.append(s);
+    }
+    return stats;
+}
+
+void CapturePipeline::resetStageStats() {
+    for (StageCounter &counter : counters) {
+        counter.count.store(0, std::memory_order_relaxed);
+        counter.totalNs.store(0, std::memory_order_relaxed);
+        counter.maxNs.store(0, std::memory_order_relaxed);
+    }
+}
+
+quint64 CapturePipeline::droppedCount() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+quint64 CapturePipeline::duplicateCount() const {
+    return duplicates.load(std::memory_order_relaxed);
+}
+
+QString CapturePipeline::stageName(Stage stage) {
+    switch (stage) {
+    case Stage::QueueWait: return "queue-wait";
+    case Stage::Hash: return "hash";
+    case Stage::Classify: return "classify";
+    case Stage::Index: return "index";
+    case Stage::Similarity: return "similarity";
+    case Stage::Compress: return "compress";
+    case Stage::Persist: return "persist";
+    case Stage::Publish: return "publish";
+    case Stage::Count: break;
+    }
+    return QString();
+}
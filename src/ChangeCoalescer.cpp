@@ -0,0 +1,97 @@
+#include "../include/ChangeCoalescer.h"
+
+ChangeCoalescer::ChangeCoalescer(int quietPeriodMs, int maxDelayMs)
+    : quietPeriodMs(qMax(0, quietPeriodMs)),
+      maxDelayMs(qMax(0, maxDelayMs)) {
+}
+
+void ChangeCoalescer::setPolicy(Policy policy) {
+    currentPolicy = policy;
+    pending = false;
+}
+
+ChangeCoalescer::Policy ChangeCoalescer::policy() const {
+    return currentPolicy;
+}
+
+void ChangeCoalescer::setQuietPeriod(int ms) {
+    quietPeriodMs = qMax(0, ms);
+}
+
+int ChangeCoalescer::quietPeriod() const {
+    return quietPeriodMs;
+}
+
+void ChangeCoalescer::setMaxDelay(int ms) {
+    maxDelayMs = qMax(0, ms);
+}
+
+int ChangeCoalescer::maxDelay() const {
+    return maxDelayMs;
+}
+
+bool ChangeCoalescer::noteChange(qint64 nowMs) {
+    ++changes;
+    if (currentPolicy == Policy::Immediate) {
+        ++commits;
+        return true;
+    }
+
+    bool burstStarted = !pending;
+    if (burstStarted) {
+        pending = true;
+        burstStartMs = nowMs;
+    }
+    lastChangeMs = nowMs;
+
+    if (currentPolicy == Policy::Leading && burstStarted) {
+        ++commits;
+        return true;
+    }
+    return false;
+}
+
+bool ChangeCoalescer::takeSettled(qint64 nowMs) {
+    if (msUntilSettled(nowMs) != 0) {
+        return false;
+    }
+    pending = false;
+    if (currentPolicy != Policy::Trailing) {
+        // Leading already committed the first change of this burst
+        return false;
+    }
+    ++commits;
+    return true;
+}
+
+qint64 ChangeCoalescer::msUntilSettled(qint64 nowMs) const {
+    if (!pending) {
+        return -1;
+    }
+    qint64 deadline = lastChangeMs + quietPeriodMs;
+    if (maxDelayMs > 0) {
+        // Never hold a burst back longer than maxDelay
+        deadline = qMin(deadline, burstStartMs + maxDelayMs);
+    }
+    return qMax<qint64>(0, deadline - nowMs);
+}
+
+bool ChangeCoalescer::hasPending() const {
+    return pending;
+}
+
+void ChangeCoalescer::reset() {
+    pending = false;
+}
+
+quint64 ChangeCoalescer::changeCount() const {
+    return changes;
+}
+
+quint64 ChangeCoalescer::commitCount() const {
+    return commits;
+}
+
+quint64 ChangeCoalescer::suppressedCount() const {
+    return changes - commits;
+}
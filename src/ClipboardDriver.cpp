@@ -0,0 +1,127 @@
+#include "../include/ClipboardDriver.h"
+#include "../include/EntryArena.h"
+#include <QClipboard>
+#include <QCoreApplication>
+#include <QFile>
+#include <QGuiApplication>
+#include <QHash>
+#include <QTextStream>
+#include <QTimer>
+#include <chrono>
+
+namespace {
+
+QHash<QString, QString> parseOptions(const QStringList &arguments, int first) {
+    QHash<QString, QString> options;
+    for (int i = first; i < arguments.size(); ++i) {
+        const QString &arg = arguments.at(i);
+        if (!arg.startsWith("--")) {
+            continue;
+        }
+        int eq = arg.indexOf('=');
+        if (eq > 2) {
+            options.insert(arg.mid(2, eq - 2), arg.mid(eq + 1));
+        } else {
+            options.insert(arg.mid(2), QString("1"));
+        }
+    }
+    return options;
+}
+
+int intOption(const QHash<QString, QString> &options, const QString &key, int defaultValue) {
+    bool ok = false;
+    int value = options.value(key).toInt(&ok);
+    return ok ? value : defaultValue;
+}
+
+// Distinct per sequence number all the way through, so neither exact nor
+// near-duplicate detection can fold two changes together
+QString payload(int seq, int size) {
+    QString text = QString("xclipy-e2e %1 ").arg(seq);
+    quint32 state = quint32(seq) * 2654435761u + 1;
+    while (text.size() < size) {
+        state = state * 1664525u + 1013904223u;
+        text += QChar('a' + int((state >> 24) % 26));
+        if ((state & 0x1f) == 0) {
+            text += ' ';
+        }
+    }
+    text.truncate(qMax(size, 1));
+    return text;
+}
+
+}
+
+namespace ClipboardDriver {
+
+bool isDriverInvocation(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--drive-clipboard") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+qint64 monotonicNs() {
+    // steady_clock is CLOCK_MONOTONIC on Linux: one clock for every process
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+QByteArray logLine(QByteArrayView utf8) {
+    return QByteArray::number(monotonicNs()) + ' ' + QByteArray::number(Utf8Entry::hashOf(utf8))
+           + ' ' + QByteArray::number(utf8.size());
+}
+
+int run(const QStringList &arguments) {
+    const QHash<QString, QString> options = parseOptions(arguments, 1);
+    const int rate = qMax(1, intOption(options, "rate", 50));
+    const int size = qMax(16, intOption(options, "size", 256));
+    const int count = qMax(1, intOption(options, "count", 500));
+    const int burst = qMax(1, intOption(options, "burst", 1));
+    const int settleMs = qMax(0, intOption(options, "settle", 2000));
+
+    QFile log(options.value("log"));
+    if (log.fileName().isEmpty() || !log.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QTextStream(stderr) << "--drive-clipboard needs a writable --log=<path>\n";
+        return 2;
+    }
+    QClipboard *clipboard = QGuiApplication::clipboard();
+    // Payloads are built up front so a tick only costs the ownership change
+    QStringList texts;
+    texts.reserve(count);
+    for (int seq = 0; seq < count; ++seq) {
+        texts.append(payload(seq, size));
+    }
+
+    int next = 0;
+    QTimer ticker;
+    ticker.setTimerType(Qt::PreciseTimer);
+    ticker.setInterval(1000 / rate);
+    QObject::connect(&ticker, &QTimer::timeout, [&]() {
+        for (int i = 0; i < burst && next < count; ++i, ++next) {
+            const QString &text = texts.at(next);
+            // Stamped as the change is made; the capture side stamps when it has the text
+            const QByteArray line = logLine(text.toUtf8());
+            clipboard->setText(text, QClipboard::Clipboard);
+            log.write(line + ' ' + QByteArray::number(next) + '\n');
+        }
+        if (next >= count) {
+            ticker.stop();
+            log.flush();
+            // Stay the owner until the last change has been read
+            QTimer::singleShot(settleMs, qApp, &QCoreApplication::quit);
+        }
+    });
+    ticker.start();
+    const int result = QCoreApplication::exec();
+
+    QTextStream(stdout) << "driven: " << next << "\n"
+                        << "rate: " << rate << "\n"
+                        << "burst: " << burst << "\n"
+                        << "size: " << size << "\n";
+    return result;
+}
+
+}
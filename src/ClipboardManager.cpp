@@ -1,19 +1,61 @@
 #include "../include/ClipboardManager.h"
 #include "../include/GlobalHotkey.h"
+#include "../include/HistoryModel.h"
+#include "../include/ClipboardDriver.h"
+#include "../include/MemoryAccounting.h"
 #include <QApplication>
+#include <QFile>
+#include <QThread>
 #include <QTimer>
 #include <QDebug>
 #include <QUrl>
+#include <memory>
 
 ClipboardManager::ClipboardManager(QObject *parent)
     : QObject(parent),
       clipboard(QApplication::clipboard()),
       settings("Xclipy", "Xclipy"),
+      pipeline(nullptr),
+      selectionTimer(nullptr),
+      captureTimer(nullptr),
       globalHotkeyManager(nullptr) {
 
+    // History is loaded separately by loadHistoryAsync() so startup doesn't wait on it
     loadSettings();
-    history = settings.value("history").toStringList();
-    qDebug() << "Loaded history:" << history;
+
+    // Each captured text is logged with its capture time for scripts/e2e-capture.sh
+    const QString captureLogPath = qEnvironmentVariable("XCLIPY_CAPTURE_LOG");
+    if (!captureLogPath.isEmpty()) {
+        captureLog = new QFile(captureLogPath, this);
+        if (!captureLog->open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "Cannot open the capture log" << captureLogPath << ":" << captureLog->errorString();
+            delete captureLog;
+            captureLog = nullptr;
+        }
+    }
+    // Everything after the clipboard read runs on the capture pipeline's worker
+    pipeline = new CapturePipeline(QString(), this);
+    if (recordWorkloadTrace) {
+        tracePath = WorkloadTrace::newTracePath();
+        pipeline->setWorkloadTrace(tracePath);
+    }
+    connect(pipeline, &CapturePipeline::recovered, this, &ClipboardManager::onPipelineRecovered);
+    connect(pipeline, &CapturePipeline::historyPublished, this, &ClipboardManager::onHistoryPublished);
+    connect(pipeline, &CapturePipeline::importFinished, this, &ClipboardManager::importFinished);
+    applyDedupOptions();
+    pipeline->setArchiveEvicted(archiveEvictedEntries);
+    applyExpiry();
+
+    // PRIMARY selection: coalesce drag bursts and only read the selection once it settles
+    captureClock.start();
+    selectionCoalescer.setQuietPeriod(selectionQuietPeriod);
+    selectionTimer = new QTimer(this);
+    selectionTimer->setSingleShot(true);
+    connect(selectionTimer, &QTimer::timeout, this, &ClipboardManager::commitSelection);
+    if (clipboard->supportsSelection()) {
+        connect(clipboard, &QClipboard::selectionChanged,
+                this, &ClipboardManager::onSelectionChanged);
+    }
 
     // Initialize global hotkey system
     if (GlobalHotkey::isSupported()) {
@@ -21,38 +63,174 @@ ClipboardManager::ClipboardManager(QObject *parent)
         if (globalHotkeyEnabled) {
             registerGlobalHotkey();
         }
+        if (pasteHotkeysEnabled) {
+            registerPasteHotkeys();
+        }
         connect(globalHotkeyManager, &GlobalHotkey::hotkeyPressed, 
                 this, &ClipboardManager::onGlobalHotkeyPressed);
     } else {
         qWarning() << "Global hotkeys not supported on this platform";
     }
 
+    // Owner changes are debounced so bursts commit (and persist) only the settled value
+    clipboardCoalescer.setPolicy(captureDebouncePolicy);
+    clipboardCoalescer.setQuietPeriod(captureDebounceWindow);
+    captureTimer = new QTimer(this);
+    captureTimer->setSingleShot(true);
+    connect(captureTimer, &QTimer::timeout, this, &ClipboardManager::onCaptureSettled);
+    connect(clipboard, &QClipboard::dataChanged, this, &ClipboardManager::onClipboardChanged);
+
+    // Polling stays as a fallback for platforms that don't report foreign changes
     QTimer *timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, &ClipboardManager::checkClipboard);
+    connect(timer, &QTimer::timeout, this, &ClipboardManager::pollClipboard);
     timer->start(500);
 }
 
-const QStringList& ClipboardManager::getHistory() const {
-    return history;
+ClipboardManager::~ClipboardManager() {
+    if (exportThread) {
+        exportThread->wait();   // it reads the pipeline's archive
+        delete exportThread;
+    }
+    pipeline->stop();
+}
+
+void ClipboardManager::loadHistoryAsync() {
+    // The worker recovers the store first; captures queued meanwhile are applied on top
+    pipeline->start(maxHistorySize, maxSelectionHistorySize);
+}
+
+bool ClipboardManager::isHistoryLoaded() const {
+    return historyLoaded;
+}
+
+void ClipboardManager::onPipelineRecovered(const HistoryStore::RecoveryStats &stats, bool migrated) {
+    if (stats.discardedBytes > 0 || (stats.snapshotFound && !stats.snapshotValid)) {
+        qWarning() << "History recovered with losses:" << stats.journalRecords << "journal records kept,"
+                   << stats.discardedBytes << "bytes discarded";
+    }
+    if (migrated) {
+        QSettings legacyStore(QSettings::IniFormat, QSettings::UserScope, "Xclipy", "Xclipy-history");
+        legacyStore.clear();
+        settings.remove("history");
+        settings.remove("selectionHistory");
+        settings.sync();
+    }
+
+    historyLoaded = true;
+    qDebug() << "Loaded history:" << pipeline->snapshot()->history.size() << "entries in"
+             << stats.recoveryMs << "ms";
+    emit historyReady();
+}
+
+void ClipboardManager::onHistoryPublished(quint64 version) {
+    // Queued notifications for versions already adopted collapse into nothing
+    if (!publishedSnapshot.isNull() && publishedSnapshot->version >= version) {
+        return;
+    }
+    HistorySnapshotRef next = pipeline->snapshot();
+
+    // Unchanged lists share their chunks with the previous snapshot
+    bool historyDiffers = publishedSnapshot.isNull() || !next->history.isSharedWith(publishedSnapshot->history)
+                          || !next->pins.isSharedWith(publishedSnapshot->pins);
+    bool selectionsDiffer = publishedSnapshot.isNull() || !next->selections.isSharedWith(publishedSnapshot->selections);
+    publishedSnapshot = next;
+    if (historyDiffers) {
+        emit historyChanged();
+    }
+    if (selectionsDiffer) {
+        emit selectionHistoryChanged();
+    }
+}
+
+QVector<CapturePipeline::StageStats> ClipboardManager::getPipelineStats() const {
+    return pipeline->stageStats();
+}
+
+void ClipboardManager::logPipelineStats() const {
+    for (const CapturePipeline::StageStats &stage : pipeline->stageStats()) {
+        if (stage.count == 0) {
+            continue;
+        }
+        qInfo().nospace() << "Pipeline stage " << stage.name << ": " << stage.count << " items, avg "
+                          << (stage.totalNs / qint64(stage.count)) / 1000.0 << " us, max "
+                          << stage.maxNs / 1000.0 << " us";
+    }
+
+    HistorySnapshotRef snapshot = pipeline->snapshot();
+    const int entries = snapshot->history.size() + snapshot->selections.size();
+    const qint64 bytes = EntryArena::allocatedBytes();
+    qInfo().nospace() << "History storage: " << entries << " entries, " << bytes << " arena bytes ("
+                      << (entries ? bytes / entries : 0) << " bytes/entry)";
+
+    for (const MemoryAccounting::Usage &usage : MemoryAccounting::usage()) {
+        qInfo().nospace() << "Memory " << usage.name << ": " << usage.current << " bytes, peak " << usage.peak;
+    }
+    qint64 resident = 0;
+    qint64 peakResident = 0;
+    if (MemoryAccounting::residentBytes(&resident, &peakResident)) {
+        qInfo().nospace() << "Memory accounted: " << MemoryAccounting::total() << " bytes of " << resident
+                          << " resident, peak resident " << peakResident;
+    }
+}
+
+HistorySnapshotRef ClipboardManager::historySnapshot() const {
+    return pipeline->snapshot();
+}
+
+const HistoryArchive *ClipboardManager::historyArchive() const {
+    return pipeline->archive();
 }
 
 void ClipboardManager::clearHistory() {
-    history.clear();
-    settings.setValue("history", history);
-    emit historyChanged(history);
+    pipeline->clear();
 }
 
-void ClipboardManager::removeFromHistory(const QString &text) {
-    if (history.removeAll(text) > 0) {
-        settings.setValue("history", history);
-        emit historyChanged(history);
+bool ClipboardManager::exportHistory(const QString &path) {
+    if (exportThread) {
+        return false;
     }
+    // The snapshot is immutable and the archive's reads are thread-safe
+    HistorySnapshotRef snapshot = pipeline->snapshot();
+    const HistoryArchive *archive = pipeline->archive();
+    auto stats = std::make_shared<HistoryExport::Stats>();
+    exportThread = QThread::create([path, snapshot, archive, stats]() {
+        if (HistoryExport::write(path, *snapshot, archive, stats.get())) {
+            qInfo() << "Exported" << stats->entries << "entries," << stats->bytes << "bytes in"
+                    << stats->elapsedMs << "ms," << stats->entriesPerSecond() << "entries/s";
+        } else {
+            qWarning() << "History export to" << path << "failed:" << stats->error;
+        }
+    });
+    connect(exportThread, &QThread::finished, this, [this, stats]() {
+        exportThread->deleteLater();
+        exportThread = nullptr;
+        emit exportFinished(*stats);
+    });
+    exportThread->start(QThread::LowPriority);
+    return true;
+}
+
+void ClipboardManager::importHistory(const QString &path) {
+    pipeline->importHistory(path);
+}
+
+void ClipboardManager::removeFromHistory(const QString &text) {
+    pipeline->removeEntry(text);
+}
+
+void ClipboardManager::pinEntry(const QString &text) {
+    pipeline->pinEntry(text);
+}
+
+void ClipboardManager::unpinEntry(const QString &text) {
+    pipeline->unpinEntry(text);
 }
 
 void ClipboardManager::setClipboardText(const QString &text) {
     selfCopy = true;                 // mark as self-triggered
     clipboard->setText(text);        // copy to clipboard
     lastText = text;                 // update last seen
+    pipeline->touchEntry(text);      // a use, if it came from history
 }
 
 void ClipboardManager::setClipboardFiles(const QStringList &filePaths) {
@@ -63,66 +241,255 @@ void ClipboardManager::setClipboardFiles(const QStringList &filePaths) {
     clipboard->setMimeData(mimeData);
     
     lastFiles = filePaths;           // update last seen files
+    pipeline->touchEntry(filePaths.join("\n"), WorkloadTrace::FormatFiles);
 }
 
 
 
 void ClipboardManager::checkClipboard() {
-    QString text = clipboard->text();
-    QStringList files;
+    if (clipboard->ownsClipboard()) {
+        // Still our own setClipboardText/Files data; nothing foreign to capture
+        selfCopy = false;
+        return;
+    }
 
-    // Check for files/folders in clipboard
-    const QMimeData *mimeData = clipboard->mimeData();
-    if (mimeData && mimeData->hasUrls()) {
-        QList<QUrl> urls = mimeData->urls();
-        for (const QUrl &url : urls) {
-            if (url.isLocalFile()) {
-                files.append(url.toLocalFile());
-            }
-        }
+    // Owner, stamp and advertised formats first; the payload only moves once a change is confirmed
+    ClipboardProbe::Signature signature = clipboardProbe.probe(QClipboard::Clipboard);
+    if (signature.valid && signature == lastSignature) {
+        return;
     }
+    lastSignature = signature;
 
     if (selfCopy) {
         // Skip the next clipboard change since it came from us
         selfCopy = false;
         return;
     }
+    // Told by the owner window alone, so an excluded app's data is never transferred
+    if (isExcludedSource(signature.source)) {
+        return;
+    }
+
+    // Transfer only the formats we store
+    QString text;
+    if (signature.hasText) {
+        text = clipboard->text();
+    }
 
-    // Handle text clipboard changes
-    if (!text.isEmpty() && text != lastText && !history.contains(text)) {
+    const QStringList files = signature.hasFiles ? localFiles(clipboard->mimeData()) : QStringList();
+
+    // Handle text clipboard changes; dedup, persistence and publishing happen on the worker
+    if (!text.isEmpty() && text != lastText) {
         lastText = text;
-        history.prepend(text);
-        if (history.size() > maxHistorySize) history.removeLast();
-        settings.setValue("history", history);
-        emit historyChanged(history);
-        qDebug() << "Clipboard changed (text):" << text;
+        if (captureLog) {
+            captureLog->write(ClipboardDriver::logLine(text.toUtf8()) + '\n');
+            captureLog->flush();
+        }
+        // Password managers mark what they copy; such text is kept only briefly
+        bool concealed = signature.concealed;
+        if (!signature.valid) {
+            const QMimeData *offered = clipboard->mimeData();
+            concealed = offered && offered->hasFormat("x-kde-passwordManagerHint");
+        }
+        pipeline->submitText(text, concealed, signature.source.app, traceFormats(signature));
     }
 
     // Handle file/folder clipboard changes
     if (!files.isEmpty() && files != lastFiles) {
         lastFiles = files;
-        QString fileEntry = files.join("\n");
-        if (!history.contains(fileEntry)) {
-            history.prepend(fileEntry);
-            if (history.size() > maxHistorySize) history.removeLast();
-            settings.setValue("history", history);
-            emit historyChanged(history);
-            qDebug() << "Clipboard changed (files):" << files;
+        pipeline->submitFiles(files, signature.source.app, traceFormats(signature));
+    }
+}
+
+QStringList ClipboardManager::localFiles(const QMimeData *mimeData) {
+    QStringList files;
+    if (mimeData && mimeData->hasUrls()) {
+        const QList<QUrl> urls = mimeData->urls();
+        for (const QUrl &url : urls) {
+            if (url.isLocalFile()) {
+                files.append(url.toLocalFile());
+            }
+        }
+    }
+    return files;
+}
+
+// What a Leading burst settled on is taken as seen, so the next poll
+// doesn't capture it as a change; the burst's first value was recorded
+void ClipboardManager::markClipboardSeen() {
+    if (clipboard->ownsClipboard()) {
+        return;
+    }
+    lastSignature = clipboardProbe.probe(QClipboard::Clipboard);
+    if (lastSignature.valid || isExcludedSource(lastSignature.source)) {
+        return;     // the poll stops at the signature
+    }
+    // Without a signature the poll compares contents
+    const QString text = clipboard->text();
+    if (!text.isEmpty()) {
+        lastText = text;
+    }
+    const QStringList files = localFiles(clipboard->mimeData());
+    if (!files.isEmpty()) {
+        lastFiles = files;
+    }
+}
+
+void ClipboardManager::pollClipboard() {
+    // A burst in flight will be committed by the debouncer once it settles
+    if (!clipboardCoalescer.hasPending()) {
+        checkClipboard();
+    }
+}
+
+void ClipboardManager::onClipboardChanged() {
+    qint64 now = captureClock.elapsed();
+    if (clipboardCoalescer.noteChange(now)) {
+        checkClipboard();
+    }
+    qint64 remaining = clipboardCoalescer.msUntilSettled(now);
+    if (remaining >= 0) {
+        captureTimer->start(int(remaining));
+    }
+}
+
+void ClipboardManager::onCaptureSettled() {
+    qint64 now = captureClock.elapsed();
+    if (clipboardCoalescer.takeSettled(now)) {
+        checkClipboard();
+        qDebug() << "Clipboard burst settled; suppressed writes so far:"
+                 << clipboardCoalescer.suppressedCount();
+        return;
+    }
+    if (!clipboardCoalescer.hasPending()) {
+        // Leading: settled without a commit
+        markClipboardSeen();
+        return;
+    }
+    qint64 remaining = clipboardCoalescer.msUntilSettled(now);
+    if (remaining >= 0) {
+        captureTimer->start(int(remaining));
+    }
+}
+
+void ClipboardManager::onSelectionChanged() {
+    if (!trackPrimarySelection) {
+        return;
+    }
+    // Cheap path for every drag step: no selection transfer, just restart the quiet window
+    qint64 now = captureClock.elapsed();
+    selectionCoalescer.noteChange(now);
+    selectionTimer->start(int(selectionCoalescer.msUntilSettled(now)));
+}
+
+void ClipboardManager::commitSelection() {
+    qint64 now = captureClock.elapsed();
+    if (!selectionCoalescer.takeSettled(now)) {
+        qint64 remaining = selectionCoalescer.msUntilSettled(now);
+        if (remaining >= 0) {
+            selectionTimer->start(int(remaining));
         }
+        return;
+    }
+
+    if (clipboard->ownsSelection()) {
+        return;
+    }
+    ClipboardProbe::Signature signature = clipboardProbe.probe(QClipboard::Selection);
+    if ((signature.valid && signature == lastSelectionSignature) || !signature.hasText) {
+        return;
     }
+    lastSelectionSignature = signature;
+    if (isExcludedSource(signature.source)) {
+        return;
+    }
+
+    QString text = clipboard->text(QClipboard::Selection);
+    if (text.isEmpty() || text == lastSelection) {
+        return;
+    }
+    lastSelection = text;
+
+    pipeline->submitSelection(text, traceFormats(signature));
 }
 
 // Settings management methods
+ClipboardManager::SettingsTransaction::SettingsTransaction(ClipboardManager *manager)
+    : manager(manager) {
+    if (manager) {
+        manager->beginSettingsUpdate();
+    }
+}
+
+ClipboardManager::SettingsTransaction::~SettingsTransaction() {
+    if (manager) {
+        manager->endSettingsUpdate();
+    }
+}
+
+void ClipboardManager::beginSettingsUpdate() {
+    if (settingsUpdateDepth++ == 0) {
+        pendingSettingsChanges = 0;
+        hotkeyBeforeUpdate = globalHotkey;
+        hotkeyEnabledBeforeUpdate = globalHotkeyEnabled;
+    }
+}
+
+void ClipboardManager::endSettingsUpdate() {
+    if (--settingsUpdateDepth == 0 && pendingSettingsChanges != 0) {
+        const quint32 changes = pendingSettingsChanges;
+        pendingSettingsChanges = 0;
+        applySettingsChanges(changes);
+    }
+}
+
+void ClipboardManager::settingsUpdated(quint32 changes) {
+    pendingSettingsChanges |= changes | PersistSettings;
+}
+
+void ClipboardManager::applySettingsChanges(quint32 changes) {
+    // Queued back to back, so the worker drains them as one batch and
+    // publishes once. Archiving first: entries trimmed by a smaller limit
+    // set in the same transaction are archived when that was enabled too.
+    if (changes & PipelineArchive) {
+        pipeline->setArchiveEvicted(archiveEvictedEntries);
+    }
+    if (changes & PipelineLimits) {
+        // The worker trims if a size is smaller and publishes the result
+        pipeline->setLimits(maxHistorySize, maxSelectionHistorySize);
+    }
+    if (changes & PipelineDedup) {
+        applyDedupOptions();
+    }
+    if (changes & PipelineExpiry) {
+        applyExpiry();
+    }
+
+    // Grabbing a key is a round trip to the X server; skip it when nothing moved
+    if ((changes & GlobalHotkeyChange) && globalHotkeyManager
+        && (globalHotkey != hotkeyBeforeUpdate || globalHotkeyEnabled != hotkeyEnabledBeforeUpdate)) {
+        if (globalHotkeyEnabled) {
+            registerGlobalHotkey();
+        } else {
+            globalHotkeyManager->unregisterHotkey(0);
+        }
+    }
+    if (changes & PasteHotkeyChange) {
+        unregisterPasteHotkeys();
+        if (pasteHotkeysEnabled) {
+            registerPasteHotkeys();
+        }
+    }
+
+    saveSettings();
+    emit settingsChanged();
+}
+
 void ClipboardManager::setMaxHistorySize(int size) {
     if (size > 0 && size != maxHistorySize) {
+        SettingsTransaction transaction(this);
         maxHistorySize = size;
-        // Trim history if new size is smaller
-        while (history.size() > maxHistorySize) {
-            history.removeLast();
-        }
-        settings.setValue("history", history);
-        emit historyChanged(history);
-        saveSettings();
+        settingsUpdated(PipelineLimits);
     }
 }
 
@@ -131,8 +498,11 @@ int ClipboardManager::getMaxHistorySize() const {
 }
 
 void ClipboardManager::setAutoStart(bool enabled) {
-    autoStart = enabled;
-    saveSettings();
+    if (autoStart != enabled) {
+        SettingsTransaction transaction(this);
+        autoStart = enabled;
+        settingsUpdated(PersistSettings);
+    }
 }
 
 bool ClipboardManager::getAutoStart() const {
@@ -140,20 +510,291 @@ bool ClipboardManager::getAutoStart() const {
 }
 
 void ClipboardManager::setShowTrayIcon(bool enabled) {
-    showTrayIcon = enabled;
-    saveSettings();
+    if (showTrayIcon != enabled) {
+        SettingsTransaction transaction(this);
+        showTrayIcon = enabled;
+        settingsUpdated(PersistSettings);
+    }
 }
 
 bool ClipboardManager::getShowTrayIcon() const {
     return showTrayIcon;
 }
 
+void ClipboardManager::setCaptureDebouncePolicy(ChangeCoalescer::Policy policy) {
+    if (captureDebouncePolicy != policy) {
+        SettingsTransaction transaction(this);
+        captureDebouncePolicy = policy;
+        captureTimer->stop();
+        clipboardCoalescer.setPolicy(policy);
+        settingsUpdated(PersistSettings);
+    }
+}
+
+ChangeCoalescer::Policy ClipboardManager::getCaptureDebouncePolicy() const {
+    return captureDebouncePolicy;
+}
+
+void ClipboardManager::setCaptureDebounceWindow(int ms) {
+    if (ms >= 0 && ms != captureDebounceWindow) {
+        SettingsTransaction transaction(this);
+        captureDebounceWindow = ms;
+        clipboardCoalescer.setQuietPeriod(ms);
+        settingsUpdated(PersistSettings);
+    }
+}
+
+int ClipboardManager::getCaptureDebounceWindow() const {
+    return captureDebounceWindow;
+}
+
+quint64 ClipboardManager::getSuppressedCaptureCount() const {
+    return clipboardCoalescer.suppressedCount();
+}
+
+void ClipboardManager::setNormalizeDuplicates(bool enabled) {
+    if (normalizeDuplicates != enabled) {
+        SettingsTransaction transaction(this);
+        normalizeDuplicates = enabled;
+        settingsUpdated(PipelineDedup);
+    }
+}
+
+bool ClipboardManager::getNormalizeDuplicates() const {
+    return normalizeDuplicates;
+}
+
+void ClipboardManager::setCollapseNearDuplicates(bool enabled) {
+    if (collapseNearDuplicates != enabled) {
+        SettingsTransaction transaction(this);
+        collapseNearDuplicates = enabled;
+        settingsUpdated(PipelineDedup);
+    }
+}
+
+bool ClipboardManager::getCollapseNearDuplicates() const {
+    return collapseNearDuplicates;
+}
+
+void ClipboardManager::setNearDuplicateThreshold(int bits) {
+    bits = qBound(0, bits, NearDuplicateIndex::kMaxThreshold);
+    if (bits != nearDuplicateThreshold) {
+        SettingsTransaction transaction(this);
+        nearDuplicateThreshold = bits;
+        settingsUpdated(PipelineDedup);
+    }
+}
+
+int ClipboardManager::getNearDuplicateThreshold() const {
+    return nearDuplicateThreshold;
+}
+
+void ClipboardManager::setRankByFrecency(bool enabled) {
+    if (rankByFrecency != enabled) {
+        SettingsTransaction transaction(this);
+        rankByFrecency = enabled;
+        settingsUpdated(PersistSettings);
+    }
+}
+
+bool ClipboardManager::getRankByFrecency() const {
+    return rankByFrecency;
+}
+
+void ClipboardManager::setArchiveEvictedEntries(bool enabled) {
+    if (archiveEvictedEntries != enabled) {
+        SettingsTransaction transaction(this);
+        archiveEvictedEntries = enabled;
+        settingsUpdated(PipelineArchive);
+    }
+}
+
+bool ClipboardManager::getArchiveEvictedEntries() const {
+    return archiveEvictedEntries;
+}
+
+void ClipboardManager::setHistoryMaxAge(int days) {
+    days = qMax(0, days);
+    if (historyMaxAgeDays != days) {
+        SettingsTransaction transaction(this);
+        historyMaxAgeDays = days;
+        settingsUpdated(PipelineExpiry);
+    }
+}
+
+int ClipboardManager::getHistoryMaxAge() const {
+    return historyMaxAgeDays;
+}
+
+void ClipboardManager::setConcealedEntryLifetime(int seconds) {
+    seconds = qMax(0, seconds);
+    if (concealedEntryLifetime != seconds) {
+        SettingsTransaction transaction(this);
+        concealedEntryLifetime = seconds;
+        settingsUpdated(PipelineExpiry);
+    }
+}
+
+int ClipboardManager::getConcealedEntryLifetime() const {
+    return concealedEntryLifetime;
+}
+
+void ClipboardManager::applyExpiry() {
+    pipeline->setExpiry(qint64(historyMaxAgeDays) * 24 * 60 * 60, concealedEntryLifetime);
+}
+
+void ClipboardManager::setExcludedSourceApps(const QStringList &apps) {
+    QStringList names;
+    for (const QString &app : apps) {
+        const QString name = app.trimmed();
+        if (!name.isEmpty() && !names.contains(name, Qt::CaseInsensitive)) {
+            names.append(name);
+        }
+    }
+    if (excludedSourceApps != names) {
+        SettingsTransaction transaction(this);
+        excludedSourceApps = names;
+        settingsUpdated(PersistSettings);
+    }
+}
+
+QStringList ClipboardManager::getExcludedSourceApps() const {
+    return excludedSourceApps;
+}
+
+bool ClipboardManager::isExcludedSource(const ClipboardProbe::Source &source) const {
+    return !excludedSourceApps.isEmpty() && source.matches(excludedSourceApps);
+}
+
+void ClipboardManager::setRecordWorkloadTrace(bool enabled) {
+    if (recordWorkloadTrace != enabled) {
+        SettingsTransaction transaction(this);
+        recordWorkloadTrace = enabled;
+        tracePath = enabled ? WorkloadTrace::newTracePath() : QString();
+        pipeline->setWorkloadTrace(tracePath);
+        settingsUpdated(PersistSettings);
+    }
+}
+
+bool ClipboardManager::getRecordWorkloadTrace() const {
+    return recordWorkloadTrace;
+}
+
+QString ClipboardManager::workloadTracePath() const {
+    return tracePath;
+}
+
+quint8 ClipboardManager::traceFormats(const ClipboardProbe::Signature &signature) {
+    quint8 formats = 0;
+    if (signature.hasText) {
+        formats |= WorkloadTrace::FormatText;
+    }
+    if (signature.hasFiles) {
+        formats |= WorkloadTrace::FormatFiles;
+    }
+    if (signature.concealed) {
+        formats |= WorkloadTrace::FormatConcealed;
+    }
+    return signature.valid ? formats : formats | WorkloadTrace::FormatUnknown;
+}
+
+void ClipboardManager::applyDedupOptions() {
+    // The worker re-indexes existing history and republishes it with groups
+    pipeline->setDedupOptions(normalizeDuplicates, collapseNearDuplicates ? nearDuplicateThreshold : -1);
+}
+
+void ClipboardManager::setTrackPrimarySelection(bool enabled) {
+    if (trackPrimarySelection != enabled) {
+        SettingsTransaction transaction(this);
+        trackPrimarySelection = enabled;
+        if (!enabled) {
+            selectionTimer->stop();
+            selectionCoalescer.reset();
+        }
+        settingsUpdated(PersistSettings);
+    }
+}
+
+bool ClipboardManager::getTrackPrimarySelection() const {
+    return trackPrimarySelection;
+}
+
+void ClipboardManager::setSelectionQuietPeriod(int ms) {
+    if (ms >= 0 && ms != selectionQuietPeriod) {
+        SettingsTransaction transaction(this);
+        selectionQuietPeriod = ms;
+        selectionCoalescer.setQuietPeriod(ms);
+        settingsUpdated(PersistSettings);
+    }
+}
+
+int ClipboardManager::getSelectionQuietPeriod() const {
+    return selectionQuietPeriod;
+}
+
+void ClipboardManager::setMaxSelectionHistorySize(int size) {
+    if (size > 0 && size != maxSelectionHistorySize) {
+        SettingsTransaction transaction(this);
+        maxSelectionHistorySize = size;
+        settingsUpdated(PipelineLimits);
+    }
+}
+
+int ClipboardManager::getMaxSelectionHistorySize() const {
+    return maxSelectionHistorySize;
+}
+
+bool ClipboardManager::isSelectionSupported() const {
+    return clipboard->supportsSelection();
+}
+
 void ClipboardManager::loadSettings() {
     maxHistorySize = settings.value("maxHistorySize", 50).toInt();
     autoStart = settings.value("autoStart", false).toBool();
     showTrayIcon = settings.value("showTrayIcon", true).toBool();
     globalHotkey = QKeySequence(settings.value("globalHotkey", "Ctrl+Shift+V").toString());
     globalHotkeyEnabled = settings.value("globalHotkeyEnabled", true).toBool();
+    pasteHotkeysEnabled = settings.value("pasteHotkeysEnabled", false).toBool();
+    trackPrimarySelection = settings.value("trackPrimarySelection", false).toBool();
+    selectionQuietPeriod = settings.value("selectionQuietPeriod", 400).toInt();
+    maxSelectionHistorySize = settings.value("maxSelectionHistorySize", 20).toInt();
+    captureDebounceWindow = settings.value("captureDebounceWindow", 150).toInt();
+    QString policy = settings.value("captureDebouncePolicy", "trailing").toString();
+    if (policy == "immediate") {
+        captureDebouncePolicy = ChangeCoalescer::Policy::Immediate;
+    } else if (policy == "leading") {
+        captureDebouncePolicy = ChangeCoalescer::Policy::Leading;
+    } else {
+        captureDebouncePolicy = ChangeCoalescer::Policy::Trailing;
+    }
+    synthesizePaste = settings.value("synthesizePaste", false).toBool();
+    normalizeDuplicates = settings.value("normalizeDuplicates", false).toBool();
+    collapseNearDuplicates = settings.value("collapseNearDuplicates", false).toBool();
+    nearDuplicateThreshold = qBound(0, settings.value("nearDuplicateThreshold", 3).toInt(),
+                                    NearDuplicateIndex::kMaxThreshold);
+    rankByFrecency = settings.value("rankByFrecency", false).toBool();
+    archiveEvictedEntries = settings.value("archiveEvictedEntries", false).toBool();
+    historyMaxAgeDays = qMax(0, settings.value("historyMaxAgeDays", 0).toInt());
+    concealedEntryLifetime = qMax(0, settings.value("concealedEntryLifetime", 60).toInt());
+    excludedSourceApps = settings.value("excludedSourceApps").toStringList();
+    recordWorkloadTrace = settings.value("recordWorkloadTrace", false).toBool();
+
+    int bindingCount = settings.beginReadArray("pasteHotkeys");
+    pasteHotkeyBindings.clear();
+    for (int i = 0; i < bindingCount; ++i) {
+        settings.setArrayIndex(i);
+        HotkeyBinding binding;
+        binding.keySequence = QKeySequence(settings.value("keySequence").toString());
+        binding.action = HotkeyAction::PasteEntry;
+        binding.entryIndex = settings.value("entry", i).toInt();
+        if (!binding.keySequence.isEmpty()) {
+            pasteHotkeyBindings.append(binding);
+        }
+    }
+    settings.endArray();
+    if (bindingCount == 0) {
+        pasteHotkeyBindings = defaultPasteHotkeyBindings();
+    }
 }
 
 void ClipboardManager::saveSettings() {
@@ -162,17 +803,49 @@ void ClipboardManager::saveSettings() {
     settings.setValue("showTrayIcon", showTrayIcon);
     settings.setValue("globalHotkey", globalHotkey.toString());
     settings.setValue("globalHotkeyEnabled", globalHotkeyEnabled);
+    settings.setValue("pasteHotkeysEnabled", pasteHotkeysEnabled);
+    settings.setValue("trackPrimarySelection", trackPrimarySelection);
+    settings.setValue("selectionQuietPeriod", selectionQuietPeriod);
+    settings.setValue("maxSelectionHistorySize", maxSelectionHistorySize);
+    settings.setValue("captureDebounceWindow", captureDebounceWindow);
+    settings.setValue("normalizeDuplicates", normalizeDuplicates);
+    settings.setValue("collapseNearDuplicates", collapseNearDuplicates);
+    settings.setValue("nearDuplicateThreshold", nearDuplicateThreshold);
+    settings.setValue("rankByFrecency", rankByFrecency);
+    settings.setValue("archiveEvictedEntries", archiveEvictedEntries);
+    settings.setValue("historyMaxAgeDays", historyMaxAgeDays);
+    settings.setValue("concealedEntryLifetime", concealedEntryLifetime);
+    settings.setValue("excludedSourceApps", excludedSourceApps);
+    settings.setValue("recordWorkloadTrace", recordWorkloadTrace);
+    switch (captureDebouncePolicy) {
+    case ChangeCoalescer::Policy::Immediate:
+        settings.setValue("captureDebouncePolicy", "immediate");
+        break;
+    case ChangeCoalescer::Policy::Leading:
+        settings.setValue("captureDebouncePolicy", "leading");
+        break;
+    case ChangeCoalescer::Policy::Trailing:
+        settings.setValue("captureDebouncePolicy", "trailing");
+        break;
+    }
+    settings.setValue("synthesizePaste", synthesizePaste);
+
+    settings.beginWriteArray("pasteHotkeys", pasteHotkeyBindings.size());
+    for (int i = 0; i < pasteHotkeyBindings.size(); ++i) {
+        settings.setArrayIndex(i);
+        settings.setValue("keySequence", pasteHotkeyBindings[i].keySequence.toString());
+        settings.setValue("entry", pasteHotkeyBindings[i].entryIndex);
+    }
+    settings.endArray();
     settings.sync();
 }
 
 // Global hotkey management methods
 void ClipboardManager::setGlobalHotkey(const QKeySequence &keySequence) {
     if (globalHotkey != keySequence) {
+        SettingsTransaction transaction(this);
         globalHotkey = keySequence;
-        if (globalHotkeyEnabled && globalHotkeyManager) {
-            registerGlobalHotkey();
-        }
-        saveSettings();
+        settingsUpdated(GlobalHotkeyChange);
     }
 }
 
@@ -186,19 +859,19 @@ bool ClipboardManager::isGlobalHotkeyEnabled() const {
 
 void ClipboardManager::setGlobalHotkeyEnabled(bool enabled) {
     if (globalHotkeyEnabled != enabled) {
+        SettingsTransaction transaction(this);
         globalHotkeyEnabled = enabled;
-        if (globalHotkeyManager) {
-            if (enabled) {
-                registerGlobalHotkey();
-            } else {
-                globalHotkeyManager->unregisterHotkey(0);
-            }
-        }
-        saveSettings();
+        settingsUpdated(GlobalHotkeyChange);
     }
 }
 
 void ClipboardManager::registerGlobalHotkey() {
+    if (hotkeyBindings.isEmpty()) {
+        hotkeyBindings.resize(1);
+    }
+    hotkeyBindings[0].keySequence = globalHotkey;
+    hotkeyBindings[0].action = HotkeyAction::ToggleHistory;
+
     if (globalHotkeyManager && globalHotkeyEnabled) {
         globalHotkeyManager->unregisterHotkey(0); // Unregister previous hotkey
         bool success = globalHotkeyManager->registerHotkey(globalHotkey, 0);
@@ -211,7 +884,120 @@ void ClipboardManager::registerGlobalHotkey() {
 }
 
 void ClipboardManager::onGlobalHotkeyPressed(int id) {
-    Q_UNUSED(id)
-    qDebug() << "Global hotkey pressed - toggling history window";
-    emit toggleHistoryRequested();
+    if (id < 0 || id >= hotkeyBindings.size()) {
+        return;
+    }
+
+    const HotkeyBinding &binding = hotkeyBindings.at(id);
+    switch (binding.action) {
+    case HotkeyAction::ToggleHistory:
+        qDebug() << "Global hotkey pressed - toggling history window";
+        emit toggleHistoryRequested();
+        break;
+    case HotkeyAction::PasteEntry:
+        pasteHistoryEntry(binding.entryIndex);
+        break;
+    }
+}
+
+// Paste hotkey management methods
+void ClipboardManager::setPasteHotkeysEnabled(bool enabled) {
+    if (pasteHotkeysEnabled != enabled) {
+        SettingsTransaction transaction(this);
+        pasteHotkeysEnabled = enabled;
+        settingsUpdated(PasteHotkeyChange);
+    }
+}
+
+bool ClipboardManager::isPasteHotkeysEnabled() const {
+    return pasteHotkeysEnabled;
+}
+
+void ClipboardManager::setPasteHotkeyBindings(const QList<HotkeyBinding> &bindings) {
+    SettingsTransaction transaction(this);
+    pasteHotkeyBindings = bindings;
+    settingsUpdated(PasteHotkeyChange);
+}
+
+QList<ClipboardManager::HotkeyBinding> ClipboardManager::getPasteHotkeyBindings() const {
+    return pasteHotkeyBindings;
+}
+
+void ClipboardManager::setSynthesizePaste(bool enabled) {
+    if (synthesizePaste != enabled) {
+        SettingsTransaction transaction(this);
+        synthesizePaste = enabled;
+        settingsUpdated(PersistSettings);
+    }
+}
+
+bool ClipboardManager::getSynthesizePaste() const {
+    return synthesizePaste;
+}
+
+void ClipboardManager::pasteHistoryEntry(int index) {
+    // Index into what the user last saw; the body is decoded only now
+    if (publishedSnapshot.isNull() || index < 0 || index >= publishedSnapshot->history.size()) {
+        return;
+    }
+
+    // Straight to the clipboard: no window, no historyChanged, no redraw.
+    // Files go back as a file list, as when the row is clicked.
+    const QString text = publishedSnapshot->history.at(index);
+    if (HistoryModel::isFileEntry(text)) {
+        setClipboardFiles(text.split("\n", Qt::SkipEmptyParts));
+    } else {
+        setClipboardText(text);
+    }
+
+    if (synthesizePaste && globalHotkeyManager) {
+        // Let the event loop publish the new selection owner before the target asks for it
+        QTimer::singleShot(50, this, [this]() {
+            if (globalHotkeyManager) {
+                globalHotkeyManager->synthesizePaste();
+            }
+        });
+    }
+}
+
+void ClipboardManager::registerPasteHotkeys() {
+    unregisterPasteHotkeys();
+    if (hotkeyBindings.isEmpty()) {
+        hotkeyBindings.resize(1);
+    }
+    for (const HotkeyBinding &binding : pasteHotkeyBindings) {
+        hotkeyBindings.append(binding);
+    }
+
+    if (!globalHotkeyManager) {
+        return;
+    }
+    for (int id = 1; id < hotkeyBindings.size(); ++id) {
+        if (!globalHotkeyManager->registerHotkey(hotkeyBindings[id].keySequence, id)) {
+            qWarning() << "Failed to register paste hotkey:" << hotkeyBindings[id].keySequence.toString();
+        }
+    }
+}
+
+void ClipboardManager::unregisterPasteHotkeys() {
+    if (globalHotkeyManager) {
+        for (int id = 1; id < hotkeyBindings.size(); ++id) {
+            globalHotkeyManager->unregisterHotkey(id);
+        }
+    }
+    if (hotkeyBindings.size() > 1) {
+        hotkeyBindings.resize(1);
+    }
+}
+
+QList<ClipboardManager::HotkeyBinding> ClipboardManager::defaultPasteHotkeyBindings() {
+    QList<HotkeyBinding> bindings;
+    for (int i = 0; i < 9; ++i) {
+        HotkeyBinding binding;
+        binding.keySequence = QKeySequence(QString("Ctrl+Alt+%1").arg(i + 1));
+        binding.action = HotkeyAction::PasteEntry;
+        binding.entryIndex = i;
+        bindings.append(binding);
+    }
+    return bindings;
 }
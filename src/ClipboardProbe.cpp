@@ -0,0 +1,417 @@
+#include "../include/ClipboardProbe.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QVector>
+
+#ifdef Q_OS_MAC
+#include <ApplicationServices/ApplicationServices.h>
+#endif
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <poll.h>
+
+namespace {
+// Owners answer TIMESTAMP/TARGETS from their event loop; a hung owner must not stall polling
+const int kReplyTimeoutMs = 50;
+
+// An owner destroyed before its lookup finished; trapped instead of letting
+// the default handler terminate the process
+bool lookupFailed = false;
+
+int lookupErrorHandler(Display *display, XErrorEvent *error) {
+    Q_UNUSED(display)
+    Q_UNUSED(error)
+    lookupFailed = true;
+    return 0;
+}
+}
+#endif
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_WIN)
+namespace {
+// Owners whose destruction went unnoticed can't pile up past this
+const int kMaxCachedSources = 256;
+}
+#endif
+
+struct ClipboardProbe::Platform {
+#ifdef Q_OS_MAC
+    PasteboardRef pasteboard = nullptr;
+    quint64 changeCount = 0;
+#endif
+
+#ifdef Q_OS_WIN
+    // By owner window, with the process it belonged to when looked up
+    QHash<quintptr, Source> sources;
+
+    Source sourceOf(HWND owner);
+#endif
+
+#ifdef Q_OS_LINUX
+    Display *display = nullptr;
+    Window window = 0;
+    Atom clipboardAtom = 0;
+    Atom timestampAtom = 0;
+    Atom targetsAtom = 0;
+    Atom propertyAtom = 0;
+    QVector<Atom> textTargets;
+    QVector<Atom> fileTargets;
+    Atom concealedTarget = 0;
+    Atom pidAtom = 0;
+    Atom clientLeaderAtom = 0;
+
+    // By owner window; an entry goes when the server reports its window destroyed
+    QHash<Window, Source> sources;
+    // Formats can only change with the owner stamp, so TARGETS is asked once per change
+    struct Cached {
+        Window owner = 0;
+        quint64 stamp = 0;
+        bool hasText = true;
+        bool hasFiles = true;
+        bool concealed = false;
+        bool valid = false;
+    };
+    Cached cached[2];
+
+    bool convert(Atom selection, Atom target, QVector<long> *values);
+    QByteArray property(Window window, Atom name, Atom type);
+    long longProperty(Window window, Atom name, Atom type);
+    Source sourceOf(Window owner);
+    void forgetDestroyed();
+#endif
+};
+
+bool ClipboardProbe::Source::matches(const QStringList &apps) const {
+    for (const QString &name : apps) {
+        if ((!app.isEmpty() && app.compare(name, Qt::CaseInsensitive) == 0)
+            || (!instance.isEmpty() && instance.compare(name, Qt::CaseInsensitive) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef Q_OS_LINUX
+bool ClipboardProbe::Platform::convert(Atom selection, Atom target, QVector<long> *values) {
+    XDeleteProperty(display, window, propertyAtom);
+    XConvertSelection(display, selection, target, propertyAtom, window, CurrentTime);
+    XFlush(display);
+
+    QElapsedTimer timer;
+    timer.start();
+    XEvent event;
+    while (true) {
+        while (XCheckTypedWindowEvent(display, window, SelectionNotify, &event)) {
+            // Skip late replies to an earlier request that timed out
+            if (event.xselection.selection != selection || event.xselection.target != target) {
+                continue;
+            }
+            if (event.xselection.property == None) {
+                return false;   // owner doesn't support this target
+            }
+            Atom type = 0;
+            int format = 0;
+            unsigned long count = 0;
+            unsigned long remaining = 0;
+            unsigned char *data = nullptr;
+            if (XGetWindowProperty(display, window, propertyAtom, 0, 1024, True, AnyPropertyType,
+                                   &type, &format, &count, &remaining, &data) != Success) {
+                return false;
+            }
+            bool ok = data && format == 32;
+            if (ok) {
+                // Xlib hands format-32 items back as longs
+                const long *items = reinterpret_cast<const long *>(data);
+                for (unsigned long i = 0; i < count; ++i) {
+                    values->append(items[i]);
+                }
+            }
+            if (data) {
+                XFree(data);
+            }
+            return ok;
+        }
+
+        int waitMs = kReplyTimeoutMs - int(timer.elapsed());
+        if (waitMs <= 0) {
+            return false;
+        }
+        pollfd fd;
+        fd.fd = ConnectionNumber(display);
+        fd.events = POLLIN;
+        fd.revents = 0;
+        poll(&fd, 1, waitMs);
+    }
+}
+
+// Raw property data of the given type; empty when unset or the window is gone
+QByteArray ClipboardProbe::Platform::property(Window window, Atom name, Atom type) {
+    Atom actualType = 0;
+    int format = 0;
+    unsigned long count = 0;
+    unsigned long remaining = 0;
+    unsigned char *data = nullptr;
+    QByteArray value;
+    if (XGetWindowProperty(display, window, name, 0, 256, False, type,
+                           &actualType, &format, &count, &remaining, &data) == Success && data) {
+        if (actualType == type) {
+            // Xlib hands format-32 items back as longs
+            const unsigned long itemSize = format == 32 ? sizeof(long) : unsigned(format / 8);
+            value = QByteArray(reinterpret_cast<const char *>(data), int(count * itemSize));
+        }
+        XFree(data);
+    }
+    return value;
+}
+
+long ClipboardProbe::Platform::longProperty(Window window, Atom name, Atom type) {
+    const QByteArray value = property(window, name, type);
+    return value.size() >= int(sizeof(long)) ? *reinterpret_cast<const long *>(value.constData()) : 0;
+}
+
+// Who owns the selection, from its window's WM_CLASS and _NET_WM_PID. A few
+// blocking requests the first time an owner is seen, none after that.
+ClipboardProbe::Source ClipboardProbe::Platform::sourceOf(Window owner) {
+    const auto cachedSource = sources.constFind(owner);
+    if (cachedSource != sources.constEnd()) {
+        return cachedSource.value();
+    }
+
+    lookupFailed = false;
+    XErrorHandler previousHandler = XSetErrorHandler(lookupErrorHandler);
+    // Its DestroyNotify tells when the cached result goes stale
+    XSelectInput(display, owner, StructureNotifyMask);
+    QByteArray wmClass = property(owner, XA_WM_CLASS, XA_STRING);
+    long pid = longProperty(owner, pidAtom, XA_CARDINAL);
+    const bool ownerGone = lookupFailed;
+    if (!ownerGone && (wmClass.isEmpty() || pid == 0)) {
+        // Hidden clipboard windows often carry neither; their client leader does
+        const Window leader = Window(longProperty(owner, clientLeaderAtom, XA_WINDOW));
+        if (leader != None && leader != owner) {
+            if (wmClass.isEmpty()) {
+                wmClass = property(leader, XA_WM_CLASS, XA_STRING);
+            }
+            if (pid == 0) {
+                pid = longProperty(leader, pidAtom, XA_CARDINAL);
+            }
+        }
+    }
+    XSetErrorHandler(previousHandler);
+
+    Source source;
+    const QList<QByteArray> names = wmClass.split('\0');     // "instance\0class\0"
+    source.instance = QString::fromLocal8Bit(names.value(0));
+    source.app = QString::fromLocal8Bit(names.value(1));
+    source.pid = pid;
+    if (source.app.isEmpty()) {
+        source.app = source.instance;
+    }
+    if (source.app.isEmpty() && pid > 0) {
+        QFile comm(QString("/proc/%1/comm").arg(pid));
+        if (comm.open(QIODevice::ReadOnly)) {
+            source.app = QString::fromLocal8Bit(comm.readAll().trimmed());
+        }
+    }
+    if (ownerGone) {
+        return source;  // no DestroyNotify will come to drop it
+    }
+    if (sources.size() >= kMaxCachedSources) {
+        sources.clear();
+    }
+    sources.insert(owner, source);
+    qDebug() << "Selection owner" << owner << "is" << source.app << "pid" << source.pid;
+    return source;
+}
+
+// Structure events of the owners looked up; only their destruction matters
+void ClipboardProbe::Platform::forgetDestroyed() {
+    XEvent event;
+    while (XCheckMaskEvent(display, StructureNotifyMask, &event)) {
+        if (event.type == DestroyNotify) {
+            sources.remove(event.xdestroywindow.window);
+        }
+    }
+}
+#endif
+
+#ifdef Q_OS_WIN
+// The owning process's executable name. Window handles are reused, so a
+// cached name holds only while the window still belongs to the same process.
+ClipboardProbe::Source ClipboardProbe::Platform::sourceOf(HWND owner) {
+    Source source;
+    DWORD pid = 0;
+    if (!owner || !GetWindowThreadProcessId(owner, &pid)) {
+        return source;
+    }
+    const auto cachedSource = sources.constFind(quintptr(owner));
+    if (cachedSource != sources.constEnd() && cachedSource->pid == qint64(pid)) {
+        return cachedSource.value();
+    }
+    source.pid = pid;
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (process) {
+        wchar_t path[MAX_PATH];
+        DWORD size = MAX_PATH;
+        if (QueryFullProcessImageNameW(process, 0, path, &size)) {
+            source.app = QFileInfo(QString::fromWCharArray(path, int(size))).completeBaseName();
+            source.instance = source.app;
+        }
+        CloseHandle(process);
+    }
+    if (sources.size() >= kMaxCachedSources) {
+        sources.clear();
+    }
+    sources.insert(quintptr(owner), source);
+    return source;
+}
+#endif
+
+ClipboardProbe::ClipboardProbe()
+    : platform(new Platform) {
+#ifdef Q_OS_MAC
+    if (PasteboardCreate(kPasteboardClipboard, &platform->pasteboard) != noErr) {
+        platform->pasteboard = nullptr;
+        qWarning() << "Clipboard probe unavailable; falling back to reading contents";
+    }
+#endif
+
+#ifdef Q_OS_LINUX
+    // A private connection and an unmapped window to receive SelectionNotify replies
+    platform->display = XOpenDisplay(nullptr);
+    if (!platform->display) {
+        qWarning() << "Clipboard probe unavailable; falling back to reading contents";
+        return;
+    }
+    Display *display = platform->display;
+    platform->window = XCreateSimpleWindow(display, DefaultRootWindow(display), 0, 0, 1, 1, 0, 0, 0);
+    platform->clipboardAtom = XInternAtom(display, "CLIPBOARD", False);
+    platform->timestampAtom = XInternAtom(display, "TIMESTAMP", False);
+    platform->targetsAtom = XInternAtom(display, "TARGETS", False);
+    platform->propertyAtom = XInternAtom(display, "XCLIPY_PROBE", False);
+    platform->textTargets = {
+        XInternAtom(display, "UTF8_STRING", False),
+        XA_STRING,
+        XInternAtom(display, "TEXT", False),
+        XInternAtom(display, "text/plain", False),
+        XInternAtom(display, "text/plain;charset=utf-8", False)
+    };
+    platform->fileTargets = {
+        XInternAtom(display, "text/uri-list", False),
+        XInternAtom(display, "x-special/gnome-copied-files", False)
+    };
+    platform->concealedTarget = XInternAtom(display, "x-kde-passwordManagerHint", False);
+    platform->pidAtom = XInternAtom(display, "_NET_WM_PID", False);
+    platform->clientLeaderAtom = XInternAtom(display, "WM_CLIENT_LEADER", False);
+#endif
+}
+
+ClipboardProbe::~ClipboardProbe() {
+#ifdef Q_OS_MAC
+    if (platform->pasteboard) {
+        CFRelease(platform->pasteboard);
+    }
+#endif
+
+#ifdef Q_OS_LINUX
+    if (platform->display) {
+        XDestroyWindow(platform->display, platform->window);
+        XCloseDisplay(platform->display);
+    }
+#endif
+}
+
+ClipboardProbe::Signature ClipboardProbe::probe(QClipboard::Mode mode) {
+    Signature signature;
+
+#ifdef Q_OS_MAC
+    if (mode != QClipboard::Clipboard || !platform->pasteboard) {
+        return signature;
+    }
+    if (PasteboardSynchronize(platform->pasteboard) & kPasteboardModified) {
+        ++platform->changeCount;
+    }
+    signature.valid = true;
+    signature.stamp = platform->changeCount;
+#endif
+
+#ifdef Q_OS_WIN
+    if (mode != QClipboard::Clipboard) {
+        return signature;
+    }
+    DWORD sequence = GetClipboardSequenceNumber();
+    if (sequence == 0) {
+        return signature;   // no clipboard access from this window station
+    }
+    signature.valid = true;
+    signature.stamp = sequence;
+    signature.owner = quint64(quintptr(GetClipboardOwner()));
+    signature.source = platform->sourceOf(GetClipboardOwner());
+    signature.hasText = IsClipboardFormatAvailable(CF_UNICODETEXT);
+    signature.hasFiles = IsClipboardFormatAvailable(CF_HDROP);
+#endif
+
+#ifdef Q_OS_LINUX
+    if (!platform->display || (mode != QClipboard::Clipboard && mode != QClipboard::Selection)) {
+        return signature;
+    }
+    const bool primary = mode == QClipboard::Selection;
+    const Atom selection = primary ? XA_PRIMARY : platform->clipboardAtom;
+    Platform::Cached &cached = platform->cached[primary ? 1 : 0];
+    platform->forgetDestroyed();
+
+    Window owner = XGetSelectionOwner(platform->display, selection);
+    if (owner == None) {
+        signature.valid = true;
+        signature.hasText = false;
+        signature.hasFiles = false;
+        return signature;
+    }
+    signature.source = platform->sourceOf(owner);
+
+    // Without a TIMESTAMP a re-asserted selection looks unchanged, so let the caller read
+    QVector<long> values;
+    if (!platform->convert(selection, platform->timestampAtom, &values) || values.isEmpty()) {
+        return signature;
+    }
+    signature.valid = true;
+    signature.owner = quint64(owner);
+    signature.stamp = quint64(static_cast<unsigned long>(values.first()));
+
+    if (cached.valid && cached.owner == owner && cached.stamp == signature.stamp) {
+        signature.hasText = cached.hasText;
+        signature.hasFiles = cached.hasFiles;
+        signature.concealed = cached.concealed;
+        return signature;
+    }
+
+    values.clear();
+    if (platform->convert(selection, platform->targetsAtom, &values)) {
+        signature.hasText = false;
+        signature.hasFiles = false;
+        for (long value : values) {
+            Atom target = Atom(value);
+            signature.hasText = signature.hasText || platform->textTargets.contains(target);
+            signature.hasFiles = signature.hasFiles || platform->fileTargets.contains(target);
+            signature.concealed = signature.concealed || target == platform->concealedTarget;
+        }
+    }
+    cached.owner = owner;
+    cached.stamp = signature.stamp;
+    cached.hasText = signature.hasText;
+    cached.hasFiles = signature.hasFiles;
+    cached.concealed = signature.concealed;
+    cached.valid = true;
+#endif
+
+    Q_UNUSED(mode)
+    return signature;
+}
@@ -0,0 +1,488 @@
+#include "../include/ContentClassifier.h"
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QtAlgorithms>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XCLIPY_CLASSIFIER_SSE2 1
+#endif
+
+namespace {
+
+struct MarkerByte {
+    char byte;
+    quint32 marker;
+};
+
+const MarkerByte kMarkerBytes[] = {
+    {':', ContentClassifier::Colon},     {'@', ContentClassifier::At},
+    {'{', ContentClassifier::Brace},     {'}', ContentClassifier::Brace},
+    {'[', ContentClassifier::Bracket},   {']', ContentClassifier::Bracket},
+    {'#', ContentClassifier::Hash},      {'/', ContentClassifier::Slash},
+    {';', ContentClassifier::Semicolon}, {'=', ContentClassifier::Equals},
+    {'(', ContentClassifier::Paren},     {')', ContentClassifier::Paren},
+    {'|', ContentClassifier::Pipe},      {'$', ContentClassifier::Dollar},
+    {'\\', ContentClassifier::Backslash}, {'"', ContentClassifier::Quote},
+    {'\'', ContentClassifier::Quote},    {'.', ContentClassifier::Dot},
+    {'&', ContentClassifier::Ampersand}, {'>', ContentClassifier::Greater},
+};
+const int kMarkerByteCount = int(sizeof(kMarkerBytes) / sizeof(kMarkerBytes[0]));
+
+const qsizetype kMaxJsonParseBytes = 1024 * 1024;
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+bool isAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool isHexDigit(char c) {
+    return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+QByteArrayView trimmed(QByteArrayView utf8) {
+    qsizetype first = 0;
+    qsizetype last = utf8.size();
+    while (first < last && isBlank(utf8.at(first))) {
+        ++first;
+    }
+    while (last > first && isBlank(utf8.at(last - 1))) {
+        --last;
+    }
+    return utf8.sliced(first, last - first);
+}
+
+bool startsWithNoCase(QByteArrayView text, QByteArrayView prefix) {
+    return text.size() >= prefix.size() && qstrnicmp(text.data(), prefix.data(), prefix.size()) == 0;
+}
+
+template <typename F>
+void forEachLine(QByteArrayView text, F f) {
+    qsizetype start = 0;
+    while (start <= text.size()) {
+        qsizetype end = text.indexOf('\n', start);
+        if (end < 0) {
+            end = text.size();
+        }
+        QByteArrayView line = text.sliced(start, end - start);
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if (!f(line)) {
+            return;
+        }
+        start = end + 1;
+    }
+}
+
+// scheme://rest, or www.host
+bool isUrl(QByteArrayView token) {
+    if (startsWithNoCase(token, "www.") && token.size() > 4) {
+        return token.indexOf('.', 4) > 4;
+    }
+    const qsizetype separator = token.indexOf("://");
+    if (separator <= 0 || separator + 3 >= token.size() || !isAlpha(token.at(0))) {
+        return false;
+    }
+    for (qsizetype i = 1; i < separator; ++i) {
+        const char c = token.at(i);
+        if (!isAlpha(c) && !isDigit(c) && c != '+' && c != '.' && c != '-') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isEmail(QByteArrayView token) {
+    if (startsWithNoCase(token, "mailto:")) {
+        token = token.sliced(7);
+    }
+    const qsizetype at = token.indexOf('@');
+    if (at <= 0 || at != token.lastIndexOf('@') || at + 1 >= token.size()) {
+        return false;
+    }
+    for (qsizetype i = 0; i < at; ++i) {
+        const char c = token.at(i);
+        if (!isAlpha(c) && !isDigit(c) && c != '.' && c != '_' && c != '%' && c != '+' && c != '-') {
+            return false;
+        }
+    }
+    const QByteArrayView domain = token.sliced(at + 1);
+    const qsizetype dot = domain.lastIndexOf('.');
+    if (dot <= 0 || dot + 2 > domain.size() || domain.startsWith('.') || domain.startsWith('-')) {
+        return false;
+    }
+    for (char c : domain) {
+        if (!isAlpha(c) && !isDigit(c) && c != '.' && c != '-') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isJson(QByteArrayView text, quint32 markers) {
+    const bool object = text.startsWith('{') && text.endsWith('}');
+    const bool array = text.startsWith('[') && text.endsWith(']');
+    if (!object && !array) {
+        return false;
+    }
+    if (object && !(markers & ContentClassifier::Quote)) {
+        return false;   // JSON keys are quoted
+    }
+    if (text.size() > kMaxJsonParseBytes) {
+        // Too big to parse at capture; the brackets and markers will do
+        return markers & ContentClassifier::Colon;
+    }
+    QJsonParseError error;
+    QJsonDocument::fromJson(text.toByteArray(), &error);
+    return error.error == QJsonParseError::NoError;
+}
+
+// #rgb, #rgba, #rrggbb, #rrggbbaa, or a CSS rgb()/hsl() function
+bool isColor(QByteArrayView token) {
+    if (token.startsWith('#')) {
+        const qsizetype digits = token.size() - 1;
+        if (digits != 3 && digits != 4 && digits != 6 && digits != 8) {
+            return false;
+        }
+        for (qsizetype i = 1; i < token.size(); ++i) {
+            if (!isHexDigit(token.at(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (!token.endsWith(')') || token.size() > 64) {
+        return false;
+    }
+    for (const char *function : {"rgb(", "rgba(", "hsl(", "hsla("}) {
+        if (startsWithNoCase(token, function)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isPathLine(QByteArrayView line) {
+    if (line.startsWith("file://")) {
+        return line.size() > 7;
+    }
+    const bool windows = line.size() > 2 && isAlpha(line.at(0)) && line.at(1) == ':'
+                         && (line.at(2) == '\\' || line.at(2) == '/');
+    const bool posix = (line.startsWith('/') && line.size() > 1) || line.startsWith("~/")
+                       || line.startsWith("./") || line.startsWith("../");
+    if (!windows && !posix) {
+        return false;
+    }
+    // "/usr/bin/foo --flag" is a command, "/a | b" a pipeline
+    for (qsizetype i = 0; i + 1 < line.size(); ++i) {
+        if (line.at(i) == ' ' && (line.at(i + 1) == '-' || line.at(i + 1) == '|' || line.at(i + 1) == '>')) {
+            return false;
+        }
+    }
+    return line.indexOf("://") < 0;
+}
+
+bool isFilePaths(QByteArrayView text, const ContentClassifier::Profile &profile) {
+    if (!(profile.markers & (ContentClassifier::Slash | ContentClassifier::Backslash)) || profile.lines > 256) {
+        return false;
+    }
+    bool any = false;
+    bool all = true;
+    forEachLine(text, [&any, &all](QByteArrayView line) {
+        line = trimmed(line);
+        if (line.isEmpty()) {
+            return true;
+        }
+        any = true;
+        all = isPathLine(line);
+        return all;
+    });
+    return any && all;
+}
+
+bool isCommand(QByteArrayView text, const ContentClassifier::Profile &profile) {
+    if (profile.lines > 1) {
+        // Only a command continued with backslashes spans lines
+        bool continued = true;
+        int line = 0;
+        forEachLine(text, [&continued, &line, &profile](QByteArrayView part) {
+            if (++line < profile.lines && !trimmed(part).endsWith('\\')) {
+                continued = false;
+            }
+            return continued;
+        });
+        if (!continued) {
+            return false;
+        }
+    }
+    if (text.startsWith("$ ") || text.startsWith("% ")) {
+        text = trimmed(text.sliced(2));
+    }
+    qsizetype end = 0;
+    while (end < text.size() && !isBlank(text.at(end))) {
+        ++end;
+    }
+    const QByteArrayView word = text.first(end);
+    if (word.isEmpty()) {
+        return false;
+    }
+    static const char *const kCommands[] = {
+        "sudo", "git", "cd", "ls", "cp", "mv", "rm", "mkdir", "cat", "grep", "rg", "find", "docker",
+        "podman", "kubectl", "helm", "npm", "npx", "yarn", "pnpm", "pip", "pip3", "python", "python3",
+        "node", "make", "cmake", "ninja", "ssh", "scp", "rsync", "curl", "wget", "chmod", "chown",
+        "tar", "unzip", "systemctl", "journalctl", "apt", "apt-get", "dnf", "yum", "pacman", "brew",
+        "echo", "export", "source", "go", "cargo", "rustup", "gcc", "g++", "clang", "ctest", "sed",
+        "awk", "ps", "kill", "pkill", "less", "tail", "head", "xargs", "ping", "ln", "touch", "gh",
+        "terraform", "ansible", "xdg-open", "flatpak", "snap", "ffmpeg", "openssl", "dig", "nc",
+    };
+    for (const char *command : kCommands) {
+        if (word == QByteArrayView(command)) {
+            return true;
+        }
+    }
+    // An unknown program, but written like a command line
+    if (profile.blanks == 0) {
+        return false;
+    }
+    for (char c : word) {
+        if (!(c >= 'a' && c <= 'z') && !isDigit(c) && c != '-' && c != '_' && c != '.' && c != '/') {
+            return false;
+        }
+    }
+    return text.indexOf(" | ") >= 0 || text.indexOf(" && ") >= 0 || text.indexOf(" || ") >= 0
+           || text.indexOf(" --") >= 0 || text.indexOf(" > ") >= 0;
+}
+
+bool isCode(QByteArrayView text, const ContentClassifier::Profile &profile) {
+    int score = 0;
+    if ((profile.markers & ContentClassifier::Brace) && (profile.markers & ContentClassifier::Semicolon)) {
+        score += 2;
+    }
+    if (profile.lines < 2) {
+        // One-liners need more to tell them from prose
+        return score >= 2 && (profile.markers & ContentClassifier::Paren) && text.endsWith(';');
+    }
+
+    static const char *const kKeywords[] = {
+        "def ", "class ", "function ", "#include", "import ", "from ", "const ", "let ", "var ",
+        "return", "if (", "for (", "while (", "public ", "private ", "fn ", "func ", "package ",
+        "using ", "int ", "void ", "struct ", "#define", "async ", "SELECT ", "template",
+    };
+    int statementEnds = 0;
+    int blockLines = 0;
+    int indented = 0;
+    int keywords = 0;
+    forEachLine(text, [&](QByteArrayView line) {
+        if (line.startsWith(' ') || line.startsWith('\t')) {
+            ++indented;
+        }
+        line = trimmed(line);
+        if (line.endsWith(';')) {
+            ++statementEnds;
+        } else if (line.endsWith('{') || line.endsWith('}') || line.endsWith(':')) {
+            ++blockLines;
+        }
+        for (const char *keyword : kKeywords) {
+            if (line.startsWith(QByteArrayView(keyword))) {
+                ++keywords;
+                break;
+            }
+        }
+        return true;
+    });
+    score += qMin(statementEnds, 2) + qMin(blockLines, 2) + qMin(keywords, 3);
+    if (indented >= 2) {
+        ++score;
+    }
+    if (text.indexOf("=>") >= 0 || text.indexOf("->") >= 0 || text.indexOf("::") >= 0
+        || text.indexOf("==") >= 0 || text.indexOf("!=") >= 0) {
+        ++score;
+    }
+    return score >= 4;
+}
+
+double entropyBitsPerByte(QByteArrayView token) {
+    int counts[256] = {};
+    for (char c : token) {
+        ++counts[quint8(c)];
+    }
+    double bits = 0;
+    for (int count : counts) {
+        if (count > 0) {
+            const double p = double(count) / token.size();
+            bits -= p * std::log2(p);
+        }
+    }
+    return bits;
+}
+
+// API keys, access tokens and private keys: things a user would rather not
+// see in plain text in a history list
+bool isSecret(QByteArrayView text, const ContentClassifier::Profile &profile) {
+    if (text.startsWith("-----BEGIN ") && text.indexOf("PRIVATE KEY-----") > 0) {
+        return true;
+    }
+    if (profile.lines != 1 || profile.blanks != 0 || !profile.ascii || text.size() < 16 || text.size() > 512) {
+        return false;
+    }
+    static const char *const kPrefixes[] = {
+        "ghp_", "gho_", "ghu_", "ghs_", "ghr_", "github_pat_", "glpat-", "sk-", "sk_live_",
+        "rk_live_", "xoxb-", "xoxp-", "xoxa-", "xapp-", "AKIA", "ASIA", "AIza", "npm_", "pypi-",
+    };
+    for (const char *prefix : kPrefixes) {
+        if (text.startsWith(QByteArrayView(prefix))) {
+            return true;
+        }
+    }
+    // A JWT: three base64url parts, the first a JSON header
+    if (text.startsWith("eyJ") && text.count('.') == 2) {
+        return true;
+    }
+
+    bool lower = false;
+    bool upper = false;
+    bool digit = false;
+    for (char c : text) {
+        if (c >= 'a' && c <= 'z') {
+            lower = true;
+        } else if (c >= 'A' && c <= 'Z') {
+            upper = true;
+        } else if (isDigit(c)) {
+            digit = true;
+        } else if (c != '+' && c != '/' && c != '=' && c != '_' && c != '-' && c != '.' && c != '~') {
+            return false;
+        }
+    }
+    return text.size() >= 20 && digit && (lower && upper) && entropyBitsPerByte(text) >= 3.5;
+}
+
+}
+
+ContentClassifier::Profile ContentClassifier::profileScalar(QByteArrayView utf8) {
+    static quint32 table[256];
+    static bool tableReady = [] {
+        for (const MarkerByte &marker : kMarkerBytes) {
+            table[quint8(marker.byte)] |= marker.marker;
+        }
+        return true;
+    }();
+    Q_UNUSED(tableReady)
+
+    Profile result;
+    const qsizetype size = qMin<qsizetype>(utf8.size(), kScanBytes);
+    int newlines = 0;
+    quint8 high = 0;
+    for (qsizetype i = 0; i < size; ++i) {
+        const quint8 c = quint8(utf8.at(i));
+        result.markers |= table[c];
+        newlines += c == '\n';
+        result.blanks += c == ' ' || c == '\t';
+        high |= c;
+    }
+    result.lines = newlines + 1;
+    result.ascii = high < 0x80;
+    return result;
+}
+
+ContentClassifier::Profile ContentClassifier::profile(QByteArrayView utf8) {
+#ifdef XCLIPY_CLASSIFIER_SSE2
+    const qsizetype size = qMin<qsizetype>(utf8.size(), kScanBytes);
+    const char *data = utf8.data();
+    __m128i seen[kMarkerByteCount];
+    for (__m128i &s : seen) {
+        s = _mm_setzero_si128();
+    }
+    __m128i high = _mm_setzero_si128();
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    int newlines = 0;
+    int blanks = 0;
+    qsizetype i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        for (int m = 0; m < kMarkerByteCount; ++m) {
+            seen[m] = _mm_or_si128(seen[m], _mm_cmpeq_epi8(v, _mm_set1_epi8(kMarkerBytes[m].byte)));
+        }
+        high = _mm_or_si128(high, v);
+        newlines += qPopulationCount(quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline))));
+        blanks += qPopulationCount(quint32(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)))));
+    }
+
+    // The tail is shorter than a vector
+    Profile result = profileScalar(QByteArrayView(data + i, size - i));
+    for (int m = 0; m < kMarkerByteCount; ++m) {
+        if (_mm_movemask_epi8(seen[m]) != 0) {
+            result.markers |= kMarkerBytes[m].marker;
+        }
+    }
+    result.lines += newlines;
+    result.blanks += blanks;
+    result.ascii = result.ascii && _mm_movemask_epi8(high) == 0;
+    return result;
+#else
+    return profileScalar(utf8);
+#endif
+}
+
+ContentClassifier::Kinds ContentClassifier::classify(QByteArrayView utf8) {
+    const QByteArrayView text = trimmed(utf8);
+    if (text.isEmpty()) {
+        return Classified;
+    }
+    const Profile p = profile(text);
+    // Line-by-line checks look at the scanned head only
+    const QByteArrayView head = text.first(qMin<qsizetype>(text.size(), kScanBytes));
+    const bool token = p.lines == 1 && p.blanks == 0;
+    Kinds kinds = Classified;
+
+    if (token && (p.markers & (Colon | Dot)) && isUrl(text)) {
+        kinds |= Url;
+    }
+    if (token && (p.markers & At) && (p.markers & Dot) && isEmail(text)) {
+        kinds |= Email;
+    }
+    if ((p.markers & (Brace | Bracket)) && isJson(text, p.markers)) {
+        kinds |= Json;
+    }
+    if (text.size() <= 64 && p.lines == 1 && (p.markers & (Hash | Paren)) && isColor(text)) {
+        kinds |= Color;
+    }
+    if (!(kinds & (Url | Email)) && text.size() == head.size() && isFilePaths(text, p)) {
+        kinds |= FilePath;
+    }
+    if (!(kinds & (Json | FilePath)) && p.lines <= 8 && text.size() <= 4096 && isCommand(text, p)) {
+        kinds |= Command;
+    }
+    if (!(kinds & (Json | Command)) && (p.markers & (Semicolon | Brace | Colon | Paren | Equals)) && isCode(head, p)) {
+        kinds |= Code;
+    }
+    if (!(kinds & (Url | Email | FilePath | Color)) && isSecret(text, p)) {
+        kinds |= Secret;
+    }
+    return kinds;
+}
+
+QString ContentClassifier::kindName(Kind kind) {
+    switch (kind) {
+    case Url: return "URLs";
+    case Email: return "Email addresses";
+    case Json: return "JSON";
+    case Color: return "Colors";
+    case Code: return "Code";
+    case Command: return "Shell commands";
+    case FilePath: return "File paths";
+    case Secret: return "Secrets";
+    }
+    return QString();
+}
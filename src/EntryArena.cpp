@@ -0,0 +1,180 @@
+#include "../include/EntryArena.h"
+#include "../include/MemoryAccounting.h"
+#include <QHash>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+namespace {
+std::atomic<qint64> slabCount{0};
+}
+
+struct Utf8Entry::Slab {
+    std::atomic<int> refs{1};
+    int capacity = 0;
+    int used = 0;
+
+    char *bytes() { return reinterpret_cast<char *>(this + 1); }
+
+    static Slab *create(int capacity) {
+        void *memory = ::operator new(sizeof(Slab) + size_t(capacity));
+        Slab *slab = new (memory) Slab;
+        slab->capacity = capacity;
+        MemoryAccounting::add(MemoryAccounting::Subsystem::EntryPayloads, qint64(sizeof(Slab)) + capacity);
+        ++slabCount;
+        return slab;
+    }
+
+    void ref() {
+        refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void deref() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            MemoryAccounting::add(MemoryAccounting::Subsystem::EntryPayloads, -(qint64(sizeof(Slab)) + capacity));
+            --slabCount;
+            this->~Slab();
+            ::operator delete(this);
+        }
+    }
+};
+
+Utf8Entry::Utf8Entry(const Utf8Entry &other)
+    : slab(other.slab), data(other.data), length(other.length), hashValue(other.hashValue) {
+    if (slab) {
+        slab->ref();
+    }
+}
+
+Utf8Entry::Utf8Entry(Utf8Entry &&other) noexcept
+    : slab(other.slab), data(other.data), length(other.length), hashValue(other.hashValue) {
+    other.slab = nullptr;
+    other.data = nullptr;
+    other.length = 0;
+}
+
+Utf8Entry &Utf8Entry::operator=(Utf8Entry other) noexcept {
+    std::swap(slab, other.slab);
+    std::swap(data, other.data);
+    std::swap(length, other.length);
+    std::swap(hashValue, other.hashValue);
+    return *this;
+}
+
+Utf8Entry::~Utf8Entry() {
+    if (slab) {
+        slab->deref();
+    }
+}
+
+bool Utf8Entry::equals(QByteArrayView utf8, quint32 utf8Hash) const {
+    return hashValue == utf8Hash && length == utf8.size()
+        && std::memcmp(data, utf8.data(), size_t(length)) == 0;
+}
+
+QString Utf8Entry::toString() const {
+    return QString::fromUtf8(data, length);
+}
+
+QString Utf8Entry::preview(int maxLines, int maxBytes, bool *truncated) const {
+    const char *end = data + length;
+    const char *limit = data + qMin(length, qMax(0, maxBytes));
+    const char *cut = end;
+    int lines = 0;
+    bool inLine = false;
+    for (const char *c = data; c < limit; ++c) {
+        if (*c == '\n') {
+            inLine = false;
+        } else if (!inLine) {
+            inLine = true;
+            if (++lines > maxLines) {
+                cut = c;
+                break;
+            }
+        }
+    }
+    if (cut == end && limit < end) {
+        cut = limit;
+    }
+    // Never split a multi-byte sequence
+    while (cut > data && cut < end && (uchar(*cut) & 0xC0) == 0x80) {
+        --cut;
+    }
+    if (truncated) {
+        *truncated = cut < end;
+    }
+    return QString::fromUtf8(data, cut - data);
+}
+
+quint32 Utf8Entry::hashOf(QByteArrayView utf8) {
+    return quint32(qHash(utf8));
+}
+
+EntryArena::EntryArena(int slabSize)
+    : slabSize(qMax(4096, slabSize)) {
+}
+
+EntryArena::~EntryArena() {
+    if (current) {
+        current->deref();
+    }
+}
+
+Utf8Entry EntryArena::store(QByteArrayView utf8, quint32 hash) {
+    const int size = int(utf8.size());
+    Utf8Entry::Slab *slab = nullptr;
+    if (size > slabSize / 4) {
+        // Large bodies get an exact-fit slab so they don't pin a shared one
+        slab = Utf8Entry::Slab::create(size);
+    } else {
+        if (!current || current->capacity - current->used < size) {
+            if (current) {
+                current->deref();
+            }
+            current = Utf8Entry::Slab::create(slabSize);
+        }
+        slab = current;
+        slab->ref();
+    }
+
+    // Bytes before `used` are immutable, so readers never see a write in progress
+    char *target = slab->bytes() + slab->used;
+    if (size > 0) {
+        std::memcpy(target, utf8.data(), size_t(size));
+    }
+    slab->used += size;
+
+    Utf8Entry entry;
+    entry.slab = slab;
+    entry.data = target;
+    entry.length = size;
+    entry.hashValue = hash;
+    return entry;
+}
+
+Utf8Entry EntryArena::store(const QString &text) {
+    const QByteArray utf8 = text.toUtf8();
+    return store(utf8, Utf8Entry::hashOf(utf8));
+}
+
+Utf8Entry EntryArena::restore(const Utf8Entry &entry) {
+    if (!sharedSlabOf(entry)) {
+        return entry;
+    }
+    return store(entry.bytes(), entry.hash());
+}
+
+const void *EntryArena::sharedSlabOf(const Utf8Entry &entry) const {
+    if (!entry.slab || entry.slab == current || entry.slab->capacity != slabSize) {
+        return nullptr;
+    }
+    return entry.slab;
+}
+
+qint64 EntryArena::allocatedBytes() {
+    return MemoryAccounting::current(MemoryAccounting::Subsystem::EntryPayloads);
+}
+
+qint64 EntryArena::liveSlabCount() {
+    return slabCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,150 @@
+#include "../include/ExpiryIndex.h"
+#include "../include/MemoryAccounting.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+namespace {
+const quint32 kExpiryMagic = 0x58434550;   // "XCEP"
+const quint32 kExpiryVersion = 1;
+}
+
+ExpiryIndex::ExpiryIndex()
+    : wheel(now()) {
+}
+
+qint64 ExpiryIndex::now() {
+    return QDateTime::currentSecsSinceEpoch();
+}
+
+void ExpiryIndex::setPolicy(qint64 maxAgeSeconds, qint64 concealedSeconds) {
+    if (maxAgeSeconds == maxAge && concealedSeconds == concealedLifetime) {
+        return;
+    }
+    maxAge = qMax<qint64>(0, maxAgeSeconds);
+    concealedLifetime = qMax<qint64>(0, concealedSeconds);
+    reschedule();
+}
+
+void ExpiryIndex::track(quint32 hash, bool concealed, qint64 time) {
+    Entry &entry = entries[hash];
+    entry.capturedAt = time;
+    entry.concealed = entry.concealed || concealed;
+    schedule(hash, entry);
+}
+
+void ExpiryIndex::seed(quint32 hash, qint64 time) {
+    if (!entries.contains(hash)) {
+        track(hash, false, time);
+    }
+}
+
+void ExpiryIndex::clear() {
+    entries.clear();
+    wheel.reset(now());
+}
+
+qint64 ExpiryIndex::deadlineOf(const Entry &entry) const {
+    qint64 deadline = maxAge > 0 ? entry.capturedAt + maxAge : -1;
+    if (entry.concealed && concealedLifetime > 0) {
+        const qint64 concealedDeadline = entry.capturedAt + concealedLifetime;
+        deadline = deadline < 0 ? concealedDeadline : qMin(deadline, concealedDeadline);
+    }
+    return deadline;
+}
+
+void ExpiryIndex::schedule(quint32 hash, const Entry &entry) {
+    // An earlier timer for the same entry stays in the wheel; takeExpired
+    // skips it because its deadline is no longer the entry's
+    const qint64 deadline = deadlineOf(entry);
+    if (deadline >= 0) {
+        wheel.schedule(hash, deadline);
+    }
+}
+
+void ExpiryIndex::reschedule() {
+    wheel.reset(now());
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        schedule(it.key(), it.value());
+    }
+}
+
+QVector<quint32> ExpiryIndex::takeExpired(qint64 time) {
+    QVector<TimerWheel::Timer> fired;
+    wheel.advance(time, &fired);
+    QVector<quint32> expired;
+    for (const TimerWheel::Timer &timer : fired) {
+        auto it = entries.find(timer.key);
+        if (it != entries.end() && deadlineOf(it.value()) == timer.deadline) {
+            expired.append(timer.key);
+            entries.erase(it);
+        }
+    }
+    return expired;
+}
+
+qint64 ExpiryIndex::msUntilNext() const {
+    const qint64 deadline = wheel.nextDeadline();
+    if (deadline < 0) {
+        return -1;
+    }
+    return qMax<qint64>(0, deadline * 1000 - QDateTime::currentMSecsSinceEpoch());
+}
+
+bool ExpiryIndex::load(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::BigEndian);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != kExpiryMagic || version != kExpiryVersion) {
+        qWarning() << "Ignoring expiry file with unknown format:" << path;
+        return false;
+    }
+    QHash<quint32, Entry> loaded;
+    loaded.reserve(int(qMin(count, quint32(1 << 20))));
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint32 hash = 0;
+        Entry entry;
+        quint8 concealed = 0;
+        stream >> hash >> entry.capturedAt >> concealed;
+        entry.concealed = concealed != 0;
+        loaded.insert(hash, entry);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Expiry file is truncated; entries are aged from now:" << path;
+        return false;
+    }
+    entries = loaded;
+    reschedule();
+    return true;
+}
+
+bool ExpiryIndex::save(const QString &path) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write expiry file:" << path << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream << kExpiryMagic << kExpiryVersion << quint32(entries.size());
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        stream << it.key() << it.value().capturedAt << quint8(it.value().concealed ? 1 : 0);
+    }
+    return file.commit();
+}
+
+qint64 ExpiryIndex::memoryBytes() const {
+    return MemoryAccounting::hashBytes(entries) + wheel.memoryBytes();
+}
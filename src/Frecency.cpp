@@ -0,0 +1,108 @@
+#include "../include/Frecency.h"
+#include "../include/MemoryAccounting.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <cmath>
+
+namespace {
+
+const quint32 kFrecencyMagic = 0x58434652;  // "XCFR"
+const quint32 kFrecencyVersion = 1;
+const qint64 kEpochSecs = 1704067200;       // 2024-01-01T00:00:00Z
+
+// log2(2^a + 2^b) without leaving float range for large keys
+double logAdd(double a, double b) {
+    const double high = qMax(a, b);
+    return high + std::log2(1.0 + std::exp2(qMin(a, b) - high));
+}
+
+}
+
+double FrecencyIndex::now() {
+    return double(QDateTime::currentSecsSinceEpoch() - kEpochSecs) / (kHalfLifeHours * 3600.0);
+}
+
+float FrecencyIndex::bump(quint32 hash, double time, double weight) {
+    const double use = time + std::log2(weight);
+    auto it = keys.find(hash);
+    if (it == keys.end()) {
+        return keys.insert(hash, float(use)).value();
+    }
+    it.value() = float(logAdd(it.value(), use));
+    return it.value();
+}
+
+float FrecencyIndex::seed(quint32 hash, double time) {
+    auto it = keys.find(hash);
+    if (it == keys.end()) {
+        it = keys.insert(hash, float(time));
+    }
+    return it.value();
+}
+
+float FrecencyIndex::merge(quint32 hash, float key) {
+    auto it = keys.find(hash);
+    if (it == keys.end()) {
+        return keys.insert(hash, key).value();
+    }
+    it.value() = qMax(it.value(), key);
+    return it.value();
+}
+
+bool FrecencyIndex::load(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != kFrecencyMagic || version != kFrecencyVersion) {
+        qWarning() << "Ignoring frecency file with unknown format:" << path;
+        return false;
+    }
+    QHash<quint32, float> loaded;
+    loaded.reserve(int(qMin(count, quint32(1 << 20))));
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint32 hash = 0;
+        float key = 0;
+        stream >> hash >> key;
+        loaded.insert(hash, key);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Frecency file is truncated; starting from capture order:" << path;
+        return false;
+    }
+    keys = loaded;
+    return true;
+}
+
+bool FrecencyIndex::save(const QString &path) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write frecency file:" << path << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream << kFrecencyMagic << kFrecencyVersion << quint32(keys.size());
+    for (auto it = keys.constBegin(); it != keys.constEnd(); ++it) {
+        stream << it.key() << it.value();
+    }
+    return file.commit();
+}
+
+qint64 FrecencyIndex::memoryBytes() const {
+    return MemoryAccounting::hashBytes(keys);
+}
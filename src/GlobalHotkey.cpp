@@ -3,6 +3,29 @@
 #include <QDebug>
 #include <QKeyEvent>
 #include <QKeyCombination>
+#include <QSocketNotifier>
+
+#ifdef Q_OS_LINUX
+#ifdef XCLIPY_HAVE_XTEST
+#include <X11/extensions/XTest.h>
+#endif
+
+namespace {
+// Lock modifiers that must not affect hotkey matching (CapsLock, NumLock)
+const unsigned int kLockMasks[] = { 0, LockMask, Mod2Mask, LockMask | Mod2Mask };
+const unsigned int kHotkeyModifierMask = ControlMask | ShiftMask | Mod1Mask | Mod4Mask;
+
+bool grabFailed = false;
+
+int grabErrorHandler(Display *display, XErrorEvent *error) {
+    Q_UNUSED(display)
+    if (error->error_code == BadAccess) {
+        grabFailed = true;
+    }
+    return 0;
+}
+}
+#endif
 
 #ifdef Q_OS_WIN
 GlobalHotkey *GlobalHotkey::instance = nullptr;
@@ -18,7 +41,7 @@ GlobalHotkey::GlobalHotkey(QObject *parent)
     , hwnd(nullptr), nextHotkeyId(1)
 #endif
 #ifdef Q_OS_LINUX
-    , display(nullptr), rootWindow(0)
+    , display(nullptr), rootWindow(0), eventNotifier(nullptr)
 #endif
 {
 #ifdef Q_OS_MAC
@@ -67,6 +90,13 @@ GlobalHotkey::GlobalHotkey(QObject *parent)
     if (display) {
         rootWindow = DefaultRootWindow(display);
         initialized = true;
+
+        // Key events for our grabs arrive on this private connection, so pump it
+        // from the Qt event loop whenever the socket becomes readable
+        eventNotifier = new QSocketNotifier(ConnectionNumber(display), QSocketNotifier::Read, this);
+        connect(eventNotifier, &QSocketNotifier::activated, this, [this]() {
+            processXEvents();
+        });
     } else {
         qWarning() << "Failed to open X11 display for global hotkeys";
     }
@@ -90,6 +120,7 @@ GlobalHotkey::~GlobalHotkey() {
 #endif
 
 #ifdef Q_OS_LINUX
+    delete eventNotifier;
     if (display) {
         XCloseDisplay(display);
     }
@@ -129,6 +160,7 @@ bool GlobalHotkey::registerHotkey(const QKeySequence &keySequence, int id) {
     
     if (status == noErr) {
         info.registered = true;
+        info.ref = hotKeyRef;
         hotkeys[id] = info;
         qDebug() << "Registered global hotkey:" << keySequence.toString() << "with ID:" << id;
         return true;
@@ -190,18 +222,35 @@ bool GlobalHotkey::registerHotkey(const QKeySequence &keySequence, int id) {
     int key = keyCombo.key();
     Qt::KeyboardModifiers modifiers = keyCombo.keyboardModifiers();
     
-    int xKeyCode = keyCodeForQtKey(key);
-    int xModifiers = modifierFlagsForQtModifiers(modifiers);
+    unsigned int xKeyCode = XKeysymToKeycode(display, keyCodeForQtKey(key));
+    unsigned int xModifiers = modifierFlagsForQtModifiers(modifiers);
+    if (xKeyCode == 0) {
+        qWarning() << "No X11 keycode for hotkey:" << keySequence.toString();
+        return false;
+    }
     
-    int status = XGrabKey(display, xKeyCode, xModifiers, rootWindow, 
-                         True, GrabModeAsync, GrabModeAsync);
+    // Grab errors are reported asynchronously; trap BadAccess instead of letting
+    // the default handler terminate the process
+    grabFailed = false;
+    XErrorHandler previousHandler = XSetErrorHandler(grabErrorHandler);
+    for (unsigned int lockMask : kLockMasks) {
+        XGrabKey(display, xKeyCode, xModifiers | lockMask, rootWindow,
+                 True, GrabModeAsync, GrabModeAsync);
+    }
+    XSync(display, False);
+    XSetErrorHandler(previousHandler);
     
-    if (status == Success) {
+    if (!grabFailed) {
         info.registered = true;
         hotkeys[id] = info;
+        grabbedKeys[grabKey(xKeyCode, xModifiers)] = id;
         qDebug() << "Registered global hotkey:" << keySequence.toString() << "with ID:" << id;
         return true;
     } else {
+        for (unsigned int lockMask : kLockMasks) {
+            XUngrabKey(display, xKeyCode, xModifiers | lockMask, rootWindow);
+        }
+        XFlush(display);
         qWarning() << "Failed to register hotkey on Linux:" << keySequence.toString();
         return false;
     }
@@ -215,6 +264,12 @@ bool GlobalHotkey::unregisterHotkey(int id) {
         return false;
     }
 
+#ifdef Q_OS_MAC
+    if (hotkeys[id].ref) {
+        UnregisterEventHotKey(hotkeys[id].ref);
+    }
+#endif
+
 #ifdef Q_OS_WIN
     if (hotkeyIds.contains(id)) {
         UnregisterHotKey(hwnd, hotkeyIds[id]);
@@ -229,10 +284,14 @@ bool GlobalHotkey::unregisterHotkey(int id) {
         int key = keyCombo.key();
         Qt::KeyboardModifiers modifiers = keyCombo.keyboardModifiers();
         
-        int xKeyCode = keyCodeForQtKey(key);
-        int xModifiers = modifierFlagsForQtModifiers(modifiers);
+        unsigned int xKeyCode = XKeysymToKeycode(display, keyCodeForQtKey(key));
+        unsigned int xModifiers = modifierFlagsForQtModifiers(modifiers);
         
-        XUngrabKey(display, xKeyCode, xModifiers, rootWindow);
+        for (unsigned int lockMask : kLockMasks) {
+            XUngrabKey(display, xKeyCode, xModifiers | lockMask, rootWindow);
+        }
+        XFlush(display);
+        grabbedKeys.remove(grabKey(xKeyCode, xModifiers));
     }
 #endif
 
@@ -241,6 +300,14 @@ bool GlobalHotkey::unregisterHotkey(int id) {
 }
 
 void GlobalHotkey::unregisterAllHotkeys() {
+#ifdef Q_OS_MAC
+    for (const HotkeyInfo &info : hotkeys.values()) {
+        if (info.ref) {
+            UnregisterEventHotKey(info.ref);
+        }
+    }
+#endif
+
 #ifdef Q_OS_WIN
     for (int hotkeyId : hotkeyIds.values()) {
         UnregisterHotKey(hwnd, hotkeyId);
@@ -255,12 +322,16 @@ void GlobalHotkey::unregisterAllHotkeys() {
             int key = keyCombo.key();
             Qt::KeyboardModifiers modifiers = keyCombo.keyboardModifiers();
             
-            int xKeyCode = keyCodeForQtKey(key);
-            int xModifiers = modifierFlagsForQtModifiers(modifiers);
+            unsigned int xKeyCode = XKeysymToKeycode(display, keyCodeForQtKey(key));
+            unsigned int xModifiers = modifierFlagsForQtModifiers(modifiers);
             
-            XUngrabKey(display, xKeyCode, xModifiers, rootWindow);
+            for (unsigned int lockMask : kLockMasks) {
+                XUngrabKey(display, xKeyCode, xModifiers | lockMask, rootWindow);
+            }
         }
+        XFlush(display);
     }
+    grabbedKeys.clear();
 #endif
 
     hotkeys.clear();
@@ -278,6 +349,71 @@ bool GlobalHotkey::isSupported() {
 #endif
 }
 
+bool GlobalHotkey::synthesizePaste() {
+#ifdef Q_OS_MAC
+    // Explicit flags override any modifiers the user is still holding from the hotkey
+    CGEventRef keyDown = CGEventCreateKeyboardEvent(nullptr, kVK_ANSI_V, true);
+    CGEventRef keyUp = CGEventCreateKeyboardEvent(nullptr, kVK_ANSI_V, false);
+    CGEventSetFlags(keyDown, kCGEventFlagMaskCommand);
+    CGEventSetFlags(keyUp, kCGEventFlagMaskCommand);
+    CGEventPost(kCGHIDEventTap, keyDown);
+    CGEventPost(kCGHIDEventTap, keyUp);
+    CFRelease(keyDown);
+    CFRelease(keyUp);
+    return true;
+#elif defined(Q_OS_WIN)
+    INPUT inputs[6] = {};
+    for (INPUT &input : inputs) {
+        input.type = INPUT_KEYBOARD;
+    }
+    // Release Alt/Shift from the hotkey chord so the target sees a plain Ctrl+V
+    inputs[0].ki.wVk = VK_MENU;
+    inputs[0].ki.dwFlags = KEYEVENTF_KEYUP;
+    inputs[1].ki.wVk = VK_SHIFT;
+    inputs[1].ki.dwFlags = KEYEVENTF_KEYUP;
+    inputs[2].ki.wVk = VK_CONTROL;
+    inputs[3].ki.wVk = 'V';
+    inputs[4].ki.wVk = 'V';
+    inputs[4].ki.dwFlags = KEYEVENTF_KEYUP;
+    inputs[5].ki.wVk = VK_CONTROL;
+    inputs[5].ki.dwFlags = KEYEVENTF_KEYUP;
+    return SendInput(6, inputs, sizeof(INPUT)) == 6;
+#elif defined(Q_OS_LINUX) && defined(XCLIPY_HAVE_XTEST)
+    if (!display) {
+        return false;
+    }
+    int eventBase, errorBase, major, minor;
+    if (!XTestQueryExtension(display, &eventBase, &errorBase, &major, &minor)) {
+        qWarning() << "XTest extension not available; cannot synthesize paste";
+        return false;
+    }
+
+    // Release modifiers still held from the hotkey chord (e.g. Alt from Ctrl+Alt+1)
+    char keymap[32];
+    XQueryKeymap(display, keymap);
+    const KeySym heldModifiers[] = { XK_Alt_L, XK_Alt_R, XK_Shift_L, XK_Shift_R,
+                                     XK_Super_L, XK_Super_R, XK_Meta_L, XK_Meta_R };
+    for (KeySym keySym : heldModifiers) {
+        KeyCode code = XKeysymToKeycode(display, keySym);
+        if (code && (keymap[code / 8] & (1 << (code % 8)))) {
+            XTestFakeKeyEvent(display, code, False, CurrentTime);
+        }
+    }
+
+    KeyCode control = XKeysymToKeycode(display, XK_Control_L);
+    KeyCode v = XKeysymToKeycode(display, XK_v);
+    XTestFakeKeyEvent(display, control, True, CurrentTime);
+    XTestFakeKeyEvent(display, v, True, CurrentTime);
+    XTestFakeKeyEvent(display, v, False, CurrentTime);
+    XTestFakeKeyEvent(display, control, False, CurrentTime);
+    XFlush(display);
+    return true;
+#else
+    qWarning() << "Paste synthesis not supported on this platform";
+    return false;
+#endif
+}
+
 #ifdef Q_OS_MAC
 OSStatus GlobalHotkey::hotkeyHandler(EventHandlerCallRef nextHandler, EventRef event, void *userData) {
     Q_UNUSED(nextHandler)
@@ -307,6 +443,16 @@ UInt32 GlobalHotkey::keyCodeForQtKey(int qtKey) {
         case Qt::Key_V: return kVK_ANSI_V;
         case Qt::Key_C: return kVK_ANSI_C;
         case Qt::Key_H: return kVK_ANSI_H;
+        case Qt::Key_0: return kVK_ANSI_0;
+        case Qt::Key_1: return kVK_ANSI_1;
+        case Qt::Key_2: return kVK_ANSI_2;
+        case Qt::Key_3: return kVK_ANSI_3;
+        case Qt::Key_4: return kVK_ANSI_4;
+        case Qt::Key_5: return kVK_ANSI_5;
+        case Qt::Key_6: return kVK_ANSI_6;
+        case Qt::Key_7: return kVK_ANSI_7;
+        case Qt::Key_8: return kVK_ANSI_8;
+        case Qt::Key_9: return kVK_ANSI_9;
         default: return 0;
     }
 }
@@ -339,12 +485,28 @@ LRESULT CALLBACK GlobalHotkey::windowProc(HWND hwnd, UINT msg, WPARAM wParam, LP
 #endif
 
 #ifdef Q_OS_LINUX
+void GlobalHotkey::processXEvents() {
+    while (display && XPending(display) > 0) {
+        XEvent event;
+        XNextEvent(display, &event);
+        handleXEvent(&event);
+    }
+}
+
 void GlobalHotkey::handleXEvent(XEvent *event) {
-    if (event->type == KeyPress && instance) {
-        // For simplicity, we'll emit a signal for any key press
-        // In a real implementation, you'd want to check if it matches registered hotkeys
-        emit instance->hotkeyPressed(0);
+    if (event->type != KeyPress) {
+        return;
     }
+    // Single hash lookup on (keycode, modifiers) with lock state masked out
+    unsigned int modifiers = event->xkey.state & kHotkeyModifierMask;
+    auto it = grabbedKeys.constFind(grabKey(event->xkey.keycode, modifiers));
+    if (it != grabbedKeys.constEnd()) {
+        emit hotkeyPressed(it.value());
+    }
+}
+
+quint64 GlobalHotkey::grabKey(unsigned int keyCode, unsigned int modifiers) {
+    return (static_cast<quint64>(keyCode) << 32) | modifiers;
 }
 
 int GlobalHotkey::keyCodeForQtKey(int qtKey) {
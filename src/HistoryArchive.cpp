@@ -0,0 +1,588 @@
+#include "../include/HistoryArchive.h"
+#include "../include/HistoryStore.h"
+#include "../include/MemoryAccounting.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <algorithm>
+
+namespace {
+
+const quint32 kSegmentMagic = 0x58434153;   // "XCAS"
+const quint32 kStagingMagic = 0x58434154;   // "XCAT"
+const quint32 kArchiveVersion = 1;
+const int kStagingHeaderSize = 8;           // magic, sequence
+const int kRecordHeaderSize = 14;           // length, checksum, timestamp
+const int kFilterHashes = 6;
+const int kMinFilterBits = 1024;
+const int kMaxFilterBits = 8 * 1024 * 1024;
+
+QDataStream &configure(QDataStream &stream) {
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::BigEndian);
+    return stream;
+}
+
+quint64 mix64(quint64 x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Bit positions by double hashing one 64-bit hash of the trigram
+template <typename F>
+void forEachBit(quint32 trigram, int hashes, quint32 mask, F f) {
+    const quint64 h = mix64(trigram);
+    const quint32 h1 = quint32(h);
+    const quint32 h2 = quint32(h >> 32) | 1;
+    for (int j = 0; j < hashes; ++j) {
+        f((h1 + quint32(j) * h2) & mask);
+    }
+}
+
+qint64 dayOf(qint64 secs) {
+    return secs / 86400;
+}
+
+QByteArray stagingHeader(quint32 sequence) {
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    configure(stream) << kStagingMagic << sequence;
+    return header;
+}
+
+}
+
+HistoryArchive::HistoryArchive(const QString &directory)
+    : dir(directory),
+      filters(8 * 1024 * 1024) {
+}
+
+QString HistoryArchive::segmentPath(quint32 sequence) const {
+    return dir + QString("/seg-%1.xcs").arg(sequence, 8, 10, QChar('0'));
+}
+
+QString HistoryArchive::stagingPath() const {
+    return dir + "/staging.xca";
+}
+
+bool HistoryArchive::open() {
+    if (!QDir().mkpath(dir)) {
+        qWarning() << "Cannot create history archive directory:" << dir;
+        return false;
+    }
+
+    QVector<Segment> found;
+    qint64 total = 0;
+    const QStringList names = QDir(dir).entryList({"seg-*.xcs"}, QDir::Files, QDir::Name);
+    for (const QString &name : names) {
+        bool ok = false;
+        const quint32 sequence = name.mid(4, name.size() - 8).toUInt(&ok);
+        QFile file(dir + "/" + name);
+        if (!ok || !file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        QDataStream stream(&file);
+        configure(stream);
+        quint32 magic = 0, version = 0, count = 0;
+        qint64 firstAt = 0, lastAt = 0;
+        stream >> magic >> version >> count >> firstAt >> lastAt;
+        if (magic != kSegmentMagic || version != kArchiveVersion || stream.status() != QDataStream::Ok) {
+            qWarning() << "Skipping unreadable archive segment:" << name;
+            continue;
+        }
+        found.append(Segment{sequence, int(count), file.fileName(), lastAt});
+        total += count;
+        nextSequence = qMax(nextSequence, sequence + 1);
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        segments = found;
+    }
+    entries.store(total, std::memory_order_relaxed);
+    return recoverStaging();
+}
+
+// Reads staged records up to the first torn one and truncates the rest.
+// Staging carries the sequence it will seal into; if that segment already
+// exists the seal completed and only the staging reset was lost.
+bool HistoryArchive::recoverStaging() {
+    QVector<Staged> recovered;
+    qint64 validSize = 0;
+    QFile file(stagingPath());
+    if (file.open(QIODevice::ReadOnly)) {
+        const QByteArray data = file.readAll();
+        file.close();
+        QDataStream header(data);
+        configure(header);
+        quint32 magic = 0, sequence = 0;
+        header >> magic >> sequence;
+        if (magic == kStagingMagic && !QFile::exists(segmentPath(sequence))) {
+            nextSequence = qMax(nextSequence, sequence);
+            qint64 pos = kStagingHeaderSize;
+            while (pos + kRecordHeaderSize <= data.size()) {
+                QDataStream record(data.mid(pos, kRecordHeaderSize));
+                configure(record);
+                quint32 length = 0;
+                quint16 checksum = 0;
+                qint64 archivedAt = 0;
+                record >> length >> checksum >> archivedAt;
+                if (pos + kRecordHeaderSize + qint64(length) > data.size()) {
+                    break;
+                }
+                const QByteArray utf8 = data.mid(pos + kRecordHeaderSize, length);
+                if (qChecksum(utf8) != checksum) {
+                    break;
+                }
+                recovered.append(Staged{utf8, archivedAt});
+                pos += kRecordHeaderSize + length;
+            }
+            validSize = pos;
+        }
+    }
+
+    staging.close();
+    staging.setFileName(stagingPath());
+    if (validSize == 0) {
+        if (!staging.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || staging.write(stagingHeader(nextSequence)) != kStagingHeaderSize) {
+            qWarning() << "Cannot open archive staging file:" << staging.errorString();
+            return false;
+        }
+    } else {
+        if (!staging.open(QIODevice::ReadWrite) || !staging.resize(validSize) || !staging.seek(validSize)) {
+            qWarning() << "Cannot open archive staging file:" << staging.errorString();
+            return false;
+        }
+    }
+
+    stagedBytes = 0;
+    for (const Staged &item : recovered) {
+        stagedBytes += item.utf8.size();
+    }
+    stagingDay = recovered.isEmpty() ? -1 : dayOf(recovered.first().archivedAt);
+    {
+        QMutexLocker locker(&mutex);
+        staged = recovered;
+    }
+    entries.fetch_add(recovered.size(), std::memory_order_relaxed);
+    return true;
+}
+
+void HistoryArchive::append(QByteArrayView utf8, qint64 archivedAt) {
+    const qint64 now = archivedAt > 0 ? archivedAt : QDateTime::currentSecsSinceEpoch();
+    const QByteArray body = utf8.toByteArray();
+
+    QDataStream record(&pendingRecords, QIODevice::Append);
+    configure(record) << quint32(body.size()) << qChecksum(body) << now;
+    pendingRecords.append(body);
+
+    if (stagingDay < 0) {
+        stagingDay = dayOf(now);
+    }
+    stagedBytes += body.size();
+    {
+        QMutexLocker locker(&mutex);
+        staged.append(Staged{body, now});
+    }
+    entries.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HistoryArchive::flush() {
+    if (!pendingRecords.isEmpty() && staging.isOpen()) {
+        if (staging.write(pendingRecords) != pendingRecords.size()
+            || !staging.flush() || !HistoryStore::syncToDisk(staging)) {
+            qWarning() << "Archive staging write failed:" << staging.errorString();
+        }
+        pendingRecords.clear();
+    }
+
+    bool empty = false;
+    {
+        QMutexLocker locker(&mutex);
+        empty = staged.isEmpty();
+    }
+    const bool dayChanged = stagingDay >= 0 && dayOf(QDateTime::currentSecsSinceEpoch()) != stagingDay;
+    if (!empty && (stagedBytes >= kSegmentBytes || dayChanged)) {
+        seal();
+    }
+}
+
+bool HistoryArchive::seal() {
+    QVector<Staged> items;
+    {
+        QMutexLocker locker(&mutex);
+        items = staged;
+    }
+    const qint64 stagedCount = items.size();
+    const qint64 expiredBefore = cutoff.load(std::memory_order_relaxed);
+    items.erase(std::remove_if(items.begin(), items.end(), [expiredBefore](const Staged &item) {
+        return item.archivedAt < expiredBefore;
+    }), items.end());
+    entries.fetch_sub(stagedCount - items.size(), std::memory_order_relaxed);
+    if (items.isEmpty()) {
+        QMutexLocker locker(&mutex);
+        staged.clear();
+        locker.unlock();
+        return resetStaging();
+    }
+
+    int hashes = 0;
+    const QByteArray filter = buildFilter(items, &hashes);
+    QByteArray payload;
+    {
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        configure(stream);
+        for (const Staged &item : items) {
+            stream << item.utf8 << item.archivedAt;
+        }
+    }
+
+    const quint32 sequence = nextSequence;
+    QSaveFile file(segmentPath(sequence));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write archive segment:" << file.errorString();
+        return false;
+    }
+    {
+        QDataStream stream(&file);
+        configure(stream) << kSegmentMagic << kArchiveVersion << quint32(items.size())
+                          << items.first().archivedAt << items.last().archivedAt
+                          << quint8(hashes) << filter << qCompress(payload);
+    }
+    if (!file.flush() || !HistoryStore::syncToDisk(file) || !file.commit()) {
+        qWarning() << "Cannot write archive segment:" << file.errorString();
+        return false;
+    }
+
+    // The segment is durable; staging restarts for the next one
+    ++nextSequence;
+    {
+        QMutexLocker locker(&mutex);
+        segments.append(Segment{sequence, int(items.size()), segmentPath(sequence), items.last().archivedAt});
+        staged.clear();
+    }
+    qInfo() << "Sealed archive segment" << sequence << "with" << items.size() << "entries,"
+            << filter.size() << "filter bytes";
+    return resetStaging();
+}
+
+bool HistoryArchive::resetStaging() {
+    staging.close();
+    bool ok = staging.open(QIODevice::WriteOnly | QIODevice::Truncate)
+              && staging.write(stagingHeader(nextSequence)) == kStagingHeaderSize
+              && staging.flush() && HistoryStore::syncToDisk(staging);
+    if (!ok) {
+        qWarning() << "Cannot reset archive staging file:" << staging.errorString();
+    }
+    stagedBytes = 0;
+    stagingDay = -1;
+    return ok;
+}
+
+void HistoryArchive::expireBefore(qint64 before) {
+    cutoff.store(before, std::memory_order_relaxed);
+    if (before <= 0) {
+        return;
+    }
+    QVector<Segment> expired;
+    {
+        QMutexLocker locker(&mutex);
+        for (auto it = segments.begin(); it != segments.end();) {
+            if (it->lastAt < before) {
+                expired.append(*it);
+                filters.remove(it->sequence);
+                it = segments.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const Segment &segment : expired) {
+        QFile::remove(segment.path);
+        entries.fetch_sub(segment.count, std::memory_order_relaxed);
+    }
+    if (!expired.isEmpty()) {
+        qInfo() << "Removed" << expired.size() << "expired archive segments";
+    }
+}
+
+void HistoryArchive::clear() {
+    QVector<Segment> removed;
+    {
+        QMutexLocker locker(&mutex);
+        removed = segments;
+        segments.clear();
+        staged.clear();
+        filters.clear();
+    }
+    for (const Segment &segment : removed) {
+        QFile::remove(segment.path);
+    }
+    pendingRecords.clear();
+    stagedBytes = 0;
+    stagingDay = -1;
+    entries.store(0, std::memory_order_relaxed);
+
+    staging.close();
+    if (!staging.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || staging.write(stagingHeader(nextSequence)) != kStagingHeaderSize) {
+        qWarning() << "Cannot reset archive staging file:" << staging.errorString();
+    }
+}
+
+bool HistoryArchive::isEmpty() const {
+    return entries.load(std::memory_order_relaxed) == 0;
+}
+
+int HistoryArchive::segmentCount() const {
+    QMutexLocker locker(&mutex);
+    return segments.size();
+}
+
+qint64 HistoryArchive::memoryBytes() const {
+    QMutexLocker locker(&mutex);
+    qint64 bytes = MemoryAccounting::vectorBytes(staged) + MemoryAccounting::vectorBytes(segments)
+                   + filters.totalCost();
+    for (const Staged &item : staged) {
+        bytes += MemoryAccounting::byteArrayBytes(item.utf8);
+    }
+    return bytes;
+}
+
+QByteArray HistoryArchive::foldForFilter(const QString &text) {
+    return text.toCaseFolded().toUtf8();
+}
+
+QVector<quint32> HistoryArchive::trigramsOf(const QByteArray &folded) {
+    QSet<quint32> unique;
+    for (int i = 0; i + 3 <= folded.size(); ++i) {
+        unique.insert((quint32(quint8(folded.at(i))) << 16)
+                      | (quint32(quint8(folded.at(i + 1))) << 8)
+                      | quint32(quint8(folded.at(i + 2))));
+    }
+    return QVector<quint32>(unique.cbegin(), unique.cend());
+}
+
+// About ten bits per distinct trigram with six hashes: ~1% false positives
+QByteArray HistoryArchive::buildFilter(const QVector<Staged> &items, int *hashes) {
+    QSet<quint32> trigrams;
+    for (const Staged &item : items) {
+        for (quint32 trigram : trigramsOf(foldForFilter(QString::fromUtf8(item.utf8)))) {
+            trigrams.insert(trigram);
+        }
+    }
+
+    int bits = kMinFilterBits;
+    while (bits < kMaxFilterBits && bits < trigrams.size() * 10) {
+        bits *= 2;
+    }
+    QByteArray filter(bits / 8, '\0');
+    for (quint32 trigram : trigrams) {
+        forEachBit(trigram, kFilterHashes, quint32(bits - 1), [&filter](quint32 bit) {
+            filter[int(bit >> 3)] = char(quint8(filter.at(int(bit >> 3))) | (1 << (bit & 7)));
+        });
+    }
+    *hashes = kFilterHashes;
+    return filter;
+}
+
+bool HistoryArchive::mayContain(const Filter &filter, const QVector<quint32> &trigrams) {
+    const quint32 mask = quint32(filter.bits.size()) * 8 - 1;
+    for (quint32 trigram : trigrams) {
+        bool present = true;
+        forEachBit(trigram, filter.hashes, mask, [&filter, &present](quint32 bit) {
+            present = present && (quint8(filter.bits.at(int(bit >> 3))) & (1 << (bit & 7)));
+        });
+        if (!present) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads only the segment header; the compressed entries are left on disk
+bool HistoryArchive::loadFilter(const Segment &segment, Filter *filter) const {
+    {
+        QMutexLocker locker(&mutex);
+        if (const Filter *cached = filters.object(segment.sequence)) {
+            *filter = *cached;
+            return true;
+        }
+    }
+
+    QFile file(segment.path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    configure(stream);
+    quint32 magic = 0, version = 0, count = 0;
+    qint64 firstAt = 0, lastAt = 0;
+    quint8 hashes = 0;
+    stream >> magic >> version >> count >> firstAt >> lastAt >> hashes >> filter->bits;
+    filter->hashes = hashes;
+    if (stream.status() != QDataStream::Ok || filter->bits.isEmpty()
+        || (filter->bits.size() & (filter->bits.size() - 1)) != 0) {
+        return false;
+    }
+
+    QMutexLocker locker(&mutex);
+    filters.insert(segment.sequence, new Filter(*filter), int(filter->bits.size()));
+    return true;
+}
+
+void HistoryArchive::matchEntry(const QByteArray &utf8, const QString &text, QVector<SearchHit> *hits) {
+    const QString body = QString::fromUtf8(utf8);
+    SearchHit hit;
+    for (int at = body.indexOf(text, 0, Qt::CaseInsensitive);
+         at >= 0 && hit.ranges.size() < HistorySearch::kMaxRangesPerEntry;
+         at = body.indexOf(text, at + text.size(), Qt::CaseInsensitive)) {
+        hit.ranges.append(TextRange{at, int(text.size())});
+    }
+    if (!hit.ranges.isEmpty()) {
+        hit.archivedUtf8 = utf8;
+        hits->append(hit);
+    }
+}
+
+HistoryArchive::SearchStats HistoryArchive::search(const QString &text, int limit, const std::atomic<bool> &cancelled,
+                                                   const std::function<void(const QVector<SearchHit> &)> &onHits,
+                                                   bool useFilters) const {
+    SearchStats stats;
+    QVector<Segment> sealed;
+    QVector<Staged> unsealed;
+    {
+        QMutexLocker locker(&mutex);
+        sealed = segments;
+        unsealed = staged;
+    }
+    stats.segments = sealed.size();
+    if (text.isEmpty()) {
+        return stats;
+    }
+    const QVector<quint32> trigrams = trigramsOf(foldForFilter(text));
+
+    const qint64 expiredBefore = cutoff.load(std::memory_order_relaxed);
+
+    // Staged entries are the newest archived ones and are already in memory
+    QVector<SearchHit> hits;
+    for (int i = unsealed.size() - 1; i >= 0 && stats.matches + hits.size() < limit; --i) {
+        if (unsealed.at(i).archivedAt >= expiredBefore) {
+            matchEntry(unsealed.at(i).utf8, text, &hits);
+        }
+    }
+    if (!hits.isEmpty()) {
+        stats.matches += hits.size();
+        onHits(hits);
+    }
+
+    for (int s = sealed.size() - 1; s >= 0; --s) {
+        if (cancelled.load(std::memory_order_relaxed) || stats.matches >= limit) {
+            stats.complete = false;
+            break;
+        }
+        const Segment &segment = sealed.at(s);
+        if (segment.lastAt < expiredBefore) {
+            ++stats.segmentsSkipped;
+            continue;
+        }
+        if (useFilters && !trigrams.isEmpty()) {
+            Filter filter;
+            if (loadFilter(segment, &filter) && !mayContain(filter, trigrams)) {
+                ++stats.segmentsSkipped;
+                continue;
+            }
+        }
+
+        QVector<Staged> items;
+        if (!readSegment(segment, &items, &stats.compressedBytesRead)) {
+            continue;
+        }
+
+        hits.clear();
+        for (int i = items.size() - 1; i >= 0 && stats.matches + hits.size() < limit; --i) {
+            if (items.at(i).archivedAt >= expiredBefore) {
+                matchEntry(items.at(i).utf8, text, &hits);
+            }
+        }
+        if (!hits.isEmpty()) {
+            stats.matches += hits.size();
+            onHits(hits);
+        }
+    }
+    return stats;
+}
+
+bool HistoryArchive::readSegment(const Segment &segment, QVector<Staged> *items, qint64 *compressedBytes) {
+    items->clear();
+    QFile file(segment.path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    configure(stream);
+    quint32 magic = 0, version = 0, count = 0;
+    qint64 firstAt = 0, lastAt = 0;
+    quint8 hashes = 0;
+    QByteArray filterBits, compressed;
+    stream >> magic >> version >> count >> firstAt >> lastAt >> hashes >> filterBits >> compressed;
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Skipping unreadable archive segment:" << segment.path;
+        return false;
+    }
+    *compressedBytes += compressed.size();
+
+    items->reserve(int(count));
+    QDataStream payload(qUncompress(compressed));
+    configure(payload);
+    for (quint32 i = 0; i < count && payload.status() == QDataStream::Ok; ++i) {
+        Staged item;
+        payload >> item.utf8 >> item.archivedAt;
+        items->append(item);
+    }
+    return true;
+}
+
+bool HistoryArchive::forEachEntry(const std::function<bool(const QByteArray &, qint64)> &f) const {
+    QVector<Segment> sealed;
+    QVector<Staged> unsealed;
+    {
+        QMutexLocker locker(&mutex);
+        sealed = segments;
+        unsealed = staged;
+    }
+    const qint64 expiredBefore = cutoff.load(std::memory_order_relaxed);
+    // One segment in memory at a time
+    bool complete = true;
+    qint64 compressedBytes = 0;
+    QVector<Staged> items;
+    for (const Segment &segment : sealed) {
+        if (segment.lastAt < expiredBefore) {
+            continue;
+        }
+        if (!readSegment(segment, &items, &compressedBytes)) {
+            complete = false;
+            continue;
+        }
+        for (const Staged &item : items) {
+            if (item.archivedAt >= expiredBefore && !f(item.utf8, item.archivedAt)) {
+                return complete;
+            }
+        }
+    }
+    for (const Staged &item : unsealed) {
+        if (item.archivedAt >= expiredBefore && !f(item.utf8, item.archivedAt)) {
+            break;
+        }
+    }
+    return complete;
+}
@@ -0,0 +1,252 @@
+#include "../include/HistoryExport.h"
+#include "../include/HistoryArchive.h"
+#include "../include/HistoryStore.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+const quint32 kExportMagic = 0x58434558;    // "XCEX"
+const quint32 kExportVersion = 2;
+const quint32 kFirstVersion = 1;            // no source apps
+const int kFileHeaderSize = 16;             // magic, version, created
+const int kRecordHeaderSize = 21;           // tier, flags, frecency, timestamp, length, checksum, source length
+const int kFirstRecordHeaderSize = 20;
+const int kEndSize = 9;                     // tier 0, count
+const quint8 kFlagCompressed = 0x01;
+const quint8 kFlagConcealed = 0x02;
+const int kMaxSourceBytes = 255;
+const quint32 kMaxRecordBytes = 256 * 1024 * 1024;
+
+}
+
+HistoryExport::Writer::Writer(const QString &path)
+    : file(path) {
+}
+
+bool HistoryExport::Writer::open() {
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    buffer.reserve(kBufferBytes + kRecordHeaderSize);
+    char header[kFileHeaderSize];
+    qToBigEndian<quint32>(kExportMagic, header);
+    qToBigEndian<quint32>(kExportVersion, header + 4);
+    qToBigEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 8);
+    buffer.append(header, kFileHeaderSize);
+    return true;
+}
+
+bool HistoryExport::Writer::write(Tier tier, QByteArrayView utf8, float frecency, qint64 timestamp,
+                                  bool concealed, const QString &source) {
+    QByteArray compressed;
+    QByteArrayView stored = utf8;
+    quint8 flags = concealed ? kFlagConcealed : 0;
+    // App names are short; a longer one is cut at a character boundary
+    QString app = source;
+    while (app.toUtf8().size() > kMaxSourceBytes) {
+        app.chop(1);
+    }
+    const QByteArray sourceUtf8 = app.toUtf8();
+    if (utf8.size() > kCompressThreshold) {
+        compressed = qCompress(reinterpret_cast<const uchar *>(utf8.data()), utf8.size());
+        stored = compressed;
+        flags |= kFlagCompressed;
+    }
+    if (quint64(stored.size()) > kMaxRecordBytes) {
+        qWarning() << "Skipping an entry too large to export:" << utf8.size() << "bytes";
+        return true;
+    }
+
+    quint32 frecencyBits = 0;
+    std::memcpy(&frecencyBits, &frecency, sizeof(frecencyBits));
+    char header[kRecordHeaderSize];
+    header[0] = char(tier);
+    header[1] = char(flags);
+    qToBigEndian<quint32>(frecencyBits, header + 2);
+    qToBigEndian<qint64>(timestamp, header + 6);
+    qToBigEndian<quint32>(quint32(stored.size()), header + 14);
+    qToBigEndian<quint16>(qChecksum(stored), header + 18);
+    header[20] = char(quint8(sourceUtf8.size()));
+    buffer.append(header, kRecordHeaderSize);
+    buffer.append(stored.data(), stored.size());
+    buffer.append(sourceUtf8);
+    ++records;
+    return buffer.size() < kBufferBytes || flushBuffer();
+}
+
+bool HistoryExport::Writer::flushBuffer() {
+    if (file.write(buffer) != buffer.size()) {
+        return false;
+    }
+    written += buffer.size();
+    buffer.clear();
+    return true;
+}
+
+bool HistoryExport::Writer::finish() {
+    char end[kEndSize];
+    end[0] = char(Tier::End);
+    qToBigEndian<quint64>(quint64(records), end + 1);
+    buffer.append(end, kEndSize);
+    // A backup is only worth having if it survives a crash right after
+    return flushBuffer() && file.flush() && HistoryStore::syncToDisk(file) && file.commit();
+}
+
+HistoryExport::Reader::Reader(const QString &path)
+    : file(path) {
+}
+
+bool HistoryExport::Reader::open() {
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    if (!fill(kFileHeaderSize)
+        || qFromBigEndian<quint32>(buffer.constData()) != kExportMagic) {
+        error = "Not an Xclipy history export";
+        return false;
+    }
+    version = qFromBigEndian<quint32>(buffer.constData() + 4);
+    if (version < kFirstVersion || version > kExportVersion) {
+        error = "Unsupported history export version";
+        return false;
+    }
+    offset += kFileHeaderSize;
+    consumed += kFileHeaderSize;
+    return true;
+}
+
+// Makes at least needed unread bytes available; false at end of file
+bool HistoryExport::Reader::fill(qsizetype needed) {
+    if (buffer.size() - offset >= needed) {
+        return true;
+    }
+    buffer.remove(0, offset);
+    offset = 0;
+    while (buffer.size() < needed) {
+        const QByteArray chunk = file.read(qMax<qint64>(kBufferBytes, needed - buffer.size()));
+        if (chunk.isEmpty()) {
+            return false;
+        }
+        buffer.append(chunk);
+    }
+    return true;
+}
+
+bool HistoryExport::Reader::next(Record *record) {
+    if (complete || !error.isEmpty()) {
+        return false;
+    }
+    if (!fill(1)) {
+        error = "The export file is truncated";
+        return false;
+    }
+    const quint8 tier = quint8(buffer.at(offset));
+    if (tier == quint8(Tier::End)) {
+        if (!fill(kEndSize)) {
+            error = "The export file is truncated";
+            return false;
+        }
+        const quint64 count = qFromBigEndian<quint64>(buffer.constData() + offset + 1);
+        offset += kEndSize;
+        consumed += kEndSize;
+        if (count != quint64(records)) {
+            error = QString("The export file lists %1 entries but holds %2").arg(count).arg(records);
+            return false;
+        }
+        complete = true;
+        return false;
+    }
+
+    const int headerSize = version > kFirstVersion ? kRecordHeaderSize : kFirstRecordHeaderSize;
+    if (!fill(headerSize)) {
+        error = "The export file is truncated";
+        return false;
+    }
+    const char *header = buffer.constData() + offset;
+    const quint8 flags = quint8(header[1]);
+    const quint32 frecencyBits = qFromBigEndian<quint32>(header + 2);
+    const qint64 timestamp = qFromBigEndian<qint64>(header + 6);
+    const quint32 length = qFromBigEndian<quint32>(header + 14);
+    const quint16 checksum = qFromBigEndian<quint16>(header + 18);
+    const quint8 sourceLength = headerSize > kFirstRecordHeaderSize ? quint8(header[20]) : 0;
+    if (tier > quint8(Tier::Archived) || length > kMaxRecordBytes) {
+        error = QString("Damaged record at offset %1").arg(consumed);
+        return false;
+    }
+    const qsizetype size = headerSize + qsizetype(length) + sourceLength;
+    if (!fill(size)) {
+        error = "The export file is truncated";
+        return false;
+    }
+
+    const QByteArrayView stored(buffer.constData() + offset + headerSize, length);
+    if (qChecksum(stored) != checksum) {
+        error = QString("Damaged record at offset %1").arg(consumed);
+        return false;
+    }
+    if (flags & kFlagCompressed) {
+        record->utf8 = qUncompress(reinterpret_cast<const uchar *>(stored.data()), stored.size());
+        if (record->utf8.isEmpty()) {
+            error = QString("Damaged record at offset %1").arg(consumed);
+            return false;
+        }
+    } else {
+        record->utf8 = stored.toByteArray();
+    }
+    record->tier = Tier(tier);
+    std::memcpy(&record->frecency, &frecencyBits, sizeof(frecencyBits));
+    record->timestamp = timestamp;
+    record->concealed = flags & kFlagConcealed;
+    record->source = QString::fromUtf8(buffer.constData() + offset + headerSize + length, sourceLength);
+
+    offset += size;
+    consumed += size;
+    ++records;
+    return true;
+}
+
+bool HistoryExport::write(const QString &path, const HistorySnapshot &snapshot,
+                          const HistoryArchive *archive, Stats *stats) {
+    QElapsedTimer timer;
+    timer.start();
+    *stats = Stats();
+
+    Writer writer(path);
+    if (!writer.open()) {
+        stats->error = writer.errorString();
+        return false;
+    }
+    bool ok = true;
+    if (archive && !archive->forEachEntry([&writer, &ok](const QByteArray &utf8, qint64 archivedAt) {
+            ok = writer.write(Tier::Archived, utf8, 0, archivedAt);
+            return ok;
+        })) {
+        qWarning() << "Some archive segments could not be read; exporting the rest";
+    }
+    const auto writeList = [&writer, &ok, &snapshot](const EntryList &list, Tier tier) {
+        list.forEach([&writer, &ok, &snapshot, tier](const HistoryEntry &entry) {
+            ok = ok && writer.write(tier, entry.body.bytes(), entry.frecency, entry.capturedAt,
+                                    entry.concealed, snapshot.sourceApp(entry.source));
+            return ok;
+        });
+    };
+    writeList(snapshot.history, Tier::History);
+    writeList(snapshot.selections, Tier::Selection);
+    writeList(snapshot.pins, Tier::Pinned);
+    ok = ok && writer.finish();
+
+    stats->entries = writer.count();
+    stats->bytes = writer.bytesWritten();
+    stats->elapsedMs = timer.elapsed();
+    stats->ok = ok;
+    stats->complete = ok;
+    if (!ok) {
+        stats->error = writer.errorString();
+    }
+    return ok;
+}
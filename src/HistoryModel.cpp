@@ -0,0 +1,706 @@
+#include "../include/HistoryModel.h"
+#include "../include/MemoryAccounting.h"
+#include <QColor>
+#include <QFileInfo>
+#include <QHash>
+#include <QPixmap>
+#include <algorithm>
+
+HistoryModel::HistoryModel(QObject *parent)
+    : QAbstractListModel(parent),
+      rows(kRowCacheBytes) {
+    connect(this, &QAbstractItemModel::modelReset, this, &HistoryModel::accountMemory);
+    connect(this, &QAbstractItemModel::rowsInserted, this, &HistoryModel::accountMemory);
+}
+
+void HistoryModel::setSnapshot(const HistorySnapshotRef &next) {
+    beginResetModel();
+    snapshot = next;
+    resolveSource();
+    rows.clear();
+    rebuildRows();
+    endResetModel();
+}
+
+void HistoryModel::setFilter(const QString &text) {
+    if (text == filter) {
+        return;
+    }
+    beginResetModel();
+    filter = text;
+    rows.clear();   // previews and highlights depend on the filter
+    clearArchived();
+    rebuildRows();
+    endResetModel();
+}
+
+void HistoryModel::beginSearch(const HistorySnapshotRef &next) {
+    beginResetModel();
+    snapshot = next;
+    resolveSource();
+    searching = true;
+    rows.clear();
+    clearArchived();
+    viewRows.clear();
+    matchRanges.clear();
+    endResetModel();
+}
+
+void HistoryModel::addMatches(const QVector<SearchHit> &allHits) {
+    QVector<SearchHit> hits;
+    if (!isFiltered()) {
+        hits = allHits;
+    } else {
+        for (const SearchHit &hit : allHits) {
+            if (matches(snapshot->history.entry(hit.entry))) {
+                hits.append(hit);
+            }
+        }
+    }
+    if (!searching || hits.isEmpty()) {
+        return;
+    }
+    if (ranked) {
+        // Ranked hits can land anywhere; place each by its entry's key
+        for (const SearchHit &hit : hits) {
+            const ViewRow row{hit.entry, 0, false, snapshot->history.entry(hit.entry).frecency};
+            auto at = std::lower_bound(viewRows.begin(), viewRows.end(), row, [](const ViewRow &a, const ViewRow &b) {
+                return FrecencyHeap::lower(FrecencyHeap::Item{b.rank, b.entry}, FrecencyHeap::Item{a.rank, a.entry});
+            });
+            const int position = int(at - viewRows.begin());
+            beginInsertRows(QModelIndex(), position, position);
+            viewRows.insert(position, row);
+            matchRanges.insert(keyOf(row), hit.ranges);
+            endInsertRows();
+        }
+        return;
+    }
+    // Each batch is one contiguous run of the history, so it lands in one place
+    auto at = std::lower_bound(viewRows.begin(), viewRows.end(), hits.first().entry,
+                               [](const ViewRow &row, int entry) { return row.entry < entry; });
+    const int first = int(at - viewRows.begin());
+    beginInsertRows(QModelIndex(), first, first + int(hits.size()) - 1);
+    viewRows.insert(first, int(hits.size()), ViewRow{0, 0, false});
+    for (int i = 0; i < hits.size(); ++i) {
+        viewRows[first + i].entry = hits.at(i).entry;
+        matchRanges.insert(keyOf(Tier::History, hits.at(i).entry), hits.at(i).ranges);
+    }
+    endInsertRows();
+}
+
+void HistoryModel::addArchiveMatches(const QVector<SearchHit> &allHits) {
+    if (!sourceApp.isEmpty()) {
+        return;     // archived entries keep no source app
+    }
+    // Archived entries were never classified; the few hits are classified here
+    QVector<SearchHit> hits;
+    for (const SearchHit &hit : allHits) {
+        if (kinds == 0 || matchesKind(ContentClassifier::classify(hit.archivedUtf8))) {
+            hits.append(hit);
+        }
+    }
+    if (searching || filter.isEmpty() || hits.isEmpty()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), viewRows.size(), viewRows.size() + int(hits.size()) - 1);
+    for (const SearchHit &hit : hits) {
+        const ViewRow row{int(archived.size()), 0, false, 0, Tier::Archived};
+        archived.append(archivedArena.store(hit.archivedUtf8, Utf8Entry::hashOf(hit.archivedUtf8)));
+        matchRanges.insert(keyOf(row), hit.ranges);
+        viewRows.append(row);
+    }
+    archivedRows += int(hits.size());
+    endInsertRows();
+}
+
+void HistoryModel::clearArchived() {
+    // The next search reuses these positions; their cached rows would show the old hits
+    for (int i = 0; i < archived.size(); ++i) {
+        rows.remove(keyOf(Tier::Archived, i));
+        matchRanges.remove(keyOf(Tier::Archived, i));
+    }
+    archived.clear();
+    archivedRows = 0;
+}
+
+void HistoryModel::endSearch() {
+    if (!searching) {
+        return;
+    }
+    beginResetModel();
+    searching = false;
+    rebuildRows();
+    endResetModel();
+}
+
+void HistoryModel::setRankByFrecency(bool enabled) {
+    if (enabled == ranked) {
+        return;
+    }
+    beginResetModel();
+    ranked = enabled;
+    rebuildRows();
+    endResetModel();
+}
+
+void HistoryModel::setKindFilter(ContentClassifier::Kinds enabled) {
+    if (enabled == kinds) {
+        return;
+    }
+    beginResetModel();
+    kinds = enabled;
+    clearArchived();    // searched again by the caller
+    rebuildRows();
+    endResetModel();
+}
+
+void HistoryModel::setSourceFilter(const QString &app) {
+    if (app == sourceApp) {
+        return;
+    }
+    beginResetModel();
+    sourceApp = app;
+    resolveSource();
+    clearArchived();    // searched again by the caller
+    rebuildRows();
+    endResetModel();
+}
+
+void HistoryModel::resolveSource() {
+    sourceId = 0;
+    if (snapshot.isNull() || sourceApp.isEmpty()) {
+        return;
+    }
+    const int index = snapshot->sourceApps.indexOf(sourceApp);
+    sourceId = index >= 0 ? quint16(index + 1) : 0;
+}
+
+QStringList HistoryModel::sourceApps() const {
+    if (snapshot.isNull()) {
+        return QStringList();
+    }
+    // The table also names apps whose entries are gone; list only those still present
+    QVector<bool> present(snapshot->sourceApps.size() + 1, false);
+    auto mark = [&present](const HistoryEntry &entry) {
+        if (entry.source < present.size()) {
+            present[entry.source] = true;
+        }
+        return true;
+    };
+    snapshot->pins.forEach(mark);
+    snapshot->history.forEach(mark);
+    QStringList apps;
+    for (int id = 1; id < present.size(); ++id) {
+        if (present.at(id)) {
+            apps.append(snapshot->sourceApps.at(id - 1));
+        }
+    }
+    apps.sort(Qt::CaseInsensitive);
+    return apps;
+}
+
+bool HistoryModel::canFetchMore(const QModelIndex &parent) const {
+    return !parent.isValid() && !rankedRows.isEmpty();
+}
+
+void HistoryModel::fetchMore(const QModelIndex &parent) {
+    if (parent.isValid() || rankedRows.isEmpty()) {
+        return;
+    }
+    const QVector<FrecencyHeap::Item> page = rankedRows.take(kRankedPage);
+    // Live rows go ahead of any archived tail
+    const int first = int(viewRows.size()) - archivedRows;
+    beginInsertRows(QModelIndex(), first, first + int(page.size()) - 1);
+    for (int i = 0; i < page.size(); ++i) {
+        viewRows.insert(first + i, ViewRow{page.at(i).entry, 0, false, page.at(i).key});
+    }
+    endInsertRows();
+}
+
+void HistoryModel::toggleGroup(int row) {
+    if (searching || row < 0 || row >= viewRows.size() || tierOf(row) != Tier::History) {
+        return;
+    }
+    const quint32 group = snapshot->history.entry(viewRows.at(row).entry).group;
+    if (group == 0) {
+        return;
+    }
+    beginResetModel();
+    if (expandedGroups.contains(group)) {
+        expandedGroups.remove(group);
+    } else {
+        expandedGroups.insert(group);
+    }
+    rebuildRows();
+    endResetModel();
+}
+
+bool HistoryModel::isGroupExpanded(int row) const {
+    if (row < 0 || row >= viewRows.size() || tierOf(row) != Tier::History) {
+        return false;
+    }
+    return expandedGroups.contains(snapshot->history.entry(viewRows.at(row).entry).group);
+}
+
+void HistoryModel::rebuildRows() {
+    // Archive hits outlive a new snapshot; only their ranges are kept aside
+    QHash<qint64, QVector<TextRange>> archivedRanges;
+    for (int i = 0; i < archived.size(); ++i) {
+        archivedRanges.insert(keyOf(Tier::Archived, i), matchRanges.value(keyOf(Tier::Archived, i)));
+    }
+    viewRows.clear();
+    matchRanges = archivedRanges;
+    rankedRows.clear();
+    archivedRows = 0;
+    if (snapshot.isNull() || searching) {
+        // Search results are streamed in again by the caller
+        return;
+    }
+    viewRows.reserve(snapshot->pins.size() + snapshot->history.size());
+
+    // The pinned section comes first, in pin order, whatever the ordering below
+    int pin = 0;
+    snapshot->pins.forEach([this, &pin](const HistoryEntry &entry) {
+        const QVector<TextRange> ranges = findMatches(entry.body);
+        if (!ranges.isEmpty()) {
+            matchRanges.insert(keyOf(Tier::Pinned, pin), ranges);
+        }
+        if ((filter.isEmpty() || !ranges.isEmpty()) && matches(entry)) {
+            viewRows.append(ViewRow{pin, 0, false, 0, Tier::Pinned});
+        }
+        ++pin;
+        return true;
+    });
+
+    if (!filter.isEmpty() || ranked || isFiltered()) {
+        // Filtered or ranked rows are flat. Each body is decoded transiently
+        // to filter it, and the match offsets are kept for highlighting.
+        // The kind and source filters go first: they need no decoding.
+        QVector<FrecencyHeap::Item> rankItems;
+        int index = 0;
+        snapshot->history.forEach([this, &index, &rankItems](const HistoryEntry &entry) {
+            if (!matches(entry)) {
+                ++index;
+                return true;
+            }
+            if (!filter.isEmpty()) {
+                const QVector<TextRange> ranges = findMatches(entry.body);
+                if (ranges.isEmpty()) {
+                    ++index;
+                    return true;
+                }
+                matchRanges.insert(keyOf(Tier::History, index), ranges);
+            }
+            if (ranked) {
+                rankItems.append(FrecencyHeap::Item{entry.frecency, index});
+            } else {
+                viewRows.append(ViewRow{index, 0, false});
+            }
+            ++index;
+            return true;
+        });
+        if (ranked) {
+            rankedRows.assign(std::move(rankItems));
+            for (const FrecencyHeap::Item &item : rankedRows.take(kRankedPage)) {
+                viewRows.append(ViewRow{item.entry, 0, false, item.key});
+            }
+        }
+        for (int i = 0; i < archived.size(); ++i) {
+            viewRows.append(ViewRow{i, 0, false, 0, Tier::Archived});
+        }
+        archivedRows = int(archived.size());
+        return;
+    }
+
+    // Group members in history order; the first (newest) one heads the group
+    QHash<quint32, QVector<int>> groups;
+    int index = 0;
+    snapshot->history.forEach([&groups, &index](const HistoryEntry &entry) {
+        if (entry.group != 0) {
+            groups[entry.group].append(index);
+        }
+        ++index;
+        return true;
+    });
+
+    index = 0;
+    snapshot->history.forEach([this, &groups, &index](const HistoryEntry &entry) {
+        const QVector<int> members = entry.group != 0 ? groups.value(entry.group) : QVector<int>();
+        if (members.size() <= 1) {
+            viewRows.append(ViewRow{index, 0, false});
+        } else if (members.first() == index) {
+            viewRows.append(ViewRow{index, int(members.size()) - 1, false});
+            if (expandedGroups.contains(entry.group)) {
+                for (int i = 1; i < members.size(); ++i) {
+                    viewRows.append(ViewRow{members.at(i), 0, true});
+                }
+            }
+        }
+        ++index;
+        return true;
+    });
+}
+
+// Offsets of the plain filter in body, case-insensitive, capped per entry
+QVector<TextRange> HistoryModel::findMatches(const Utf8Entry &body) const {
+    QVector<TextRange> ranges;
+    if (filter.isEmpty()) {
+        return ranges;
+    }
+    const QString text = body.toString();
+    for (int at = text.indexOf(filter, 0, Qt::CaseInsensitive);
+         at >= 0 && ranges.size() < HistorySearch::kMaxRangesPerEntry;
+         at = text.indexOf(filter, at + filter.size(), Qt::CaseInsensitive)) {
+        ranges.append(TextRange{at, int(filter.size())});
+    }
+    return ranges;
+}
+
+HistoryModel::Tier HistoryModel::tierOf(int row) const {
+    return row >= 0 && row < viewRows.size() ? viewRows.at(row).tier : Tier::History;
+}
+
+Utf8Entry HistoryModel::entryAt(int row) const {
+    if (row < 0 || row >= viewRows.size() || snapshot.isNull()) {
+        return Utf8Entry();
+    }
+    const ViewRow &viewRow = viewRows.at(row);
+    switch (viewRow.tier) {
+    case Tier::Pinned:
+        return snapshot->pins.entry(viewRow.entry).body;
+    case Tier::Archived:
+        return archived.value(viewRow.entry);
+    case Tier::History:
+        break;
+    }
+    return snapshot->history.entry(viewRow.entry).body;
+}
+
+ContentClassifier::Kinds HistoryModel::kindsAt(int row) const {
+    if (row < 0 || row >= viewRows.size() || snapshot.isNull()) {
+        return 0;
+    }
+    const ViewRow &viewRow = viewRows.at(row);
+    switch (viewRow.tier) {
+    case Tier::Pinned:
+        return snapshot->pins.entry(viewRow.entry).kinds;
+    case Tier::Archived:
+        return ContentClassifier::classify(archived.value(viewRow.entry).bytes());
+    case Tier::History:
+        break;
+    }
+    return snapshot->history.entry(viewRow.entry).kinds;
+}
+
+QString HistoryModel::sourceAt(int row) const {
+    if (row < 0 || row >= viewRows.size() || snapshot.isNull()) {
+        return QString();
+    }
+    const ViewRow &viewRow = viewRows.at(row);
+    switch (viewRow.tier) {
+    case Tier::Pinned:
+        return snapshot->sourceApp(snapshot->pins.entry(viewRow.entry).source);
+    case Tier::Archived:
+        return QString();
+    case Tier::History:
+        break;
+    }
+    return snapshot->sourceApp(snapshot->history.entry(viewRow.entry).source);
+}
+
+int HistoryModel::firstMatchAt(int row) const {
+    if (row < 0 || row >= viewRows.size()) {
+        return -1;
+    }
+    const QVector<TextRange> ranges = matchRanges.value(keyOf(viewRows.at(row)));
+    return ranges.isEmpty() ? -1 : ranges.first().start;
+}
+
+QString HistoryModel::entryText(int row) const {
+    return entryAt(row).toString();
+}
+
+int HistoryModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) {
+        return 0;
+    }
+    return viewRows.size();
+}
+
+const HistoryModel::Row *HistoryModel::rowAt(int row) const {
+    if (row < 0 || row >= viewRows.size()) {
+        return nullptr;
+    }
+    const qint64 key = keyOf(viewRows.at(row));
+    if (Row *cached = rows.object(key)) {
+        return cached;
+    }
+    Utf8Entry entry = entryAt(row);
+    if (entry.isNull()) {
+        return nullptr;
+    }
+
+    bool truncated = false;
+    QVector<TextRange> ranges = matchRanges.value(key);
+    QString preview = ranges.isEmpty() ? entry.preview(kPreviewLines, kPreviewBytes, &truncated)
+                                       : matchPreview(entry, &ranges, &truncated);
+    Row *decoded = new Row;
+    const ContentClassifier::Kinds entryKinds = kindsAt(row);
+    if (entryKinds & ContentClassifier::Secret) {
+        // Recognizable by its head, but not readable over a shoulder
+        decoded->display = preview.left(4) + QString(8, QChar(0x2022)) + "  (hidden)";
+    } else {
+        decoded->display = formatForDisplay(preview, truncated, kPreviewLines, &ranges);
+        decoded->highlights = ranges;
+    }
+    decoded->icon = iconFor(entryKinds, entry);
+    if (isArchived(row)) {
+        decoded->icon = QIcon::fromTheme("document-open-recent");
+    } else if (isPinned(row)) {
+        decoded->icon = QIcon::fromTheme("pin", QIcon::fromTheme("emblem-important"));
+    }
+    if (decoded->icon.isNull()) {
+        decoded->icon = QIcon::fromTheme("text-x-generic");
+    }
+    rows.insert(key, decoded, int(rowBytes(*decoded)));
+    MemoryAccounting::set(MemoryAccounting::Subsystem::RowCache, rows.totalCost());
+    return decoded;
+}
+
+qint64 HistoryModel::rowBytes(const Row &row) {
+    // Icons are shared theme icons or small swatches; their pixmaps are not counted
+    return qint64(sizeof(Row)) + MemoryAccounting::stringBytes(row.display)
+           + MemoryAccounting::vectorBytes(row.highlights);
+}
+
+void HistoryModel::accountMemory() const {
+    qint64 bytes = MemoryAccounting::vectorBytes(viewRows) + MemoryAccounting::vectorBytes(archived)
+                   + MemoryAccounting::hashBytes(matchRanges) + rankedRows.memoryBytes();
+    for (const QVector<TextRange> &ranges : matchRanges) {
+        bytes += MemoryAccounting::vectorBytes(ranges);
+    }
+    MemoryAccounting::set(MemoryAccounting::Subsystem::ModelRows, bytes);
+    MemoryAccounting::set(MemoryAccounting::Subsystem::RowCache, rows.totalCost());
+}
+
+// Preview for a matching entry, scrolled so the first match is visible.
+// Ranges come in as offsets into the full text and leave as preview offsets.
+QString HistoryModel::matchPreview(const Utf8Entry &entry, QVector<TextRange> *ranges, bool *truncated) const {
+    const TextRange firstMatch = ranges->first();
+    QString preview = entry.preview(kPreviewLines, kPreviewBytes, truncated);
+    int windowStart = 0;
+
+    if (firstMatch.start + firstMatch.length > preview.size()) {
+        // Past the head: start at the match's line, or just before the match in a long line
+        const QString text = entry.toString();
+        windowStart = firstMatch.start > 0 ? text.lastIndexOf('\n', firstMatch.start - 1) + 1 : 0;
+        if (firstMatch.start - windowStart > kMatchContext) {
+            windowStart = firstMatch.start - kMatchContext;
+            if (text.at(windowStart).isLowSurrogate()) {
+                --windowStart;
+            }
+        }
+
+        int end = windowStart;
+        int lines = 0;
+        bool inLine = false;
+        const int limit = qMin(int(text.size()), windowStart + kPreviewBytes);
+        for (; end < limit; ++end) {
+            if (text.at(end) == '\n') {
+                inLine = false;
+            } else if (!inLine) {
+                inLine = true;
+                if (++lines > kPreviewLines) {
+                    break;
+                }
+            }
+        }
+        if (end < text.size() && end > windowStart && text.at(end).isLowSurrogate()) {
+            --end;
+        }
+        *truncated = end < text.size();
+        preview = text.mid(windowStart, end - windowStart);
+    }
+
+    // Mark the skipped head so the preview doesn't read as the entry's start
+    const QString marker = windowStart > 0 ? QString("… ") : QString();
+    QVector<TextRange> visible;
+    for (const TextRange &range : *ranges) {
+        const int start = qMax(range.start, windowStart) - windowStart;
+        const int end = qMin(range.start + range.length - windowStart, int(preview.size()));
+        if (end > start) {
+            visible.append(TextRange{int(marker.size()) + start, end - start});
+        }
+    }
+    *ranges = visible;
+    return marker + preview;
+}
+
+QVariant HistoryModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return QVariant();
+    }
+    switch (role) {
+    case Qt::DisplayRole:
+        if (const Row *row = rowAt(index.row())) {
+            const ViewRow &viewRow = viewRows.at(index.row());
+            if (viewRow.member) {
+                return "↳ " + row->display;
+            }
+            if (viewRow.similar > 0) {
+                return row->display + QString("\n[+%1 similar]").arg(viewRow.similar);
+            }
+            return row->display;
+        }
+        break;
+    case Qt::DecorationRole:
+        if (const Row *row = rowAt(index.row())) {
+            return row->icon;
+        }
+        break;
+    case EntryTextRole:
+        return entryText(index.row());
+    case SimilarCountRole:
+        return viewRows.at(index.row()).similar;
+    case SimilarMemberRole:
+        return viewRows.at(index.row()).member;
+    case PinnedRole:
+        return isPinned(index.row());
+    case Qt::ToolTipRole: {
+        const QString app = sourceAt(index.row());
+        return app.isEmpty() ? QVariant() : QVariant("Copied from " + app);
+    }
+    case MatchRangesRole:
+        // Only filtered rows have ranges, and they are shown without group decorations
+        if (const Row *row = rowAt(index.row())) {
+            return QVariant::fromValue(row->highlights);
+        }
+        break;
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+QIcon HistoryModel::iconFor(ContentClassifier::Kinds entryKinds, const Utf8Entry &entry) {
+    // Only entries classified as paths are checked on disk, and only short ones
+    if ((entryKinds & ContentClassifier::FilePath) && entry.size() <= kPreviewBytes) {
+        const QString text = entry.toString();
+        if (isFileEntry(text)) {
+            QFileInfo fileInfo(text.split("\n", Qt::SkipEmptyParts).first().trimmed());
+            return QIcon::fromTheme(fileInfo.isDir() ? "folder" : "text-x-generic");
+        }
+    }
+    if (entryKinds & ContentClassifier::Color) {
+        const QColor color = QColor::fromString(entry.toString().trimmed());
+        if (color.isValid()) {
+            QPixmap swatch(16, 16);
+            swatch.fill(color);
+            return QIcon(swatch);
+        }
+    }
+    if (entryKinds & ContentClassifier::Secret) {
+        return QIcon::fromTheme("dialog-password");
+    }
+    if (entryKinds & ContentClassifier::Url) {
+        return QIcon::fromTheme("text-html");
+    }
+    if (entryKinds & ContentClassifier::Email) {
+        return QIcon::fromTheme("mail-message-new");
+    }
+    if (entryKinds & ContentClassifier::Command) {
+        return QIcon::fromTheme("utilities-terminal");
+    }
+    if (entryKinds & (ContentClassifier::Json | ContentClassifier::Code)) {
+        return QIcon::fromTheme("text-x-script");
+    }
+    return QIcon();
+}
+
+bool HistoryModel::isFileEntry(const QString &text) {
+    // Check if the text contains file paths
+    QStringList lines = text.split("\n", Qt::SkipEmptyParts);
+    if (lines.isEmpty()) return false;
+
+    // Check if all lines are valid file paths
+    for (const QString &line : lines) {
+        QFileInfo fileInfo(line.trimmed());
+        if (!fileInfo.exists()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QString HistoryModel::formatForDisplay(const QString &preview, bool truncated, int maxLines,
+                                       QVector<TextRange> *ranges) {
+    // Non-empty lines with their offsets, so match ranges can follow the reformatting
+    struct Line {
+        int start;
+        QString text;
+    };
+    QVector<Line> lines;
+    for (int start = 0; start <= preview.size();) {
+        int end = preview.indexOf('\n', start);
+        if (end < 0) {
+            end = preview.size();
+        }
+        if (end > start) {
+            lines.append(Line{start, preview.mid(start, end - start)});
+        }
+        start = end + 1;
+    }
+
+    // Add bullet points for list-like (multi-line) content
+    const bool bullets = lines.size() > 1;
+    QStringList formattedLines;
+    QVector<TextRange> mapped;
+    int position = 0;
+    for (const Line &line : lines) {
+        QString text = line.text;
+        int lead = 0;
+        int prefix = 0;
+        if (bullets) {
+            while (lead < text.size() && text.at(lead).isSpace()) {
+                ++lead;
+            }
+            text = text.trimmed();
+            if (text.isEmpty()) {
+                continue;
+            }
+            text = "• " + text;
+            prefix = 2;
+        }
+        if (formattedLines.size() == maxLines) {
+            truncated = true;
+            break;
+        }
+        if (ranges) {
+            const int contentStart = line.start + lead;
+            const int contentEnd = contentStart + int(text.size()) - prefix;
+            for (const TextRange &range : *ranges) {
+                const int start = qMax(range.start, contentStart);
+                const int end = qMin(range.start + range.length, contentEnd);
+                if (end > start) {
+                    mapped.append(TextRange{position + prefix + start - contentStart, end - start});
+                }
+            }
+        }
+        formattedLines.append(text);
+        position += int(text.size()) + 1;
+    }
+
+    if (!truncated && formattedLines.size() <= 1) {
+        return preview;   // shown verbatim, so ranges already line up
+    }
+    if (ranges) {
+        *ranges = mapped;
+    }
+    if (!truncated) {
+        return formattedLines.join("\n");
+    }
+    // Truncate to maxLines and add ellipsis
+    formattedLines.append("...");
+    return formattedLines.join("\n");
+}
@@ -0,0 +1,179 @@
+#include "../include/HistorySearch.h"
+#include "../include/HistoryArchive.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMetaObject>
+#include <QThread>
+
+HistorySearch::HistorySearch(QObject *parent)
+    : QObject(parent),
+      patterns(64) {
+    pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+    // Idle workers linger briefly so a burst of keystrokes reuses them
+    pool.setExpiryTimeout(5000);
+    // Cold segments are read newest first, one at a time
+    archivePool.setMaxThreadCount(1);
+}
+
+HistorySearch::~HistorySearch() {
+    cancel();
+    cancelArchive();
+    pool.waitForDone();
+    archivePool.waitForDone();
+}
+
+bool HistorySearch::compile(const QString &pattern, QRegularExpression *regex) {
+    if (QRegularExpression *cached = patterns.object(pattern)) {
+        *regex = *cached;
+        return true;
+    }
+
+    QRegularExpression compiled(pattern, QRegularExpression::CaseInsensitiveOption
+                                             | QRegularExpression::UseUnicodePropertiesOption);
+    if (!compiled.isValid()) {
+        error = QString("%1 at offset %2").arg(compiled.errorString()).arg(compiled.patternErrorOffset());
+        return false;
+    }
+    // Compile and JIT now, on this thread, rather than racing in every shard
+    compiled.optimize();
+    *regex = compiled;
+    patterns.insert(pattern, new QRegularExpression(compiled));
+    return true;
+}
+
+quint64 HistorySearch::start(const HistorySnapshotRef &snapshot, const QString &pattern) {
+    cancel();
+    error.clear();
+
+    QRegularExpression regex;
+    if (snapshot.isNull() || !compile(pattern, &regex)) {
+        return 0;
+    }
+
+    QueryPtr query = std::make_shared<Query>();
+    query->generation = ++generation;
+    query->regex = regex;
+    query->snapshot = snapshot;
+    query->deadline = QDeadlineTimer(budget);
+    current = query;
+
+    // A few shards per thread keeps every core busy when entry sizes vary
+    const int total = snapshot->history.size();
+    const int shardSize = qMax(kMinShardSize, (total + pool.maxThreadCount() * 4 - 1) / (pool.maxThreadCount() * 4));
+    const int shards = qMax(1, (total + shardSize - 1) / shardSize);
+    query->pending.store(shards);
+    for (int first = 0, shard = 0; shard < shards; ++shard, first += shardSize) {
+        const int last = qMin(total, first + shardSize);
+        pool.start([this, query, first, last]() {
+            runShard(query, first, last);
+        });
+    }
+    return query->generation;
+}
+
+void HistorySearch::cancel() {
+    if (current) {
+        current->cancelled.store(true, std::memory_order_relaxed);
+        current.reset();
+    }
+    // Shards of the old query that haven't started yet never will
+    pool.clear();
+}
+
+quint64 HistorySearch::startArchive(const HistoryArchive *archive, const QString &text, int limit) {
+    cancelArchive();
+    if (!archive || text.isEmpty() || archive->isEmpty()) {
+        return 0;
+    }
+
+    QueryPtr query = std::make_shared<Query>();
+    query->generation = ++generation;
+    currentArchive = query;
+    archivePool.start([this, query, archive, text, limit]() {
+        const HistoryArchive::SearchStats stats = archive->search(text, limit, query->cancelled,
+            [this, &query](const QVector<SearchHit> &hits) {
+                QMetaObject::invokeMethod(this, [this, query, hits]() {
+                    if (query == currentArchive) {
+                        emit archiveMatchesFound(query->generation, hits);
+                    }
+                }, Qt::QueuedConnection);
+            });
+        QMetaObject::invokeMethod(this, [this, query, stats]() {
+            if (query == currentArchive) {
+                currentArchive.reset();
+                emit archiveFinished(query->generation, stats.matches, stats.segments, stats.segmentsSkipped);
+            }
+        }, Qt::QueuedConnection);
+    });
+    return query->generation;
+}
+
+void HistorySearch::cancelArchive() {
+    if (currentArchive) {
+        currentArchive->cancelled.store(true, std::memory_order_relaxed);
+        currentArchive.reset();
+    }
+    archivePool.clear();
+}
+
+void HistorySearch::runShard(const QueryPtr &query, int first, int last) {
+    QElapsedTimer sinceFlush;
+    sinceFlush.start();
+    QVector<SearchHit> batch;
+    int index = first;
+
+    query->snapshot->history.forEachInRange(first, last, [&](const HistoryEntry &entry) {
+        if (query->cancelled.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (query->deadline.hasExpired()) {
+            query->expired.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        SearchHit hit;
+        QRegularExpressionMatchIterator it = query->regex.globalMatch(entry.body.toString());
+        while (it.hasNext()) {
+            const QRegularExpressionMatch match = it.next();
+            hit.ranges.append(TextRange{int(match.capturedStart()), int(match.capturedLength())});
+            if (hit.ranges.size() >= kMaxRangesPerEntry) {
+                break;
+            }
+        }
+        if (!hit.ranges.isEmpty()) {
+            hit.entry = index;
+            batch.append(hit);
+        }
+        ++index;
+        if (!batch.isEmpty() && (batch.size() >= kBatchSize || sinceFlush.elapsed() >= kFlushMsecs)) {
+            post(query, batch);
+            batch.clear();
+            sinceFlush.restart();
+        }
+        return true;
+    });
+
+    if (!batch.isEmpty() && !query->cancelled.load(std::memory_order_relaxed)) {
+        post(query, batch);
+    }
+    if (query->pending.fetch_sub(1) == 1 && !query->cancelled.load(std::memory_order_relaxed)) {
+        QMetaObject::invokeMethod(this, [this, query]() {
+            if (query == current) {
+                const bool complete = !query->expired.load(std::memory_order_relaxed);
+                if (!complete) {
+                    qInfo() << "Regex search ran out of its" << budget << "ms budget";
+                }
+                current.reset();
+                emit finished(query->generation, complete);
+            }
+        }, Qt::QueuedConnection);
+    }
+}
+
+void HistorySearch::post(const QueryPtr &query, const QVector<SearchHit> &hits) {
+    // Delivered on the owner's thread; batches of a superseded query are dropped
+    QMetaObject::invokeMethod(this, [this, query, hits]() {
+        if (query == current) {
+            emit matchesFound(query->generation, hits);
+        }
+    }, Qt::QueuedConnection);
+}
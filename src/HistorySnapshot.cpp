@@ -0,0 +1,229 @@
+#include "../include/HistorySnapshot.h"
+#include "../include/MemoryAccounting.h"
+#include <QHash>
+#include <QSet>
+#include <algorithm>
+
+EntryList EntryList::fromList(const QStringList &entries, EntryArena &arena) {
+    QVector<HistoryEntry> stored;
+    stored.reserve(entries.size());
+    for (const QString &text : entries) {
+        HistoryEntry entry;
+        entry.body = arena.store(text);
+        stored.append(entry);
+    }
+    return fromEntries(stored);
+}
+
+EntryList EntryList::fromEntries(const QVector<HistoryEntry> &entries) {
+    EntryList list;
+    for (int i = 0; i < entries.size(); i += kChunkSize) {
+        list.chunks.append(std::make_shared<const Chunk>(entries.mid(i, kChunkSize)));
+    }
+    list.count = entries.size();
+    return list;
+}
+
+int EntryList::compact(EntryArena &arena, std::initializer_list<EntryList *> lists) {
+    QHash<const void *, qint64> live;
+    for (const EntryList *list : lists) {
+        list->forEach([&arena, &live](const HistoryEntry &entry) {
+            if (const void *slab = arena.sharedSlabOf(entry.body)) {
+                live[slab] += entry.body.size();
+            }
+            return true;
+        });
+    }
+    QSet<const void *> sparse;
+    for (auto it = live.cbegin(); it != live.cend(); ++it) {
+        if (it.value() * kSparseSlab < arena.slabBytes()) {
+            sparse.insert(it.key());
+        }
+    }
+    if (sparse.isEmpty()) {
+        return 0;
+    }
+
+    int moved = 0;
+    for (EntryList *list : lists) {
+        for (ChunkPtr &chunk : list->chunks) {
+            const bool touched = std::any_of(chunk->cbegin(), chunk->cend(), [&arena, &sparse](const HistoryEntry &entry) {
+                return sparse.contains(arena.sharedSlabOf(entry.body));
+            });
+            if (!touched) {
+                continue;
+            }
+            auto copy = std::make_shared<Chunk>(*chunk);
+            for (HistoryEntry &entry : *copy) {
+                if (sparse.contains(arena.sharedSlabOf(entry.body))) {
+                    entry.body = arena.restore(entry.body);
+                    ++moved;
+                }
+            }
+            chunk = std::move(copy);
+        }
+    }
+    return moved;
+}
+
+HistoryEntry EntryList::entry(int index) const {
+    if (index < 0 || index >= count) {
+        return HistoryEntry();
+    }
+    for (const ChunkPtr &chunk : chunks) {
+        if (index < chunk->size()) {
+            return chunk->at(index);
+        }
+        index -= chunk->size();
+    }
+    return HistoryEntry();
+}
+
+QString EntryList::at(int index) const {
+    return entry(index).body.toString();
+}
+
+bool EntryList::contains(QByteArrayView utf8, quint32 hash) const {
+    bool found = false;
+    forEach([&](const HistoryEntry &entry) {
+        found = entry.body.equals(utf8, hash);
+        return !found;
+    });
+    return found;
+}
+
+int EntryList::indexOf(QByteArrayView utf8, quint32 hash) const {
+    int index = 0;
+    int found = -1;
+    forEach([&](const HistoryEntry &entry) {
+        if (entry.body.equals(utf8, hash)) {
+            found = index;
+            return false;
+        }
+        ++index;
+        return true;
+    });
+    return found;
+}
+
+QStringList EntryList::toList() const {
+    QStringList list;
+    list.reserve(count);
+    forEach([&list](const HistoryEntry &entry) {
+        list.append(entry.body.toString());
+        return true;
+    });
+    return list;
+}
+
+qint64 EntryList::payloadBytes() const {
+    qint64 bytes = 0;
+    forEach([&bytes](const HistoryEntry &entry) {
+        bytes += entry.body.size();
+        return true;
+    });
+    return bytes;
+}
+
+qint64 EntryList::metadataBytes() const {
+    qint64 bytes = MemoryAccounting::vectorBytes(chunks);
+    for (const ChunkPtr &chunk : chunks) {
+        // The chunk lives in its shared_ptr control block
+        bytes += qint64(sizeof(Chunk)) + 2 * qint64(sizeof(void *)) + MemoryAccounting::vectorBytes(*chunk);
+    }
+    return bytes;
+}
+
+void EntryList::prepend(const HistoryEntry &entry) {
+    if (chunks.isEmpty() || chunks.first()->size() >= kChunkSize) {
+        chunks.prepend(std::make_shared<const Chunk>(Chunk{entry}));
+    } else {
+        auto head = std::make_shared<Chunk>(*chunks.first());
+        head->prepend(entry);
+        chunks[0] = std::move(head);
+    }
+    ++count;
+}
+
+void EntryList::replace(int index, const HistoryEntry &entry) {
+    if (index < 0 || index >= count) {
+        return;
+    }
+    for (ChunkPtr &chunk : chunks) {
+        if (index < chunk->size()) {
+            auto copy = std::make_shared<Chunk>(*chunk);
+            (*copy)[index] = entry;
+            chunk = std::move(copy);
+            return;
+        }
+        index -= chunk->size();
+    }
+}
+
+int EntryList::removeAll(QByteArrayView utf8, quint32 hash) {
+    int removed = 0;
+    for (int i = chunks.size() - 1; i >= 0; --i) {
+        const Chunk &chunk = *chunks.at(i);
+        bool hit = false;
+        for (const HistoryEntry &entry : chunk) {
+            if (entry.body.equals(utf8, hash)) {
+                hit = true;
+                break;
+            }
+        }
+        if (!hit) {
+            continue;
+        }
+        // Only chunks holding a match are copied
+        auto rest = std::make_shared<Chunk>();
+        for (const HistoryEntry &entry : chunk) {
+            if (!entry.body.equals(utf8, hash)) {
+                rest->append(entry);
+            }
+        }
+        removed += int(chunk.size() - rest->size());
+        if (rest->isEmpty()) {
+            chunks.remove(i);
+        } else {
+            chunks[i] = std::move(rest);
+        }
+    }
+    count -= removed;
+    return removed;
+}
+
+void EntryList::truncate(int size) {
+    if (size >= count) {
+        return;
+    }
+    int kept = 0;
+    int i = 0;
+    for (; i < chunks.size() && kept < size; ++i) {
+        const int chunkSize = int(chunks.at(i)->size());
+        if (kept + chunkSize > size) {
+            chunks[i] = std::make_shared<const Chunk>(chunks.at(i)->mid(0, size - kept));
+            kept = size;
+        } else {
+            kept += chunkSize;
+        }
+    }
+    chunks.resize(i);
+    count = size;
+}
+
+void EntryList::clear() {
+    chunks.clear();
+    count = 0;
+}
+
+bool EntryList::isSharedWith(const EntryList &other) const {
+    if (count != other.count || chunks.size() != other.chunks.size()) {
+        return false;
+    }
+    for (int i = 0; i < chunks.size(); ++i) {
+        if (chunks.at(i) != other.chunks.at(i)) {
+            return false;
+        }
+    }
+    return true;
+}
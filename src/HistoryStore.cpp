@@ -0,0 +1,445 @@
+#include "../include/HistoryStore.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const quint32 kSnapshotMagic = 0x5843534E;  // "XCSN"
+const quint32 kJournalMagic = 0x58434A48;   // "XCJH"
+const quint32 kRecordMagic = 0x58434A52;    // "XCJR"
+const quint32 kFormatVersion = 1;
+const int kJournalHeaderSize = 16;          // magic, version, generation
+const int kRecordHeaderSize = 12;           // magic, length, crc32
+const quint32 kMaxRecordSize = 256 * 1024 * 1024;
+
+quint32 crc32(const QByteArray &data) {
+    static quint32 table[256];
+    static bool tableReady = [] {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return true;
+    }();
+    Q_UNUSED(tableReady)
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (char byte : data) {
+        crc = table[(crc ^ quint8(byte)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+QDataStream &configure(QDataStream &stream) {
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::BigEndian);
+    return stream;
+}
+
+QByteArray journalHeader(quint64 generation) {
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    configure(stream) << kJournalMagic << kFormatVersion << generation;
+    return header;
+}
+
+}
+
+HistoryStore::HistoryStore(const QString &directory)
+    : dir(directory.isEmpty() ? defaultDirectory() : directory) {
+}
+
+HistoryStore::~HistoryStore() {
+    close();
+}
+
+QString HistoryStore::defaultDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/Xclipy";
+}
+
+QString HistoryStore::directory() const {
+    return dir;
+}
+
+QString HistoryStore::snapshotPath() const {
+    return dir + "/history.snap";
+}
+
+QString HistoryStore::journalPath() const {
+    return dir + "/history.journal";
+}
+
+bool HistoryStore::exists() const {
+    return QFile::exists(snapshotPath()) || QFile::exists(journalPath());
+}
+
+void HistoryStore::setReadOnly(bool enabled) {
+    if (enabled) {
+        close();
+    }
+    readOnly = enabled;
+}
+
+bool HistoryStore::recover(State *state, RecoveryStats *stats) {
+    QElapsedTimer timer;
+    timer.start();
+
+    RecoveryStats localStats;
+    RecoveryStats *s = stats ? stats : &localStats;
+    *s = RecoveryStats();
+    *state = State();
+    generation = 0;
+
+    bool ok = loadSnapshot(state, s);
+    ok = replayJournal(state, s) && ok;
+    s->recoveryMs = timer.elapsed();
+    return ok;
+}
+
+bool HistoryStore::loadSnapshot(State *state, RecoveryStats *stats) {
+    QFile file(snapshotPath());
+    if (!file.exists()) {
+        return true;
+    }
+    stats->snapshotFound = true;
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot read history snapshot:" << file.errorString();
+        return false;
+    }
+
+    QByteArray data = file.readAll();
+    QDataStream header(data);
+    configure(header);
+    quint32 magic = 0, version = 0, bodyLength = 0, checksum = 0;
+    quint64 snapshotGeneration = 0;
+    header >> magic >> version >> snapshotGeneration >> bodyLength >> checksum;
+
+    const int headerSize = 24;
+    if (header.status() != QDataStream::Ok || magic != kSnapshotMagic || version != kFormatVersion
+        || qint64(bodyLength) != data.size() - headerSize) {
+        qWarning() << "History snapshot has an invalid header; ignoring it";
+        return false;
+    }
+
+    QByteArray body = data.mid(headerSize);
+    if (crc32(body) != checksum) {
+        qWarning() << "History snapshot checksum mismatch; ignoring it";
+        return false;
+    }
+
+    QDataStream bodyStream(body);
+    configure(bodyStream) >> state->history >> state->selections;
+    if (bodyStream.status() != QDataStream::Ok) {
+        *state = State();
+        qWarning() << "History snapshot body is unreadable; ignoring it";
+        return false;
+    }
+
+    generation = snapshotGeneration;
+    stats->snapshotValid = true;
+    return true;
+}
+
+bool HistoryStore::replayJournal(State *state, RecoveryStats *stats) {
+    QFile file(journalPath());
+    if (!file.exists()) {
+        return true;
+    }
+    if (!file.open(readOnly ? QIODevice::ReadOnly : QIODevice::ReadWrite)) {
+        qWarning() << "Cannot open history journal:" << file.errorString();
+        return false;
+    }
+
+    QByteArray data = file.readAll();
+    if (data.size() < kJournalHeaderSize || !data.startsWith(journalHeader(generation).left(8))) {
+        // Torn or foreign header: nothing in it can be trusted
+        stats->discardedBytes = data.size();
+        if (!readOnly) {
+            file.resize(0);
+        }
+        return true;
+    }
+    if (data.left(kJournalHeaderSize) != journalHeader(generation)) {
+        // Journal of an older generation, already folded into the snapshot
+        return true;
+    }
+
+    const qint64 offset = kJournalHeaderSize
+                          + replayRecords(state, QByteArrayView(data).sliced(kJournalHeaderSize),
+                                          &stats->journalRecords);
+
+    stats->discardedBytes = data.size() - offset;
+    if (stats->discardedBytes > 0 && readOnly) {
+        // Most likely the writer's batch in flight; it will arrive through the ring
+        return true;
+    }
+    if (stats->discardedBytes > 0) {
+        // Drop the torn tail so the next append starts on a record boundary
+        qWarning() << "History journal: discarded" << stats->discardedBytes
+                   << "bytes of incomplete records";
+        file.resize(offset);
+        syncToDisk(file);
+    }
+    return true;
+}
+
+qint64 HistoryStore::replayRecords(State *state, QByteArrayView records, int *applied) {
+    qint64 offset = 0;
+    while (records.size() - offset >= kRecordHeaderSize) {
+        const uchar *header = reinterpret_cast<const uchar *>(records.data() + offset);
+        const quint32 magic = qFromBigEndian<quint32>(header);
+        const quint32 length = qFromBigEndian<quint32>(header + 4);
+        const quint32 checksum = qFromBigEndian<quint32>(header + 8);
+        if (magic != kRecordMagic || length > kMaxRecordSize
+            || qint64(length) > records.size() - offset - kRecordHeaderSize) {
+            break;
+        }
+        // Parsed in place; the records may be a view into shared memory
+        const QByteArray payload = QByteArray::fromRawData(records.data() + offset + kRecordHeaderSize,
+                                                           qsizetype(length));
+        if (crc32(payload) != checksum) {
+            break;
+        }
+        applyRecord(state, payload);
+        offset += kRecordHeaderSize + length;
+        if (applied) {
+            ++*applied;
+        }
+    }
+    return offset;
+}
+
+void HistoryStore::applyRecord(State *state, const QByteArray &payload) {
+    QDataStream stream(payload);
+    configure(stream);
+    quint8 op = 0, list = 0;
+    stream >> op >> list;
+    QStringList &target = List(list) == List::Selections ? state->selections : state->history;
+
+    switch (Op(op)) {
+    case Op::Prepend: {
+        QString text;
+        stream >> text;
+        target.removeAll(text);
+        target.prepend(text);
+        break;
+    }
+    case Op::PrependCompressed: {
+        QByteArray compressed;
+        stream >> compressed;
+        QString text = QString::fromUtf8(qUncompress(compressed));
+        target.removeAll(text);
+        target.prepend(text);
+        break;
+    }
+    case Op::Remove: {
+        QString text;
+        stream >> text;
+        target.removeAll(text);
+        break;
+    }
+    case Op::Clear:
+        target.clear();
+        break;
+    case Op::Truncate: {
+        qint32 size = 0;
+        stream >> size;
+        while (target.size() > qMax(0, size)) {
+            target.removeLast();
+        }
+        break;
+    }
+    }
+}
+
+bool HistoryStore::open() {
+    if (journal.isOpen()) {
+        return true;
+    }
+    if (readOnly) {
+        return false;
+    }
+    if (!QDir().mkpath(dir)) {
+        qWarning() << "Cannot create history directory:" << dir;
+        return false;
+    }
+
+    QFile existing(journalPath());
+    if (existing.open(QIODevice::ReadOnly)
+        && existing.read(kJournalHeaderSize) == journalHeader(generation)) {
+        existing.close();
+        journal.setFileName(journalPath());
+        return journal.open(QIODevice::WriteOnly | QIODevice::Append);
+    }
+    existing.close();
+    return startJournal();
+}
+
+bool HistoryStore::isOpen() const {
+    return journal.isOpen();
+}
+
+void HistoryStore::close() {
+    if (journal.isOpen()) {
+        commit();
+        journal.close();
+    }
+}
+
+bool HistoryStore::startJournal() {
+    journal.close();
+
+    QSaveFile file(journalPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot create history journal:" << file.errorString();
+        return false;
+    }
+    file.write(journalHeader(generation));
+    if (!file.flush() || !syncToDisk(file) || !file.commit()) {
+        qWarning() << "Cannot write history journal:" << file.errorString();
+        return false;
+    }
+
+    journal.setFileName(journalPath());
+    return journal.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+void HistoryStore::appendRecord(const QByteArray &payload) {
+    if (!journal.isOpen()) {
+        return;
+    }
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    configure(stream) << kRecordMagic << quint32(payload.size()) << crc32(payload);
+    record.append(payload);
+    pendingRecords.append(record);
+}
+
+void HistoryStore::recordPrepend(List list, const QString &text) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    configure(stream) << quint8(Op::Prepend) << quint8(list) << text;
+    appendRecord(payload);
+}
+
+void HistoryStore::recordPrependCompressed(List list, const QByteArray &compressedUtf8) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    configure(stream) << quint8(Op::PrependCompressed) << quint8(list) << compressedUtf8;
+    appendRecord(payload);
+}
+
+void HistoryStore::recordRemove(List list, const QString &text) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    configure(stream) << quint8(Op::Remove) << quint8(list) << text;
+    appendRecord(payload);
+}
+
+void HistoryStore::recordClear(List list) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    configure(stream) << quint8(Op::Clear) << quint8(list);
+    appendRecord(payload);
+}
+
+void HistoryStore::recordTruncate(List list, int size) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    configure(stream) << quint8(Op::Truncate) << quint8(list) << qint32(size);
+    appendRecord(payload);
+}
+
+bool HistoryStore::commit(QByteArray *committed) {
+    if (pendingRecords.isEmpty() || !journal.isOpen()) {
+        return true;
+    }
+    // A single write per batch keeps each commit contiguous in the journal
+    bool ok = journal.write(pendingRecords) == pendingRecords.size()
+              && journal.flush() && syncToDisk(journal);
+    if (ok && committed) {
+        committed->append(pendingRecords);
+    }
+    pendingRecords.clear();
+    if (!ok) {
+        qWarning() << "History journal write failed:" << journal.errorString();
+    }
+    return ok;
+}
+
+bool HistoryStore::writeSnapshot(const State &state) {
+    if (readOnly) {
+        return false;
+    }
+    if (!QDir().mkpath(dir)) {
+        qWarning() << "Cannot create history directory:" << dir;
+        return false;
+    }
+
+    QByteArray body;
+    QDataStream bodyStream(&body, QIODevice::WriteOnly);
+    configure(bodyStream) << state.history << state.selections;
+
+    quint64 nextGeneration = generation + 1;
+    QByteArray header;
+    QDataStream headerStream(&header, QIODevice::WriteOnly);
+    configure(headerStream) << kSnapshotMagic << kFormatVersion << nextGeneration
+                            << quint32(body.size()) << crc32(body);
+
+    QSaveFile file(snapshotPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write history snapshot:" << file.errorString();
+        return false;
+    }
+    file.write(header);
+    file.write(body);
+    if (!file.flush() || !syncToDisk(file) || !file.commit()) {
+        qWarning() << "Cannot write history snapshot:" << file.errorString();
+        return false;
+    }
+
+#ifndef Q_OS_WIN
+    // Make the rename itself durable
+    int dirFd = ::open(QFile::encodeName(dir).constData(), O_RDONLY);
+    if (dirFd >= 0) {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+#endif
+
+    // Records up to now are part of the snapshot; the old journal is now stale
+    pendingRecords.clear();
+    generation = nextGeneration;
+    return startJournal();
+}
+
+bool HistoryStore::needsCompaction() const {
+    return journal.isOpen() && journal.size() > compactionThreshold;
+}
+
+void HistoryStore::setCompactionThreshold(qint64 bytes) {
+    compactionThreshold = bytes;
+}
+
+bool HistoryStore::syncToDisk(QFileDevice &file) {
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
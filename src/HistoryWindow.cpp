@@ -1,12 +1,16 @@
 #include "../include/HistoryWindow.h"
 #include "../include/ClipboardManager.h"
+#include "../include/HistoryModel.h"
+#include "../include/PreviewPane.h"
 #include <QApplication>
 #include <QCloseEvent>
-#include <QListWidgetItem>
 #include <QContextMenuEvent>
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QAction>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QSplitter>
 #include <QHeaderView>
 #include <QLineEdit>
 #include <QMenu>
@@ -15,6 +19,8 @@
 #include <QStyle>
 #include <QTextDocument>
 #include <QTextOption>
+#include <QTextCursor>
+#include <QTextCharFormat>
 #include <QMouseEvent>
 #include <QPushButton>
 #include <QStyleOptionButton>
@@ -23,6 +29,7 @@
 #include <QGraphicsOpacityEffect>
 #include <QPropertyAnimation>
 #include <QScreen>
+#include <QSignalBlocker>
 
 
 
@@ -63,6 +70,20 @@ void HistoryItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &o
     QTextDocument doc;
     doc.setPlainText(text);
     doc.setDefaultTextOption(QTextOption(Qt::AlignLeft | Qt::AlignTop));
+
+    // Highlight matches from the ranges the filter or search already found
+    const QVector<TextRange> ranges = index.data(HistoryModel::MatchRangesRole).value<QVector<TextRange>>();
+    if (!ranges.isEmpty()) {
+        QTextCharFormat matchFormat;
+        matchFormat.setBackground(QColor(255, 200, 0, 170));
+        matchFormat.setForeground(Qt::black);
+        QTextCursor cursor(&doc);
+        for (const TextRange &range : ranges) {
+            cursor.setPosition(range.start);
+            cursor.setPosition(range.start + range.length, QTextCursor::KeepAnchor);
+            cursor.mergeCharFormat(matchFormat);
+        }
+    }
     
     // Set document width
     doc.setTextWidth(textRect.width() - 10);
@@ -92,6 +113,15 @@ void HistoryItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &o
     painter->drawLine(xRect.topRight(), xRect.bottomLeft());
     
     painter->restore();
+
+    // Rule off the pinned section from the history below it
+    if (index.data(HistoryModel::PinnedRole).toBool()
+        && !index.sibling(index.row() + 1, 0).data(HistoryModel::PinnedRole).toBool()) {
+        painter->save();
+        painter->setPen(QPen(opt.palette.mid().color(), 2));
+        painter->drawLine(opt.rect.bottomLeft(), opt.rect.bottomRight());
+        painter->restore();
+    }
 }
 
 QSize HistoryItemDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const {
@@ -130,7 +160,7 @@ HistoryWindow::HistoryWindow(ClipboardManager *manager, QWidget *parent)
     : QWidget(parent), clipboardManager(manager), shouldHideAfterCopy(true) {
 
     setWindowTitle("Xclipy - Clipboard History");
-    resize(500, 400);
+    resize(500, 560);
 
     // Always stay on top of all applications
     setWindowFlags(Qt::Window | Qt::WindowStaysOnTopHint | Qt::Tool);
@@ -143,10 +173,10 @@ HistoryWindow::HistoryWindow(ClipboardManager *manager, QWidget *parent)
     setupContextMenu();
 
     // Copy from history using ClipboardManager
-    connect(listWidget, &QListWidget::itemClicked, this, &HistoryWindow::onItemClicked);
+    connect(listView, &QListView::clicked, this, &HistoryWindow::onItemClicked);
 
     // Double-click to copy
-    connect(listWidget, &QListWidget::itemDoubleClicked, this, &HistoryWindow::onItemDoubleClicked);
+    connect(listView, &QListView::doubleClicked, this, &HistoryWindow::onItemDoubleClicked);
     
     // Setup hide timer
     hideTimer = new QTimer(this);
@@ -192,39 +222,84 @@ void HistoryWindow::setupUI() {
     searchBox = new QLineEdit(this);
     searchBox->setPlaceholderText("Type to filter history...");
     searchBox->setClearButtonEnabled(true);
+    regexCheckBox = new QCheckBox("Regex", this);
+    regexCheckBox->setToolTip("Match entries against a regular expression (case-insensitive)");
+    rankCheckBox = new QCheckBox("Most used", this);
+    rankCheckBox->setToolTip("Order by frecency: how often and how recently each entry was copied or pasted");
+    kindFilterBox = new QComboBox(this);
+    kindFilterBox->setToolTip("Show only entries of one type");
+    kindFilterBox->addItem("All types", 0);
+    for (int i = 0; i < ContentClassifier::kKindCount; ++i) {
+        const ContentClassifier::Kind kind = ContentClassifier::kindAt(i);
+        kindFilterBox->addItem(ContentClassifier::kindName(kind), uint(kind));
+    }
+    sourceFilterBox = new QComboBox(this);
+    sourceFilterBox->setToolTip("Show only entries copied from one application");
+    sourceFilterBox->addItem("All apps", QString());
+    searchStatusLabel = new QLabel(this);
+    searchStatusLabel->hide();
+    historySearch = new HistorySearch(this);
     
     searchLayout->addWidget(searchLabel);
     searchLayout->addWidget(searchBox);
+    searchLayout->addWidget(regexCheckBox);
+    searchLayout->addWidget(rankCheckBox);
+    searchLayout->addWidget(kindFilterBox);
+    searchLayout->addWidget(sourceFilterBox);
     mainLayout->addLayout(searchLayout);
-    
-    // List widget
-    listWidget = new QListWidget(this);
-    listWidget->setWordWrap(true);
-    listWidget->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-    listWidget->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-    listWidget->setAlternatingRowColors(true);
-    listWidget->setSelectionMode(QAbstractItemView::SingleSelection);
-    
-
+    mainLayout->addWidget(searchStatusLabel);
+    
+    // List view over the published snapshot; rows are decoded only when shown
+    historyModel = new HistoryModel(this);
+    listView = new QListView(this);
+    historyModel->setRankByFrecency(clipboardManager && clipboardManager->getRankByFrecency());
+    rankCheckBox->setChecked(clipboardManager && clipboardManager->getRankByFrecency());
+    listView->setModel(historyModel);
+    listView->setWordWrap(true);
+    listView->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    listView->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    listView->setAlternatingRowColors(true);
+    listView->setSelectionMode(QAbstractItemView::SingleSelection);
+    listView->setLayoutMode(QListView::Batched);
     
     // Enable mouse tracking for hover effects
-    listWidget->setMouseTracking(true);
+    listView->setMouseTracking(true);
     
-    // Enable resizable columns (for future table view)
-    listWidget->setUniformItemSizes(false);
+    // Rows wrap to different heights
+    listView->setUniformItemSizes(false);
     
     // Set custom delegate
     itemDelegate = new HistoryItemDelegate(this);
-    listWidget->setItemDelegate(itemDelegate);
+    listView->setItemDelegate(itemDelegate);
     
     // Connect delete signal
     connect(itemDelegate, &HistoryItemDelegate::deleteItemRequested, this, &HistoryWindow::onDeleteItemRequested);
     
-    mainLayout->addWidget(listWidget);
+    // The selected entry in full below the list, paged from its stored body
+    previewPane = new PreviewPane(this);
+    previewStatusLabel = new QLabel(this);
+    previewStatusLabel->hide();
+    splitter = new QSplitter(Qt::Vertical, this);
+    splitter->addWidget(listView);
+    splitter->addWidget(previewPane);
+    splitter->setStretchFactor(0, 3);
+    splitter->setStretchFactor(1, 2);
+    mainLayout->addWidget(splitter);
+    mainLayout->addWidget(previewStatusLabel);
     setLayout(mainLayout);
     
-    // Connect search box
+    // Connect search box; regex results stream in from the search pool
     connect(searchBox, &QLineEdit::textChanged, this, &HistoryWindow::filterHistory);
+    connect(regexCheckBox, &QCheckBox::toggled, this, &HistoryWindow::onRegexToggled);
+    connect(rankCheckBox, &QCheckBox::toggled, this, &HistoryWindow::onRankToggled);
+    connect(kindFilterBox, &QComboBox::currentIndexChanged, this, &HistoryWindow::onKindFilterChanged);
+    connect(sourceFilterBox, &QComboBox::currentIndexChanged, this, &HistoryWindow::onSourceFilterChanged);
+    connect(listView->selectionModel(), &QItemSelectionModel::currentChanged, this, &HistoryWindow::onCurrentRowChanged);
+    connect(previewPane, &PreviewPane::indexProgress, this, &HistoryWindow::onPreviewProgress);
+    connect(historySearch, &HistorySearch::matchesFound, this, &HistoryWindow::onSearchMatches);
+    connect(historySearch, &HistorySearch::finished, this, &HistoryWindow::onSearchFinished);
+    connect(historySearch, &HistorySearch::archiveMatchesFound, this, &HistoryWindow::onArchiveMatches);
+    connect(historySearch, &HistorySearch::archiveFinished, this, &HistoryWindow::onArchiveFinished);
 }
 
 void HistoryWindow::setupContextMenu() {
@@ -234,115 +309,201 @@ void HistoryWindow::setupContextMenu() {
     QAction *copyAsFilesAction = new QAction("Copy as Files", this);
     QAction *removeAction = new QAction("Remove", this);
     QAction *clearAllAction = new QAction("Clear All", this);
+    toggleSimilarAction = new QAction("Show Similar", this);
+    togglePinAction = new QAction("Pin", this);
     
     connect(copyAction, &QAction::triggered, this, &HistoryWindow::copySelectedItem);
     connect(copyAsFilesAction, &QAction::triggered, this, &HistoryWindow::copySelectedItemAsFiles);
     connect(removeAction, &QAction::triggered, this, &HistoryWindow::removeSelectedItem);
     connect(clearAllAction, &QAction::triggered, this, &HistoryWindow::clearAllItems);
+    connect(toggleSimilarAction, &QAction::triggered, this, &HistoryWindow::toggleSimilarItems);
+    connect(togglePinAction, &QAction::triggered, this, &HistoryWindow::togglePinnedItem);
     
     contextMenu->addAction(copyAction);
     contextMenu->addAction(copyAsFilesAction);
+    contextMenu->addAction(togglePinAction);
+    contextMenu->addAction(toggleSimilarAction);
     contextMenu->addSeparator();
     contextMenu->addAction(removeAction);
     contextMenu->addAction(clearAllAction);
 }
 
-void HistoryWindow::updateHistory(const QStringList &history) {
-    originalHistory = history;
-    filteredHistory = history;
-    
-    // Apply current filter
-    if (!searchBox->text().isEmpty()) {
-        filterHistory(searchBox->text());
-    } else {
-        listWidget->clear();
-        for (int i = 0; i < history.size(); ++i) {
-            createListItem(history[i], i);
-        }
+void HistoryWindow::updateHistory(const HistorySnapshotRef &snapshot) {
+    currentSnapshot = snapshot;
+    if (historyModel->isSearching()) {
+        // Match indexes belong to one snapshot; search the new one instead
+        startRegexSearch();
+        return;
+    }
+    // The current filter is re-applied by the model
+    historyModel->setSnapshot(snapshot);
+    if (isVisible()) {
+        refreshSourceFilter();
     }
 }
 
-void HistoryWindow::createListItem(const QString &text, int index) {
-    Q_UNUSED(index)
-    QListWidgetItem *item = new QListWidgetItem();
-    
-    // Format text for display with truncation
-    QString displayText = formatTextForDisplay(text);
-    item->setText(displayText);
-    item->setData(Qt::UserRole, text); // Store original text
-    
-    // Set icon for file/folder entries
-    if (isFileEntry(text)) {
-        QStringList files = text.split("\n", Qt::SkipEmptyParts);
-        if (!files.isEmpty()) {
-            QFileInfo fileInfo(files.first());
-            if (fileInfo.isDir()) {
-                item->setIcon(QIcon::fromTheme("folder"));
-            } else {
-                item->setIcon(QIcon::fromTheme("text-x-generic"));
-            }
-        }
-    } else {
-        item->setIcon(QIcon::fromTheme("text-x-generic"));
+void HistoryWindow::filterHistory(const QString &filter) {
+    if (regexCheckBox->isChecked()) {
+        startRegexSearch();
+        return;
     }
-    
-    listWidget->addItem(item);
+    historyModel->setFilter(filter);
+    startArchiveSearch();
 }
 
-QString HistoryWindow::formatTextForDisplay(const QString &text) const {
-    // Check if text contains multiple lines (list-like content)
-    QStringList lines = text.split("\n", Qt::SkipEmptyParts);
-    
-    if (lines.size() > 1) {
-        // Add bullet points for list items
-        QStringList formattedLines;
-        for (const QString &line : lines) {
-            if (!line.trimmed().isEmpty()) {
-                formattedLines.append("• " + line.trimmed());
-            }
-        }
-        return truncateText(formattedLines.join("\n"));
-    } else {
-        // Single line text
-        return truncateText(text);
+// The plain filter also looks in the cold archive; its hits trail the live rows
+void HistoryWindow::startArchiveSearch() {
+    const QString text = searchBox->text();
+    const HistoryArchive *archive = clipboardManager ? clipboardManager->historyArchive() : nullptr;
+    if (historySearch->startArchive(archive, text) == 0) {
+        searchStatusLabel->hide();
+        return;
     }
+    searchStatusLabel->setText("Searching archive...");
+    searchStatusLabel->show();
 }
 
-QString HistoryWindow::truncateText(const QString &text, int maxLines) const {
-    QStringList lines = text.split("\n", Qt::SkipEmptyParts);
-    
-    if (lines.size() <= maxLines) {
-        return text;
+void HistoryWindow::onRegexToggled(bool enabled) {
+    if (enabled) {
+        // Archive segments are filtered by trigrams, which a regex can't use
+        historySearch->cancelArchive();
+        historyModel->setFilter(QString());
+        startRegexSearch();
+        return;
     }
-    
-    // Truncate to maxLines and add ellipsis
-    QStringList truncatedLines = lines.mid(0, maxLines);
-    truncatedLines.append("...");
-    return truncatedLines.join("\n");
+    historySearch->cancel();
+    searchStatusLabel->hide();
+    historyModel->endSearch();
+    historyModel->setFilter(searchBox->text());
+    startArchiveSearch();
 }
 
-void HistoryWindow::filterHistory(const QString &filter) {
-    listWidget->clear();
-    
-    if (filter.isEmpty()) {
-        filteredHistory = originalHistory;
-    } else {
-        filteredHistory.clear();
-        for (const QString &text : originalHistory) {
-            if (text.contains(filter, Qt::CaseInsensitive)) {
-                filteredHistory.append(text);
-            }
-        }
+void HistoryWindow::onRankToggled(bool enabled) {
+    if (clipboardManager) {
+        clipboardManager->setRankByFrecency(enabled);
     }
-    
-    for (int i = 0; i < filteredHistory.size(); ++i) {
-        createListItem(filteredHistory[i], i);
+    historyModel->setRankByFrecency(enabled);
+    if (historyModel->isSearching()) {
+        startRegexSearch();
+    }
+}
+
+// A reset leaves no current row; the pane keeps what it shows until another is picked
+void HistoryWindow::onCurrentRowChanged(const QModelIndex &current) {
+    if (!current.isValid()) {
+        return;
+    }
+    const int row = current.row();
+    previewPane->setEntry(historyModel->entryAt(row),
+                          historyModel->kindsAt(row) & ContentClassifier::Secret,
+                          historyModel->firstMatchAt(row));
+}
+
+void HistoryWindow::onPreviewProgress(int lines, bool complete) {
+    if (complete) {
+        previewStatusLabel->hide();
+        return;
+    }
+    previewStatusLabel->setText(QString("Indexing lines... %1").arg(lines));
+    previewStatusLabel->show();
+}
+
+void HistoryWindow::onKindFilterChanged(int index) {
+    historyModel->setKindFilter(ContentClassifier::Kinds(kindFilterBox->itemData(index).toUInt()));
+    if (historyModel->isSearching()) {
+        startRegexSearch();
+        return;
     }
+    startArchiveSearch();
 }
 
-void HistoryWindow::onItemClicked(QListWidgetItem *item) {
-    if (item && clipboardManager) {
-        QString originalText = item->data(Qt::UserRole).toString();
+void HistoryWindow::onSourceFilterChanged(int index) {
+    historyModel->setSourceFilter(sourceFilterBox->itemData(index).toString());
+    if (historyModel->isSearching()) {
+        startRegexSearch();
+        return;
+    }
+    startArchiveSearch();
+}
+
+void HistoryWindow::refreshSourceFilter() {
+    const QString current = historyModel->sourceFilter();
+    QStringList apps = historyModel->sourceApps();
+    if (!current.isEmpty() && !apps.contains(current)) {
+        apps.prepend(current);  // its entries are gone, but the choice stays until changed
+    }
+    QSignalBlocker blocker(sourceFilterBox);
+    while (sourceFilterBox->count() > 1) {
+        sourceFilterBox->removeItem(1);
+    }
+    for (const QString &app : apps) {
+        sourceFilterBox->addItem(app, app);
+    }
+    sourceFilterBox->setCurrentIndex(qMax(0, sourceFilterBox->findData(current)));
+    sourceFilterBox->setVisible(apps.size() > 0);
+}
+
+// Every keystroke lands here; starting a query cancels the one in flight
+void HistoryWindow::startRegexSearch() {
+    const QString pattern = searchBox->text();
+    if (pattern.isEmpty()) {
+        historySearch->cancel();
+        searchStatusLabel->hide();
+        historyModel->endSearch();
+        return;
+    }
+
+    searchMatchCount = 0;
+    historyModel->beginSearch(currentSnapshot);
+    if (historySearch->start(currentSnapshot, pattern) == 0) {
+        searchStatusLabel->setText("Invalid pattern: " + historySearch->errorString());
+        searchStatusLabel->setVisible(!historySearch->errorString().isEmpty());
+        return;
+    }
+    searchStatusLabel->setText("Searching...");
+    searchStatusLabel->show();
+}
+
+void HistoryWindow::onSearchMatches(quint64 generation, const QVector<SearchHit> &hits) {
+    Q_UNUSED(generation)
+    historyModel->addMatches(hits);
+    searchMatchCount += hits.size();
+    searchStatusLabel->setText(QString("Searching... %1 matches").arg(searchMatchCount));
+}
+
+void HistoryWindow::onSearchFinished(quint64 generation, bool complete) {
+    Q_UNUSED(generation)
+    if (complete) {
+        searchStatusLabel->setText(QString("%1 matches").arg(searchMatchCount));
+    } else {
+        searchStatusLabel->setText(QString("%1 matches (stopped after %2 ms; refine the pattern)")
+                                       .arg(searchMatchCount)
+                                       .arg(historySearch->timeBudget()));
+    }
+}
+
+void HistoryWindow::onArchiveMatches(quint64 generation, const QVector<SearchHit> &hits) {
+    Q_UNUSED(generation)
+    historyModel->addArchiveMatches(hits);
+}
+
+void HistoryWindow::onArchiveFinished(quint64 generation, int matches, int segments, int segmentsSkipped) {
+    Q_UNUSED(generation)
+    searchStatusLabel->setText(QString("%1 archived matches (skipped %2 of %3 segments)")
+                                   .arg(matches)
+                                   .arg(segmentsSkipped)
+                                   .arg(segments));
+}
+
+QString HistoryWindow::currentEntryText() const {
+    QModelIndex index = listView->currentIndex();
+    return index.isValid() ? historyModel->entryText(index.row()) : QString();
+}
+
+void HistoryWindow::onItemClicked(const QModelIndex &index) {
+    if (index.isValid() && clipboardManager) {
+        // Full text is decoded only now, on copy
+        QString originalText = historyModel->entryText(index.row());
         if (isFileEntry(originalText)) {
             clipboardManager->setClipboardFiles(originalText.split("\n", Qt::SkipEmptyParts));
         } else {
@@ -359,23 +520,20 @@ void HistoryWindow::onItemClicked(QListWidgetItem *item) {
     }
 }
 
-void HistoryWindow::onItemDoubleClicked(QListWidgetItem *item) {
-    Q_UNUSED(item)
-    onItemClicked(listWidget->currentItem());
+void HistoryWindow::onItemDoubleClicked(const QModelIndex &index) {
+    Q_UNUSED(index)
+    onItemClicked(listView->currentIndex());
 }
 
 void HistoryWindow::copySelectedItem() {
-    QListWidgetItem *currentItem = listWidget->currentItem();
-    if (currentItem && clipboardManager) {
-        QString originalText = currentItem->data(Qt::UserRole).toString();
-        clipboardManager->setClipboardText(originalText);
+    if (listView->currentIndex().isValid() && clipboardManager) {
+        clipboardManager->setClipboardText(currentEntryText());
     }
 }
 
 void HistoryWindow::copySelectedItemAsFiles() {
-    QListWidgetItem *currentItem = listWidget->currentItem();
-    if (currentItem && clipboardManager) {
-        QString originalText = currentItem->data(Qt::UserRole).toString();
+    if (listView->currentIndex().isValid() && clipboardManager) {
+        QString originalText = currentEntryText();
         if (isFileEntry(originalText)) {
             QStringList files = originalText.split("\n", Qt::SkipEmptyParts);
             clipboardManager->setClipboardFiles(files);
@@ -387,9 +545,9 @@ void HistoryWindow::copySelectedItemAsFiles() {
 }
 
 void HistoryWindow::onDeleteItemRequested(int row) {
-    QListWidgetItem *item = listWidget->item(row);
-    if (item) {
-        QString textToRemove = item->data(Qt::UserRole).toString();
+    // Archived rows are read-only
+    if (row >= 0 && row < historyModel->rowCount() && !historyModel->isArchived(row)) {
+        QString textToRemove = historyModel->entryText(row);
         
         // Remove from manager's history (this will update our display via signal)
         if (clipboardManager) {
@@ -399,9 +557,8 @@ void HistoryWindow::onDeleteItemRequested(int row) {
 }
 
 void HistoryWindow::removeSelectedItem() {
-    QListWidgetItem *currentItem = listWidget->currentItem();
-    if (currentItem) {
-        QString textToRemove = currentItem->data(Qt::UserRole).toString();
+    if (listView->currentIndex().isValid() && !historyModel->isArchived(listView->currentIndex().row())) {
+        QString textToRemove = currentEntryText();
         
         // Remove from manager's history (this will update our display via signal)
         if (clipboardManager) {
@@ -410,6 +567,18 @@ void HistoryWindow::removeSelectedItem() {
     }
 }
 
+void HistoryWindow::togglePinnedItem() {
+    const QModelIndex index = listView->currentIndex();
+    if (!index.isValid() || !clipboardManager || historyModel->isArchived(index.row())) {
+        return;
+    }
+    if (historyModel->isPinned(index.row())) {
+        clipboardManager->unpinEntry(historyModel->entryText(index.row()));
+    } else {
+        clipboardManager->pinEntry(historyModel->entryText(index.row()));
+    }
+}
+
 void HistoryWindow::clearAllItems() {
     if (clipboardManager) {
         clipboardManager->clearHistory();
@@ -418,6 +587,7 @@ void HistoryWindow::clearAllItems() {
 
 void HistoryWindow::showWindow() {
     shouldHideAfterCopy = false;
+    refreshSourceFilter();
     show();
     raise();
     activateWindow();
@@ -426,27 +596,35 @@ void HistoryWindow::showWindow() {
 }
 
 bool HistoryWindow::isFileEntry(const QString &text) const {
-    // Check if the text contains file paths
-    QStringList lines = text.split("\n", Qt::SkipEmptyParts);
-    if (lines.isEmpty()) return false;
-    
-    // Check if all lines are valid file paths
-    for (const QString &line : lines) {
-        QFileInfo fileInfo(line.trimmed());
-        if (!fileInfo.exists()) {
-            return false;
-        }
-    }
-    
-    return true;
+    return HistoryModel::isFileEntry(text);
 }
 
 
 
+void HistoryWindow::toggleSimilarItems() {
+    QModelIndex index = listView->currentIndex();
+    if (!index.isValid()) {
+        return;
+    }
+    historyModel->toggleGroup(index.row());
+    // The head row keeps its position, so keep it selected after the reset
+    listView->setCurrentIndex(historyModel->index(index.row()));
+}
+
 void HistoryWindow::contextMenuEvent(QContextMenuEvent *event) {
-    QListWidgetItem *item = listWidget->itemAt(listWidget->mapFromParent(event->pos()));
-    if (item) {
-        listWidget->setCurrentItem(item);
+    QModelIndex index = listView->indexAt(listView->viewport()->mapFrom(this, event->pos()));
+    if (index.isValid()) {
+        listView->setCurrentIndex(index);
+
+        // Only the head of a near-duplicate group can fold its older clips
+        const int similar = index.data(HistoryModel::SimilarCountRole).toInt();
+        toggleSimilarAction->setVisible(similar > 0);
+        toggleSimilarAction->setText(historyModel->isGroupExpanded(index.row())
+                                         ? QString("Hide Similar")
+                                         : QString("Show %1 Similar").arg(similar));
+        // Archive hits are read-only; copy one back into history to pin it
+        togglePinAction->setVisible(!historyModel->isArchived(index.row()));
+        togglePinAction->setText(historyModel->isPinned(index.row()) ? QString("Unpin") : QString("Pin"));
         contextMenu->exec(event->globalPos());
     }
 }
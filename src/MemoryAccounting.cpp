@@ -0,0 +1,93 @@
+#include "../include/MemoryAccounting.h"
+#include <QFile>
+#include <QLocale>
+
+MemoryAccounting::Counter MemoryAccounting::counters[int(MemoryAccounting::Subsystem::Count)];
+
+void MemoryAccounting::set(Subsystem subsystem, qint64 bytes) {
+    Counter &counter = counters[int(subsystem)];
+    counter.current.store(bytes, std::memory_order_relaxed);
+    raisePeak(counter, bytes);
+}
+
+void MemoryAccounting::add(Subsystem subsystem, qint64 bytes) {
+    Counter &counter = counters[int(subsystem)];
+    const qint64 now = counter.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (bytes > 0) {
+        raisePeak(counter, now);
+    }
+}
+
+void MemoryAccounting::raisePeak(Counter &counter, qint64 bytes) {
+    qint64 previous = counter.peak.load(std::memory_order_relaxed);
+    while (bytes > previous && !counter.peak.compare_exchange_weak(previous, bytes, std::memory_order_relaxed)) {
+    }
+}
+
+qint64 MemoryAccounting::current(Subsystem subsystem) {
+    return counters[int(subsystem)].current.load(std::memory_order_relaxed);
+}
+
+qint64 MemoryAccounting::peak(Subsystem subsystem) {
+    return counters[int(subsystem)].peak.load(std::memory_order_relaxed);
+}
+
+QVector<MemoryAccounting::Usage> MemoryAccounting::usage() {
+    QVector<Usage> all;
+    for (int i = 0; i < int(Subsystem::Count); ++i) {
+        Usage u;
+        u.subsystem = Subsystem(i);
+        u.name = name(u.subsystem);
+        u.current = current(u.subsystem);
+        u.peak = peak(u.subsystem);
+        all.append(u);
+    }
+    return all;
+}
+
+qint64 MemoryAccounting::total() {
+    qint64 bytes = 0;
+    for (int i = 0; i < int(Subsystem::Count); ++i) {
+        bytes += current(Subsystem(i));
+    }
+    return bytes;
+}
+
+QString MemoryAccounting::name(Subsystem subsystem) {
+    switch (subsystem) {
+    case Subsystem::EntryPayloads: return "entry payloads";
+    case Subsystem::Indexes: return "indexes";
+    case Subsystem::Archive: return "archive";
+    case Subsystem::Persistence: return "persistence buffers";
+    case Subsystem::ModelRows: return "model rows";
+    case Subsystem::RowCache: return "row cache";
+    case Subsystem::PreviewIndex: return "preview index";
+    case Subsystem::Count: break;
+    }
+    return QString();
+}
+
+bool MemoryAccounting::residentBytes(qint64 *current, qint64 *peak) {
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    bool found = false;
+    // "VmRSS:     12345 kB"
+    for (const QByteArray &line : status.readAll().split('\n')) {
+        qint64 *target = line.startsWith("VmRSS:") ? current : line.startsWith("VmHWM:") ? peak : nullptr;
+        if (!target) {
+            continue;
+        }
+        const QList<QByteArray> fields = line.simplified().split(' ');
+        if (fields.size() >= 2) {
+            *target = fields.at(1).toLongLong() * 1024;
+            found = true;
+        }
+    }
+    return found;
+}
+
+QString MemoryAccounting::formatBytes(qint64 bytes) {
+    return QLocale::c().formattedDataSize(bytes, 1, QLocale::DataSizeTraditionalFormat);
+}
@@ -0,0 +1,185 @@
+#include "../include/NearDuplicateIndex.h"
+#include "../include/MemoryAccounting.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+namespace {
+// Fingerprint only the head of very large clips; near-copies share it anyway
+const qsizetype kMaxFingerprintBytes = 64 * 1024;
+const int kMinTokens = 3;
+
+quint64 mix(quint64 x) {
+    // splitmix64 finalizer: spreads FNV output over all 64 bits
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+bool isTokenByte(uchar c) {
+    return c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+}
+
+NearDuplicateIndex::NearDuplicateIndex(int threshold) {
+    setThreshold(threshold);
+}
+
+void NearDuplicateIndex::setThreshold(int bits) {
+    maxDistance = qBound(0, bits, kMaxThreshold);
+}
+
+QByteArray NearDuplicateIndex::normalize(QByteArrayView utf8) {
+    QByteArray normalized;
+    normalized.reserve(utf8.size());
+    qsizetype lineStart = 0;
+    while (lineStart <= utf8.size()) {
+        const void *newline = std::memchr(utf8.data() + lineStart, '\n', size_t(utf8.size() - lineStart));
+        qsizetype lineEnd = newline ? static_cast<const char *>(newline) - utf8.data() : utf8.size();
+        // CRLF and trailing blanks never matter when pasting
+        qsizetype end = lineEnd;
+        while (end > lineStart && (utf8[end - 1] == '\r' || utf8[end - 1] == ' ' || utf8[end - 1] == '\t')) {
+            --end;
+        }
+        normalized.append(utf8.data() + lineStart, end - lineStart);
+        normalized.append('\n');
+        lineStart = lineEnd + 1;
+    }
+    while (normalized.endsWith('\n')) {
+        normalized.chop(1);
+    }
+    return normalized;
+}
+
+bool NearDuplicateIndex::fingerprint(QByteArrayView normalized, quint64 *result) {
+    int weights[64] = {};
+    int tokens = 0;
+    quint64 previous = 0;
+
+    auto addFeature = [&weights](quint64 feature) {
+        for (int bit = 0; bit < 64; ++bit) {
+            weights[bit] += (feature >> bit) & 1 ? 1 : -1;
+        }
+    };
+
+    const uchar *data = reinterpret_cast<const uchar *>(normalized.data());
+    const qsizetype size = qMin(normalized.size(), kMaxFingerprintBytes);
+    qsizetype i = 0;
+    while (i < size) {
+        if (!isTokenByte(data[i])) {
+            ++i;
+            continue;
+        }
+        // FNV-1a over the token with each digit run folded to one '#'
+        quint64 hash = 0xCBF29CE484222325ULL;
+        bool inDigits = false;
+        for (; i < size && isTokenByte(data[i]); ++i) {
+            const bool digit = data[i] >= '0' && data[i] <= '9';
+            if (digit && inDigits) {
+                continue;
+            }
+            inDigits = digit;
+            hash = (hash ^ (digit ? uchar('#') : data[i])) * 0x100000001B3ULL;
+        }
+        const quint64 unigram = mix(hash);
+        addFeature(unigram);
+        if (tokens > 0) {
+            addFeature(mix(previous * 31 + unigram));
+        }
+        previous = unigram;
+        ++tokens;
+    }
+
+    if (tokens < kMinTokens) {
+        return false;
+    }
+    quint64 value = 0;
+    for (int bit = 0; bit < 64; ++bit) {
+        if (weights[bit] > 0) {
+            value |= quint64(1) << bit;
+        }
+    }
+    *result = value;
+    return true;
+}
+
+quint32 NearDuplicateIndex::insert(quint32 key, quint64 fingerprint) {
+    auto existing = nodes.find(key);
+    if (existing != nodes.end()) {
+        ++existing->count;
+        return existing->group;
+    }
+
+    // Pigeonhole: within kMaxThreshold bits, at least one 8-bit band is equal
+    int bestDistance = maxDistance + 1;
+    quint32 group = 0;
+    for (int band = 0; band < kBands; ++band) {
+        for (const Slot &slot : buckets[band][bandValue(fingerprint, band)]) {
+            int distance = int(qPopulationCount(slot.fingerprint ^ fingerprint));
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                group = slot.group;
+            }
+        }
+    }
+    if (group == 0) {
+        if (++nextGroup == 0) {
+            ++nextGroup;
+        }
+        group = nextGroup;
+    }
+
+    Node node;
+    node.fingerprint = fingerprint;
+    node.group = group;
+    node.count = 1;
+    nodes.insert(key, node);
+    for (int band = 0; band < kBands; ++band) {
+        buckets[band][bandValue(fingerprint, band)].append(Slot{fingerprint, key, group});
+    }
+    return group;
+}
+
+void NearDuplicateIndex::remove(quint32 key) {
+    auto it = nodes.find(key);
+    if (it == nodes.end()) {
+        return;
+    }
+    if (--it->count > 0) {
+        return;
+    }
+    const quint64 fingerprint = it->fingerprint;
+    nodes.erase(it);
+    for (int band = 0; band < kBands; ++band) {
+        QVector<Slot> &bucket = buckets[band][bandValue(fingerprint, band)];
+        for (int i = 0; i < bucket.size(); ++i) {
+            if (bucket.at(i).key == key) {
+                // Order within a bucket doesn't matter
+                bucket[i] = bucket.last();
+                bucket.removeLast();
+                break;
+            }
+        }
+    }
+}
+
+void NearDuplicateIndex::clear() {
+    nodes.clear();
+    for (auto &band : buckets) {
+        for (QVector<Slot> &bucket : band) {
+            bucket.clear();
+        }
+    }
+}
+
+qint64 NearDuplicateIndex::memoryBytes() const {
+    qint64 bytes = MemoryAccounting::hashBytes(nodes) + qint64(sizeof(buckets));
+    for (const auto &band : buckets) {
+        for (const QVector<Slot> &bucket : band) {
+            bytes += MemoryAccounting::vectorBytes(bucket);
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,71 @@
+#include "../include/PinStore.h"
+#include "../include/HistoryStore.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+namespace {
+
+const quint32 kPinMagic = 0x5843504E;   // "XCPN"
+const quint32 kPinVersion = 1;
+
+}
+
+PinStore::PinStore(const QString &path)
+    : file(path) {
+}
+
+bool PinStore::load(QVector<QByteArray> *bodies) const {
+    bodies->clear();
+    QFile input(file);
+    if (!input.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&input);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::BigEndian);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != kPinMagic || version != kPinVersion || count > quint32(kMaxPins)) {
+        qWarning() << "Ignoring pin file with unknown format:" << file;
+        return false;
+    }
+    QVector<QByteArray> loaded;
+    loaded.reserve(int(count));
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QByteArray utf8;
+        stream >> utf8;
+        loaded.append(utf8);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Pin file is truncated; ignoring it:" << file;
+        return false;
+    }
+    *bodies = loaded;
+    return true;
+}
+
+bool PinStore::save(const QVector<QByteArrayView> &bodies) const {
+    QSaveFile output(file);
+    if (!output.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write pin file:" << file << output.errorString();
+        return false;
+    }
+    QDataStream stream(&output);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream << kPinMagic << kPinVersion << quint32(bodies.size());
+    for (QByteArrayView utf8 : bodies) {
+        stream.writeBytes(utf8.data(), uint(utf8.size()));
+    }
+    // Pins are user choices, not a cache: make them durable like the journal
+    if (!output.flush() || !HistoryStore::syncToDisk(output) || !output.commit()) {
+        qWarning() << "Failed to write pin file:" << file << output.errorString();
+        return false;
+    }
+    return true;
+}
@@ -1,8 +1,11 @@
 #include "../include/PreferencesWindow.h"
 #include "../include/ClipboardManager.h"
+#include "../include/MemoryAccounting.h"
 #include <QApplication>
 #include <QDialogButtonBox>
+#include <QFontDatabase>
 #include <QKeySequenceEdit>
+#include <QTimer>
 
 PreferencesWindow::PreferencesWindow(ClipboardManager *manager, QWidget *parent)
     : QDialog(parent), clipboardManager(manager) {
@@ -32,6 +35,100 @@ void PreferencesWindow::setupUI() {
     historySizeLayout->addStretch();
     
     historyLayout->addLayout(historySizeLayout);
+    
+    archiveEvictedCheckBox = new QCheckBox("Keep older items in a searchable archive", this);
+    archiveEvictedCheckBox->setToolTip("Items beyond the maximum history size are compressed on disk "
+                                       "and still found by the history filter. Passwords are never "
+                                       "archived");
+    historyLayout->addWidget(archiveEvictedCheckBox);
+    
+    QHBoxLayout *maxAgeLayout = new QHBoxLayout();
+    QLabel *maxAgeLabel = new QLabel("Forget items older than:", this);
+    maxAgeSpinBox = new QSpinBox(this);
+    maxAgeSpinBox->setRange(0, 3650);
+    maxAgeSpinBox->setSuffix(" days");
+    maxAgeSpinBox->setSpecialValueText("Never");
+    maxAgeSpinBox->setToolTip("Archived items count their age from when they were archived");
+    maxAgeLayout->addWidget(maxAgeLabel);
+    maxAgeLayout->addWidget(maxAgeSpinBox);
+    maxAgeLayout->addStretch();
+    historyLayout->addLayout(maxAgeLayout);
+    
+    QHBoxLayout *concealedLayout = new QHBoxLayout();
+    QLabel *concealedLabel = new QLabel("Forget passwords after:", this);
+    concealedLifetimeSpinBox = new QSpinBox(this);
+    concealedLifetimeSpinBox->setRange(0, 24 * 60 * 60);
+    concealedLifetimeSpinBox->setSuffix(" s");
+    concealedLifetimeSpinBox->setSpecialValueText("Never");
+    concealedLifetimeSpinBox->setToolTip("Applies to items a password manager marks as passwords");
+    concealedLayout->addWidget(concealedLabel);
+    concealedLayout->addWidget(concealedLifetimeSpinBox);
+    concealedLayout->addStretch();
+    historyLayout->addLayout(concealedLayout);
+    
+    QHBoxLayout *excludedAppsLayout = new QHBoxLayout();
+    QLabel *excludedAppsLabel = new QLabel("Never record from:", this);
+    excludedAppsEdit = new QLineEdit(this);
+    excludedAppsEdit->setPlaceholderText("e.g. KeePassXC, org.gnome.Terminal");
+    excludedAppsEdit->setToolTip("Comma-separated application names (window class or process name); "
+                                 "their copies are never read");
+    excludedAppsLayout->addWidget(excludedAppsLabel);
+    excludedAppsLayout->addWidget(excludedAppsEdit);
+    historyLayout->addLayout(excludedAppsLayout);
+    
+    recordTraceCheckBox = new QCheckBox("Record an anonymized workload trace", this);
+    recordTraceCheckBox->setToolTip("Logs the timing, size, type and a salted hash of each clipboard event, "
+                                    "never its content, for replaying performance tests");
+    historyLayout->addWidget(recordTraceCheckBox);
+    
+    trackSelectionCheckBox = new QCheckBox("Record mouse selections (middle-click buffer)", this);
+    historyLayout->addWidget(trackSelectionCheckBox);
+    
+    QHBoxLayout *selectionQuietLayout = new QHBoxLayout();
+    QLabel *selectionQuietLabel = new QLabel("Record selection after it is unchanged for:", this);
+    selectionQuietSpinBox = new QSpinBox(this);
+    selectionQuietSpinBox->setRange(50, 5000);
+    selectionQuietSpinBox->setSingleStep(50);
+    selectionQuietSpinBox->setSuffix(" ms");
+    selectionQuietLayout->addWidget(selectionQuietLabel);
+    selectionQuietLayout->addWidget(selectionQuietSpinBox);
+    selectionQuietLayout->addStretch();
+    historyLayout->addLayout(selectionQuietLayout);
+    
+    QHBoxLayout *debounceLayout = new QHBoxLayout();
+    QLabel *debounceLabel = new QLabel("Rapid clipboard changes:", this);
+    debouncePolicyComboBox = new QComboBox(this);
+    debouncePolicyComboBox->addItem("Record settled value", int(ChangeCoalescer::Policy::Trailing));
+    debouncePolicyComboBox->addItem("Record first value", int(ChangeCoalescer::Policy::Leading));
+    debouncePolicyComboBox->addItem("Record every change", int(ChangeCoalescer::Policy::Immediate));
+    debounceWindowSpinBox = new QSpinBox(this);
+    debounceWindowSpinBox->setRange(0, 2000);
+    debounceWindowSpinBox->setSingleStep(50);
+    debounceWindowSpinBox->setSuffix(" ms");
+    debounceLayout->addWidget(debounceLabel);
+    debounceLayout->addWidget(debouncePolicyComboBox);
+    debounceLayout->addWidget(debounceWindowSpinBox);
+    debounceLayout->addStretch();
+    historyLayout->addLayout(debounceLayout);
+    
+    normalizeDuplicatesCheckBox = new QCheckBox("Treat clips differing only in whitespace as duplicates", this);
+    historyLayout->addWidget(normalizeDuplicatesCheckBox);
+    
+    QHBoxLayout *similarLayout = new QHBoxLayout();
+    collapseSimilarCheckBox = new QCheckBox("Collapse similar clips, tolerance:", this);
+    similarThresholdSpinBox = new QSpinBox(this);
+    similarThresholdSpinBox->setRange(0, NearDuplicateIndex::kMaxThreshold);
+    similarThresholdSpinBox->setSuffix(" bits");
+    similarThresholdSpinBox->setToolTip("Fingerprint bits two clips may differ by and still be grouped");
+    similarLayout->addWidget(collapseSimilarCheckBox);
+    similarLayout->addWidget(similarThresholdSpinBox);
+    similarLayout->addStretch();
+    historyLayout->addLayout(similarLayout);
+    
+    if (clipboardManager && !clipboardManager->isSelectionSupported()) {
+        trackSelectionCheckBox->setEnabled(false);
+        selectionQuietSpinBox->setEnabled(false);
+    }
     mainLayout->addWidget(historyGroup);
     
     // Application Settings Group
@@ -54,7 +151,26 @@ void PreferencesWindow::setupUI() {
     hotkeyLayout->addWidget(globalHotkeyEdit);
     appLayout->addLayout(hotkeyLayout);
     
+    pasteHotkeysEnabledCheckBox = new QCheckBox("Paste recent items with Ctrl+Alt+1..9", this);
+    synthesizePasteCheckBox = new QCheckBox("Paste into the active window automatically", this);
+    appLayout->addWidget(pasteHotkeysEnabledCheckBox);
+    appLayout->addWidget(synthesizePasteCheckBox);
+    
     mainLayout->addWidget(appGroup);
+
+    // Memory, refreshed while the dialog is open
+    QGroupBox *memoryGroup = new QGroupBox("Memory Usage", this);
+    QVBoxLayout *memoryLayout = new QVBoxLayout(memoryGroup);
+    memoryLabel = new QLabel(this);
+    memoryLabel->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    memoryLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    memoryLayout->addWidget(memoryLabel);
+    mainLayout->addWidget(memoryGroup);
+    memoryTimer = new QTimer(this);
+    memoryTimer->setInterval(1000);
+    connect(memoryTimer, &QTimer::timeout, this, &PreferencesWindow::refreshMemoryUsage);
+    memoryTimer->start();
+    refreshMemoryUsage();
     mainLayout->addStretch();
     
     // Buttons
@@ -72,19 +188,75 @@ void PreferencesWindow::setupUI() {
 void PreferencesWindow::loadSettings() {
     if (clipboardManager) {
         historySizeSpinBox->setValue(clipboardManager->getMaxHistorySize());
+        archiveEvictedCheckBox->setChecked(clipboardManager->getArchiveEvictedEntries());
+        maxAgeSpinBox->setValue(clipboardManager->getHistoryMaxAge());
+        concealedLifetimeSpinBox->setValue(clipboardManager->getConcealedEntryLifetime());
+        excludedAppsEdit->setText(clipboardManager->getExcludedSourceApps().join(", "));
+        recordTraceCheckBox->setChecked(clipboardManager->getRecordWorkloadTrace());
         autoStartCheckBox->setChecked(clipboardManager->getAutoStart());
         showTrayIconCheckBox->setChecked(clipboardManager->getShowTrayIcon());
         globalHotkeyEnabledCheckBox->setChecked(clipboardManager->isGlobalHotkeyEnabled());
         globalHotkeyEdit->setKeySequence(clipboardManager->getGlobalHotkey());
+        pasteHotkeysEnabledCheckBox->setChecked(clipboardManager->isPasteHotkeysEnabled());
+        synthesizePasteCheckBox->setChecked(clipboardManager->getSynthesizePaste());
+        trackSelectionCheckBox->setChecked(clipboardManager->getTrackPrimarySelection());
+        selectionQuietSpinBox->setValue(clipboardManager->getSelectionQuietPeriod());
+        debouncePolicyComboBox->setCurrentIndex(
+            debouncePolicyComboBox->findData(int(clipboardManager->getCaptureDebouncePolicy())));
+        debounceWindowSpinBox->setValue(clipboardManager->getCaptureDebounceWindow());
+        normalizeDuplicatesCheckBox->setChecked(clipboardManager->getNormalizeDuplicates());
+        collapseSimilarCheckBox->setChecked(clipboardManager->getCollapseNearDuplicates());
+        similarThresholdSpinBox->setValue(clipboardManager->getNearDuplicateThreshold());
+    }
+}
+
+void PreferencesWindow::refreshMemoryUsage() {
+    const QVector<MemoryAccounting::Usage> usage = MemoryAccounting::usage();
+    int width = 0;
+    for (const MemoryAccounting::Usage &u : usage) {
+        width = qMax(width, int(u.name.size()));
+    }
+    QStringList lines;
+    lines << QString("%1  %2  %3").arg(QString(), -width).arg(QString("current"), 10).arg(QString("peak"), 10);
+    for (const MemoryAccounting::Usage &u : usage) {
+        lines << QString("%1  %2  %3").arg(u.name, -width)
+                     .arg(MemoryAccounting::formatBytes(u.current), 10)
+                     .arg(MemoryAccounting::formatBytes(u.peak), 10);
+    }
+    lines << QString("%1  %2").arg(QString("total"), -width).arg(MemoryAccounting::formatBytes(MemoryAccounting::total()), 10);
+    qint64 resident = 0;
+    qint64 peakResident = 0;
+    if (MemoryAccounting::residentBytes(&resident, &peakResident)) {
+        lines << QString("%1  %2  %3").arg(QString("process"), -width)
+                     .arg(MemoryAccounting::formatBytes(resident), 10)
+                     .arg(MemoryAccounting::formatBytes(peakResident), 10);
     }
+    memoryLabel->setText(lines.join('\n'));
 }
 
 void PreferencesWindow::saveSettings() {
     if (clipboardManager) {
+        // One write, one notification, and the worker gets the changed options once
+        ClipboardManager::SettingsTransaction transaction(clipboardManager);
+        clipboardManager->setArchiveEvictedEntries(archiveEvictedCheckBox->isChecked());
         clipboardManager->setMaxHistorySize(historySizeSpinBox->value());
+        clipboardManager->setHistoryMaxAge(maxAgeSpinBox->value());
+        clipboardManager->setConcealedEntryLifetime(concealedLifetimeSpinBox->value());
+        clipboardManager->setExcludedSourceApps(excludedAppsEdit->text().split(',', Qt::SkipEmptyParts));
+        clipboardManager->setRecordWorkloadTrace(recordTraceCheckBox->isChecked());
         clipboardManager->setAutoStart(autoStartCheckBox->isChecked());
         clipboardManager->setShowTrayIcon(showTrayIconCheckBox->isChecked());
         clipboardManager->setGlobalHotkeyEnabled(globalHotkeyEnabledCheckBox->isChecked());
         clipboardManager->setGlobalHotkey(globalHotkeyEdit->keySequence());
+        clipboardManager->setPasteHotkeysEnabled(pasteHotkeysEnabledCheckBox->isChecked());
+        clipboardManager->setSynthesizePaste(synthesizePasteCheckBox->isChecked());
+        clipboardManager->setTrackPrimarySelection(trackSelectionCheckBox->isChecked());
+        clipboardManager->setSelectionQuietPeriod(selectionQuietSpinBox->value());
+        clipboardManager->setCaptureDebouncePolicy(
+            ChangeCoalescer::Policy(debouncePolicyComboBox->currentData().toInt()));
+        clipboardManager->setCaptureDebounceWindow(debounceWindowSpinBox->value());
+        clipboardManager->setNormalizeDuplicates(normalizeDuplicatesCheckBox->isChecked());
+        clipboardManager->setNearDuplicateThreshold(similarThresholdSpinBox->value());
+        clipboardManager->setCollapseNearDuplicates(collapseSimilarCheckBox->isChecked());
     }
 }
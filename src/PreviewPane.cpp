@@ -0,0 +1,267 @@
+#include "../include/PreviewPane.h"
+#include "../include/MemoryAccounting.h"
+#include <QFontDatabase>
+#include <QMetaObject>
+#include <QPainter>
+#include <QScrollBar>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Byte offset of the character at a UTF-16 offset; the text is scanned up to it
+qint32 utf8OffsetOf(QByteArrayView bytes, int utf16Offset) {
+    int units = 0;
+    for (qsizetype i = 0; i < bytes.size(); ++i) {
+        const uchar byte = uchar(bytes.at(i));
+        if ((byte & 0xC0) == 0x80) {
+            continue;
+        }
+        if (units >= utf16Offset) {
+            return qint32(i);
+        }
+        units += byte >= 0xF0 ? 2 : 1;    // four-byte sequences are surrogate pairs
+    }
+    return qint32(bytes.size());
+}
+
+// Finds display line starts, resuming where the previous call stopped
+struct LineScanner {
+    const char *data = nullptr;
+    int size = 0;
+    int lineStart = 0;
+    int widest = 0;
+
+    // Scans the lines starting before stop; each new start is appended
+    void scan(int stop, QVector<qint32> *starts) {
+        while (lineStart < stop) {
+            const int limit = qMin(size, lineStart + PreviewPane::kMaxLineBytes);
+            const void *found = std::memchr(data + lineStart, '\n', size_t(limit - lineStart));
+            int next;
+            if (found) {
+                const int newline = int(static_cast<const char *>(found) - data);
+                widest = qMax(widest, newline - lineStart);
+                next = newline + 1;
+            } else if (limit == size) {
+                widest = qMax(widest, size - lineStart);
+                lineStart = size;
+                return;
+            } else {
+                // Too long to show as one line: break it, never inside a character
+                next = limit;
+                while (next > lineStart + 1 && (uchar(data[next]) & 0xC0) == 0x80) {
+                    --next;
+                }
+                widest = qMax(widest, next - lineStart);
+            }
+            lineStart = next;
+            if (next < size) {
+                starts->append(next);
+            }
+        }
+    }
+};
+
+}
+
+PreviewPane::PreviewPane(QWidget *parent)
+    : QAbstractScrollArea(parent) {
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    viewport()->setBackgroundRole(QPalette::Base);
+    viewport()->setAutoFillBackground(true);
+    // One index at a time; a newer entry cancels the one in flight
+    pool.setMaxThreadCount(1);
+}
+
+PreviewPane::~PreviewPane() {
+    cancelIndex();
+    pool.waitForDone();
+}
+
+void PreviewPane::setEntry(const Utf8Entry &next, bool mask, int matchOffset) {
+    cancelIndex();
+    entry = next;
+    masked = mask;
+    lineStarts.clear();
+    widestLine = 0;
+    indexed = true;
+    scrollTarget = -1;
+
+    if (!entry.isNull() && !masked) {
+        lineStarts.append(0);
+        const QByteArrayView bytes = entry.bytes();
+        if (bytes.size() <= kIndexChunkBytes) {
+            // Indexing a small entry takes less than posting it would
+            LineScanner scanner{bytes.data(), int(bytes.size())};
+            scanner.scan(scanner.size, &lineStarts);
+            widestLine = scanner.widest;
+            if (matchOffset > 0) {
+                scrollTarget = utf8OffsetOf(bytes, matchOffset);
+            }
+        } else {
+            indexed = false;
+            JobPtr job = std::make_shared<Job>();
+            job->entry = entry;
+            job->matchOffset = matchOffset;
+            current = job;
+            pool.start([this, job]() {
+                runIndex(job);
+            });
+        }
+    }
+
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+    updateScrollBars();
+    scrollToTarget();
+    viewport()->update();
+    accountMemory();
+    emit indexProgress(lineCount(), indexed);
+}
+
+void PreviewPane::accountMemory() const {
+    MemoryAccounting::set(MemoryAccounting::Subsystem::PreviewIndex, MemoryAccounting::vectorBytes(lineStarts));
+}
+
+void PreviewPane::clear() {
+    setEntry(Utf8Entry());
+}
+
+int PreviewPane::firstVisibleLine() const {
+    return verticalScrollBar()->value();
+}
+
+void PreviewPane::cancelIndex() {
+    if (current) {
+        current->cancelled.store(true, std::memory_order_relaxed);
+        current.reset();
+    }
+    pool.clear();
+}
+
+// Pool thread. The job's handle keeps the slab alive, and slabs are
+// immutable, so the body is read without locking.
+void PreviewPane::runIndex(const JobPtr &job) {
+    const QByteArrayView bytes = job->entry.bytes();
+    if (job->matchOffset > 0) {
+        // Ahead of the first lines, so the pane knows where to go as they arrive
+        const qint32 target = utf8OffsetOf(bytes, job->matchOffset);
+        QMetaObject::invokeMethod(this, [this, job, target]() {
+            if (job == current) {
+                scrollTarget = target;
+            }
+        }, Qt::QueuedConnection);
+    }
+    LineScanner scanner{bytes.data(), int(bytes.size())};
+    while (scanner.lineStart < scanner.size) {
+        if (job->cancelled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        QVector<qint32> starts;
+        scanner.scan(qMin(scanner.size, scanner.lineStart + kIndexChunkBytes), &starts);
+        const bool complete = scanner.lineStart >= scanner.size;
+        const int widest = scanner.widest;
+        QMetaObject::invokeMethod(this, [this, job, starts, widest, complete]() {
+            addLines(job, starts, widest, complete);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void PreviewPane::addLines(const JobPtr &job, const QVector<qint32> &starts, int widest, bool complete) {
+    if (job != current) {
+        return;
+    }
+    const int before = lineCount();
+    lineStarts += starts;
+    accountMemory();
+    widestLine = qMax(widestLine, widest);
+    indexed = complete;
+    if (complete) {
+        current.reset();
+    }
+    updateScrollBars();
+    scrollToTarget();
+    // The last visible line may have been cut short until its end was known
+    const int pageLines = viewport()->height() / qMax(1, fontMetrics().lineSpacing()) + 1;
+    if (before <= firstVisibleLine() + pageLines) {
+        viewport()->update();
+    }
+    emit indexProgress(lineCount(), indexed);
+}
+
+void PreviewPane::scrollToTarget() {
+    if (scrollTarget < 0 || lineStarts.isEmpty()) {
+        return;
+    }
+    // The target's line is known once a later line starts, or indexing is done
+    if (!indexed && lineStarts.last() <= scrollTarget) {
+        return;
+    }
+    const auto next = std::upper_bound(lineStarts.cbegin(), lineStarts.cend(), scrollTarget);
+    const int line = int(next - lineStarts.cbegin()) - 1;
+    scrollTarget = -1;
+    verticalScrollBar()->setValue(line);
+}
+
+// Decodes one display line, without its line break
+QString PreviewPane::lineText(int line) const {
+    const QByteArrayView bytes = entry.bytes();
+    const int start = lineStarts.at(line);
+    int end = line + 1 < lineStarts.size() ? lineStarts.at(line + 1)
+                                           : qMin(int(bytes.size()), start + kMaxLineBytes);
+    if (const void *found = std::memchr(bytes.data() + start, '\n', size_t(end - start))) {
+        end = int(static_cast<const char *>(found) - bytes.data());
+    }
+    if (end > start && bytes.at(end - 1) == '\r') {
+        --end;
+    }
+    QString text = QString::fromUtf8(bytes.data() + start, end - start);
+    text.replace(QLatin1Char('\t'), QLatin1String("    "));
+    return text;
+}
+
+void PreviewPane::updateScrollBars() {
+    const QFontMetrics metrics = fontMetrics();
+    const int pageLines = qMax(1, viewport()->height() / qMax(1, metrics.lineSpacing()));
+    verticalScrollBar()->setSingleStep(1);
+    verticalScrollBar()->setPageStep(pageLines);
+    verticalScrollBar()->setRange(0, qMax(0, lineCount() - pageLines));
+
+    // Widths are estimated from byte counts; laying out every line would defeat the point
+    const int contentWidth = widestLine * metrics.averageCharWidth() + 2 * kMargin;
+    horizontalScrollBar()->setSingleStep(metrics.averageCharWidth() * 4);
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setRange(0, qMax(0, contentWidth - viewport()->width()));
+}
+
+void PreviewPane::paintEvent(QPaintEvent *) {
+    QPainter painter(viewport());
+    if (entry.isNull() || masked) {
+        painter.setPen(palette().color(QPalette::PlaceholderText));
+        painter.drawText(viewport()->rect(), Qt::AlignCenter,
+                         masked ? "Secret hidden; copy it to use it" : "Select an entry to preview it");
+        return;
+    }
+
+    painter.setPen(palette().color(QPalette::Text));
+    const QFontMetrics metrics = fontMetrics();
+    const int lineHeight = qMax(1, metrics.lineSpacing());
+    const int first = firstVisibleLine();
+    const int last = qMin(lineCount(), first + viewport()->height() / lineHeight + 1);
+    const int x = kMargin - horizontalScrollBar()->value();
+    int y = metrics.ascent();
+    for (int line = first; line < last; ++line, y += lineHeight) {
+        painter.drawText(x, y, lineText(line));
+    }
+}
+
+void PreviewPane::resizeEvent(QResizeEvent *event) {
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void PreviewPane::scrollContentsBy(int, int) {
+    viewport()->update();
+}
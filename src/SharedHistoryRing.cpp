@@ -0,0 +1,200 @@
+#include "../include/SharedHistoryRing.h"
+#include <QDebug>
+#include <QDir>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <cstring>
+#include <new>
+
+static_assert(std::atomic<quint64>::is_always_lock_free, "ring counters must be lock-free to live in shared memory");
+
+namespace {
+
+const quint32 kRingMagic = 0x58435247;  // "XCRG"
+const quint32 kRingVersion = 1;
+const int kFrameHeaderSize = 5;         // length, kind
+
+}
+
+struct SharedHistoryRing::Header {
+    quint32 magic;
+    quint32 version;
+    quint64 capacity;
+    std::atomic<quint64> epoch;
+    std::atomic<quint64> reserved;  // end of the batch being written
+    std::atomic<quint64> head;      // end of the last complete batch
+};
+
+SharedHistoryRing::SharedHistoryRing(const QString &key) {
+    memory.setKey(key);
+}
+
+SharedHistoryRing::~SharedHistoryRing() {
+    if (memory.isAttached()) {
+        memory.detach();
+    }
+}
+
+QString SharedHistoryRing::keyFor(const QString &storeDirectory) {
+    return QString("xclipy-history-%1").arg(qHash(QDir(storeDirectory).absolutePath()), 0, 16);
+}
+
+SharedHistoryRing::Header *SharedHistoryRing::header() const {
+    return static_cast<Header *>(const_cast<void *>(memory.constData()));
+}
+
+char *SharedHistoryRing::ring() const {
+    return reinterpret_cast<char *>(header()) + sizeof(Header);
+}
+
+bool SharedHistoryRing::createAsWriter() {
+    const qsizetype size = qsizetype(sizeof(Header)) + kCapacity;
+    if (!memory.create(size)) {
+        // Left behind by a writer that died while readers stayed attached
+        if (memory.error() != QSharedMemory::AlreadyExists || !memory.attach()) {
+            qWarning() << "Cannot create shared history ring:" << memory.errorString();
+            return false;
+        }
+        if (memory.size() < size) {
+            qWarning() << "Shared history ring has an unexpected size; not sharing history";
+            memory.detach();
+            return false;
+        }
+    }
+
+    Header *h = header();
+    if (h->magic == kRingMagic && h->version == kRingVersion && h->capacity == quint64(kCapacity)) {
+        // Taking over: readers of the old writer reload from the store
+        h->epoch.fetch_add(1, std::memory_order_acq_rel);
+    } else {
+        new (h) Header{kRingMagic, kRingVersion, quint64(kCapacity), {0}, {0}, {0}};
+        h->epoch.store(QRandomGenerator::global()->generate64() | 1, std::memory_order_release);
+    }
+    writer = true;
+    return true;
+}
+
+bool SharedHistoryRing::attachAsReader() {
+    if (memory.isAttached()) {
+        return isAttached();
+    }
+    if (!memory.attach(QSharedMemory::ReadOnly)) {
+        return false;
+    }
+    if (!isAttached()) {
+        memory.detach();
+        return false;
+    }
+    return true;
+}
+
+bool SharedHistoryRing::isAttached() const {
+    if (!memory.isAttached() || memory.size() < qsizetype(sizeof(Header)) + kCapacity) {
+        return false;
+    }
+    const Header *h = header();
+    return h->magic == kRingMagic && h->version == kRingVersion && h->capacity == quint64(kCapacity);
+}
+
+quint64 SharedHistoryRing::epoch() const {
+    return isAttached() ? header()->epoch.load(std::memory_order_acquire) : 0;
+}
+
+quint64 SharedHistoryRing::head() const {
+    return isAttached() ? header()->head.load(std::memory_order_acquire) : 0;
+}
+
+void SharedHistoryRing::copyIn(quint64 position, const char *data, qint64 size) {
+    const qint64 at = qint64(position % kCapacity);
+    const qint64 first = qMin(size, kCapacity - at);
+    std::memcpy(ring() + at, data, size_t(first));
+    std::memcpy(ring(), data + first, size_t(size - first));
+}
+
+void SharedHistoryRing::copyOut(quint64 position, char *data, qint64 size) const {
+    const qint64 at = qint64(position % kCapacity);
+    const qint64 first = qMin(size, kCapacity - at);
+    std::memcpy(data, ring() + at, size_t(first));
+    std::memcpy(data + first, ring(), size_t(size - first));
+}
+
+void SharedHistoryRing::append(Batch kind, QByteArrayView data) {
+    if (!writer || !isAttached()) {
+        return;
+    }
+    Header *h = header();
+    const qint64 frame = kFrameHeaderSize + data.size();
+    if (frame > kCapacity) {
+        // Too big to mirror: readers pick it up from the store instead
+        invalidate();
+        return;
+    }
+
+    // Reserve first, so a reader that races the copy below sees it was lapped
+    const quint64 start = h->head.load(std::memory_order_relaxed);
+    h->reserved.store(start + quint64(frame), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    char prefix[kFrameHeaderSize];
+    qToBigEndian<quint32>(quint32(data.size()), prefix);
+    prefix[4] = char(kind);
+    copyIn(start, prefix, kFrameHeaderSize);
+    copyIn(start + kFrameHeaderSize, data.data(), data.size());
+    h->head.store(start + quint64(frame), std::memory_order_release);
+}
+
+void SharedHistoryRing::invalidate() {
+    if (writer && isAttached()) {
+        header()->epoch.fetch_add(1, std::memory_order_acq_rel);
+    }
+}
+
+SharedHistoryRing::ReadResult SharedHistoryRing::read(quint64 epoch, quint64 *cursor,
+                                                      const std::function<void(Batch, QByteArrayView)> &f) {
+    if (!isAttached()) {
+        return ReadResult::Detached;
+    }
+    const Header *h = header();
+    // Nothing read since start may have been overwritten by a later batch
+    const auto intact = [h, epoch](quint64 start) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return h->reserved.load(std::memory_order_relaxed) - start <= quint64(kCapacity)
+               && h->epoch.load(std::memory_order_relaxed) == epoch;
+    };
+
+    if (h->epoch.load(std::memory_order_acquire) != epoch) {
+        return ReadResult::Resync;
+    }
+    const quint64 end = h->head.load(std::memory_order_acquire);
+    if (end < *cursor || end - *cursor > quint64(kCapacity)) {
+        return ReadResult::Resync;
+    }
+
+    QByteArray scratch;
+    while (*cursor < end) {
+        const quint64 start = *cursor;
+        char prefix[kFrameHeaderSize];
+        copyOut(start, prefix, kFrameHeaderSize);
+        const quint32 length = qFromBigEndian<quint32>(prefix);
+        if (!intact(start) || start + kFrameHeaderSize + length > end) {
+            return ReadResult::Resync;
+        }
+
+        // In place unless the batch wraps around the end of the ring
+        const qint64 at = qint64((start + kFrameHeaderSize) % kCapacity);
+        QByteArrayView data;
+        if (at + qint64(length) <= kCapacity) {
+            data = QByteArrayView(ring() + at, length);
+        } else {
+            scratch.resize(length);
+            copyOut(start + kFrameHeaderSize, scratch.data(), length);
+            data = scratch;
+        }
+        f(Batch(quint8(prefix[4])), data);
+        if (!intact(start)) {
+            return ReadResult::Resync;
+        }
+        *cursor = start + kFrameHeaderSize + length;
+    }
+    return ReadResult::Ok;
+}
@@ -0,0 +1,85 @@
+#include "../include/SingleInstance.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QGuiApplication>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QStandardPaths>
+
+namespace {
+
+const QByteArray kActivateMessage = "show\n";
+
+}
+
+SingleInstance::SingleInstance(QObject *parent)
+    : QObject(parent) {
+    // Per user and display: two X displays get an instance each
+    QString user = qEnvironmentVariable("USER", qEnvironmentVariable("USERNAME"));
+    if (user.isEmpty()) {
+        user = QDir::home().dirName();
+    }
+    QString display = QGuiApplication::platformName();
+    if (display == "xcb") {
+        display += qEnvironmentVariable("DISPLAY");
+    }
+    const QByteArray digest = QCryptographicHash::hash((user + '|' + display).toUtf8(), QCryptographicHash::Sha1);
+    scopeName = "xclipy-" + QString::fromLatin1(digest.toHex().left(16));
+}
+
+SingleInstance::~SingleInstance() {
+    if (server) {
+        server->close();
+    }
+}
+
+bool SingleInstance::acquire() {
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (dir.isEmpty()) {
+        dir = QDir::tempPath();
+    }
+    lock = std::make_unique<QLockFile>(dir + "/" + scopeName + ".lock");
+    // Only a live process holds the lock; a crashed one's lock is reclaimed by PID
+    lock->setStaleLockTime(0);
+    if (!lock->tryLock(100)) {
+        qint64 pid = 0;
+        QString host, app;
+        lock->getLockInfo(&pid, &host, &app);
+        qInfo() << "Xclipy is already running on this display (pid" << pid << ")";
+        return false;
+    }
+
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    // We hold the lock, so any socket left under this name is a dead instance's
+    QLocalServer::removeServer(scopeName);
+    if (!server->listen(scopeName)) {
+        qWarning() << "Cannot listen for other Xclipy starts:" << server->errorString();
+        return true;
+    }
+    connect(server, &QLocalServer::newConnection, this, [this]() {
+        while (QLocalSocket *socket = server->nextPendingConnection()) {
+            connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+                if (socket->canReadLine() && socket->readLine() == kActivateMessage) {
+                    emit activationRequested();
+                }
+            });
+        }
+    });
+    return true;
+}
+
+bool SingleInstance::activateRunning(int timeoutMs) {
+    QLocalSocket socket;
+    socket.connectToServer(scopeName);
+    if (!socket.waitForConnected(timeoutMs)) {
+        qWarning() << "The running instance did not answer:" << socket.errorString();
+        return false;
+    }
+    socket.write(kActivateMessage);
+    const bool sent = socket.waitForBytesWritten(timeoutMs);
+    socket.disconnectFromServer();
+    return sent;
+}
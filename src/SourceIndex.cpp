@@ -0,0 +1,109 @@
+#include "../include/SourceIndex.h"
+#include "../include/MemoryAccounting.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+namespace {
+const quint32 kSourceMagic = 0x5843534f;   // "XCSO"
+const quint32 kSourceVersion = 1;
+}
+
+quint16 SourceIndex::intern(const QString &app) {
+    const auto known = ids.constFind(app);
+    if (known != ids.constEnd()) {
+        return known.value();
+    }
+    if (names.size() >= kMaxApps) {
+        return 0;
+    }
+    names.append(app);
+    const quint16 id = quint16(names.size());
+    ids.insert(app, id);
+    return id;
+}
+
+quint16 SourceIndex::record(quint32 hash, const QString &app) {
+    const quint16 id = app.isEmpty() ? 0 : intern(app);
+    if (id == 0) {
+        return appOf(hash);
+    }
+    entries.insert(hash, id);
+    return id;
+}
+
+void SourceIndex::set(quint32 hash, quint16 app) {
+    if (app == 0 || app > names.size()) {
+        entries.remove(hash);
+    } else {
+        entries.insert(hash, app);
+    }
+}
+
+bool SourceIndex::load(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::BigEndian);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QStringList loadedNames;
+    quint32 count = 0;
+    stream >> magic >> version;
+    if (magic != kSourceMagic || version != kSourceVersion) {
+        qWarning() << "Ignoring source app file with unknown format:" << path;
+        return false;
+    }
+    stream >> loadedNames >> count;
+    QHash<quint32, quint16> loaded;
+    loaded.reserve(int(qMin(count, quint32(1 << 20))));
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint32 hash = 0;
+        quint16 app = 0;
+        stream >> hash >> app;
+        if (app != 0 && app <= loadedNames.size()) {
+            loaded.insert(hash, app);
+        }
+    }
+    if (stream.status() != QDataStream::Ok || loadedNames.size() > kMaxApps) {
+        qWarning() << "Source app file is truncated; entries have no source app:" << path;
+        return false;
+    }
+    entries = loaded;
+    names = loadedNames;
+    ids.clear();
+    for (int i = 0; i < names.size(); ++i) {
+        ids.insert(names.at(i), quint16(i + 1));
+    }
+    return true;
+}
+
+bool SourceIndex::save(const QString &path) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write source app file:" << path << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream << kSourceMagic << kSourceVersion << names << quint32(entries.size());
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        stream << it.key() << it.value();
+    }
+    return file.commit();
+}
+
+qint64 SourceIndex::memoryBytes() const {
+    qint64 bytes = MemoryAccounting::hashBytes(entries) + MemoryAccounting::hashBytes(ids)
+                   + MemoryAccounting::vectorBytes(names);
+    for (const QString &name : names) {
+        bytes += MemoryAccounting::stringBytes(name);   // shared with its key in ids
+    }
+    return bytes;
+}
@@ -0,0 +1,151 @@
+#include "../include/TimerWheel.h"
+#include "../include/MemoryAccounting.h"
+
+TimerWheel::TimerWheel(qint64 now)
+    : current(now) {
+}
+
+void TimerWheel::schedule(quint32 key, qint64 deadline) {
+    Timer timer;
+    timer.key = key;
+    timer.deadline = deadline;
+    place(timer);
+    ++pending;
+}
+
+void TimerWheel::place(const Timer &timer) {
+    const qint64 delta = timer.deadline - current;
+    if (delta <= 0) {
+        due.append(timer);
+        return;
+    }
+    for (int level = 0; level < kLevels; ++level) {
+        if (delta < span(level + 1)) {
+            // Its slot comes round after now and before this one comes round again
+            const int slot = int((timer.deadline >> (kSlotBits * level)) & (kSlots - 1));
+            slots[level][slot].append(timer);
+            ++counts[level];
+            return;
+        }
+    }
+    overflow.append(timer);
+}
+
+// Spreads the slot the wheel just reached over the levels below
+void TimerWheel::cascade(int level) {
+    const int slot = int((current >> (kSlotBits * level)) & (kSlots - 1));
+    QVector<Timer> timers;
+    timers.swap(slots[level][slot]);
+    counts[level] -= int(timers.size());
+    for (const Timer &timer : timers) {
+        place(timer);
+    }
+}
+
+void TimerWheel::advance(qint64 now, QVector<Timer> *expired) {
+    auto takeDue = [this, expired]() {
+        *expired += due;
+        pending -= int(due.size());
+        due.clear();
+    };
+    takeDue();
+
+    while (current < now) {
+        int lowest = 0;
+        while (lowest < kLevels && counts[lowest] == 0) {
+            ++lowest;
+        }
+        if (lowest == kLevels && overflow.isEmpty()) {
+            current = now;
+            break;
+        }
+        if (lowest > 0) {
+            // Nothing can fire before the next turn of the lowest occupied level
+            const qint64 step = span(qMin(lowest, kLevels - 1));
+            current = qMin(now, (current / step + 1) * step - 1);
+            if (current >= now) {
+                break;
+            }
+        }
+
+        ++current;
+        if (current % span(kLevels - 1) == 0 && !overflow.isEmpty()) {
+            QVector<Timer> waiting;
+            waiting.swap(overflow);
+            for (const Timer &timer : waiting) {
+                place(timer);
+            }
+        }
+        for (int level = kLevels - 1; level >= 1; --level) {
+            if (current % span(level) == 0) {
+                cascade(level);
+            }
+        }
+        takeDue();
+
+        QVector<Timer> &slot = slots[0][current & (kSlots - 1)];
+        if (!slot.isEmpty()) {
+            *expired += slot;
+            counts[0] -= int(slot.size());
+            pending -= int(slot.size());
+            slot.clear();
+        }
+    }
+}
+
+qint64 TimerWheel::nextDeadline() const {
+    qint64 best = -1;
+    auto consider = [&best](const QVector<Timer> &timers) {
+        for (const Timer &timer : timers) {
+            if (best < 0 || timer.deadline < best) {
+                best = timer.deadline;
+            }
+        }
+    };
+    consider(due);
+    for (int level = 0; level < kLevels; ++level) {
+        if (counts[level] == 0) {
+            continue;
+        }
+        // Slots in the order the wheel reaches them; the first occupied one
+        // holds the level's earliest, unless a finer level has one before it
+        const qint64 base = current >> (kSlotBits * level);
+        for (int step = 1; step <= kSlots; ++step) {
+            const QVector<Timer> &slot = slots[level][(base + step) & (kSlots - 1)];
+            if (!slot.isEmpty()) {
+                if (best < 0 || best >= ((base + step) << (kSlotBits * level))) {
+                    consider(slot);
+                }
+                break;
+            }
+        }
+    }
+    consider(overflow);
+    return best;
+}
+
+void TimerWheel::reset(qint64 now) {
+    for (auto &level : slots) {
+        for (QVector<Timer> &slot : level) {
+            slot.clear();
+        }
+    }
+    for (int &count : counts) {
+        count = 0;
+    }
+    due.clear();
+    overflow.clear();
+    current = now;
+    pending = 0;
+}
+
+qint64 TimerWheel::memoryBytes() const {
+    qint64 bytes = qint64(sizeof(slots)) + MemoryAccounting::vectorBytes(due)
+                   + MemoryAccounting::vectorBytes(overflow);
+    for (const auto &level : slots) {
+        for (const QVector<Timer> &slot : level) {
+            bytes += MemoryAccounting::vectorBytes(slot);
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,245 @@
+#include "../include/WorkloadTrace.h"
+#include "../include/HistoryStore.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QtEndian>
+
+namespace {
+
+const quint32 kTraceMagic = 0x58435452;     // "XCTR"
+const quint32 kTraceVersion = 1;
+const int kHeaderSize = 16;                 // magic, version, created
+const int kRecordSize = 24;                 // at, hash, size, parts, kinds, event, formats
+
+// Stand-in text is built from a generator seeded by the record's hash
+class Synthesizer {
+public:
+    explicit Synthesizer(quint32 hash)
+        : state(hash * 2654435761u + 0x9e3779b9u) {
+    }
+
+    quint32 next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    QString word(int length) {
+        QString text;
+        for (int i = 0; i < length; ++i) {
+            text += QChar('a' + int(next() % 26));
+        }
+        return text;
+    }
+
+    QString token(int length) {
+        static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+        QString text;
+        for (int i = 0; i < length; ++i) {
+            text += QChar(alphabet[next() % 62]);
+        }
+        return text;
+    }
+
+private:
+    quint32 state;
+};
+
+// Pads or cuts text to size bytes (it is ASCII), keeping about `lines` lines
+QString fitted(QString text, int size, int lines, Synthesizer *random) {
+    const int lineLength = qMax(8, size / qMax(1, lines));
+    int sinceBreak = 0;
+    while (text.size() < size) {
+        if (lines > 1 && sinceBreak >= lineLength) {
+            text += '\n';
+            sinceBreak = 0;
+            continue;
+        }
+        text += ' ' + random->word(2 + int(random->next() % 8));
+        sinceBreak = int(text.size() - text.lastIndexOf('\n'));
+    }
+    text.truncate(size);
+    return text;
+}
+
+}
+
+bool WorkloadTrace::Recorder::open(const QString &path) {
+    close();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot record a workload trace to" << path << ":" << file.errorString();
+        return false;
+    }
+    char header[kHeaderSize];
+    qToBigEndian<quint32>(kTraceMagic, header);
+    qToBigEndian<quint32>(kTraceVersion, header + 4);
+    qToBigEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 8);
+    file.write(header, kHeaderSize);
+    salt = QRandomGenerator::system()->generate();
+    records = 0;
+    clock.start();
+    qInfo() << "Recording an anonymized workload trace to" << path;
+    return true;
+}
+
+void WorkloadTrace::Recorder::close() {
+    if (file.isOpen()) {
+        file.close();
+        qInfo() << "Workload trace closed:" << records << "events in" << file.fileName();
+    }
+}
+
+void WorkloadTrace::Recorder::record(Event event, QByteArrayView utf8, ContentClassifier::Kinds kinds,
+                                     quint8 formats) {
+    if (!file.isOpen()) {
+        return;
+    }
+    Record record;
+    record.event = event;
+    record.hash = quint32(qHash(utf8, salt));
+    record.size = quint32(utf8.size());
+    record.parts = quint32(utf8.count('\n') + 1);
+    record.kinds = kinds;
+    record.formats = formats;
+    write(record);
+}
+
+void WorkloadTrace::Recorder::record(Event event) {
+    if (!file.isOpen()) {
+        return;
+    }
+    Record record;
+    record.event = event;
+    write(record);
+}
+
+void WorkloadTrace::Recorder::write(const Record &record) {
+    char bytes[kRecordSize];
+    qToBigEndian<qint64>(clock.nsecsElapsed(), bytes);
+    qToBigEndian<quint32>(record.hash, bytes + 8);
+    qToBigEndian<quint32>(record.size, bytes + 12);
+    qToBigEndian<quint32>(record.parts, bytes + 16);
+    qToBigEndian<quint16>(record.kinds, bytes + 20);
+    bytes[22] = char(record.event);
+    bytes[23] = char(record.formats);
+    // Buffered by QFile; a crash loses at most the last few events
+    file.write(bytes, kRecordSize);
+    ++records;
+}
+
+WorkloadTrace::Reader::Reader(const QString &path)
+    : file(path) {
+}
+
+bool WorkloadTrace::Reader::open() {
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    const QByteArray header = file.read(kHeaderSize);
+    if (header.size() != kHeaderSize || qFromBigEndian<quint32>(header.constData()) != kTraceMagic) {
+        error = "Not an Xclipy workload trace";
+        return false;
+    }
+    if (qFromBigEndian<quint32>(header.constData() + 4) != kTraceVersion) {
+        error = "Unsupported workload trace version";
+        return false;
+    }
+    return true;
+}
+
+bool WorkloadTrace::Reader::next(Record *record) {
+    char bytes[kRecordSize];
+    const qint64 read = file.read(bytes, kRecordSize);
+    if (read != kRecordSize) {
+        // A partial record is the tail of a trace cut short by a crash
+        return false;
+    }
+    const quint8 event = quint8(bytes[22]);
+    if (event < quint8(Event::Text) || event > quint8(Event::Clear)) {
+        error = QString("Damaged record at offset %1").arg(file.pos() - kRecordSize);
+        return false;
+    }
+    record->atNs = qFromBigEndian<qint64>(bytes);
+    record->hash = qFromBigEndian<quint32>(bytes + 8);
+    record->size = qFromBigEndian<quint32>(bytes + 12);
+    record->parts = qFromBigEndian<quint32>(bytes + 16);
+    record->kinds = qFromBigEndian<quint16>(bytes + 20);
+    record->event = Event(event);
+    record->formats = quint8(bytes[23]);
+    return true;
+}
+
+QString WorkloadTrace::synthesize(const Record &record) {
+    Synthesizer random(record.hash);
+    const int size = int(qMin<quint32>(record.size, 256u * 1024 * 1024));
+    const int lines = int(qMax<quint32>(1, record.parts));
+    const QString id = QString::number(record.hash, 16);
+    const ContentClassifier::Kinds kinds = record.kinds;
+
+    if (kinds & ContentClassifier::Secret) {
+        return ("ghp_" + id + random.token(size)).left(qMax(size, 1));
+    }
+    if (kinds & ContentClassifier::Url) {
+        QString text = "https://example.org/" + id;
+        while (text.size() < size) {
+            text += '/' + random.word(3 + int(random.next() % 6));
+        }
+        return text.left(qMax(size, 24));
+    }
+    if (kinds & ContentClassifier::Email) {
+        return "user" + id + "@example.org";
+    }
+    if (kinds & ContentClassifier::Color) {
+        return QString("#%1").arg(record.hash & 0xffffff, 6, 16, QChar('0'));
+    }
+    if (kinds & ContentClassifier::Json) {
+        // One long string value keeps it valid JSON at any size
+        const QString head = "{\"id\": \"" + id + "\", \"data\": \"";
+        QString body = random.word(qMax(0, size - int(head.size()) - 2));
+        return head + body + "\"}";
+    }
+    if (kinds & ContentClassifier::Command) {
+        return fitted("git log --oneline " + id + " | grep", size, lines, &random);
+    }
+    if (kinds & ContentClassifier::Code) {
+        QString text;
+        while (text.size() < size) {
+            text += QString("    int v%1 = compute(%2);\n").arg(random.next() % 1000).arg(id);
+        }
+        text.truncate(qMax(size, 1));
+        return text;
+    }
+    if (kinds & ContentClassifier::FilePath) {
+        return synthesizeFiles(record).join('\n').left(qMax(size, 1));
+    }
+    return fitted("clip " + id, qMax(size, 1), lines, &random);
+}
+
+QStringList WorkloadTrace::synthesizeFiles(const Record &record) {
+    Synthesizer random(record.hash);
+    const int count = int(qBound<quint32>(1, record.parts, 10000));
+    const int length = qMax(24, int(record.size) / count - 1);
+    const QString prefix = "/home/user/trace/" + QString::number(record.hash, 16) + "-";
+    QStringList files;
+    for (int i = 0; i < count; ++i) {
+        QString path = prefix + QString::number(i) + "-";
+        path += random.word(qMax(1, length - int(path.size()) - 4)) + ".txt";
+        files.append(path);
+    }
+    return files;
+}
+
+QString WorkloadTrace::defaultDirectory() {
+    return HistoryStore::defaultDirectory() + "/traces";
+}
+
+QString WorkloadTrace::newTracePath() {
+    return defaultDirectory() + "/trace-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".xct";
+}
@@ -3,11 +3,34 @@
 #include <QMenu>
 #include <QAction>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QDir>
+#include <QFileDialog>
+#include <memory>
 #include "../include/ClipboardManager.h"
 #include "../include/HistoryWindow.h"
 #include "../include/PreferencesWindow.h"
+#include "../include/Benchmarks.h"
+#include "../include/ClipboardDriver.h"
+#include "../include/SingleInstance.h"
 
 int main(int argc, char *argv[]) {
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
+    // Headless benchmark mode; must not touch the display
+    if (Benchmarks::isBenchmarkInvocation(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return Benchmarks::run(app.arguments());
+    }
+
+    // Synthetic clipboard owner for scripts/e2e-capture.sh; no tray, no single-instance lock
+    if (ClipboardDriver::isDriverInvocation(argc, argv)) {
+        QGuiApplication app(argc, argv);
+        return ClipboardDriver::run(app.arguments());
+    }
+
     QApplication app(argc, argv);
     
     // Set application properties
@@ -22,10 +45,39 @@ int main(int argc, char *argv[]) {
     // Don't quit when last window is closed
     app.setQuitOnLastWindowClosed(false);
 
-    // Core manager + GUI
+    // One instance per user and display; a second start shows the first one's history
+    SingleInstance instance;
+    if (!instance.acquire()) {
+        instance.activateRunning();
+        return 0;
+    }
+
+    // Capture engine first; history loads in the background once the tray is up
     ClipboardManager manager;
-    HistoryWindow historyWin(&manager);
-    PreferencesWindow prefsWin(&manager);
+
+    // Windows are built on first use
+    std::unique_ptr<HistoryWindow> historyWin;
+    std::unique_ptr<PreferencesWindow> prefsWin;
+
+    auto historyWindow = [&]() -> HistoryWindow * {
+        if (!historyWin) {
+            historyWin = std::make_unique<HistoryWindow>(&manager);
+            // Sync manager → window
+            HistoryWindow *window = historyWin.get();
+            QObject::connect(&manager, &ClipboardManager::historyChanged, window, [&manager, window]() {
+                window->updateHistory(manager.historySnapshot());
+            });
+            window->updateHistory(manager.historySnapshot());
+        }
+        return historyWin.get();
+    };
+
+    auto preferencesWindow = [&]() -> PreferencesWindow * {
+        if (!prefsWin) {
+            prefsWin = std::make_unique<PreferencesWindow>(&manager);
+        }
+        return prefsWin.get();
+    };
 
     // Tray icon
     QSystemTrayIcon tray;
@@ -36,18 +88,55 @@ int main(int argc, char *argv[]) {
     // Tray menu
     QMenu menu;
     QAction showHistoryAction("Show History");
+    QMenu selectionsMenu("Recent Selections");
     QAction preferencesAction("Preferences");
+    QAction exportAction("Export History...");
+    QAction importAction("Import History...");
     QAction clearAction("Clear History");
     QAction quitAction("Quit");
 
     QObject::connect(&showHistoryAction, &QAction::triggered, [&]() {
-        historyWin.showWindow();
+        historyWindow()->showWindow();
     });
 
     QObject::connect(&preferencesAction, &QAction::triggered, [&]() {
-        prefsWin.show();
-        prefsWin.raise();
-        prefsWin.activateWindow();
+        PreferencesWindow *prefs = preferencesWindow();
+        prefs->show();
+        prefs->raise();
+        prefs->activateWindow();
+    });
+
+    const QString exportFilter = "Xclipy history (*.xce);;All files (*)";
+    QObject::connect(&exportAction, &QAction::triggered, [&]() {
+        const QString path = QFileDialog::getSaveFileName(nullptr, "Export History",
+                                                          QDir::homePath() + "/xclipy-history.xce", exportFilter);
+        if (!path.isEmpty() && !manager.exportHistory(path)) {
+            tray.showMessage("Xclipy", "An export is already running");
+        }
+    });
+
+    QObject::connect(&importAction, &QAction::triggered, [&]() {
+        const QString path = QFileDialog::getOpenFileName(nullptr, "Import History", QDir::homePath(), exportFilter);
+        if (!path.isEmpty()) {
+            manager.importHistory(path);
+        }
+    });
+
+    QObject::connect(&manager, &ClipboardManager::exportFinished, [&](const HistoryExport::Stats &stats) {
+        tray.showMessage("Xclipy", stats.ok
+            ? QString("Exported %1 entries (%2 entries/s)").arg(stats.entries).arg(stats.entriesPerSecond())
+            : QString("Export failed: %1").arg(stats.error));
+    });
+
+    QObject::connect(&manager, &ClipboardManager::importFinished, [&](const HistoryExport::Stats &stats) {
+        QString message = QString("Imported %1 new entries, %2 archived, %3 duplicates (%4 entries/s)")
+                              .arg(stats.added).arg(stats.archived).arg(stats.duplicates)
+                              .arg(stats.entriesPerSecond());
+        if (!stats.ok) {
+            message = stats.entries > 0 ? message + "\nStopped early: " + stats.error
+                                        : "Import failed: " + stats.error;
+        }
+        tray.showMessage("Xclipy", message);
     });
 
     QObject::connect(&clearAction, &QAction::triggered, [&]() {
@@ -60,8 +149,35 @@ int main(int argc, char *argv[]) {
         app.quit();
     });
 
+    // Built on demand so selection captures never touch the menu
+    QObject::connect(&selectionsMenu, &QMenu::aboutToShow, [&]() {
+        selectionsMenu.clear();
+        HistorySnapshotRef snapshot = manager.historySnapshot();
+        snapshot->selections.forEach([&](const HistoryEntry &entry) {
+            QString label = entry.body.preview(1, 240).simplified();
+            if (label.length() > 60) {
+                label = label.left(57) + "...";
+            }
+            QAction *action = selectionsMenu.addAction(label);
+            // The entry keeps its arena slab alive; decode on use
+            Utf8Entry body = entry.body;
+            QObject::connect(action, &QAction::triggered, [&manager, body]() {
+                manager.setClipboardText(body.toString());
+            });
+            return true;
+        });
+        if (selectionsMenu.isEmpty()) {
+            selectionsMenu.addAction("(none)")->setEnabled(false);
+        }
+    });
+
     menu.addAction(&showHistoryAction);
+    if (manager.isSelectionSupported()) {
+        menu.addMenu(&selectionsMenu);
+    }
     menu.addAction(&preferencesAction);
+    menu.addAction(&exportAction);
+    menu.addAction(&importAction);
     menu.addSeparator();
     menu.addAction(&clearAction);
     menu.addSeparator();
@@ -72,26 +188,33 @@ int main(int argc, char *argv[]) {
     if (manager.getShowTrayIcon()) {
         tray.show();
     }
+    QObject::connect(&manager, &ClipboardManager::settingsChanged, &tray, [&]() {
+        tray.setVisible(manager.getShowTrayIcon());
+    });
+    qInfo() << "Startup: time-to-tray" << startupTimer.elapsed() << "ms";
 
-    // Sync manager → window
-    QObject::connect(&manager, &ClipboardManager::historyChanged,
-                     &historyWin, &HistoryWindow::updateHistory);
+    QObject::connect(&manager, &ClipboardManager::historyReady, [&]() {
+        qInfo() << "Startup: time-to-history-ready" << startupTimer.elapsed() << "ms";
+    });
+    manager.loadHistoryAsync();
     
+    QObject::connect(&instance, &SingleInstance::activationRequested, [&]() {
+        historyWindow()->showWindow();
+    });
+
     // Connect global hotkey to toggle history
     QObject::connect(&manager, &ClipboardManager::toggleHistoryRequested, [&]() {
-        if (historyWin.isVisible()) {
-            historyWin.hide();
+        if (historyWin && historyWin->isVisible()) {
+            historyWin->hide();
         } else {
-            historyWin.showWindow();
+            historyWindow()->showWindow();
         }
     });
 
-    // Initialize window with saved history
-    historyWin.updateHistory(manager.getHistory());
-
     // Handle application state changes
     QObject::connect(&app, &QApplication::aboutToQuit, [&]() {
         manager.saveSettings();
+        manager.logPipelineStats();
     });
 
     return app.exec();